@@ -0,0 +1,68 @@
+/// One point of an auto-brightness response curve: the brightness
+/// (0.0-1.0) a display should have at [lux]. Brightness is interpolated
+/// linearly in log lux between points.
+typedef AmbientCurvePoint = ({double lux, double brightness});
+
+/// State of the native ambient-light auto-brightness engine.
+final class AutoBrightnessStatus {
+  const AutoBrightnessStatus({
+    required this.available,
+    required this.enabled,
+    this.sensor,
+    this.lux,
+    this.samples = 0,
+    this.error,
+    this.targets = const {},
+    this.offsets = const {},
+  });
+
+  /// Whether an ambient light sensor with a buffered illuminance channel
+  /// was found.
+  final bool available;
+  final bool enabled;
+
+  /// The sensor's IIO device name, e.g. `als`.
+  final String? sensor;
+
+  /// Smoothed illuminance, once the sensor has reported.
+  final double? lux;
+
+  /// Samples received since startup.
+  final int samples;
+
+  /// Why the sensor could not be used: `no sensor`, `busy` (another
+  /// reader owns the buffer), `permission`, `unsupported` or
+  /// `sensor closed`.
+  final String? error;
+
+  /// Brightness each managed display was last faded to, by display ID.
+  final Map<String, double> targets;
+
+  /// Offset learned from manual changes, added to each display's curve.
+  final Map<String, double> offsets;
+
+  factory AutoBrightnessStatus.fromMap(Map<String, dynamic> map) {
+    final displays = (map['displays'] as Map<dynamic, dynamic>?) ?? const {};
+    return AutoBrightnessStatus(
+      available: map['available'] as bool? ?? false,
+      enabled: map['enabled'] as bool? ?? false,
+      sensor: map['sensor'] as String?,
+      lux: (map['lux'] as num?)?.toDouble(),
+      samples: map['samples'] as int? ?? 0,
+      error: map['error'] as String?,
+      targets: {
+        for (final MapEntry(:key, :value) in displays.entries)
+          key as String: ((value as Map)['target'] as num).toDouble(),
+      },
+      offsets: {
+        for (final MapEntry(:key, :value) in displays.entries)
+          key as String: ((value as Map)['offset'] as num).toDouble(),
+      },
+    );
+  }
+
+  @override
+  String toString() =>
+      'AutoBrightnessStatus(enabled: $enabled, sensor: $sensor, lux: $lux, '
+      'error: $error)';
+}
@@ -0,0 +1,219 @@
+/// Call counters and a latency histogram for one brightness backend.
+///
+/// [histogram] has one entry per bucket: bucket `i` counts calls that took
+/// at most `bucketBoundsUs[i]` microseconds, and the final bucket counts
+/// everything slower than the last bound.
+final class BackendStats {
+  const BackendStats({
+    required this.ok,
+    required this.failed,
+    required this.fellBack,
+    required this.totalUs,
+    required this.histogram,
+    required this.bucketBoundsUs,
+  });
+
+  /// Calls that succeeded on this backend.
+  final int ok;
+
+  /// Calls that failed with no further backend to try.
+  final int failed;
+
+  /// Calls that failed here and were handed to the next backend.
+  final int fellBack;
+
+  /// Summed wall-clock time of all calls, in microseconds.
+  final int totalUs;
+
+  /// Call counts per latency bucket.
+  final List<int> histogram;
+
+  /// Upper bound of each bounded bucket, in microseconds.
+  final List<int> bucketBoundsUs;
+
+  /// Total number of recorded calls.
+  int get calls => ok + failed + fellBack;
+
+  /// Mean latency, or `null` if nothing was recorded.
+  Duration? get mean =>
+      calls == 0 ? null : Duration(microseconds: totalUs ~/ calls);
+
+  /// Upper bound of the bucket holding the [q] quantile (0.0-1.0).
+  ///
+  /// Returns `null` if nothing was recorded or the quantile falls in the
+  /// unbounded last bucket.
+  Duration? percentile(double q) {
+    if (calls == 0) return null;
+    final target = (q.clamp(0.0, 1.0) * calls).ceil().clamp(1, calls);
+    var seen = 0;
+    for (var i = 0; i < histogram.length; i++) {
+      seen += histogram[i];
+      if (seen >= target) {
+        return i < bucketBoundsUs.length
+            ? Duration(microseconds: bucketBoundsUs[i])
+            : null;
+      }
+    }
+    return null;
+  }
+
+  factory BackendStats.fromMap(
+    Map<String, dynamic> map,
+    List<int> bucketBoundsUs,
+  ) {
+    final histogram = map['histogram'];
+    if (histogram is! List) {
+      throw FormatException(
+        'BackendStats.fromMap: "histogram" must be a List, got ${histogram.runtimeType}',
+      );
+    }
+    return BackendStats(
+      ok: map['ok'] as int? ?? 0,
+      failed: map['failed'] as int? ?? 0,
+      fellBack: map['fellBack'] as int? ?? 0,
+      totalUs: map['totalUs'] as int? ?? 0,
+      histogram: histogram.cast<int>(),
+      bucketBoundsUs: bucketBoundsUs,
+    );
+  }
+
+  @override
+  String toString() =>
+      'BackendStats(ok: $ok, failed: $failed, fellBack: $fellBack, '
+      'mean: ${mean?.inMicroseconds}us)';
+}
+
+/// Idle cost of the resident tray mode (`--tray`), measured natively at
+/// each hide and show of the window.
+final class ResidentStats {
+  const ResidentStats({
+    required this.hidden,
+    required this.hiddenTime,
+    required this.hiddenCpuTime,
+    required this.rssKb,
+    required this.rssAtHideKb,
+    required this.shows,
+    this.lastShowLatency,
+  });
+
+  /// Whether the window is hidden right now.
+  final bool hidden;
+
+  /// Total time spent hidden, including the current interval.
+  final Duration hiddenTime;
+
+  /// Process CPU time (all threads) consumed while hidden.
+  final Duration hiddenCpuTime;
+
+  /// Current resident set size in KiB.
+  final int rssKb;
+
+  /// Resident set size shortly after the last hide, once caches were
+  /// released, in KiB; `-1` before the first hide.
+  final int rssAtHideKb;
+
+  /// Times the window was shown again after being hidden.
+  final int shows;
+
+  /// From the last activation to the window being mapped.
+  final Duration? lastShowLatency;
+
+  /// Fraction of one CPU used while hidden.
+  double get idleCpuShare => hiddenTime == Duration.zero
+      ? 0.0
+      : hiddenCpuTime.inMicroseconds / hiddenTime.inMicroseconds;
+
+  factory ResidentStats.fromMap(Map<String, dynamic> map) {
+    final lastShowMs = map['lastShowMs'] as num?;
+    return ResidentStats(
+      hidden: map['hidden'] as bool? ?? false,
+      hiddenTime: Duration(milliseconds: map['hiddenMs'] as int? ?? 0),
+      hiddenCpuTime: Duration(milliseconds: map['hiddenCpuMs'] as int? ?? 0),
+      rssKb: map['rssKb'] as int? ?? -1,
+      rssAtHideKb: map['rssAtHideKb'] as int? ?? -1,
+      shows: map['shows'] as int? ?? 0,
+      lastShowLatency: lastShowMs == null
+          ? null
+          : Duration(microseconds: (lastShowMs * 1000).round()),
+    );
+  }
+
+  @override
+  String toString() =>
+      'ResidentStats(hidden: $hidden, hiddenTime: $hiddenTime, '
+      'hiddenCpuTime: $hiddenCpuTime, rssKb: $rssKb)';
+}
+
+/// Snapshot of the native backend counters returned by `getStats`.
+final class DisplayControlStats {
+  const DisplayControlStats({
+    required this.bucketBoundsUs,
+    this.backends = const {},
+    this.displays = const {},
+    this.skippedWrites = const {},
+    this.resident,
+  });
+
+  /// Upper bound of each bounded histogram bucket, in microseconds.
+  final List<int> bucketBoundsUs;
+
+  /// Process-wide stats keyed by backend name (`ddc`, `libddcutil`,
+  /// `ddcutil`, `xrandr`, `mutter`, `backlight`, `kms`, `wlr`). Backends
+  /// that were never called are absent.
+  final Map<String, BackendStats> backends;
+
+  /// Per-display stats keyed by display ID, then by backend name.
+  final Map<String, Map<String, BackendStats>> displays;
+
+  /// Hardware writes skipped because the value was already applied, keyed
+  /// by write path (`ddc`, `xrandr`, `backlight`, `gamma`).
+  final Map<String, int> skippedWrites;
+
+  /// Idle cost of the tray mode, or `null` when not running resident.
+  final ResidentStats? resident;
+
+  factory DisplayControlStats.fromMap(Map<String, dynamic> map) {
+    final bounds = map['bucketBoundsUs'];
+    if (bounds is! List) {
+      throw FormatException(
+        'DisplayControlStats.fromMap: "bucketBoundsUs" must be a List, got ${bounds.runtimeType}',
+      );
+    }
+    final bucketBoundsUs = bounds.cast<int>();
+
+    Map<String, BackendStats> parseSet(Object? raw) => {
+      for (final MapEntry(:key, :value)
+          in (raw as Map<dynamic, dynamic>? ?? const {}).entries)
+        key as String: BackendStats.fromMap(
+          Map<String, dynamic>.from(value as Map<dynamic, dynamic>),
+          bucketBoundsUs,
+        ),
+    };
+
+    final rawDisplays = map['displays'] as Map<dynamic, dynamic>? ?? const {};
+    final rawSkipped =
+        map['skippedWrites'] as Map<dynamic, dynamic>? ?? const {};
+    final rawResident = map['resident'] as Map<dynamic, dynamic>?;
+
+    return DisplayControlStats(
+      bucketBoundsUs: bucketBoundsUs,
+      backends: parseSet(map['backends']),
+      displays: {
+        for (final MapEntry(:key, :value) in rawDisplays.entries)
+          key as String: parseSet(value),
+      },
+      skippedWrites: {
+        for (final MapEntry(:key, :value) in rawSkipped.entries)
+          key as String: value as int,
+      },
+      resident: rawResident == null
+          ? null
+          : ResidentStats.fromMap(Map<String, dynamic>.from(rawResident)),
+    );
+  }
+
+  @override
+  String toString() =>
+      'DisplayControlStats(${backends.length} backends, '
+      '${displays.length} displays)';
+}
@@ -0,0 +1,45 @@
+/// State of the native brightness-key listener.
+final class BrightnessHotkeysStatus {
+  const BrightnessHotkeysStatus({
+    required this.enabled,
+    this.targets = 'external',
+    this.displayIds = const [],
+    this.devices = const [],
+    this.error,
+    this.presses = 0,
+  });
+
+  final bool enabled;
+
+  /// Which displays the keys step: `external` (all but the built-in
+  /// panel), `all`, or `list` for [displayIds].
+  final String targets;
+  final List<String> displayIds;
+
+  /// Names of the input devices being listened to.
+  final List<String> devices;
+
+  /// Why no device is listened to: `no devices` or `permission` (the
+  /// user cannot read `/dev/input`).
+  final String? error;
+
+  /// Brightness key presses handled since startup.
+  final int presses;
+
+  factory BrightnessHotkeysStatus.fromMap(Map<String, dynamic> map) {
+    return BrightnessHotkeysStatus(
+      enabled: map['enabled'] as bool? ?? false,
+      targets: map['targets'] as String? ?? 'external',
+      displayIds:
+          (map['displays'] as List<dynamic>?)?.cast<String>() ?? const [],
+      devices: (map['devices'] as List<dynamic>?)?.cast<String>() ?? const [],
+      error: map['error'] as String?,
+      presses: map['presses'] as int? ?? 0,
+    );
+  }
+
+  @override
+  String toString() =>
+      'BrightnessHotkeysStatus(enabled: $enabled, targets: $targets, '
+      'devices: $devices, error: $error)';
+}
@@ -0,0 +1,125 @@
+/// What a schedule entry is anchored to.
+enum ScheduleAnchor { clock, sunrise, sunset }
+
+/// One entry of a time-of-day brightness schedule: at [at] (or
+/// [offsetMinutes] after sunrise or sunset), fade the displays in [values]
+/// to their unified value over [ramp].
+final class ScheduleEntry {
+  const ScheduleEntry.clock({
+    required int hour,
+    required int minute,
+    required this.values,
+    this.ramp = Duration.zero,
+  }) : anchor = ScheduleAnchor.clock,
+       minutes = hour * 60 + minute;
+
+  const ScheduleEntry.sun({
+    required this.anchor,
+    required this.values,
+    int offsetMinutes = 0,
+    this.ramp = Duration.zero,
+  }) : minutes = offsetMinutes,
+       assert(anchor != ScheduleAnchor.clock);
+
+  final ScheduleAnchor anchor;
+
+  /// Minutes after local midnight for [ScheduleAnchor.clock]; otherwise
+  /// the offset from sunrise or sunset.
+  final int minutes;
+
+  final Duration ramp;
+
+  /// Unified value (-0.5 to 1.0) by display ID; `*` means every display.
+  /// Negative values are applied at once through gamma dimming.
+  final Map<String, double> values;
+
+  /// The platform's `at` string: `HH:MM`, `sunrise` or `sunset`.
+  String get at => switch (anchor) {
+    ScheduleAnchor.clock =>
+      '${(minutes ~/ 60).toString().padLeft(2, '0')}:'
+          '${(minutes % 60).toString().padLeft(2, '0')}',
+    ScheduleAnchor.sunrise => 'sunrise',
+    ScheduleAnchor.sunset => 'sunset',
+  };
+
+  Map<String, dynamic> toMap() => {
+    'at': at,
+    if (anchor != ScheduleAnchor.clock) 'offsetMinutes': minutes,
+    'rampMs': ramp.inMilliseconds,
+    'values': values,
+  };
+
+  factory ScheduleEntry.fromMap(Map<String, dynamic> map) {
+    final at = map['at'] as String;
+    final values = {
+      for (final MapEntry(:key, :value)
+          in (map['values'] as Map<dynamic, dynamic>).entries)
+        key as String: (value as num).toDouble(),
+    };
+    final ramp = Duration(milliseconds: map['rampMs'] as int? ?? 0);
+    if (at == 'sunrise' || at == 'sunset') {
+      return ScheduleEntry.sun(
+        anchor: at == 'sunrise' ? ScheduleAnchor.sunrise : ScheduleAnchor.sunset,
+        offsetMinutes: map['offsetMinutes'] as int? ?? 0,
+        values: values,
+        ramp: ramp,
+      );
+    }
+    final [hour, minute] = at.split(':').map(int.parse).toList();
+    return ScheduleEntry.clock(
+      hour: hour,
+      minute: minute,
+      values: values,
+      ramp: ramp,
+    );
+  }
+
+  @override
+  String toString() => 'ScheduleEntry($at, offset: '
+      '${anchor == ScheduleAnchor.clock ? 0 : minutes}, $values)';
+}
+
+/// A time-of-day brightness schedule as held by the platform side.
+final class BrightnessSchedule {
+  const BrightnessSchedule({
+    this.entries = const [],
+    this.latitude,
+    this.longitude,
+    this.activeIndex,
+    this.nextChange,
+  });
+
+  final List<ScheduleEntry> entries;
+
+  /// Location for sunrise and sunset entries; without it those entries
+  /// never fire.
+  final double? latitude;
+  final double? longitude;
+
+  /// Index into [entries] of the entry in effect, if any.
+  final int? activeIndex;
+
+  /// When the next entry takes effect.
+  final DateTime? nextChange;
+
+  factory BrightnessSchedule.fromMap(Map<String, dynamic> map) {
+    final nextAtMs = map['nextAtMs'] as int?;
+    return BrightnessSchedule(
+      entries: [
+        for (final e in (map['entries'] as List<dynamic>?) ?? const [])
+          ScheduleEntry.fromMap(Map<String, dynamic>.from(e as Map)),
+      ],
+      latitude: (map['latitude'] as num?)?.toDouble(),
+      longitude: (map['longitude'] as num?)?.toDouble(),
+      activeIndex: map['active'] as int?,
+      nextChange: nextAtMs == null
+          ? null
+          : DateTime.fromMillisecondsSinceEpoch(nextAtMs),
+    );
+  }
+
+  @override
+  String toString() =>
+      'BrightnessSchedule(${entries.length} entries, active: $activeIndex, '
+      'next: $nextChange)';
+}
@@ -6,6 +6,7 @@ final class DisplayInfo {
     required this.brightness,
     this.isBuiltIn = false,
     this.softwareBrightness = 1.0,
+    this.stableId,
   });
 
   /// Platform-specific display identifier.
@@ -27,6 +28,14 @@ final class DisplayInfo {
   /// allowing dimming below the hardware minimum.
   final double softwareBrightness;
 
+  /// Port-independent identity of the physical monitor, if known.
+  ///
+  /// On Linux this is a hash of the EDID manufacturer, product code and
+  /// serial (e.g. `edid:3f2a9c0d11e4b7a5`). Unlike [id], it does not change
+  /// when the cable is moved to another connector, so per-monitor settings
+  /// should be keyed on it when available.
+  final String? stableId;
+
   /// The effective brightness combining hardware and software dimming.
   ///
   /// Maps the unified slider range (-0.5 to 1.0) where:
@@ -46,6 +55,7 @@ final class DisplayInfo {
     double? brightness,
     bool? isBuiltIn,
     double? softwareBrightness,
+    String? stableId,
   }) {
     return DisplayInfo(
       id: id ?? this.id,
@@ -53,6 +63,7 @@ final class DisplayInfo {
       brightness: brightness ?? this.brightness,
       isBuiltIn: isBuiltIn ?? this.isBuiltIn,
       softwareBrightness: softwareBrightness ?? this.softwareBrightness,
+      stableId: stableId ?? this.stableId,
     );
   }
 
@@ -87,6 +98,7 @@ final class DisplayInfo {
       softwareBrightness: (softwareBrightness is num)
           ? softwareBrightness.toDouble()
           : 1.0,
+      stableId: map['stableId'] as String?,
     );
   }
 
@@ -97,6 +109,7 @@ final class DisplayInfo {
       'brightness': brightness,
       'isBuiltIn': isBuiltIn,
       'softwareBrightness': softwareBrightness,
+      if (stableId != null) 'stableId': stableId,
     };
   }
 
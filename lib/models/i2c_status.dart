@@ -0,0 +1,76 @@
+/// Whether the app can open the I2C buses that DDC/CI uses, as of the
+/// last display probe.
+///
+/// The [name] is what the platform side sends on the channel.
+enum I2cAccess {
+  unknown('unknown'),
+
+  /// No connected monitor exposes a DDC bus.
+  noBuses('noBuses'),
+
+  /// The buses exist but have no device nodes (`i2c-dev` is not loaded).
+  noDevices('noDevices'),
+  denied('denied'),
+  accessible('accessible');
+
+  const I2cAccess(this.name);
+
+  final String name;
+
+  static I2cAccess fromName(String? name) =>
+      values.firstWhere((a) => a.name == name, orElse: () => unknown);
+}
+
+/// Outcome of the last permission setup, remembered across sessions.
+enum I2cSetup {
+  none('none'),
+  running('running'),
+  installed('installed'),
+  declined('declined'),
+  failed('failed');
+
+  const I2cSetup(this.name);
+
+  final String name;
+
+  static I2cSetup fromName(String? name) =>
+      values.firstWhere((s) => s.name == name, orElse: () => none);
+}
+
+/// I2C permission state reported by the Linux runner.
+final class I2cStatus {
+  const I2cStatus({
+    required this.access,
+    required this.setup,
+    this.buses = const [],
+  });
+
+  final I2cAccess access;
+  final I2cSetup setup;
+
+  /// The DDC bus numbers that were checked.
+  final List<int> buses;
+
+  /// Setup installed the udev rule and group, but this session started
+  /// before the user joined the group.
+  bool get needsRelogin =>
+      access == I2cAccess.denied && setup == I2cSetup.installed;
+
+  /// Whether offering the PolicyKit setup would help.
+  bool get canRequestSetup =>
+      (access == I2cAccess.denied || access == I2cAccess.noDevices) &&
+      setup != I2cSetup.running &&
+      !needsRelogin;
+
+  factory I2cStatus.fromMap(Map<String, dynamic> map) {
+    return I2cStatus(
+      access: I2cAccess.fromName(map['access'] as String?),
+      setup: I2cSetup.fromName(map['setup'] as String?),
+      buses: (map['buses'] as List<dynamic>?)?.cast<int>() ?? const [],
+    );
+  }
+
+  @override
+  String toString() =>
+      'I2cStatus(access: ${access.name}, setup: ${setup.name}, buses: $buses)';
+}
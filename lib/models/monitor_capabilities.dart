@@ -0,0 +1,69 @@
+/// MCCS capabilities reported by a monitor over DDC/CI.
+///
+/// Lists which VCP feature codes the monitor implements, so unsupported
+/// controls can be hidden instead of discovered through timeouts.
+final class MonitorCapabilities {
+  const MonitorCapabilities({
+    required this.raw,
+    this.model = '',
+    this.type = '',
+    this.mccsVersion = '',
+    this.vcpCodes = const {},
+    this.vcpValues = const {},
+  });
+
+  /// The unparsed capabilities string.
+  final String raw;
+
+  /// Model name from the `model(...)` entry.
+  final String model;
+
+  /// Display type from the `type(...)` entry, e.g. `lcd`.
+  final String type;
+
+  /// MCCS version from the `mccs_ver(...)` entry, e.g. `2.1`.
+  final String mccsVersion;
+
+  /// Supported VCP feature codes.
+  final Set<int> vcpCodes;
+
+  /// Allowed values for non-continuous features (e.g. input sources).
+  final Map<int, List<int>> vcpValues;
+
+  /// Whether the monitor implements VCP feature [code].
+  bool supports(int code) => vcpCodes.contains(code);
+
+  factory MonitorCapabilities.fromMap(Map<String, dynamic> map) {
+    final raw = map['raw'];
+    if (raw is! String) {
+      throw FormatException(
+        'MonitorCapabilities.fromMap: "raw" must be a String, got ${raw.runtimeType}',
+      );
+    }
+
+    final codes = (map['vcpCodes'] as List<dynamic>? ?? const [])
+        .cast<int>()
+        .toSet();
+    final values = <int, List<int>>{};
+    final rawValues = map['vcpValues'] as Map<dynamic, dynamic>? ?? const {};
+    for (final MapEntry(:key, :value) in rawValues.entries) {
+      final code = int.tryParse(key as String, radix: 16);
+      if (code == null) continue;
+      values[code] = (value as List<dynamic>).cast<int>();
+    }
+
+    return MonitorCapabilities(
+      raw: raw,
+      model: map['model'] as String? ?? '',
+      type: map['type'] as String? ?? '',
+      mccsVersion: map['mccsVersion'] as String? ?? '',
+      vcpCodes: codes,
+      vcpValues: values,
+    );
+  }
+
+  @override
+  String toString() =>
+      'MonitorCapabilities(model: $model, mccs: $mccsVersion, '
+      '${vcpCodes.length} VCP codes)';
+}
@@ -0,0 +1,13 @@
+/// Easing curve for a native brightness transition.
+///
+/// The [name] is what the platform side expects on the channel.
+enum TransitionCurve {
+  linear('linear'),
+  easeIn('easeIn'),
+  easeOut('easeOut'),
+  easeInOut('easeInOut');
+
+  const TransitionCurve(this.name);
+
+  final String name;
+}
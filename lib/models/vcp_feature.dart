@@ -0,0 +1,74 @@
+/// Well-known MCCS VCP (Virtual Control Panel) feature codes.
+abstract final class VcpCode {
+  static const int brightness = 0x10;
+  static const int contrast = 0x12;
+  static const int colorPreset = 0x14;
+  static const int inputSource = 0x60;
+  static const int volume = 0x62;
+  static const int mute = 0x8D;
+  static const int powerMode = 0xD6;
+}
+
+/// A single VCP read or write in a batch sent to one monitor.
+///
+/// A request with a [value] writes the feature; one without reads it.
+final class VcpRequest {
+  const VcpRequest.get(this.code) : value = null;
+
+  const VcpRequest.set(this.code, int this.value);
+
+  /// VCP feature code, e.g. [VcpCode.contrast].
+  final int code;
+
+  /// Value to write, or `null` to read the feature.
+  final int? value;
+
+  Map<String, dynamic> toMap() {
+    return {
+      'code': code,
+      if (value != null) 'value': value,
+    };
+  }
+}
+
+/// Result of one [VcpRequest].
+final class VcpResult {
+  const VcpResult({
+    required this.code,
+    required this.ok,
+    this.current = 0,
+    this.max = 0,
+  });
+
+  /// VCP feature code this result belongs to.
+  final int code;
+
+  /// Whether the monitor accepted the read or write.
+  final bool ok;
+
+  /// Current value (for writes, the value that was written).
+  final int current;
+
+  /// Maximum value reported by the monitor (reads only).
+  final int max;
+
+  factory VcpResult.fromMap(Map<String, dynamic> map) {
+    final code = map['code'];
+    if (code is! int) {
+      throw FormatException(
+        'VcpResult.fromMap: "code" must be an int, got ${code.runtimeType}',
+      );
+    }
+    return VcpResult(
+      code: code,
+      ok: map['ok'] as bool? ?? false,
+      current: map['current'] as int? ?? 0,
+      max: map['max'] as int? ?? 0,
+    );
+  }
+
+  @override
+  String toString() =>
+      'VcpResult(code: 0x${code.toRadixString(16)}, ok: $ok, '
+      'current: $current, max: $max)';
+}
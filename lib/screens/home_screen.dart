@@ -1,9 +1,13 @@
 import 'dart:async';
 
 import 'package:flutter/material.dart';
+import 'package:flutter/services.dart';
 
+import '../models/auto_brightness.dart';
 import '../models/display_info.dart';
+import '../models/i2c_status.dart';
 import '../services/brightness_service.dart';
+import '../widgets/backend_stats_panel.dart';
 import '../widgets/display_brightness_card.dart';
 
 /// The main home screen showing all connected displays.
@@ -21,19 +25,62 @@ class _HomeScreenState extends State<HomeScreen> {
   bool _isLoading = true;
   String? _error;
   Timer? _debounceTimer;
+  StreamSubscription<({String displayId, double value})>? _changes;
+  StreamSubscription<I2cStatus>? _i2cChanges;
+  I2cStatus? _i2cStatus;
+  AutoBrightnessStatus? _autoBrightness;
+
+  /// When each display's slider last moved, to ignore late echoes of our
+  /// own writes while the user is still dragging.
+  final _lastLocalChange = <String, DateTime>{};
 
   @override
   void initState() {
     super.initState();
     _loadDisplays();
+    _changes = _brightnessService.brightnessChanges.listen(_onPlatformChange);
+    _i2cChanges = _brightnessService.i2cStatusChanges.listen(
+      (status) => setState(() => _i2cStatus = status),
+    );
   }
 
   @override
   void dispose() {
     _debounceTimer?.cancel();
+    _changes?.cancel();
+    _i2cChanges?.cancel();
     super.dispose();
   }
 
+  void _onPlatformChange(({String displayId, double value}) change) {
+    final last = _lastLocalChange[change.displayId];
+    if (last != null &&
+        DateTime.now().difference(last) < const Duration(milliseconds: 500)) {
+      return;
+    }
+    setState(() {
+      _displays = [
+        for (final d in _displays)
+          d.id == change.displayId ? _withUnifiedValue(d, change.value) : d,
+      ];
+    });
+  }
+
+  /// Splits the unified slider value (-0.5 to 1.0) into its parts.
+  ///
+  /// - [0.0, 1.0]: hardware brightness = value, software gamma = 1.0
+  /// - [-0.5, 0.0): hardware brightness = 0, software gamma = 1.0 + 2*value
+  static DisplayInfo _withUnifiedValue(DisplayInfo display, double value) {
+    if (value >= 0.0) {
+      return display.copyWith(brightness: value, softwareBrightness: 1.0);
+    }
+    // Map -0.5 → 0.0, 0.0 → 1.0
+    return display.copyWith(
+      brightness: 0.0,
+      softwareBrightness: 1.0 + value * 2.0,
+    );
+  }
+
   Future<void> _loadDisplays() async {
     setState(() {
       _isLoading = true;
@@ -42,9 +89,13 @@ class _HomeScreenState extends State<HomeScreen> {
 
     try {
       final displays = await _brightnessService.getDisplays();
+      final i2cStatus = await _loadI2cStatus();
+      final autoBrightness = await _loadAutoBrightness();
       if (!mounted) return;
       setState(() {
         _displays = displays;
+        _i2cStatus = i2cStatus;
+        _autoBrightness = autoBrightness;
         _isLoading = false;
       });
     } catch (e) {
@@ -56,59 +107,74 @@ class _HomeScreenState extends State<HomeScreen> {
     }
   }
 
+  /// `null` on platforms without DDC/CI permission handling.
+  Future<I2cStatus?> _loadI2cStatus() async {
+    try {
+      return await _brightnessService.getI2cStatus();
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  /// `null` on platforms without an auto-brightness engine.
+  Future<AutoBrightnessStatus?> _loadAutoBrightness() async {
+    try {
+      return await _brightnessService.getAutoBrightness();
+    } on MissingPluginException {
+      return null;
+    }
+  }
+
+  Future<void> _toggleAutoBrightness() async {
+    final enable = !(_autoBrightness?.enabled ?? false);
+    final status = await _brightnessService.setAutoBrightness(enabled: enable);
+    if (!mounted) return;
+    setState(() => _autoBrightness = status);
+    if (enable && !status.enabled) {
+      ScaffoldMessenger.of(context).showSnackBar(
+        SnackBar(
+          content: Text(
+            'Ambient light sensor unavailable (${status.error ?? 'unknown'})',
+          ),
+          behavior: SnackBarBehavior.floating,
+          duration: const Duration(seconds: 2),
+        ),
+      );
+    }
+  }
+
+  Future<void> _requestI2cAccess() async {
+    final status = await _brightnessService.setupI2cPermissions();
+    if (!mounted) return;
+    setState(() => _i2cStatus = status);
+    // Monitors that were unreachable may now answer over DDC/CI.
+    if (status.access == I2cAccess.accessible) _loadDisplays();
+  }
+
   /// Handles the unified slider value (-0.5 to 1.0).
   ///
-  /// - [0.0, 1.0]: hardware brightness = value, software gamma = 1.0
-  /// - [-0.5, 0.0): hardware brightness = 0, software gamma = 1.0 + 2*value
+  /// The split in [_withUnifiedValue] only drives the optimistic UI state;
+  /// the platform call sends the unified value and decomposes it natively.
   void _onBrightnessChanged(DisplayInfo display, double value) {
-    // Decompose unified slider value into hardware + software components.
-    final double hardwareBrightness;
-    final double softwareGamma;
-
-    if (value >= 0.0) {
-      hardwareBrightness = value;
-      softwareGamma = 1.0;
-    } else {
-      hardwareBrightness = 0.0;
-      // Map -0.5 → 0.0, 0.0 → 1.0
-      softwareGamma = 1.0 + (value * 2.0);
-    }
+    _lastLocalChange[display.id] = DateTime.now();
 
     // Update UI immediately for responsiveness.
     setState(() {
-      _displays = _displays.map((d) {
-        if (d.id == display.id) {
-          return d.copyWith(
-            brightness: hardwareBrightness,
-            softwareBrightness: softwareGamma,
-          );
-        }
-        return d;
-      }).toList();
+      _displays = [
+        for (final d in _displays)
+          d.id == display.id ? _withUnifiedValue(d, value) : d,
+      ];
     });
 
     // Debounce the actual platform calls to avoid flooding.
     _debounceTimer?.cancel();
     _debounceTimer = Timer(const Duration(milliseconds: 16), () async {
       try {
-        // Always set hardware brightness.
-        await _brightnessService.setBrightness(
+        // One call; the platform splits it into hardware + gamma.
+        await _brightnessService.setEffectiveBrightness(
           displayId: display.id,
-          brightness: hardwareBrightness,
+          value: value,
         );
-        // Set software gamma (1.0 = normal, <1.0 = dimmed).
-        if (softwareGamma < 1.0) {
-          await _brightnessService.setSoftwareBrightness(
-            displayId: display.id,
-            gamma: softwareGamma,
-          );
-        } else {
-          // Reset gamma to normal when not in software dimming range.
-          await _brightnessService.setSoftwareBrightness(
-            displayId: display.id,
-            gamma: 1.0,
-          );
-        }
       } catch (e) {
         if (!mounted) return;
         ScaffoldMessenger.of(context).showSnackBar(
@@ -133,6 +199,26 @@ class _HomeScreenState extends State<HomeScreen> {
         title: const Text('Display Control'),
         centerTitle: true,
         actions: [
+          if (_autoBrightness case AutoBrightnessStatus(available: true, :final enabled))
+            IconButton(
+              onPressed: _toggleAutoBrightness,
+              isSelected: enabled,
+              icon: const Icon(Icons.brightness_auto_outlined),
+              selectedIcon: const Icon(Icons.brightness_auto),
+              tooltip: enabled
+                  ? 'Turn off auto-brightness'
+                  : 'Turn on auto-brightness',
+            ),
+          IconButton(
+            onPressed: () => showModalBottomSheet<void>(
+              context: context,
+              isScrollControlled: true,
+              showDragHandle: true,
+              builder: (context) => const BackendStatsPanel(),
+            ),
+            icon: const Icon(Icons.query_stats),
+            tooltip: 'Backend statistics',
+          ),
           IconButton(
             onPressed: _loadDisplays,
             icon: const Icon(Icons.refresh),
@@ -152,17 +238,31 @@ class _HomeScreenState extends State<HomeScreen> {
           itemCount: _displays.length + 1,
           itemBuilder: (context, index) {
             if (index == 0) {
-              return Padding(
-                padding: const EdgeInsets.symmetric(
-                  horizontal: 24,
-                  vertical: 8,
-                ),
-                child: Text(
-                  '${_displays.length} display${_displays.length == 1 ? '' : 's'} detected',
-                  style: theme.textTheme.bodyMedium?.copyWith(
-                    color: theme.colorScheme.onSurfaceVariant,
+              final i2cStatus = _i2cStatus;
+              return Column(
+                crossAxisAlignment: CrossAxisAlignment.stretch,
+                children: [
+                  if (i2cStatus != null &&
+                      (i2cStatus.canRequestSetup ||
+                          i2cStatus.needsRelogin ||
+                          i2cStatus.setup == I2cSetup.running))
+                    _I2cAccessBanner(
+                      status: i2cStatus,
+                      onRequest: _requestI2cAccess,
+                    ),
+                  Padding(
+                    padding: const EdgeInsets.symmetric(
+                      horizontal: 24,
+                      vertical: 8,
+                    ),
+                    child: Text(
+                      '${_displays.length} display${_displays.length == 1 ? '' : 's'} detected',
+                      style: theme.textTheme.bodyMedium?.copyWith(
+                        color: theme.colorScheme.onSurfaceVariant,
+                      ),
+                    ),
                   ),
-                ),
+                ],
               );
             }
             final display = _displays[index - 1];
@@ -178,6 +278,58 @@ class _HomeScreenState extends State<HomeScreen> {
   }
 }
 
+/// Explains why external monitors fall back to slower backends and offers
+/// the PolicyKit setup for the I2C buses.
+class _I2cAccessBanner extends StatelessWidget {
+  const _I2cAccessBanner({required this.status, required this.onRequest});
+
+  final I2cStatus status;
+  final VoidCallback onRequest;
+
+  @override
+  Widget build(BuildContext context) {
+    final theme = Theme.of(context);
+    final message = switch (status) {
+      I2cStatus(setup: I2cSetup.running) =>
+        'Waiting for authentication to grant monitor access…',
+      I2cStatus(needsRelogin: true) =>
+        'Monitor access is set up. Log out and back in to use it.',
+      I2cStatus(setup: I2cSetup.declined) =>
+        'Monitor access was not granted, so external monitors use slower '
+            'fallbacks.',
+      _ =>
+        'External monitors need access to the I2C bus for fast, direct '
+            'brightness control.',
+    };
+    return Card(
+      margin: const EdgeInsets.fromLTRB(16, 0, 16, 8),
+      color: theme.colorScheme.secondaryContainer,
+      child: Padding(
+        padding: const EdgeInsets.fromLTRB(16, 12, 8, 12),
+        child: Row(
+          children: [
+            Icon(
+              Icons.lock_outline,
+              color: theme.colorScheme.onSecondaryContainer,
+            ),
+            const SizedBox(width: 12),
+            Expanded(
+              child: Text(
+                message,
+                style: theme.textTheme.bodyMedium?.copyWith(
+                  color: theme.colorScheme.onSecondaryContainer,
+                ),
+              ),
+            ),
+            if (status.canRequestSetup)
+              TextButton(onPressed: onRequest, child: const Text('Grant access')),
+          ],
+        ),
+      ),
+    );
+  }
+}
+
 class _ErrorView extends StatelessWidget {
   const _ErrorView({required this.message, required this.onRetry});
 
@@ -1,6 +1,17 @@
+import 'dart:async';
+
 import 'package:flutter/services.dart';
 
+import '../models/auto_brightness.dart';
+import '../models/backend_stats.dart';
+import '../models/brightness_hotkeys.dart';
+import '../models/brightness_schedule.dart';
 import '../models/display_info.dart';
+import '../models/i2c_status.dart';
+import '../models/monitor_capabilities.dart';
+import '../models/transition_curve.dart';
+import '../models/vcp_feature.dart';
+import 'native_brightness.dart';
 
 /// Service that communicates with platform-native brightness APIs
 /// via a [MethodChannel].
@@ -13,6 +24,53 @@ final class BrightnessService {
     'com.chandanbsd.bsdisplaycontrol/brightness',
   );
 
+  /// Cleared once the platform reports `setEffectiveBrightness` missing.
+  bool _hasNativeEffectiveBrightness = true;
+
+  final _brightnessChanges =
+      StreamController<({String displayId, double value})>.broadcast();
+  final _i2cStatusChanges = StreamController<I2cStatus>.broadcast();
+  bool _handlingPlatformCalls = false;
+
+  void _handlePlatformCalls() {
+    if (_handlingPlatformCalls) return;
+    _handlingPlatformCalls = true;
+    _channel.setMethodCallHandler(_handlePlatformCall);
+  }
+
+  /// Unified brightness values (-0.5 to 1.0) pushed by the platform after
+  /// every change, including ones made from the tray icon or the control
+  /// socket, and echoes of this app's own writes. Currently only emitted
+  /// on Linux.
+  Stream<({String displayId, double value})> get brightnessChanges {
+    _handlePlatformCalls();
+    return _brightnessChanges.stream;
+  }
+
+  /// I2C permission status pushed by the platform whenever a display probe
+  /// or [setupI2cPermissions] changes it. Currently only emitted on Linux.
+  Stream<I2cStatus> get i2cStatusChanges {
+    _handlePlatformCalls();
+    return _i2cStatusChanges.stream;
+  }
+
+  Future<void> _handlePlatformCall(MethodCall call) async {
+    final args = call.arguments as Map<dynamic, dynamic>;
+    switch (call.method) {
+      case 'brightnessChanged':
+        _brightnessChanges.add((
+          displayId: args['displayId'] as String,
+          value: (args['value'] as num).toDouble(),
+        ));
+      case 'i2cStatusChanged':
+        _i2cStatusChanges.add(
+          I2cStatus.fromMap(Map<String, dynamic>.from(args)),
+        );
+      default:
+        throw MissingPluginException('No handler for ${call.method}');
+    }
+  }
+
   /// Retrieves all connected displays with their current brightness levels.
   Future<List<DisplayInfo>> getDisplays() async {
     final result = await _channel.invokeMethod<List<dynamic>>('getDisplays');
@@ -61,4 +119,288 @@ final class BrightnessService {
     });
     return result ?? false;
   }
+
+  /// Sets the unified slider value (-0.5 to 1.0) for a display.
+  ///
+  /// The platform splits [value] into hardware brightness and software
+  /// gamma and only touches the gamma path when entering, moving within or
+  /// leaving the software dimming range. Platforms without a native
+  /// implementation fall back to [setBrightness] plus
+  /// [setSoftwareBrightness].
+  ///
+  /// On Linux this goes through [NativeBrightness] instead of the method
+  /// channel when the runner exports it.
+  Future<bool> setEffectiveBrightness({
+    required String displayId,
+    required double value,
+  }) async {
+    final clamped = value.clamp(-0.5, 1.0);
+    if (NativeBrightness.instance case final native?) {
+      return native.setEffectiveBrightness(displayId, clamped);
+    }
+    if (_hasNativeEffectiveBrightness) {
+      try {
+        final result = await _channel.invokeMethod<bool>(
+          'setEffectiveBrightness',
+          {'displayId': displayId, 'value': clamped},
+        );
+        return result ?? false;
+      } on MissingPluginException {
+        _hasNativeEffectiveBrightness = false;
+      }
+    }
+
+    // Map -0.5 → gamma 0.0, 0.0 → gamma 1.0.
+    final hardware = clamped >= 0.0 ? clamped : 0.0;
+    final gamma = clamped >= 0.0 ? 1.0 : 1.0 + clamped * 2.0;
+    final hardwareOk = await setBrightness(
+      displayId: displayId,
+      brightness: hardware,
+    );
+    final gammaOk = await setSoftwareBrightness(
+      displayId: displayId,
+      gamma: gamma,
+    );
+    return hardwareOk && gammaOk;
+  }
+
+  /// Sets brightness (and optionally gamma) on several displays at once.
+  ///
+  /// The native side drives every display's backend concurrently and
+  /// answers with one result per entry, keyed by display ID. Currently
+  /// only implemented on Linux.
+  Future<Map<String, bool>> setBrightnessBatch(
+    List<({String displayId, double brightness, double? gamma})> displays,
+  ) async {
+    final result = await _channel
+        .invokeMethod<List<dynamic>>('setBrightnessBatch', {
+          'displays': [
+            for (final d in displays)
+              {
+                'displayId': d.displayId,
+                'brightness': d.brightness.clamp(0.0, 1.0),
+                if (d.gamma != null) 'gamma': d.gamma!.clamp(0.0, 1.0),
+              },
+          ],
+        });
+    if (result == null) return {};
+    return {
+      for (final entry in result.cast<Map<dynamic, dynamic>>())
+        entry['displayId'] as String: entry['ok'] as bool? ?? false,
+    };
+  }
+
+  /// Fades the hardware brightness of a display to [target] over [duration].
+  ///
+  /// The ramp runs natively, so this is a single channel call regardless of
+  /// the duration. [from] defaults to the display's current brightness.
+  /// Completes with `true` once the target is reached, or `false` if the
+  /// fade failed or was superseded by another brightness change.
+  /// Currently only implemented on Linux.
+  Future<bool> transitionBrightness({
+    required String displayId,
+    required double target,
+    required Duration duration,
+    TransitionCurve curve = TransitionCurve.easeInOut,
+    double? from,
+  }) async {
+    final result = await _channel.invokeMethod<bool>('transitionBrightness', {
+      'displayId': displayId,
+      'target': target.clamp(0.0, 1.0),
+      'durationMs': duration.inMilliseconds,
+      'curve': curve.name,
+      if (from != null) 'from': from.clamp(0.0, 1.0),
+    });
+    return result ?? false;
+  }
+
+  /// Reads and/or writes several VCP features on one monitor in a single
+  /// DDC/CI bus session.
+  ///
+  /// Results are returned in the same order as [requests]. Currently only
+  /// implemented on Linux.
+  Future<List<VcpResult>> vcpBatch({
+    required String displayId,
+    required List<VcpRequest> requests,
+  }) async {
+    final result = await _channel.invokeMethod<List<dynamic>>('vcpBatch', {
+      'displayId': displayId,
+      'features': requests.map((r) => r.toMap()).toList(),
+    });
+    if (result == null) return [];
+    return result
+        .cast<Map<dynamic, dynamic>>()
+        .map((m) => VcpResult.fromMap(Map<String, dynamic>.from(m)))
+        .toList();
+  }
+
+  /// Retrieves the MCCS capabilities of a monitor.
+  ///
+  /// Results are cached natively per physical monitor; pass [refresh] to
+  /// query the monitor again. Returns `null` if the monitor does not
+  /// answer the capabilities request. Currently only implemented on Linux.
+  Future<MonitorCapabilities?> getCapabilities({
+    required String displayId,
+    bool refresh = false,
+  }) async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'getCapabilities',
+      {'displayId': displayId, 'refresh': refresh},
+    );
+    if (result == null) return null;
+    return MonitorCapabilities.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Returns per-backend call counts and latency histograms, overall and
+  /// per display, plus the skipped-write counters. Pass [reset] to zero
+  /// every counter after reading. Currently only implemented on Linux.
+  Future<DisplayControlStats> getStats({bool reset = false}) async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'getStats',
+      {'reset': reset},
+    );
+    if (result == null) return const DisplayControlStats(bucketBoundsUs: []);
+    return DisplayControlStats.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Returns the state of ambient-light auto-brightness. Currently only
+  /// implemented on Linux.
+  Future<AutoBrightnessStatus> getAutoBrightness() async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'getAutoBrightness',
+    );
+    if (result == null) {
+      return const AutoBrightnessStatus(available: false, enabled: false);
+    }
+    return AutoBrightnessStatus.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Turns ambient-light auto-brightness on or off.
+  ///
+  /// [displayIds] limits it to those displays; by default it drives every
+  /// display. [curves] replaces the response curve of the given displays
+  /// and clears their learned offsets; points must have rising lux. If the
+  /// sensor cannot be used, the result is not enabled and carries an
+  /// [AutoBrightnessStatus.error]. Currently only implemented on Linux.
+  Future<AutoBrightnessStatus> setAutoBrightness({
+    required bool enabled,
+    List<String>? displayIds,
+    Map<String, List<AmbientCurvePoint>>? curves,
+  }) async {
+    final result = await _channel
+        .invokeMethod<Map<dynamic, dynamic>>('setAutoBrightness', {
+          'enabled': enabled,
+          'displays': displayIds,
+          if (curves != null)
+            'curves': {
+              for (final MapEntry(:key, :value) in curves.entries)
+                key: [
+                  for (final p in value) [p.lux, p.brightness.clamp(0.0, 1.0)],
+                ],
+            },
+        });
+    if (result == null) {
+      return const AutoBrightnessStatus(available: false, enabled: false);
+    }
+    return AutoBrightnessStatus.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Returns the time-of-day brightness schedule and the entry in effect.
+  /// Currently only implemented on Linux.
+  Future<BrightnessSchedule> getSchedule() async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'getSchedule',
+    );
+    if (result == null) return const BrightnessSchedule();
+    return BrightnessSchedule.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Replaces the time-of-day brightness schedule. The platform side saves
+  /// it, applies the entry now in effect and applies each later entry when
+  /// it falls due, whether or not the window is open. Sunrise and sunset
+  /// entries need [latitude] and [longitude]. An empty [entries] list turns
+  /// the schedule off. Currently only implemented on Linux.
+  Future<BrightnessSchedule> setSchedule(
+    List<ScheduleEntry> entries, {
+    double? latitude,
+    double? longitude,
+  }) async {
+    final result = await _channel
+        .invokeMethod<Map<dynamic, dynamic>>('setSchedule', {
+          'entries': [for (final e in entries) e.toMap()],
+          if (latitude != null && longitude != null) ...{
+            'latitude': latitude,
+            'longitude': longitude,
+          },
+        });
+    if (result == null) return const BrightnessSchedule();
+    return BrightnessSchedule.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Returns the state of the brightness-key listener. Currently only
+  /// implemented on Linux.
+  Future<BrightnessHotkeysStatus> getBrightnessHotkeys() async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'getBrightnessHotkeys',
+    );
+    if (result == null) return const BrightnessHotkeysStatus(enabled: false);
+    return BrightnessHotkeysStatus.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Makes the keyboard's brightness keys step external monitors too.
+  ///
+  /// By default the keys step every display except the built-in panel,
+  /// which the desktop already handles; [allDisplays] includes it and
+  /// [displayIds] limits the keys to those displays. Listening needs read
+  /// access to `/dev/input`; otherwise the result carries an
+  /// [BrightnessHotkeysStatus.error]. Currently only implemented on Linux.
+  Future<BrightnessHotkeysStatus> setBrightnessHotkeys({
+    required bool enabled,
+    bool allDisplays = false,
+    List<String>? displayIds,
+  }) async {
+    final result = await _channel
+        .invokeMethod<Map<dynamic, dynamic>>('setBrightnessHotkeys', {
+          'enabled': enabled,
+          'displays': displayIds ?? (allDisplays ? 'all' : 'external'),
+        });
+    if (result == null) return const BrightnessHotkeysStatus(enabled: false);
+    return BrightnessHotkeysStatus.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Returns whether DDC/CI can reach the monitors' I2C buses, as of the
+  /// last [getDisplays]. Currently only implemented on Linux.
+  Future<I2cStatus> getI2cStatus() async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'getI2cStatus',
+    );
+    if (result == null) {
+      return const I2cStatus(access: I2cAccess.unknown, setup: I2cSetup.none);
+    }
+    return I2cStatus.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Asks PolicyKit to grant this user access to the I2C buses, by
+  /// installing a udev rule and an `i2c` group.
+  ///
+  /// Shows the system authentication dialog and completes once it is
+  /// answered; display enumeration never waits for it. The new group
+  /// usually only applies after logging in again, see
+  /// [I2cStatus.needsRelogin]. Currently only implemented on Linux.
+  Future<I2cStatus> setupI2cPermissions() async {
+    final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'setupI2cPermissions',
+    );
+    if (result == null) {
+      return const I2cStatus(access: I2cAccess.unknown, setup: I2cSetup.none);
+    }
+    return I2cStatus.fromMap(Map<String, dynamic>.from(result));
+  }
+
+  /// Writes the native trace buffers to disk and returns the file path, or
+  /// `null` when the app was not started with tracing enabled
+  /// (`--trace` or `BS_DISPLAY_CONTROL_TRACE`). Currently only implemented
+  /// on Linux.
+  Future<String?> flushTrace() =>
+      _channel.invokeMethod<String>('flushTrace');
 }
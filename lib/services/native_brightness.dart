@@ -0,0 +1,115 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+
+typedef _PostCObject =
+    Pointer<NativeFunction<Int8 Function(Int64, Pointer<Dart_CObject>)>>;
+
+/// Only a `@Native` leaf call may take the address of Dart heap data, so
+/// the ID bytes are passed without a copy. No native asset is bundled
+/// under this library's ID, so the symbol resolves in the process, like
+/// the [DynamicLibrary.process] lookups below.
+@Native<Void Function(Pointer<Uint8>, Size, Double, Int64)>(
+  symbol: 'bsdc_set_effective_brightness',
+  isLeaf: true,
+)
+external void _setEffectiveBrightness(
+  Pointer<Uint8> displayId,
+  int length,
+  double value,
+  int requestId,
+);
+
+/// Direct calls into the Linux runner's brightness core, bypassing the
+/// method channel.
+///
+/// The runner exports a small C ABI from its own executable, found with
+/// [DynamicLibrary.process]. A write is a leaf call that only queues the
+/// request natively; its result arrives on a [ReceivePort] as
+/// `[requestId, ok, applied]`. A request with no result after
+/// [_resultTimeout] completes with `false`.
+final class NativeBrightness {
+  NativeBrightness._(this._results) {
+    _results.listen(_onResult, onDone: _failPending);
+  }
+
+  /// Must match `kFfiAbiVersion` in `linux/runner/my_application.cc`.
+  static const _abiVersion = 1;
+
+  /// Longer than any write cascade (DDC/CI retries, then a ddcutil spawn).
+  static const _resultTimeout = Duration(seconds: 10);
+
+  /// The fast path, or `null` when the runner does not export it (other
+  /// platforms, or a runner built without it).
+  static final NativeBrightness? instance = _open();
+
+  final ReceivePort _results;
+  final _pending = <int, Completer<bool>>{};
+  final _encodedIds = <String, Uint8List>{};
+  var _nextRequestId = 0;
+
+  static NativeBrightness? _open() {
+    if (!Platform.isLinux) return null;
+    try {
+      final process = DynamicLibrary.process();
+      final abiVersion = process
+          .lookupFunction<Int32 Function(), int Function()>(
+            'bsdc_ffi_abi_version',
+          );
+      if (abiVersion() != _abiVersion) return null;
+
+      final init = process
+          .lookupFunction<
+            Void Function(_PostCObject, Int64),
+            void Function(_PostCObject, int)
+          >('bsdc_ffi_init');
+      // Fail here rather than on the first write if it is missing.
+      process.lookup<Void>('bsdc_set_effective_brightness');
+
+      final results = ReceivePort('bs_display_control brightness results');
+      init(NativeApi.postCObject, results.sendPort.nativePort);
+      return NativeBrightness._(results);
+    } on ArgumentError {
+      return null; // Symbol not exported.
+    }
+  }
+
+  /// Queues the unified slider value (-0.5 to 1.0) for [displayId].
+  ///
+  /// Completes with the outcome of the hardware write that covered this
+  /// request; writes arriving while one is in flight are coalesced.
+  Future<bool> setEffectiveBrightness(String displayId, double value) {
+    final requestId = _nextRequestId++;
+    final completer = Completer<bool>();
+    _pending[requestId] = completer;
+    final id = _encodedIds.putIfAbsent(displayId, () => utf8.encode(displayId));
+    _setEffectiveBrightness(id.address, id.length, value, requestId);
+    return completer.future.timeout(
+      _resultTimeout,
+      onTimeout: () {
+        _pending.remove(requestId);
+        return false;
+      },
+    );
+  }
+
+  /// Stops listening for results; every pending write completes with
+  /// `false`.
+  void dispose() => _results.close();
+
+  void _onResult(dynamic message) {
+    if (message case [final int requestId, final bool ok, double _]) {
+      _pending.remove(requestId)?.complete(ok);
+    }
+  }
+
+  void _failPending() {
+    for (final completer in _pending.values) {
+      completer.complete(false);
+    }
+    _pending.clear();
+  }
+}
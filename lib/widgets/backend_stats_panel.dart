@@ -0,0 +1,271 @@
+import 'package:flutter/material.dart';
+import 'package:flutter/services.dart';
+
+import '../models/backend_stats.dart';
+import '../services/brightness_service.dart';
+
+/// Debug panel listing per-backend call counts and latencies.
+///
+/// Shows which backend each display actually used and how often it fell
+/// through to a slower one, so a stall can be told apart from a fallback.
+class BackendStatsPanel extends StatefulWidget {
+  const BackendStatsPanel({super.key});
+
+  @override
+  State<BackendStatsPanel> createState() => _BackendStatsPanelState();
+}
+
+class _BackendStatsPanelState extends State<BackendStatsPanel> {
+  final _brightnessService = BrightnessService.instance;
+
+  DisplayControlStats? _stats;
+  bool _isLoading = true;
+  bool _unsupported = false;
+  String? _error;
+
+  @override
+  void initState() {
+    super.initState();
+    _load();
+  }
+
+  Future<void> _load({bool reset = false}) async {
+    setState(() {
+      _isLoading = true;
+      _error = null;
+    });
+
+    try {
+      final stats = await _brightnessService.getStats(reset: reset);
+      if (!mounted) return;
+      setState(() {
+        _stats = stats;
+        _isLoading = false;
+      });
+    } on MissingPluginException {
+      if (!mounted) return;
+      setState(() {
+        _unsupported = true;
+        _isLoading = false;
+      });
+    } catch (e) {
+      if (!mounted) return;
+      setState(() {
+        _error = e.toString();
+        _isLoading = false;
+      });
+    }
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    final theme = Theme.of(context);
+    final stats = _stats;
+
+    return SafeArea(
+      child: Padding(
+        padding: const EdgeInsets.fromLTRB(24, 8, 24, 24),
+        child: Column(
+          mainAxisSize: MainAxisSize.min,
+          crossAxisAlignment: CrossAxisAlignment.start,
+          children: [
+            Row(
+              children: [
+                Expanded(
+                  child: Text(
+                    'Backend statistics',
+                    style: theme.textTheme.titleLarge,
+                  ),
+                ),
+                IconButton(
+                  onPressed: _isLoading || _unsupported ? null : () => _load(),
+                  icon: const Icon(Icons.refresh),
+                  tooltip: 'Refresh',
+                ),
+                IconButton(
+                  onPressed: _isLoading || _unsupported
+                      ? null
+                      : () => _load(reset: true),
+                  icon: const Icon(Icons.restart_alt),
+                  tooltip: 'Reset counters',
+                ),
+              ],
+            ),
+            const SizedBox(height: 8),
+            Flexible(
+              child: switch ((_isLoading, _unsupported, _error, stats)) {
+                (true, _, _, _) => const Padding(
+                  padding: EdgeInsets.all(24),
+                  child: Center(child: CircularProgressIndicator()),
+                ),
+                (_, true, _, _) => const _Message(
+                  'Statistics are not available on this platform.',
+                ),
+                (_, _, final String error, _) => _Message(error),
+                (_, _, _, final DisplayControlStats stats)
+                    when stats.backends.isEmpty =>
+                  const _Message('No backend calls recorded yet.'),
+                (_, _, _, final DisplayControlStats stats) => ListView(
+                  shrinkWrap: true,
+                  children: [
+                    _StatsTable(title: 'All displays', stats: stats.backends),
+                    for (final MapEntry(:key, :value) in stats.displays.entries)
+                      _StatsTable(title: key, stats: value),
+                    if (stats.resident case final resident?)
+                      _ResidentSummary(resident),
+                    if (stats.skippedWrites.isNotEmpty)
+                      Padding(
+                        padding: const EdgeInsets.only(top: 16),
+                        child: Text(
+                          'Skipped writes: ${stats.skippedWrites.entries.map((e) => '${e.key} ${e.value}').join(', ')}',
+                          style: theme.textTheme.bodySmall?.copyWith(
+                            color: theme.colorScheme.onSurfaceVariant,
+                          ),
+                        ),
+                      ),
+                  ],
+                ),
+                _ => const SizedBox.shrink(),
+              },
+            ),
+          ],
+        ),
+      ),
+    );
+  }
+}
+
+class _StatsTable extends StatelessWidget {
+  const _StatsTable({required this.title, required this.stats});
+
+  final String title;
+  final Map<String, BackendStats> stats;
+
+  static String _formatLatency(Duration? d) {
+    if (d == null) return '—';
+    final us = d.inMicroseconds;
+    if (us < 1000) return '$usµs';
+    return '${(us / 1000).toStringAsFixed(us < 10000 ? 1 : 0)}ms';
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    final theme = Theme.of(context);
+    final headerStyle = theme.textTheme.labelSmall?.copyWith(
+      color: theme.colorScheme.onSurfaceVariant,
+    );
+
+    return Padding(
+      padding: const EdgeInsets.only(top: 12),
+      child: Column(
+        crossAxisAlignment: CrossAxisAlignment.start,
+        children: [
+          Text(title, style: theme.textTheme.titleSmall),
+          const SizedBox(height: 4),
+          Table(
+            defaultColumnWidth: const IntrinsicColumnWidth(),
+            columnWidths: const {0: FlexColumnWidth()},
+            children: [
+              TableRow(
+                children: [
+                  for (final label in const [
+                    'Backend',
+                    'OK',
+                    'Failed',
+                    'Fell back',
+                    'Mean',
+                    'p50',
+                    'p95',
+                  ])
+                    Padding(
+                      padding: const EdgeInsets.only(left: 12, bottom: 4),
+                      child: Text(label, style: headerStyle),
+                    ),
+                ],
+              ),
+              for (final MapEntry(:key, :value) in stats.entries)
+                TableRow(
+                  children: [
+                    for (final cell in [
+                      key,
+                      '${value.ok}',
+                      '${value.failed}',
+                      '${value.fellBack}',
+                      _formatLatency(value.mean),
+                      _formatLatency(value.percentile(0.5)),
+                      _formatLatency(value.percentile(0.95)),
+                    ])
+                      Padding(
+                        padding: const EdgeInsets.only(left: 12, bottom: 2),
+                        child: Text(cell, style: theme.textTheme.bodySmall),
+                      ),
+                  ],
+                ),
+            ],
+          ),
+        ],
+      ),
+    );
+  }
+}
+
+class _ResidentSummary extends StatelessWidget {
+  const _ResidentSummary(this.resident);
+
+  final ResidentStats resident;
+
+  static String _formatDuration(Duration d) {
+    if (d.inHours > 0) return '${d.inHours}h ${d.inMinutes % 60}m';
+    if (d.inMinutes > 0) return '${d.inMinutes}m ${d.inSeconds % 60}s';
+    return '${d.inSeconds}s';
+  }
+
+  static String _formatKb(int kb) =>
+      kb < 0 ? '—' : '${(kb / 1024).toStringAsFixed(1)} MiB';
+
+  @override
+  Widget build(BuildContext context) {
+    final theme = Theme.of(context);
+    final lastShow = resident.lastShowLatency;
+    return Padding(
+      padding: const EdgeInsets.only(top: 16),
+      child: Column(
+        crossAxisAlignment: CrossAxisAlignment.start,
+        children: [
+          Text('Tray mode', style: theme.textTheme.titleSmall),
+          const SizedBox(height: 4),
+          Text(
+            'Hidden ${_formatDuration(resident.hiddenTime)} using '
+            '${(resident.idleCpuShare * 100).toStringAsFixed(3)}% CPU. '
+            'Resident ${_formatKb(resident.rssKb)} now, '
+            '${_formatKb(resident.rssAtHideKb)} after the last hide. '
+            'Shown ${resident.shows} times'
+            '${lastShow == null ? '' : ', last in ${lastShow.inMilliseconds}ms'}.',
+            style: theme.textTheme.bodySmall,
+          ),
+        ],
+      ),
+    );
+  }
+}
+
+class _Message extends StatelessWidget {
+  const _Message(this.text);
+
+  final String text;
+
+  @override
+  Widget build(BuildContext context) {
+    final theme = Theme.of(context);
+    return Padding(
+      padding: const EdgeInsets.all(24),
+      child: Text(
+        text,
+        style: theme.textTheme.bodyMedium?.copyWith(
+          color: theme.colorScheme.onSurfaceVariant,
+        ),
+        textAlign: TextAlign.center,
+      ),
+    );
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef FLUTTER_AMBIENT_LIGHT_H_
+#define FLUTTER_AMBIENT_LIGHT_H_
+
+// Pure helpers of the ambient light auto-brightness in my_application.cc:
+// IIO scan record decoding and the lux-to-brightness response curve.  No
+// GLib or sysfs access, so linux/test can exercise them directly.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct AmbientCurvePoint {
+  double lux;
+  double brightness;
+};
+
+// Default response: 5% in the dark, full brightness in daylight.
+inline const std::vector<AmbientCurvePoint> kDefaultAmbientCurve = {
+    {0.0, 0.05}, {10.0, 0.2}, {100.0, 0.45}, {1000.0, 0.8}, {10000.0, 1.0}};
+
+// One channel of an IIO scan record, from scan_elements/<channel>_type,
+// e.g. "le:u32/32>>0".
+struct IioScanElement {
+  int index = 0;
+  bool bigEndian = false;
+  bool isSigned = false;
+  unsigned bits = 0;
+  unsigned storageBits = 0;
+  unsigned repeat = 1;
+  unsigned shift = 0;
+  size_t offset = 0;  // Byte offset within the record.
+};
+
+// Parse "[be|le]:[s|u]bits/storagebits[Xrepeat][>>shift]".
+inline bool ParseIioScanType(const char* type, IioScanElement& el) {
+  char endian[3] = {};
+  char sign = 0;
+  if (sscanf(type, "%2[bel]:%c%u/%u", endian, &sign, &el.bits, &el.storageBits) != 4)
+    return false;
+  el.bigEndian = strcmp(endian, "be") == 0;
+  el.isSigned = sign == 's' || sign == 'S';
+  if (const char* x = strchr(type, 'X')) el.repeat = static_cast<unsigned>(strtoul(x + 1, nullptr, 10));
+  if (const char* shift = strstr(type, ">>")) el.shift = static_cast<unsigned>(strtoul(shift + 2, nullptr, 10));
+  bool storageOk = el.storageBits == 8 || el.storageBits == 16 || el.storageBits == 32 ||
+                   el.storageBits == 64;
+  return storageOk && el.bits > 0 && el.bits <= el.storageBits && el.repeat > 0 &&
+         el.shift < el.storageBits;
+}
+
+// Lay out the enabled scan elements (channel name, element) the way the
+// kernel packs a record: by index, each aligned to its storage size, the
+// whole record padded to the largest alignment.  Sorts |elements|, fills
+// their offsets and returns the record size.
+inline size_t ComputeIioRecordLayout(std::vector<std::pair<std::string, IioScanElement>>& elements) {
+  std::sort(elements.begin(), elements.end(),
+            [](const auto& a, const auto& b) { return a.second.index < b.second.index; });
+  size_t offset = 0;
+  size_t maxAlign = 1;
+  for (auto& [channel, el] : elements) {
+    size_t align = el.storageBits / 8;
+    offset = (offset + align - 1) / align * align;
+    el.offset = offset;
+    offset += align * el.repeat;
+    maxAlign = std::max(maxAlign, align);
+  }
+  return (offset + maxAlign - 1) / maxAlign * maxAlign;
+}
+
+inline double IioSampleValue(const IioScanElement& el, const uint8_t* record) {
+  const uint8_t* p = record + el.offset;
+  size_t bytes = el.storageBits / 8;
+  uint64_t v = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    v = (v << 8) | p[el.bigEndian ? i : bytes - 1 - i];
+  }
+  v >>= el.shift;
+  if (el.bits < 64) {
+    uint64_t mask = (uint64_t{1} << el.bits) - 1;
+    v &= mask;
+    if (el.isSigned && (v >> (el.bits - 1)) & 1) v |= ~mask;
+  }
+  return el.isSigned ? static_cast<double>(static_cast<int64_t>(v)) : static_cast<double>(v);
+}
+
+// Brightness for |lux| on |curve|, linear in log10(lux + 1) between points.
+inline double EvaluateAmbientCurve(const std::vector<AmbientCurvePoint>& curve, double lux) {
+  const std::vector<AmbientCurvePoint>& pts = curve.empty() ? kDefaultAmbientCurve : curve;
+  double x = std::log10(std::max(lux, 0.0) + 1.0);
+  double x0 = std::log10(pts.front().lux + 1.0);
+  if (x <= x0) return pts.front().brightness;
+  for (size_t i = 1; i < pts.size(); i++) {
+    double x1 = std::log10(pts[i].lux + 1.0);
+    if (x <= x1) {
+      double t = x1 > x0 ? (x - x0) / (x1 - x0) : 1.0;
+      return pts[i - 1].brightness + t * (pts[i].brightness - pts[i - 1].brightness);
+    }
+    x0 = x1;
+  }
+  return pts.back().brightness;
+}
+
+#endif  // FLUTTER_AMBIENT_LIGHT_H_
@@ -0,0 +1,238 @@
+#ifndef FLUTTER_EDID_H_
+#define FLUTTER_EDID_H_
+
+// Pure EDID decoding for the display enumeration in my_application.cc:
+// the base block, CTA-861 extension blocks and the stable monitor ID.  No
+// sysfs access, so linux/test can exercise it directly.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Decodes the EDID base block plus any CTA-861 extension blocks into a
+// fixed-size struct.  The decoder works directly on the raw bytes (no
+// intermediate copies or heap allocations).
+//
+// Base block layout (128 bytes):
+//   0-7     Header 00 FF FF FF FF FF FF 00
+//   8-9     Manufacturer ID (compressed ASCII, 3 letters)
+//   10-11   Product code (little-endian)
+//   12-15   Serial number (little-endian)
+//   16      Week of manufacture (0xFF = byte 17 is the model year)
+//   17      Year of manufacture - 1990
+//   18-19   EDID version / revision
+//   54-125  Four 18-byte descriptors (0xFC name, 0xFF serial, 0xFE text)
+//   126     Extension block count
+//   127     Checksum (all 128 bytes sum to 0 mod 256)
+
+static const size_t kEdidBlockSize = 128;
+static const size_t kEdidMaxBlocks = 8;
+
+struct EdidCtaInfo {
+  uint8_t revision;
+  bool underscan;
+  bool basicAudio;
+  bool ycbcr444;
+  bool ycbcr422;
+  uint8_t nativeDtdCount;
+  uint8_t videoDataBlockCount;   // Short video descriptors (SVDs).
+  uint8_t audioDataBlockCount;   // Short audio descriptors (SADs).
+  bool hasHdmiVsdb;              // HDMI 1.x VSDB (OUI 00-0C-03).
+  bool hasHdmiForumVsdb;         // HDMI Forum VSDB (OUI C4-5D-D8).
+  bool hasHdrStaticMetadata;     // Extended tag 0x06.
+  uint16_t hdmiPhysicalAddress;  // a.b.c.d packed as nibbles, 0 if absent.
+};
+
+struct EdidInfo {
+  bool valid;                // Header matched and base block present.
+  bool checksumOk;           // Base block checksum is correct.
+  char manufacturer[4];      // e.g., "DEL"
+  uint16_t productCode;
+  uint32_t serialNumber;     // 0 if the panel does not report one.
+  uint8_t week;              // 0 = unspecified, 0xFF = model year.
+  uint16_t year;
+  uint8_t versionMajor;
+  uint8_t versionMinor;
+  char monitorName[14];      // Descriptor 0xFC
+  char serialString[14];     // Descriptor 0xFF
+  char asciiText[14];        // Descriptor 0xFE
+  uint8_t extensionCount;    // As declared in byte 126.
+  uint8_t ctaBlockCount;     // CTA-861 blocks actually decoded.
+  EdidCtaInfo cta;           // Merged from all CTA blocks.
+};
+
+// Copy a descriptor string (bytes 5..17) into a NUL-terminated buffer,
+// stopping at newline and trimming trailing spaces.
+inline void EdidCopyDescriptorString(const uint8_t* desc, char (&out)[14]) {
+  size_t n = 0;
+  for (int i = 5; i < 18; ++i) {
+    char ch = static_cast<char>(desc[i]);
+    if (ch == '\n' || ch == '\0') break;
+    out[n++] = ch;
+  }
+  while (n > 0 && out[n - 1] == ' ') --n;
+  out[n] = '\0';
+}
+
+inline void DecodeCtaBlock(const uint8_t* block, EdidCtaInfo& cta) {
+  cta.revision = block[1];
+  uint8_t dtdOffset = block[2];
+  if (cta.revision >= 2) {
+    cta.underscan = cta.underscan || (block[3] & 0x80);
+    cta.basicAudio = cta.basicAudio || (block[3] & 0x40);
+    cta.ycbcr444 = cta.ycbcr444 || (block[3] & 0x20);
+    cta.ycbcr422 = cta.ycbcr422 || (block[3] & 0x10);
+    cta.nativeDtdCount += block[3] & 0x0F;
+  }
+  // Data block collection only exists in revision 3+ (bytes 4..dtdOffset).
+  if (cta.revision < 3 || dtdOffset < 4 || dtdOffset > 127) return;
+
+  size_t pos = 4;
+  while (pos < dtdOffset) {
+    uint8_t tag = block[pos] >> 5;
+    uint8_t len = block[pos] & 0x1F;
+    const uint8_t* payload = block + pos + 1;
+    if (pos + 1 + len > dtdOffset) break;  // Malformed block; stop.
+
+    switch (tag) {
+      case 1:  // Audio data block: 3 bytes per SAD.
+        cta.audioDataBlockCount += len / 3;
+        break;
+      case 2:  // Video data block: 1 byte per SVD.
+        cta.videoDataBlockCount += len;
+        break;
+      case 3:  // Vendor-specific data block: 24-bit OUI, little-endian.
+        if (len >= 3) {
+          uint32_t oui = payload[0] | (payload[1] << 8) | (payload[2] << 16);
+          if (oui == 0x000C03) {
+            cta.hasHdmiVsdb = true;
+            if (len >= 5)
+              cta.hdmiPhysicalAddress =
+                  static_cast<uint16_t>((payload[3] << 8) | payload[4]);
+          } else if (oui == 0xC45DD8) {
+            cta.hasHdmiForumVsdb = true;
+          }
+        }
+        break;
+      case 7:  // Extended tag in the first payload byte.
+        if (len >= 1 && payload[0] == 0x06) cta.hasHdrStaticMetadata = true;
+        break;
+      default:
+        break;
+    }
+    pos += 1 + len;
+  }
+}
+
+// Decode an EDID blob.  |data| is borrowed; nothing is copied beyond the
+// short descriptor strings.  Returns false if the base block is unusable.
+inline bool DecodeEdid(const uint8_t* data, size_t len, EdidInfo& out) {
+  memset(&out, 0, sizeof(out));
+  if (len < kEdidBlockSize) return false;
+
+  static const uint8_t kHeader[8] = {0x00, 0xFF, 0xFF, 0xFF,
+                                     0xFF, 0xFF, 0xFF, 0x00};
+  if (memcmp(data, kHeader, sizeof(kHeader)) != 0) return false;
+  out.valid = true;
+
+  uint8_t sum = 0;
+  for (size_t i = 0; i < kEdidBlockSize; ++i) sum += data[i];
+  out.checksumOk = (sum == 0);
+
+  // Manufacturer ID from bytes 8-9 (compressed ASCII).
+  uint16_t mfr = (static_cast<uint16_t>(data[8]) << 8) | data[9];
+  out.manufacturer[0] = static_cast<char>(((mfr >> 10) & 0x1F) + 64);
+  out.manufacturer[1] = static_cast<char>(((mfr >> 5) & 0x1F) + 64);
+  out.manufacturer[2] = static_cast<char>((mfr & 0x1F) + 64);
+  out.manufacturer[3] = '\0';
+
+  out.productCode = static_cast<uint16_t>(data[10] | (data[11] << 8));
+  out.serialNumber = static_cast<uint32_t>(data[12]) |
+                     (static_cast<uint32_t>(data[13]) << 8) |
+                     (static_cast<uint32_t>(data[14]) << 16) |
+                     (static_cast<uint32_t>(data[15]) << 24);
+  out.week = data[16];
+  out.year = static_cast<uint16_t>(1990 + data[17]);
+  out.versionMajor = data[18];
+  out.versionMinor = data[19];
+
+  // Display descriptors at offsets 54, 72, 90, 108.  A descriptor (as
+  // opposed to a detailed timing) starts with a zero pixel clock.
+  for (size_t off : {54, 72, 90, 108}) {
+    const uint8_t* desc = data + off;
+    if (desc[0] != 0 || desc[1] != 0) continue;
+    switch (desc[3]) {
+      case 0xFC: EdidCopyDescriptorString(desc, out.monitorName); break;
+      case 0xFF: EdidCopyDescriptorString(desc, out.serialString); break;
+      case 0xFE: EdidCopyDescriptorString(desc, out.asciiText); break;
+      default: break;
+    }
+  }
+
+  // Extension blocks.  Only CTA-861 (tag 0x02) is decoded; others such as
+  // DisplayID or block maps are counted via extensionCount only.
+  out.extensionCount = data[126];
+  size_t available = len / kEdidBlockSize - 1;
+  size_t blocks = std::min<size_t>(out.extensionCount, available);
+  for (size_t b = 1; b <= blocks; ++b) {
+    const uint8_t* block = data + b * kEdidBlockSize;
+    if (block[0] == 0x02) {
+      DecodeCtaBlock(block, out.cta);
+      out.ctaBlockCount++;
+    }
+  }
+  return true;
+}
+
+// Human-readable name: the 0xFC descriptor, else the manufacturer code.
+inline std::string EdidDisplayName(const EdidInfo& edid) {
+  if (!edid.valid) return "";
+  if (edid.monitorName[0] != '\0') return edid.monitorName;
+  return edid.manufacturer;  // Fallback to manufacturer code.
+}
+
+// Stable identity for a physical monitor, independent of which port it is
+// plugged into: FNV-1a over manufacturer, product code, serial number and
+// serial string.  Panels that report no serial at all cannot be told apart
+// from an identical model, so the connector is folded in for those.
+// Format: "edid:<16 hex digits>".  Empty if there is no usable EDID.
+inline std::string EdidStableId(const EdidInfo& edid, const std::string& connector) {
+  if (!edid.valid) return "";
+
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  auto mix = [&hash](const void* p, size_t n) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(p);
+    for (size_t i = 0; i < n; ++i) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ULL;
+    }
+  };
+
+  uint8_t fields[6] = {
+    static_cast<uint8_t>(edid.manufacturer[0]),
+    static_cast<uint8_t>(edid.manufacturer[1]),
+    static_cast<uint8_t>(edid.manufacturer[2]),
+    static_cast<uint8_t>(edid.productCode & 0xFF),
+    static_cast<uint8_t>(edid.productCode >> 8),
+    0,
+  };
+  mix(fields, sizeof(fields));
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint8_t b = static_cast<uint8_t>(edid.serialNumber >> shift);
+    mix(&b, 1);
+  }
+  mix(edid.serialString, strlen(edid.serialString));
+
+  if (edid.serialNumber == 0 && edid.serialString[0] == '\0') {
+    mix(connector.data(), connector.size());
+  }
+
+  char out[32];
+  snprintf(out, sizeof(out), "edid:%016llx", static_cast<unsigned long long>(hash));
+  return out;
+}
+
+#endif  // FLUTTER_EDID_H_
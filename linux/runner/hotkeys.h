@@ -0,0 +1,45 @@
+#ifndef FLUTTER_HOTKEYS_H_
+#define FLUTTER_HOTKEYS_H_
+
+// Pure helpers of the brightness hotkeys in my_application.cc: which
+// /dev/input entries to open and how key events become brightness steps.
+// No GLib or device access, so linux/test can exercise them directly.
+
+#include <linux/input.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Whether a /dev/input entry (from the directory scan or an inotify event)
+// is an evdev node worth opening: "event" followed by digits only.
+inline bool IsHotkeyCandidate(const char* name) {
+  if (strncmp(name, "event", 5) != 0 || name[5] == '\0') return false;
+  for (const char* p = name + 5; *p; p++) {
+    if (*p < '0' || *p > '9') return false;
+  }
+  return true;
+}
+
+// Net brightness steps for a batch of events read at |nowUs|: +1 per
+// KEY_BRIGHTNESSUP, -1 per KEY_BRIGHTNESSDOWN.  Releases and other events
+// are ignored.  An auto-repeat (value 2) only counts once |repeatUs| has
+// passed since the last counted key, tracked in |lastKeyUs|.  Counted
+// keys are added to |presses|.
+inline int HotkeySteps(const struct input_event* events, size_t count, int64_t nowUs,
+                       int64_t repeatUs, int64_t& lastKeyUs, uint64_t& presses) {
+  int steps = 0;
+  for (size_t i = 0; i < count; i++) {
+    const struct input_event& ev = events[i];
+    if (ev.type != EV_KEY || ev.value == 0) continue;
+    int direction = ev.code == KEY_BRIGHTNESSUP ? 1 : ev.code == KEY_BRIGHTNESSDOWN ? -1 : 0;
+    if (direction == 0) continue;
+    if (ev.value == 2 && nowUs - lastKeyUs < repeatUs) continue;
+    lastKeyUs = nowUs;
+    presses++;
+    steps += direction;
+  }
+  return steps;
+}
+
+#endif  // FLUTTER_HOTKEYS_H_
@@ -0,0 +1,132 @@
+#ifndef FLUTTER_KMS_UAPI_H_
+#define FLUTTER_KMS_UAPI_H_
+
+// The subset of the stable <drm/drm.h> and <drm/drm_mode.h> UAPI used by
+// the KMS GAMMA_LUT backend in my_application.cc, declared by hand so
+// neither libdrm nor its headers are needed.  The static_asserts pin every
+// structure to the kernel's layout: the ioctl numbers encode the sizes,
+// and the kernel reads the fields at these offsets.
+
+#include <sys/ioctl.h>
+
+#include <cstddef>
+#include <cstdint>
+
+struct KmsSetClientCap {  // struct drm_set_client_cap
+  uint64_t capability;
+  uint64_t value;
+};
+
+struct KmsCardRes {  // struct drm_mode_card_res
+  uint64_t fbIdPtr, crtcIdPtr, connectorIdPtr, encoderIdPtr;
+  uint32_t countFbs, countCrtcs, countConnectors, countEncoders;
+  uint32_t minWidth, maxWidth, minHeight, maxHeight;
+};
+
+struct KmsGetConnector {  // struct drm_mode_get_connector
+  uint64_t encodersPtr, modesPtr, propsPtr, propValuesPtr;
+  uint32_t countModes, countProps, countEncoders;
+  uint32_t encoderId, connectorId, connectorType, connectorTypeId;
+  uint32_t connection, mmWidth, mmHeight, subpixel, pad;
+};
+
+struct KmsGetEncoder {  // struct drm_mode_get_encoder
+  uint32_t encoderId, encoderType, crtcId, possibleCrtcs, possibleClones;
+};
+
+struct KmsGetProperty {  // struct drm_mode_get_property
+  uint64_t valuesPtr, enumBlobPtr;
+  uint32_t propId, flags;
+  char name[32];
+  uint32_t countValues, countEnumBlobs;
+};
+
+struct KmsObjGetProperties {  // struct drm_mode_obj_get_properties
+  uint64_t propsPtr, propValuesPtr;
+  uint32_t countProps, objId, objType;
+};
+
+struct KmsAtomic {  // struct drm_mode_atomic
+  uint32_t flags, countObjs;
+  uint64_t objsPtr, countPropsPtr, propsPtr, propValuesPtr, reserved, userData;
+};
+
+struct KmsCreateBlob {  // struct drm_mode_create_blob
+  uint64_t data;
+  uint32_t length, blobId;
+};
+
+struct KmsDestroyBlob {  // struct drm_mode_destroy_blob
+  uint32_t blobId;
+};
+
+struct KmsColorLut {  // struct drm_color_lut
+  uint16_t red, green, blue, reserved;
+};
+
+static_assert(sizeof(KmsSetClientCap) == 16, "drm_set_client_cap");
+static_assert(offsetof(KmsSetClientCap, value) == 8, "drm_set_client_cap.value");
+
+static_assert(sizeof(KmsCardRes) == 64, "drm_mode_card_res");
+static_assert(offsetof(KmsCardRes, connectorIdPtr) == 16, "drm_mode_card_res.connector_id_ptr");
+static_assert(offsetof(KmsCardRes, countCrtcs) == 36, "drm_mode_card_res.count_crtcs");
+static_assert(offsetof(KmsCardRes, countConnectors) == 40, "drm_mode_card_res.count_connectors");
+static_assert(offsetof(KmsCardRes, maxHeight) == 60, "drm_mode_card_res.max_height");
+
+static_assert(sizeof(KmsGetConnector) == 80, "drm_mode_get_connector");
+static_assert(offsetof(KmsGetConnector, modesPtr) == 8, "drm_mode_get_connector.modes_ptr");
+static_assert(offsetof(KmsGetConnector, countModes) == 32, "drm_mode_get_connector.count_modes");
+static_assert(offsetof(KmsGetConnector, encoderId) == 44, "drm_mode_get_connector.encoder_id");
+static_assert(offsetof(KmsGetConnector, connectorId) == 48, "drm_mode_get_connector.connector_id");
+static_assert(offsetof(KmsGetConnector, connectorType) == 52,
+              "drm_mode_get_connector.connector_type");
+static_assert(offsetof(KmsGetConnector, connectorTypeId) == 56,
+              "drm_mode_get_connector.connector_type_id");
+static_assert(offsetof(KmsGetConnector, connection) == 60, "drm_mode_get_connector.connection");
+static_assert(offsetof(KmsGetConnector, pad) == 76, "drm_mode_get_connector.pad");
+
+static_assert(sizeof(KmsGetEncoder) == 20, "drm_mode_get_encoder");
+static_assert(offsetof(KmsGetEncoder, crtcId) == 8, "drm_mode_get_encoder.crtc_id");
+
+static_assert(sizeof(KmsGetProperty) == 64, "drm_mode_get_property");
+static_assert(offsetof(KmsGetProperty, propId) == 16, "drm_mode_get_property.prop_id");
+static_assert(offsetof(KmsGetProperty, name) == 24, "drm_mode_get_property.name");
+static_assert(offsetof(KmsGetProperty, countValues) == 56, "drm_mode_get_property.count_values");
+
+static_assert(sizeof(KmsObjGetProperties) == 32, "drm_mode_obj_get_properties");
+static_assert(offsetof(KmsObjGetProperties, countProps) == 16,
+              "drm_mode_obj_get_properties.count_props");
+static_assert(offsetof(KmsObjGetProperties, objType) == 24,
+              "drm_mode_obj_get_properties.obj_type");
+
+static_assert(sizeof(KmsAtomic) == 56, "drm_mode_atomic");
+static_assert(offsetof(KmsAtomic, objsPtr) == 8, "drm_mode_atomic.objs_ptr");
+static_assert(offsetof(KmsAtomic, propValuesPtr) == 32, "drm_mode_atomic.prop_values_ptr");
+static_assert(offsetof(KmsAtomic, userData) == 48, "drm_mode_atomic.user_data");
+
+static_assert(sizeof(KmsCreateBlob) == 16, "drm_mode_create_blob");
+static_assert(offsetof(KmsCreateBlob, length) == 8, "drm_mode_create_blob.length");
+static_assert(offsetof(KmsCreateBlob, blobId) == 12, "drm_mode_create_blob.blob_id");
+
+static_assert(sizeof(KmsDestroyBlob) == 4, "drm_mode_destroy_blob");
+
+static_assert(sizeof(KmsColorLut) == 8, "drm_color_lut");
+static_assert(offsetof(KmsColorLut, blue) == 4, "drm_color_lut.blue");
+
+static const unsigned long kDrmIoctlSetClientCap = _IOW('d', 0x0d, KmsSetClientCap);
+static const unsigned long kDrmIoctlGetResources = _IOWR('d', 0xA0, KmsCardRes);
+static const unsigned long kDrmIoctlGetEncoder = _IOWR('d', 0xA6, KmsGetEncoder);
+static const unsigned long kDrmIoctlGetConnector = _IOWR('d', 0xA7, KmsGetConnector);
+static const unsigned long kDrmIoctlGetProperty = _IOWR('d', 0xAA, KmsGetProperty);
+static const unsigned long kDrmIoctlObjGetProperties = _IOWR('d', 0xB9, KmsObjGetProperties);
+static const unsigned long kDrmIoctlAtomic = _IOWR('d', 0xBC, KmsAtomic);
+static const unsigned long kDrmIoctlCreateBlob = _IOWR('d', 0xBD, KmsCreateBlob);
+static const unsigned long kDrmIoctlDestroyBlob = _IOWR('d', 0xBE, KmsDestroyBlob);
+
+static const uint64_t kDrmClientCapUniversalPlanes = 2;
+static const uint64_t kDrmClientCapAtomic = 3;
+static const uint32_t kDrmObjectCrtc = 0xcccccccc;
+static const uint32_t kDrmAtomicNonblock = 0x0200;
+static const size_t kDrmModeInfoSize = 68;  // sizeof(struct drm_mode_modeinfo).
+
+#endif  // FLUTTER_KMS_UAPI_H_
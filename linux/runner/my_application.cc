@@ -8,21 +8,54 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <cmath>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <map>
+#include <unordered_map>
+#include <string_view>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <cstdarg>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+#include <spawn.h>
+#include <signal.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <limits.h>
+#include <glib-unix.h>
 #include <pwd.h>
+#include <dlfcn.h>
 #include <linux/i2c-dev.h>
 #include <linux/i2c.h>
+#include <linux/input.h>
+#include <linux/io_uring.h>
 
+#include "ambient_light.h"
+#include "edid.h"
+#include "hotkeys.h"
+#include "kms_uapi.h"
 #include "flutter/generated_plugin_registrant.h"
 
 // ── Utility: check if a command exists (safe, no shell) ────────────
@@ -58,43 +91,856 @@ static bool CommandExists(const std::string& cmd) {
   return false;
 }
 
-// ── EDID parsing: extract monitor name from raw EDID ───────────────
-
-static std::string ParseEdidName(const std::string& edidPath) {
-  std::ifstream file(edidPath, std::ios::binary);
-  if (!file.is_open()) return "";
-
-  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
-                             std::istreambuf_iterator<char>());
-  if (data.size() < 128) return "";
-
-  // Parse manufacturer ID from bytes 8-9 (compressed ASCII).
-  uint16_t mfr = (static_cast<uint16_t>(data[8]) << 8) | data[9];
-  char c1 = static_cast<char>(((mfr >> 10) & 0x1F) + 64);
-  char c2 = static_cast<char>(((mfr >> 5) & 0x1F) + 64);
-  char c3 = static_cast<char>((mfr & 0x1F) + 64);
-  std::string manufacturer = {c1, c2, c3};
-
-  // Parse descriptor blocks at offsets 54, 72, 90, 108 for monitor name (tag 0xFC).
-  std::string monitorName;
-  for (int off : {54, 72, 90, 108}) {
-    if (off + 18 > static_cast<int>(data.size())) break;
-    if (data[off] == 0 && data[off + 1] == 0 && data[off + 3] == 0xFC) {
-      for (int i = 5; i < 18; ++i) {
-        char ch = static_cast<char>(data[off + i]);
-        if (ch == '\n' || ch == '\0') break;
-        monitorName += ch;
-      }
+// ── EDID decoding ──────────────────────────────────────────────────
+//
+// The decoder itself lives in edid.h.  ReadEdid() fills a stack buffer with
+// a single read() loop and hands it over without further copies.
+
+// Read an EDID file (e.g. /sys/class/drm/card1-DP-1/edid) into a fixed
+// stack buffer and decode it.  |edidPath| is resolved relative to |dirFd|
+// (pass AT_FDCWD for an absolute path).
+static bool ReadEdid(int dirFd, const char* edidPath, EdidInfo& out) {
+  uint8_t buf[kEdidBlockSize * kEdidMaxBlocks];
+  int fd = openat(dirFd, edidPath, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    memset(&out, 0, sizeof(out));
+    return false;
+  }
+  size_t total = 0;
+  while (total < sizeof(buf)) {
+    ssize_t n = read(fd, buf + total, sizeof(buf) - total);
+    if (n <= 0) break;
+    total += static_cast<size_t>(n);
+  }
+  close(fd);
+  return DecodeEdid(buf, total, out);
+}
+
+// ── Trace-event export ─────────────────────────────────────────────
+//
+// Opt-in tracing for investigations the getStats counters cannot explain.
+// Enabled with --trace[=FILE] or BS_DISPLAY_CONTROL_TRACE=FILE.  FILE is
+// resolved against the working directory; plain --trace, or a variable
+// value without a '/' (e.g. 1), selects the default file in the user cache
+// directory.
+// Method-channel dispatch, enumeration, I2C transactions, subprocesses and
+// Mutter D-Bus calls are recorded as complete ("X") events and written as
+// Chrome trace-event JSON, which chrome://tracing and ui.perfetto.dev open
+// directly.
+//
+// Each thread records into its own fixed ring of kTraceRingEvents slots,
+// overwriting the oldest, so recording never allocates or locks after the
+// thread's first event.  Rings of exited threads are reused by new ones.
+// Slots carry a sequence number (odd while being written) so a flush can
+// run concurrently and skip any slot it catches mid-write.  The file is
+// rewritten with everything still in the rings on shutdown, on SIGUSR1
+// and on the flushTrace method.
+
+static const size_t kTraceRingEvents = 4096;
+static const size_t kTraceNameLen = 32;
+static const size_t kTraceDetailLen = 48;
+
+struct TraceEvent {
+  std::atomic<uint64_t> seq{0};  // 2n+1 while event n is written, 2n+2 after.
+  const char* category;          // Static strings only.
+  pid_t tid;
+  gint64 startUs;
+  gint64 durUs;
+  char name[kTraceNameLen];
+  char detail[kTraceDetailLen];
+};
+
+struct TraceRing {
+  std::atomic<bool> inUse{false};
+  std::atomic<uint64_t> written{0};
+  TraceEvent events[kTraceRingEvents];
+};
+
+static std::atomic<bool> g_traceEnabled{false};
+static std::string g_tracePath;
+static gint64 g_traceStartUs = 0;
+static std::mutex g_traceMutex;  // Guards the two tables below.
+static std::vector<std::unique_ptr<TraceRing>> g_traceRings;
+static std::map<pid_t, std::string> g_traceThreadNames;
+
+static bool TraceEnabled() {
+  return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+// Turn tracing on, writing to |path| or, if null, the default file.
+// Called once from the command-line handler, before any other thread
+// exists.
+static void EnableTracing(const char* path) {
+  if (path && *path) {
+    g_autofree gchar* absolute = g_canonicalize_filename(path, nullptr);
+    g_tracePath = absolute;
+  } else {
+    char name[64];
+    snprintf(name, sizeof(name), "trace-%d.json", static_cast<int>(getpid()));
+    g_autofree gchar* dir = g_build_filename(g_get_user_cache_dir(), "bs_display_control",
+                                             nullptr);
+    g_mkdir_with_parents(dir, 0700);
+    g_autofree gchar* file = g_build_filename(dir, name, nullptr);
+    g_tracePath = file;
+  }
+  g_traceStartUs = g_get_monotonic_time();
+  g_traceEnabled.store(true, std::memory_order_release);
+  fprintf(stderr, "[BSDisplayControl] Tracing to %s\n", g_tracePath.c_str());
+}
+
+// Returns the ring to the pool when its thread exits.
+struct TraceRingLease {
+  TraceRing* ring = nullptr;
+  ~TraceRingLease() {
+    if (ring) ring->inUse.store(false, std::memory_order_release);
+  }
+};
+
+static TraceRing* TraceRingForThisThread() {
+  thread_local TraceRingLease lease;
+  if (lease.ring) return lease.ring;
+
+  pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  char threadName[16] = {};
+  pthread_getname_np(pthread_self(), threadName, sizeof(threadName));
+
+  std::lock_guard<std::mutex> lock(g_traceMutex);
+  for (auto& ring : g_traceRings) {
+    bool expected = false;
+    if (ring->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+      lease.ring = ring.get();
       break;
     }
   }
+  if (!lease.ring) {
+    g_traceRings.push_back(std::make_unique<TraceRing>());
+    lease.ring = g_traceRings.back().get();
+    lease.ring->inUse.store(true, std::memory_order_relaxed);
+  }
+  g_traceThreadNames[tid] = tid == getpid() ? "main" : threadName;
+  return lease.ring;
+}
+
+static void CopyTraceString(char* dst, size_t size, const char* src) {
+  size_t len = src ? strnlen(src, size - 1) : 0;
+  memcpy(dst, src ? src : "", len);
+  dst[len] = '\0';
+}
+
+// Record a span from |startUs| to |endUs| (monotonic time).  |name| and
+// |detail| are copied; |category| must be a string literal.
+static void TraceRecord(const char* category, const char* name, gint64 startUs, gint64 endUs,
+                        const char* detail = nullptr) {
+  if (!TraceEnabled()) return;
+  TraceRing* ring = TraceRingForThisThread();
+  thread_local pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+  uint64_t n = ring->written.load(std::memory_order_relaxed);
+  TraceEvent& ev = ring->events[n % kTraceRingEvents];
+  ev.seq.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  ev.category = category;
+  ev.tid = tid;
+  ev.startUs = startUs;
+  ev.durUs = endUs - startUs;
+  CopyTraceString(ev.name, sizeof(ev.name), name);
+  CopyTraceString(ev.detail, sizeof(ev.detail), detail);
+  ev.seq.store(2 * n + 2, std::memory_order_release);
+  ring->written.store(n + 1, std::memory_order_release);
+}
+
+// Records the enclosing scope as one span.  Costs a relaxed load when
+// tracing is off.  |name| must outlive the span.
+class TraceSpan {
+ public:
+  TraceSpan(const char* category, const char* name) {
+    if (!TraceEnabled()) return;
+    category_ = category;
+    name_ = name;
+    detail_[0] = '\0';
+    startUs_ = g_get_monotonic_time();
+  }
+  ~TraceSpan() {
+    if (category_) TraceRecord(category_, name_, startUs_, g_get_monotonic_time(), detail_);
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  // Attach a short printf-style note, e.g. the bus and VCP code.
+  __attribute__((format(printf, 2, 3))) void Detail(const char* fmt, ...) {
+    if (!category_) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(detail_, sizeof(detail_), fmt, ap);
+    va_end(ap);
+  }
+
+ private:
+  const char* category_ = nullptr;
+  const char* name_ = nullptr;
+  gint64 startUs_ = 0;
+  char detail_[kTraceDetailLen];
+};
+
+static void AppendJsonString(std::string& out, const char* s) {
+  out += '"';
+  for (; *s; s++) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  out += '"';
+}
+
+// Write every event still held in the rings to g_tracePath.  Safe to call
+// while other threads keep recording.
+static bool FlushTrace() {
+  if (!TraceEnabled()) return false;
+  int pid = static_cast<int>(getpid());
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  char buf[160];
+
+  std::lock_guard<std::mutex> lock(g_traceMutex);
+  for (const auto& [tid, threadName] : g_traceThreadNames) {
+    snprintf(buf, sizeof(buf),
+             "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+             "\"args\":{\"name\":",
+             first ? "" : ",", pid, static_cast<int>(tid));
+    json += buf;
+    AppendJsonString(json, threadName.c_str());
+    json += "}}";
+    first = false;
+  }
+
+  size_t count = 0;
+  for (const auto& ring : g_traceRings) {
+    uint64_t written = ring->written.load(std::memory_order_acquire);
+    uint64_t n = written > kTraceRingEvents ? written - kTraceRingEvents : 0;
+    for (; n < written; n++) {
+      const TraceEvent& ev = ring->events[n % kTraceRingEvents];
+      uint64_t seq = ev.seq.load(std::memory_order_acquire);
+      if (seq != 2 * n + 2) continue;  // Overwritten or still being written.
+      const char* category = ev.category;
+      pid_t tid = ev.tid;
+      gint64 startUs = ev.startUs;
+      gint64 durUs = ev.durUs;
+      char name[kTraceNameLen];
+      char detail[kTraceDetailLen];
+      memcpy(name, ev.name, sizeof(name));
+      memcpy(detail, ev.detail, sizeof(detail));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (ev.seq.load(std::memory_order_relaxed) != seq) continue;
+      name[sizeof(name) - 1] = '\0';
+      detail[sizeof(detail) - 1] = '\0';
+
+      snprintf(buf, sizeof(buf),
+               "%s\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"cat\":",
+               first ? "" : ",", pid, static_cast<int>(tid),
+               static_cast<long long>(startUs - g_traceStartUs),
+               static_cast<long long>(durUs));
+      json += buf;
+      AppendJsonString(json, category);
+      json += ",\"name\":";
+      AppendJsonString(json, name);
+      if (detail[0]) {
+        json += ",\"args\":{\"detail\":";
+        AppendJsonString(json, detail);
+        json += '}';
+      }
+      json += '}';
+      first = false;
+      count++;
+    }
+  }
+  json += "\n]}\n";
+
+  g_autoptr(GError) error = nullptr;
+  if (!g_file_set_contents(g_tracePath.c_str(), json.data(), static_cast<gssize>(json.size()),
+                           &error)) {
+    fprintf(stderr, "[BSDisplayControl] Trace write failed: %s\n",
+            error ? error->message : "unknown");
+    return false;
+  }
+  fprintf(stderr, "[BSDisplayControl] Wrote %zu trace events to %s\n", count,
+          g_tracePath.c_str());
+  return true;
+}
+
+static gboolean OnTraceFlushSignal(gpointer) {
+  FlushTrace();
+  return G_SOURCE_CONTINUE;
+}
+
+// ── Backend statistics ─────────────────────────────────────────────
+//
+// Every hardware/compositor call is timed and counted per backend, both in
+// total and per display, so a slow slider can be traced to DDC/CI,
+// libddcutil, a ddcutil or xrandr spawn, Mutter D-Bus or sysfs.  Counters
+// and fixed-bucket latency histograms are relaxed atomics, so recording
+// from the main thread and batch workers never takes a lock.  Per-display
+// slots live in a fixed table claimed with a CAS; ids beyond the table are
+// only counted in the totals.  Exposed through the getStats method.
+//
+// An outcome is kFellBack when the call failed and the cascade went on to
+// the next backend, kFailed when it was the last resort.
+
+enum class StatsBackend { kDdc, kLibDdcutil, kDdcutil, kXrandr, kMutter, kBacklight, kKms, kWlr, kCount };
+enum class CallOutcome { kOk, kFailed, kFellBack };
+
+static const char* const kStatsBackendNames[] = {
+    "ddc", "libddcutil", "ddcutil", "xrandr", "mutter", "backlight", "kms", "wlr"};
+static const size_t kStatsBackendCount = static_cast<size_t>(StatsBackend::kCount);
+
+// Upper bounds of the latency buckets; the last bucket is unbounded.
+static const gint64 kLatencyBucketBoundsUs[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000};
+static const size_t kLatencyBucketCount =
+    sizeof(kLatencyBucketBoundsUs) / sizeof(kLatencyBucketBoundsUs[0]) + 1;
+
+static const size_t kStatsMaxDisplays = 32;
+
+struct BackendStats {
+  std::atomic<uint64_t> ok{0};
+  std::atomic<uint64_t> failed{0};
+  std::atomic<uint64_t> fellBack{0};
+  std::atomic<uint64_t> totalUs{0};
+  std::atomic<uint64_t> buckets[kLatencyBucketCount] = {};
+};
+
+struct DisplayStatsSlot {
+  std::atomic<int> state{0};  // 0 free, 1 being claimed, 2 ready.
+  char id[64];
+  BackendStats backends[kStatsBackendCount];
+};
+
+static BackendStats g_backendStats[kStatsBackendCount];
+static DisplayStatsSlot g_displayStats[kStatsMaxDisplays];
+
+// Slots are claimed first-free in order, so two threads racing on a new
+// id always meet at the same slot.
+static DisplayStatsSlot* StatsSlotFor(const std::string& displayId) {
+  for (auto& slot : g_displayStats) {
+    int state = slot.state.load(std::memory_order_acquire);
+    if (state == 0) {
+      if (slot.state.compare_exchange_strong(state, 1, std::memory_order_acq_rel)) {
+        snprintf(slot.id, sizeof(slot.id), "%s", displayId.c_str());
+        slot.state.store(2, std::memory_order_release);
+        return &slot;
+      }
+    }
+    while (state == 1) state = slot.state.load(std::memory_order_acquire);
+    if (strncmp(slot.id, displayId.c_str(), sizeof(slot.id) - 1) == 0) return &slot;
+  }
+  return nullptr;
+}
+
+static void AddBackendSample(BackendStats& stats, gint64 elapsedUs, CallOutcome outcome) {
+  auto& counter = outcome == CallOutcome::kOk       ? stats.ok
+                  : outcome == CallOutcome::kFailed ? stats.failed
+                                                    : stats.fellBack;
+  counter.fetch_add(1, std::memory_order_relaxed);
+  uint64_t us = static_cast<uint64_t>(std::max<gint64>(elapsedUs, 0));
+  stats.totalUs.fetch_add(us, std::memory_order_relaxed);
+  size_t bucket = 0;
+  while (bucket < kLatencyBucketCount - 1 &&
+         elapsedUs > kLatencyBucketBoundsUs[bucket]) {
+    bucket++;
+  }
+  stats.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+static void RecordBackendCall(const std::string& displayId, StatsBackend backend,
+                              gint64 elapsedUs, CallOutcome outcome) {
+  size_t b = static_cast<size_t>(backend);
+  AddBackendSample(g_backendStats[b], elapsedUs, outcome);
+  if (DisplayStatsSlot* slot = StatsSlotFor(displayId)) {
+    AddBackendSample(slot->backends[b], elapsedUs, outcome);
+  }
+}
+
+// Time |call| (returning bool) and record it.  |hasFallback| says whether
+// a failure hands over to another backend.
+template <typename Fn>
+static bool TimeBackendCall(const std::string& displayId, StatsBackend backend,
+                            bool hasFallback, Fn&& call) {
+  gint64 start = g_get_monotonic_time();
+  bool ok = call();
+  RecordBackendCall(displayId, backend, g_get_monotonic_time() - start,
+                    ok ? CallOutcome::kOk
+                       : hasFallback ? CallOutcome::kFellBack : CallOutcome::kFailed);
+  return ok;
+}
+
+static void ResetBackendStats(BackendStats& stats) {
+  stats.ok.store(0, std::memory_order_relaxed);
+  stats.failed.store(0, std::memory_order_relaxed);
+  stats.fellBack.store(0, std::memory_order_relaxed);
+  stats.totalUs.store(0, std::memory_order_relaxed);
+  for (auto& bucket : stats.buckets) bucket.store(0, std::memory_order_relaxed);
+}
+
+// Returns nullptr for a backend that was never called.
+static FlValue* BackendStatsToFlValue(const BackendStats& stats) {
+  int64_t ok = static_cast<int64_t>(stats.ok.load(std::memory_order_relaxed));
+  int64_t failed = static_cast<int64_t>(stats.failed.load(std::memory_order_relaxed));
+  int64_t fellBack = static_cast<int64_t>(stats.fellBack.load(std::memory_order_relaxed));
+  if (ok + failed + fellBack == 0) return nullptr;
+
+  int64_t buckets[kLatencyBucketCount];
+  for (size_t i = 0; i < kLatencyBucketCount; i++)
+    buckets[i] = static_cast<int64_t>(stats.buckets[i].load(std::memory_order_relaxed));
+
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "ok", fl_value_new_int(ok));
+  fl_value_set_string_take(map, "failed", fl_value_new_int(failed));
+  fl_value_set_string_take(map, "fellBack", fl_value_new_int(fellBack));
+  fl_value_set_string_take(
+      map, "totalUs",
+      fl_value_new_int(static_cast<int64_t>(stats.totalUs.load(std::memory_order_relaxed))));
+  fl_value_set_string_take(map, "histogram", fl_value_new_int64_list(buckets, kLatencyBucketCount));
+  return map;
+}
+
+// Map of backend name -> stats, skipping backends never called.
+static FlValue* BackendStatsSetToFlValue(const BackendStats (&set)[kStatsBackendCount]) {
+  FlValue* map = fl_value_new_map();
+  for (size_t b = 0; b < kStatsBackendCount; b++) {
+    if (FlValue* stats = BackendStatsToFlValue(set[b]))
+      fl_value_set_string_take(map, kStatsBackendNames[b], stats);
+  }
+  return map;
+}
+
+// ── Subprocess runner ──────────────────────────────────────────────
+//
+// Every external tool (ddcutil, xrandr, tee, pkexec) is started
+// with posix_spawnp().  glibc implements it with CLONE_VM | CLONE_VFORK, so
+// the child never copies the page tables of the Flutter process, however
+// large the engine's address space and thread count.  Pipes are created
+// O_CLOEXEC so no child inherits another spawn's descriptors.
+//
+// RunProcess() blocks; it is meant for worker threads and one-shot setup.
+// SpawnAsync() returns at once: the child is watched through a pidfd and
+// its stdout through a non-blocking pipe, both as GLib fd sources on the
+// main loop, and the callback runs there once the child has exited and
+// its output is drained.
+//
+// A spawn may carry a supersede key (e.g. "ddcutil:4").  Starting another
+// spawn with the same key SIGTERMs the older child, whose result is then
+// reported as kSuperseded so callers drop it instead of falling back to
+// another backend.
+
+enum class SpawnStatus { kOk, kFailed, kSuperseded };
+
+struct SpawnResult {
+  SpawnStatus status = SpawnStatus::kFailed;
+  int exitCode = -1;
+  std::string output;
+};
+
+struct SpawnOptions {
+  std::string supersedeKey;  // Empty: never superseded.
+  bool captureOutput = false;
+  std::string input;         // Small stdin payload (RunProcess only).
+};
+
+using SpawnCallback = std::function<void(const SpawnResult&)>;
+
+struct SpawnedChild {
+  pid_t pid = -1;
+  int pidfd = -1;
+  std::atomic<bool> superseded{false};
+};
+
+static std::mutex g_spawnMutex;
+static std::map<std::string, std::shared_ptr<SpawnedChild>> g_spawnsByKey;
+
+static int PidfdOpen(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+// Caller holds g_spawnMutex, so the child has not been reaped yet.
+static void SignalChild(const SpawnedChild& child, int sig) {
+#ifdef SYS_pidfd_send_signal
+  if (child.pidfd >= 0 &&
+      syscall(SYS_pidfd_send_signal, child.pidfd, sig, nullptr, 0) == 0) {
+    return;
+  }
+#endif
+  kill(child.pid, sig);
+}
+
+static void RegisterSpawn(const std::string& key, const std::shared_ptr<SpawnedChild>& child) {
+  std::lock_guard<std::mutex> lock(g_spawnMutex);
+  auto& slot = g_spawnsByKey[key];
+  if (slot) {
+    slot->superseded = true;
+    SignalChild(*slot, SIGTERM);
+  }
+  slot = child;
+}
+
+// Must run before the child is reaped, so a late supersede never signals
+// a recycled pid.
+static void UnregisterSpawn(const std::string& key, const std::shared_ptr<SpawnedChild>& child) {
+  std::lock_guard<std::mutex> lock(g_spawnMutex);
+  auto it = g_spawnsByKey.find(key);
+  if (it != g_spawnsByKey.end() && it->second == child) g_spawnsByKey.erase(it);
+}
+
+static void CloseFd(int& fd) {
+  if (fd >= 0) close(fd);
+  fd = -1;
+}
+
+// Start args[0] (PATH lookup) with stdin/stdout on the given descriptors
+// (-1 = /dev/null) and stderr on /dev/null.  Returns the pid or -1.
+static pid_t SpawnChild(const std::vector<std::string>& args, int stdinFd, int stdoutFd) {
+  if (args.empty()) return -1;
+  std::vector<char*> argv;
+  argv.reserve(args.size() + 1);
+  for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (stdinFd >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, stdinFd, STDIN_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  }
+  if (stdoutFd >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, stdoutFd, STDOUT_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  }
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+  // Engine threads may block signals or ignore SIGPIPE; the child starts
+  // with a clean mask and default dispositions.
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t mask;
+  sigemptyset(&mask);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  sigaddset(&defaults, SIGTERM);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  pid_t pid = -1;
+  int rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  return rc == 0 ? pid : -1;
+}
+
+static SpawnResult SpawnResultFromStatus(const SpawnedChild& child, int status) {
+  SpawnResult result;
+  result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  if (child.superseded) {
+    result.status = SpawnStatus::kSuperseded;
+  } else if (result.exitCode == 0) {
+    result.status = SpawnStatus::kOk;
+  }
+  return result;
+}
+
+// Run a command to completion.  Safe on any thread.
+static SpawnResult RunProcess(const std::vector<std::string>& args,
+                              const SpawnOptions& opts = SpawnOptions()) {
+  TraceSpan span("spawn", args.empty() ? "" : args[0].c_str());
+  int inPipe[2] = {-1, -1};
+  int outPipe[2] = {-1, -1};
+  if (!opts.input.empty()) {
+    // The payload is written before the child exists, so it must fit in
+    // the pipe buffer; that also rules out SIGPIPE in this process.
+    if (opts.input.size() > PIPE_BUF || pipe2(inPipe, O_CLOEXEC) != 0) return SpawnResult();
+    bool written = write(inPipe[1], opts.input.data(), opts.input.size()) ==
+                   static_cast<ssize_t>(opts.input.size());
+    CloseFd(inPipe[1]);
+    if (!written) {
+      CloseFd(inPipe[0]);
+      return SpawnResult();
+    }
+  }
+  if (opts.captureOutput && pipe2(outPipe, O_CLOEXEC) != 0) {
+    CloseFd(inPipe[0]);
+    return SpawnResult();
+  }
+
+  pid_t pid = SpawnChild(args, inPipe[0], outPipe[1]);
+  CloseFd(inPipe[0]);
+  CloseFd(outPipe[1]);
+  if (pid < 0) {
+    CloseFd(outPipe[0]);
+    return SpawnResult();
+  }
+
+  auto child = std::make_shared<SpawnedChild>();
+  child->pid = pid;
+  child->pidfd = PidfdOpen(pid);
+  if (!opts.supersedeKey.empty()) RegisterSpawn(opts.supersedeKey, child);
+
+  std::string output;
+  if (outPipe[0] >= 0) {
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(outPipe[0], buf, sizeof(buf))) != 0) {
+      if (n > 0) {
+        output.append(buf, static_cast<size_t>(n));
+      } else if (errno != EINTR) {
+        break;
+      }
+    }
+    CloseFd(outPipe[0]);
+  }
+
+  // Wait without reaping so the key is dropped while the pid is still ours.
+  siginfo_t info;
+  while (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT) < 0 && errno == EINTR) {}
+  if (!opts.supersedeKey.empty()) UnregisterSpawn(opts.supersedeKey, child);
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+  CloseFd(child->pidfd);
+
+  SpawnResult result = SpawnResultFromStatus(*child, status);
+  result.output = std::move(output);
+  span.Detail("pid=%d exit=%d%s", static_cast<int>(pid), result.exitCode,
+              result.status == SpawnStatus::kSuperseded ? " superseded" : "");
+  return result;
+}
+
+struct AsyncSpawn {
+  std::shared_ptr<SpawnedChild> child;
+  std::string key;
+  int outFd = -1;
+  bool exited = false;
+  int waitStatus = 0;
+  std::string output;
+  SpawnCallback done;
+  std::string program;  // For the trace span.
+  gint64 startUs = 0;
+};
+
+static void MaybeFinishAsyncSpawn(AsyncSpawn* op) {
+  if (!op->exited || op->outFd >= 0) return;
+  SpawnResult result = SpawnResultFromStatus(*op->child, op->waitStatus);
+  result.output = std::move(op->output);
+  if (TraceEnabled()) {
+    char detail[kTraceDetailLen];
+    snprintf(detail, sizeof(detail), "pid=%d exit=%d%s async", static_cast<int>(op->child->pid),
+             result.exitCode, result.status == SpawnStatus::kSuperseded ? " superseded" : "");
+    TraceRecord("spawn", op->program.c_str(), op->startUs, g_get_monotonic_time(), detail);
+  }
+  SpawnCallback done = std::move(op->done);
+  delete op;
+  if (done) done(result);
+}
+
+static gboolean OnAsyncSpawnOutput(gint fd, GIOCondition condition, gpointer user_data) {
+  auto* op = static_cast<AsyncSpawn*>(user_data);
+  char buf[4096];
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n > 0) {
+      op->output.append(buf, static_cast<size_t>(n));
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      return G_SOURCE_CONTINUE;
+    } else {
+      break;  // EOF or error.
+    }
+  }
+  CloseFd(op->outFd);
+  MaybeFinishAsyncSpawn(op);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean OnAsyncSpawnPidfd(gint fd, GIOCondition condition, gpointer user_data) {
+  auto* op = static_cast<AsyncSpawn*>(user_data);
+  if (!op->key.empty()) UnregisterSpawn(op->key, op->child);
+  while (waitpid(op->child->pid, &op->waitStatus, 0) < 0 && errno == EINTR) {}
+  CloseFd(op->child->pidfd);
+  op->exited = true;
+  MaybeFinishAsyncSpawn(op);
+  return G_SOURCE_REMOVE;
+}
+
+// Kernels without pidfd_open (< 5.3): GLib's SIGCHLD-based child watch.
+static void OnAsyncSpawnChildWatch(GPid pid, gint status, gpointer user_data) {
+  auto* op = static_cast<AsyncSpawn*>(user_data);
+  if (!op->key.empty()) UnregisterSpawn(op->key, op->child);
+  g_spawn_close_pid(pid);
+  op->waitStatus = status;
+  op->exited = true;
+  MaybeFinishAsyncSpawn(op);
+}
+
+// Start a command and return immediately.  Main thread only; |done| runs
+// on the main loop.  Returns false (and never calls |done|) if the
+// command could not be started.  opts.input is not supported here.
+static bool SpawnAsync(const std::vector<std::string>& args, const SpawnOptions& opts,
+                       SpawnCallback done) {
+  int outPipe[2] = {-1, -1};
+  if (opts.captureOutput && pipe2(outPipe, O_CLOEXEC) != 0) return false;
+
+  gint64 startUs = g_get_monotonic_time();
+  pid_t pid = SpawnChild(args, -1, outPipe[1]);
+  CloseFd(outPipe[1]);
+  if (pid < 0) {
+    CloseFd(outPipe[0]);
+    return false;
+  }
+
+  auto* op = new AsyncSpawn();
+  op->child = std::make_shared<SpawnedChild>();
+  op->child->pid = pid;
+  op->child->pidfd = PidfdOpen(pid);
+  op->key = opts.supersedeKey;
+  op->outFd = outPipe[0];
+  op->done = std::move(done);
+  if (TraceEnabled() && !args.empty()) op->program = args[0];
+  op->startUs = startUs;
+  if (!op->key.empty()) RegisterSpawn(op->key, op->child);
+
+  if (op->outFd >= 0) {
+    // Only our end is non-blocking; the child's stdout stays blocking.
+    fcntl(op->outFd, F_SETFL, fcntl(op->outFd, F_GETFL) | O_NONBLOCK);
+    g_unix_fd_add(op->outFd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+                  OnAsyncSpawnOutput, op);
+  }
+  if (op->child->pidfd >= 0) {
+    g_unix_fd_add(op->child->pidfd, G_IO_IN, OnAsyncSpawnPidfd, op);
+  } else {
+    g_child_watch_add(pid, OnAsyncSpawnChildWatch, op);
+  }
+  return true;
+}
+
+// Record a spawned backend call.  Superseded spawns were cut short on
+// purpose and are not counted.
+static void RecordSpawnCall(const std::string& displayId, StatsBackend backend, gint64 startUs,
+                            SpawnStatus status, bool hasFallback) {
+  if (status == SpawnStatus::kSuperseded) return;
+  RecordBackendCall(displayId, backend, g_get_monotonic_time() - startUs,
+                    status == SpawnStatus::kOk ? CallOutcome::kOk
+                    : hasFallback              ? CallOutcome::kFellBack
+                                               : CallOutcome::kFailed);
+}
+
+// ── Last-applied value cache ───────────────────────────────────────
+//
+// Remembers, per display and backend, the last value written at that
+// backend's own resolution (DDC level, raw backlight step, xrandr
+// hundredths, 16-bit gamma LUT scale).  A write that would not change the
+// hardware is dropped and counted instead.  Brightness reads seed the
+// cache.  A getDisplays refresh clears the hardware levels, so changes
+// made behind our back (monitor OSD, other tools) are not hidden for long,
+// and then seeds them again.  Gamma survives the refresh: no read tells
+// what the ramp holds, and forgetting a dimmed ramp would keep the next
+// non-negative set from restoring it.
+//
+// Worker threads (setBrightnessBatch) write through here too, so the
+// table is guarded by a mutex; the skip counters are atomics.  The display
+// probe may run on a worker while writes are in flight, so its reads do
+// not touch the table: they are collected as seeds and applied on the
+// main thread by ReseedAppliedHardware(), and only if nothing was recorded
+// in the meantime.
+
+enum class WriteBackend { kDdc, kXrandr, kBacklight, kGamma, kCount };
+
+static const char* const kWriteBackendNames[] = {"ddc", "xrandr", "backlight", "gamma"};
+
+struct AppliedState {
+  int level[static_cast<size_t>(WriteBackend::kCount)] = {-1, -1, -1, -1};
+};
+
+struct AppliedSeed {
+  std::string displayId;
+  WriteBackend backend;
+  int level;
+};
+
+static std::mutex g_appliedMutex;
+static std::map<std::string, AppliedState> g_applied;
+static uint64_t g_appliedUpdates = 0;  // RecordApplied() calls; under g_appliedMutex.
+static std::atomic<uint64_t> g_skippedWrites[static_cast<size_t>(WriteBackend::kCount)];
+// Set while this thread runs ProbeDisplays(): RecordApplied() collects here.
+static thread_local std::vector<AppliedSeed>* t_appliedSeeds = nullptr;
+
+// True (and counts a skip) if |level| is already what |backend| holds.
+static bool AppliedMatches(const std::string& displayId, WriteBackend backend, int level) {
+  std::lock_guard<std::mutex> lock(g_appliedMutex);
+  auto it = g_applied.find(displayId);
+  if (it == g_applied.end() || it->second.level[static_cast<size_t>(backend)] != level)
+    return false;
+  g_skippedWrites[static_cast<size_t>(backend)].fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+static void RecordApplied(const std::string& displayId, WriteBackend backend, int level) {
+  if (t_appliedSeeds) {
+    t_appliedSeeds->push_back({displayId, backend, level});
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_appliedMutex);
+  g_applied[displayId].level[static_cast<size_t>(backend)] = level;
+  g_appliedUpdates++;
+}
+
+static uint64_t AppliedUpdates() {
+  std::lock_guard<std::mutex> lock(g_appliedMutex);
+  return g_appliedUpdates;
+}
+
+// Last recorded level, or -1 if unknown.
+static int AppliedLevel(const std::string& displayId, WriteBackend backend) {
+  std::lock_guard<std::mutex> lock(g_appliedMutex);
+  auto it = g_applied.find(displayId);
+  return it == g_applied.end() ? -1 : it->second.level[static_cast<size_t>(backend)];
+}
 
-  // Trim whitespace.
-  while (!monitorName.empty() && monitorName.back() == ' ')
-    monitorName.pop_back();
+// Forget every hardware level, keeping gamma, then seed it from a probe's
+// reads.  |updatesBefore| is AppliedUpdates() from before the reads: if a
+// write was recorded since, a read may predate it, so the seeds are dropped.
+// Main thread only.
+static void ReseedAppliedHardware(const std::vector<AppliedSeed>& seeds,
+                                  uint64_t updatesBefore) {
+  std::lock_guard<std::mutex> lock(g_appliedMutex);
+  for (auto& entry : g_applied) {
+    for (size_t i = 0; i < static_cast<size_t>(WriteBackend::kCount); i++) {
+      if (i != static_cast<size_t>(WriteBackend::kGamma)) entry.second.level[i] = -1;
+    }
+  }
+  if (g_appliedUpdates != updatesBefore) return;
+  for (const auto& seed : seeds) {
+    if (seed.backend == WriteBackend::kGamma) continue;
+    g_applied[seed.displayId].level[static_cast<size_t>(seed.backend)] = seed.level;
+  }
+}
 
-  if (!monitorName.empty()) return monitorName;
-  return manufacturer;  // Fallback to manufacturer code.
+// Seed the DDC level from a read.  Writes send brightness * 100, so a
+// read only matches one when the monitor's maximum is 100.
+static void RecordReadDdcLevel(const std::string& displayId, int current, int maximum) {
+  if (maximum == 100) RecordApplied(displayId, WriteBackend::kDdc, current);
 }
 
 // ── Brightness control via sysfs (backlight) ───────────────────────
@@ -126,9 +972,23 @@ static double GetBacklightBrightness(const std::string& backlightPath) {
   curFile >> current;
   maxFile >> maximum;
   if (maximum <= 0) return 1.0;
+  RecordApplied("backlight", WriteBackend::kBacklight, current);
   return static_cast<double>(current) / static_cast<double>(maximum);
 }
 
+static bool WriteBacklightLevel(const std::string& backlightPath, int newValue) {
+  std::ofstream curFile(backlightPath + "/brightness");
+  if (curFile.is_open()) {
+    curFile << newValue;
+    return curFile.good();
+  }
+
+  // Fallback: use tee for permission issues.
+  SpawnOptions opts;
+  opts.input = std::to_string(newValue);
+  return RunProcess({"tee", backlightPath + "/brightness"}, opts).status == SpawnStatus::kOk;
+}
+
 static bool SetBacklightBrightness(const std::string& backlightPath, double brightness) {
   std::ifstream maxFile(backlightPath + "/max_brightness");
   if (!maxFile.is_open()) return false;
@@ -140,47 +1000,13 @@ static bool SetBacklightBrightness(const std::string& backlightPath, double brig
   int newValue = static_cast<int>(std::clamp(brightness, 0.0, 1.0) * maximum);
   if (newValue < 1 && brightness > 0.0) newValue = 1;
 
-  std::ofstream curFile(backlightPath + "/brightness");
-  if (curFile.is_open()) {
-    curFile << newValue;
-    return curFile.good();
-  }
-
-  // Fallback: use fork/exec with tee for permission issues.
-  std::string brightnessFile = backlightPath + "/brightness";
-  std::string valueStr = std::to_string(newValue);
-
-  int pipefd[2];
-  if (pipe(pipefd) != 0) return false;
-
-  pid_t pid = fork();
-  if (pid < 0) {
-    close(pipefd[0]);
-    close(pipefd[1]);
+  if (AppliedMatches("backlight", WriteBackend::kBacklight, newValue)) return true;
+  if (!TimeBackendCall("backlight", StatsBackend::kBacklight, false,
+                       [&] { return WriteBacklightLevel(backlightPath, newValue); })) {
     return false;
   }
-
-  if (pid == 0) {
-    close(pipefd[1]);
-    dup2(pipefd[0], STDIN_FILENO);
-    close(pipefd[0]);
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDOUT_FILENO);
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
-    }
-    execlp("tee", "tee", brightnessFile.c_str(), nullptr);
-    _exit(1);
-  }
-
-  close(pipefd[0]);
-  write(pipefd[1], valueStr.c_str(), valueStr.size());
-  close(pipefd[1]);
-
-  int status = 0;
-  waitpid(pid, &status, 0);
-  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  RecordApplied("backlight", WriteBackend::kBacklight, newValue);
+  return true;
 }
 
 // ── DDC/CI via direct I2C ──────────────────────────────────────────
@@ -191,38 +1017,45 @@ static bool SetBacklightBrightness(const std::string& backlightPath, double brig
 
 static const uint8_t DDC_CI_ADDR = 0x37;
 static const uint8_t VCP_BRIGHTNESS = 0x10;
+static const uint8_t VCP_CONTRAST = 0x12;
+static const uint8_t VCP_COLOR_PRESET = 0x14;
+static const uint8_t VCP_INPUT_SOURCE = 0x60;
+static const uint8_t VCP_AUDIO_VOLUME = 0x62;
+static const uint8_t VCP_AUDIO_MUTE = 0x8D;
+static const uint8_t VCP_POWER_MODE = 0xD6;
 
-// Compute DDC/CI checksum: XOR of (source_addr << 1) and all payload bytes.
 // ── I2C permission setup ───────────────────────────────────────────
 //
 // DDC/CI requires read/write access to /dev/i2c-* devices.  On most Linux
-// distros these are root-only by default.  This helper sets up the required
-// udev rule and user group so the app can access I2C without root.
-// It runs once and uses pkexec (PolicyKit) to get the needed privileges.
-
-static bool g_i2c_setup_attempted = false;
-static bool g_i2c_accessible = false;
-
-// Helper: run a command via fork/exec with no shell.  Returns exit status.
-// argv[0] is the program name, last element must be nullptr.
-static int ForkExec(const char* const argv[]) {
-  pid_t pid = fork();
-  if (pid < 0) return -1;
-  if (pid == 0) {
-    // Child: silence stdout/stderr.
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDOUT_FILENO);
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
-    }
-    execvp(argv[0], const_cast<char* const*>(argv));
-    _exit(127);
-  }
-  int status = 0;
-  waitpid(pid, &status, 0);
-  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-}
+// distros these are root-only by default.
+//
+// Checking and fixing access are separate steps.  Every display probe
+// checks the buses it found with faccessat(), a few syscalls that never
+// block, and records the result.  Fixing access (a udev rule and an i2c
+// group, installed with pkexec) runs only when Dart calls
+// setupI2cPermissions, and as an async spawn, so enumeration never waits
+// on a PolicyKit dialog.  The outcome of the last setup is kept under the
+// user cache directory: a later session then knows that the rule is in
+// place and only a re-login is missing, or that the user declined.
+//
+// I2C access belongs to the process, not to any display, so it is not part
+// of the display registry.
+
+enum class I2cAccess { kUnknown, kNoBuses, kNoDevices, kDenied, kAccessible };
+enum class I2cSetup { kNone, kRunning, kInstalled, kDeclined, kFailed };
+
+static const char* const kI2cAccessNames[] = {"unknown", "noBuses", "noDevices", "denied",
+                                              "accessible"};
+static const char* const kI2cSetupNames[] = {"none", "running", "installed", "declined",
+                                             "failed"};
+
+static std::atomic<I2cAccess> g_i2cAccess{I2cAccess::kUnknown};
+static std::mutex g_i2cBusesMutex;
+static std::vector<int> g_i2cBuses;              // Guarded by g_i2cBusesMutex.
+static I2cSetup g_i2cSetup = I2cSetup::kNone;    // Main thread.
+static bool g_i2cSetupLoaded = false;            // Main thread.
+static std::vector<std::function<void()>> g_i2cSetupWaiters;  // Main thread.
+static std::function<void()> g_i2cStatusListener;             // Main thread.
 
 // Get the current username safely via getpwuid (not getenv).
 static std::string GetCurrentUsername() {
@@ -245,49 +1078,130 @@ static bool IsValidUsername(const std::string& name) {
   return true;
 }
 
-static bool SetupI2cPermissions() {
-  if (g_i2c_setup_attempted) return g_i2c_accessible;
-  g_i2c_setup_attempted = true;
-
-  // Check if i2c-dev module is loaded; load it if not.
-  // Check /sys/module/i2c_dev first to avoid unnecessary modprobe.
-  if (!std::filesystem::exists("/dev/i2c-0") &&
-      !std::filesystem::exists("/sys/module/i2c_dev")) {
-    const char* modprobe_argv[] = {"modprobe", "i2c-dev", nullptr};
-    ForkExec(modprobe_argv);
-    // Give kernel a moment to create device nodes.
-    usleep(100000);
-  }
-
-  // Check if we already have access to any I2C device.
-  for (const auto& entry : std::filesystem::directory_iterator("/dev")) {
-    std::string name = entry.path().filename().string();
-    if (name.find("i2c-") == 0) {
-      int fd = open(entry.path().c_str(), O_RDWR);
-      if (fd >= 0) {
-        close(fd);
-        g_i2c_accessible = true;
-        fprintf(stderr, "[BSDisplayControl] I2C devices already accessible.\n");
-        return true;
+// Whether this process may open any of |buses| read/write.  AT_EACCESS
+// checks the effective IDs and current groups, so a group granted by
+// setup but not yet picked up by a re-login still reads as denied.
+static I2cAccess CheckI2cAccess(const std::vector<int>& buses) {
+  if (buses.empty()) return I2cAccess::kNoBuses;
+  bool anyNode = false;
+  for (int bus : buses) {
+    char path[32];
+    snprintf(path, sizeof(path), "/dev/i2c-%d", bus);
+    if (faccessat(AT_FDCWD, path, R_OK | W_OK, AT_EACCESS) == 0) return I2cAccess::kAccessible;
+    if (errno != ENOENT) anyNode = true;
+  }
+  // No device nodes at all: the i2c-dev module is not loaded.
+  return anyNode ? I2cAccess::kDenied : I2cAccess::kNoDevices;
+}
+
+static gboolean OnI2cStatusChanged(gpointer user_data) {
+  if (g_i2cStatusListener) g_i2cStatusListener();
+  return G_SOURCE_REMOVE;
+}
+
+static void StoreI2cAccess(I2cAccess access) {
+  if (g_i2cAccess.exchange(access, std::memory_order_relaxed) == access) return;
+  fprintf(stderr, "[BSDisplayControl] I2C access: %s\n",
+          kI2cAccessNames[static_cast<int>(access)]);
+  g_idle_add(OnI2cStatusChanged, nullptr);
+}
+
+// Check |buses| (every DDC bus the probe found) and remember them for the
+// re-check after setup.  Any thread.
+static void RecordI2cBuses(std::vector<int> buses) {
+  I2cAccess access = CheckI2cAccess(buses);
+  {
+    std::lock_guard<std::mutex> lock(g_i2cBusesMutex);
+    g_i2cBuses = std::move(buses);
+  }
+  StoreI2cAccess(access);
+}
+
+static void RecheckI2cAccess() {
+  std::vector<int> buses;
+  {
+    std::lock_guard<std::mutex> lock(g_i2cBusesMutex);
+    buses = g_i2cBuses;
+  }
+  StoreI2cAccess(CheckI2cAccess(buses));
+}
+
+static std::string I2cSetupStatePath() {
+  g_autofree gchar* path = g_build_filename(g_get_user_cache_dir(), "bs_display_control",
+                                            "i2c-setup", nullptr);
+  return path;
+}
+
+static I2cSetup CurrentI2cSetup() {
+  if (!g_i2cSetupLoaded) {
+    g_i2cSetupLoaded = true;
+    g_autofree gchar* contents = nullptr;
+    if (g_file_get_contents(I2cSetupStatePath().c_str(), &contents, nullptr, nullptr)) {
+      g_strstrip(contents);
+      for (I2cSetup setup : {I2cSetup::kInstalled, I2cSetup::kDeclined, I2cSetup::kFailed}) {
+        if (strcmp(contents, kI2cSetupNames[static_cast<int>(setup)]) == 0) g_i2cSetup = setup;
       }
-      break;  // If one is inaccessible, they all are.
     }
   }
+  return g_i2cSetup;
+}
 
-  // I2C devices exist but are not accessible.
-  fprintf(stderr, "[BSDisplayControl] I2C devices not accessible, requesting permissions...\n");
+static void FinishI2cSetup(I2cSetup outcome) {
+  g_i2cSetup = outcome;
+  std::string path = I2cSetupStatePath();
+  g_autofree gchar* dir = g_path_get_dirname(path.c_str());
+  g_mkdir_with_parents(dir, 0700);
+  std::string contents = std::string(kI2cSetupNames[static_cast<int>(outcome)]) + "\n";
+  g_file_set_contents(path.c_str(), contents.c_str(), -1, nullptr);
+
+  RecheckI2cAccess();
+  g_idle_add(OnI2cStatusChanged, nullptr);
+  std::vector<std::function<void()>> waiters;
+  waiters.swap(g_i2cSetupWaiters);
+  for (auto& waiter : waiters) waiter();
+}
+
+// {access, setup, buses}.  Main thread.
+static FlValue* I2cStatusToFlValue() {
+  FlValue* result = fl_value_new_map();
+  fl_value_set_string_take(
+      result, "access",
+      fl_value_new_string(kI2cAccessNames[static_cast<int>(g_i2cAccess.load())]));
+  fl_value_set_string_take(
+      result, "setup", fl_value_new_string(kI2cSetupNames[static_cast<int>(CurrentI2cSetup())]));
+  FlValue* buses = fl_value_new_list();
+  {
+    std::lock_guard<std::mutex> lock(g_i2cBusesMutex);
+    for (int bus : g_i2cBuses) fl_value_append_take(buses, fl_value_new_int(bus));
+  }
+  fl_value_set_string_take(result, "buses", buses);
+  return result;
+}
+
+// Install the udev rule and i2c group with pkexec, without blocking.
+// |done| runs on the main loop once setup has finished (at once if access
+// is already fine); calls made while setup runs share its outcome.
+static void StartI2cSetup(std::function<void()> done) {
+  if (g_i2cAccess.load() == I2cAccess::kAccessible) {
+    done();
+    return;
+  }
+  g_i2cSetupWaiters.push_back(std::move(done));
+  if (CurrentI2cSetup() == I2cSetup::kRunning) return;
 
   std::string user = GetCurrentUsername();
   if (!IsValidUsername(user)) {
     fprintf(stderr, "[BSDisplayControl] Cannot determine valid username for I2C setup.\n");
-    return false;
+    FinishI2cSetup(I2cSetup::kFailed);
+    return;
   }
 
   // Set up persistent udev rule + i2c group via pkexec sh -c "..." (no temp file).
   // This avoids TOCTOU race conditions with /tmp scripts.
   // The udev rule grants group 'i2c' read/write on i2c devices with MODE=0660
-  // (not world-readable 0666).
+  // (not world-readable 0666).  Loading i2c-dev needs root too.
   std::string setupScript =
+      "modprobe i2c-dev 2>/dev/null; "
       "grep -q '^i2c:' /etc/group || groupadd i2c; "
       "usermod -aG i2c " + user + "; "
       "echo 'KERNEL==\"i2c-[0-9]*\", GROUP=\"i2c\", MODE=\"0660\"' "
@@ -297,40 +1211,67 @@ static bool SetupI2cPermissions() {
       "chgrp i2c /dev/i2c-* 2>/dev/null; "
       "chmod 0660 /dev/i2c-* 2>/dev/null";
 
-  const char* pkexec_argv[] = {"pkexec", "sh", "-c", setupScript.c_str(), nullptr};
-  int ret = ForkExec(pkexec_argv);
-  if (ret != 0) {
-    fprintf(stderr, "[BSDisplayControl] pkexec I2C setup failed (ret=%d).\n", ret);
-    fprintf(stderr, "[BSDisplayControl] You can set up manually:\n");
-    fprintf(stderr, "  sudo groupadd i2c\n");
-    fprintf(stderr, "  sudo usermod -aG i2c %s\n", user.c_str());
-    fprintf(stderr, "  (Then log out and back in for group to take effect)\n");
-    return false;
-  }
-
-  fprintf(stderr, "[BSDisplayControl] Persistent I2C permissions installed.\n");
-
-  // Verify access.
-  for (const auto& entry : std::filesystem::directory_iterator("/dev")) {
-    std::string name = entry.path().filename().string();
-    if (name.find("i2c-") == 0) {
-      int fd = open(entry.path().c_str(), O_RDWR);
-      if (fd >= 0) {
-        close(fd);
-        g_i2c_accessible = true;
-        fprintf(stderr, "[BSDisplayControl] I2C permissions set up successfully.\n");
-        return true;
+  fprintf(stderr, "[BSDisplayControl] I2C devices not accessible, requesting permissions...\n");
+  g_i2cSetup = I2cSetup::kRunning;
+  g_idle_add(OnI2cStatusChanged, nullptr);
+  bool started = SpawnAsync({"pkexec", "sh", "-c", setupScript}, SpawnOptions(),
+                            [user](const SpawnResult& ret) {
+    if (ret.status == SpawnStatus::kOk) {
+      fprintf(stderr, "[BSDisplayControl] Persistent I2C permissions installed.\n");
+      FinishI2cSetup(I2cSetup::kInstalled);
+      if (g_i2cAccess.load() != I2cAccess::kAccessible) {
+        // Group membership takes effect at the next login.
+        fprintf(stderr, "[BSDisplayControl] I2C not yet accessible — you may need to log out and back in.\n");
       }
-      break;
+      return;
     }
+    // pkexec exits 126 when the dialog is dismissed or authorization denied.
+    fprintf(stderr, "[BSDisplayControl] pkexec I2C setup failed (ret=%d).\n", ret.exitCode);
+    fprintf(stderr, "[BSDisplayControl] You can set up manually:\n");
+    fprintf(stderr, "  sudo groupadd i2c\n");
+    fprintf(stderr, "  sudo usermod -aG i2c %s\n", user.c_str());
+    fprintf(stderr, "  (Then log out and back in for group to take effect)\n");
+    FinishI2cSetup(ret.exitCode == 126 ? I2cSetup::kDeclined : I2cSetup::kFailed);
+  });
+  if (!started) {
+    fprintf(stderr, "[BSDisplayControl] Could not start pkexec for I2C setup.\n");
+    FinishI2cSetup(I2cSetup::kFailed);
   }
-
-  // Permissions may not take effect until re-login (group membership).
-  fprintf(stderr, "[BSDisplayControl] I2C not yet accessible — you may need to log out and back in.\n");
-  return false;
 }
 
 // ── DDC/CI protocol ────────────────────────────────────────────────
+//
+// Host -> display frames start with the source address 0x51 and a length
+// byte (0x80 | payload length), and end with a checksum: XOR of the
+// destination address (0x6E) and every preceding byte.
+//
+//   Get VCP Feature:  [0x51][0x82][0x01][code][chk]
+//   Set VCP Feature:  [0x51][0x84][0x03][code][hi][lo][chk]
+//
+// Get frames are fully constant per VCP code, so a table of all 256 is
+// built at compile time.  Set frames only differ in the value bytes, so
+// the checksum over the constant prefix is precomputed and the value
+// bytes are folded in at runtime.
+
+static const uint8_t DDC_DEST_ADDR = 0x6E;
+static const uint8_t DDC_HOST_ADDR = 0x51;
+static const uint8_t DDC_OP_GET_VCP = 0x01;
+static const uint8_t DDC_OP_GET_VCP_REPLY = 0x02;
+static const uint8_t DDC_OP_SET_VCP = 0x03;
+static const uint8_t DDC_OP_CAPS_REQUEST = 0xF3;
+static const uint8_t DDC_OP_CAPS_REPLY = 0xE3;
+
+// Capabilities strings are normally a few hundred bytes; anything beyond
+// this is treated as a misbehaving monitor.
+static const size_t kMccsMaxCapsLength = 8192;
+static const int kMccsFragmentRetries = 3;
+
+// Delay between a Get request and reading the reply, and the minimum gap
+// between the end of one transaction and the next write on the same bus.
+// The DDC/CI spec asks for 40ms and 50ms respectively; 50ms for the reply
+// is what real hardware needed in testing.
+static const gint64 kDdcReplyDelayUs = 50000;
+static const gint64 kDdcCommandGapUs = 50000;
 
 static uint8_t DdcChecksum(uint8_t srcAddr, const uint8_t* data, size_t len) {
   uint8_t csum = srcAddr;
@@ -338,77 +1279,860 @@ static uint8_t DdcChecksum(uint8_t srcAddr, const uint8_t* data, size_t len) {
   return csum;
 }
 
-// Try to get brightness via DDC/CI on a given I2C bus.
-// Returns true if successful, with brightness in [0..100].
-static bool DdcGetBrightness(int busNum, int& outCurrent, int& outMax) {
-  std::string devPath = "/dev/i2c-" + std::to_string(busNum);
-  int fd = open(devPath.c_str(), O_RDWR);
-  if (fd < 0) return false;
+using DdcGetFrame = std::array<uint8_t, 5>;
+using DdcSetFrame = std::array<uint8_t, 7>;
 
-  if (ioctl(fd, I2C_SLAVE, DDC_CI_ADDR) < 0) {
-    close(fd);
-    return false;
+static constexpr DdcGetFrame MakeVcpGetFrame(uint8_t code) {
+  return {DDC_HOST_ADDR, 0x82, DDC_OP_GET_VCP, code,
+          static_cast<uint8_t>(DDC_DEST_ADDR ^ DDC_HOST_ADDR ^ 0x82 ^
+                               DDC_OP_GET_VCP ^ code)};
+}
+
+static constexpr std::array<DdcGetFrame, 256> MakeVcpGetFrameTable() {
+  std::array<DdcGetFrame, 256> table{};
+  for (size_t code = 0; code < 256; ++code)
+    table[code] = MakeVcpGetFrame(static_cast<uint8_t>(code));
+  return table;
+}
+
+static constexpr std::array<uint8_t, 256> MakeVcpSetChecksumTable() {
+  std::array<uint8_t, 256> table{};
+  for (size_t code = 0; code < 256; ++code)
+    table[code] = static_cast<uint8_t>(DDC_DEST_ADDR ^ DDC_HOST_ADDR ^ 0x84 ^
+                                       DDC_OP_SET_VCP ^ code);
+  return table;
+}
+
+static constexpr std::array<DdcGetFrame, 256> kVcpGetFrames = MakeVcpGetFrameTable();
+static constexpr std::array<uint8_t, 256> kVcpSetChecksumBase = MakeVcpSetChecksumTable();
+
+static_assert(kVcpGetFrames[VCP_BRIGHTNESS][4] == (0x6E ^ 0x51 ^ 0x82 ^ 0x01 ^ 0x10),
+              "Get VCP checksum");
+
+static inline DdcSetFrame MakeVcpSetFrame(uint8_t code, uint16_t value) {
+  uint8_t hi = static_cast<uint8_t>(value >> 8);
+  uint8_t lo = static_cast<uint8_t>(value & 0xFF);
+  return {DDC_HOST_ADDR, 0x84, DDC_OP_SET_VCP, code, hi, lo,
+          static_cast<uint8_t>(kVcpSetChecksumBase[code] ^ hi ^ lo)};
+}
+
+// Per-bus state shared by every DdcSession and RunDdcTransactions() round,
+// whichever thread they run on (main loop, batch jobs, the display probe).
+// |mutex| is held for as long as a caller drives the bus, and |lastDoneUs|
+// is when the bus's last transaction ended, so kDdcCommandGapUs holds
+// between callers too.  Entries are never removed; std::map keeps their
+// addresses stable.  Callers that need several buses lock them in
+// ascending bus order.
+struct DdcBusState {
+  std::mutex mutex;
+  gint64 lastDoneUs = 0;
+};
+
+static std::mutex g_ddcBusesMutex;  // Guards g_ddcBuses itself.
+static std::map<int, DdcBusState> g_ddcBuses;
+
+static DdcBusState& DdcBus(int busNum) {
+  std::lock_guard<std::mutex> lock(g_ddcBusesMutex);
+  return g_ddcBuses[busNum];
+}
+
+// One open DDC/CI bus, held exclusively for the session's lifetime.
+// Commands wait only for whatever part of kDdcCommandGapUs has not already
+// elapsed since the previous transaction on the bus, from any session.
+class DdcSession {
+ public:
+  explicit DdcSession(int busNum)
+      : busNum_(busNum), bus_(DdcBus(busNum)), busLock_(bus_.mutex) {
+    char devPath[32];
+    snprintf(devPath, sizeof(devPath), "/dev/i2c-%d", busNum);
+    fd_ = open(devPath, O_RDWR | O_CLOEXEC);
+    if (fd_ >= 0 && ioctl(fd_, I2C_SLAVE, DDC_CI_ADDR) < 0) {
+      close(fd_);
+      fd_ = -1;
+    }
   }
+  ~DdcSession() {
+    if (fd_ >= 0) close(fd_);
+  }
+  DdcSession(const DdcSession&) = delete;
+  DdcSession& operator=(const DdcSession&) = delete;
 
-  // DDC/CI "Get VCP Feature" request for brightness.
-  uint8_t request[] = {0x51, 0x82, 0x01, VCP_BRIGHTNESS, 0x00};
-  request[4] = DdcChecksum(0x6E, request, 4);
+  bool ok() const { return fd_ >= 0; }
+  int fd() const { return fd_; }
 
-  if (write(fd, request, sizeof(request)) != static_cast<ssize_t>(sizeof(request))) {
-    close(fd);
-    return false;
+  // How much of kDdcCommandGapUs is still to wait before the next command.
+  gint64 GapRemainingUs() const {
+    if (bus_.lastDoneUs == 0) return 0;
+    return std::max<gint64>(kDdcCommandGapUs - (g_get_monotonic_time() - bus_.lastDoneUs), 0);
   }
+  // Record that a transaction on the bus just ended.
+  void MarkDone() { bus_.lastDoneUs = g_get_monotonic_time(); }
+
+  // Read a VCP feature.  Returns true with current/max values on success.
+  bool GetVcp(uint8_t code, int& outCurrent, int& outMax) {
+    if (fd_ < 0) return false;
+    TraceSpan span("i2c", "GetVcp");
+    span.Detail("bus=%d code=0x%02x", busNum_, code);
+    const DdcGetFrame& request = kVcpGetFrames[code];
+
+    WaitForGap();
+    if (write(fd_, request.data(), request.size()) !=
+        static_cast<ssize_t>(request.size())) {
+      MarkDone();
+      return false;
+    }
 
-  // DDC/CI spec says to wait 40-50ms for the monitor to respond.
-  usleep(50000);
+    // Monitor needs time to prepare the reply.
+    usleep(kDdcReplyDelayUs);
 
-  uint8_t response[12] = {};
-  ssize_t bytesRead = read(fd, response, sizeof(response));
-  close(fd);
+    uint8_t response[12] = {};
+    ssize_t bytesRead = read(fd_, response, sizeof(response));
+    MarkDone();
+
+    return ParseVcpReply(code, response, bytesRead, outCurrent, outMax);
+  }
 
-  if (bytesRead < 9) return false;
+  // Write a VCP feature.  Returns true if the frame was accepted by the bus.
+  bool SetVcp(uint8_t code, int value) {
+    if (fd_ < 0) return false;
+    TraceSpan span("i2c", "SetVcp");
+    span.Detail("bus=%d code=0x%02x value=%d", busNum_, code, value);
+    DdcSetFrame cmd = MakeVcpSetFrame(
+        code, static_cast<uint16_t>(std::clamp(value, 0, 0xFFFF)));
+
+    WaitForGap();
+    ssize_t written = write(fd_, cmd.data(), cmd.size());
+    MarkDone();
+    return written == static_cast<ssize_t>(cmd.size());
+  }
+
+  // Retrieve the MCCS capabilities string with Capabilities Request (0xF3).
+  // The monitor returns it in fragments; each request carries the offset
+  // of the next fragment and an empty fragment marks the end.
+  //   Request: [0x51][0x83][0xF3][off_hi][off_lo][chk]
+  //   Reply:   [0x6E][0x80|len][0xE3][off_hi][off_lo][data...][chk]
+  bool GetCapabilities(std::string& out) {
+    out.clear();
+    if (fd_ < 0) return false;
+    TraceSpan span("i2c", "GetCapabilities");
+    span.Detail("bus=%d", busNum_);
+
+    int retries = 0;
+    while (out.size() < kMccsMaxCapsLength) {
+      uint16_t offset = static_cast<uint16_t>(out.size());
+      uint8_t request[6] = {DDC_HOST_ADDR, 0x83, DDC_OP_CAPS_REQUEST,
+                            static_cast<uint8_t>(offset >> 8),
+                            static_cast<uint8_t>(offset & 0xFF), 0x00};
+      request[5] = DdcChecksum(DDC_DEST_ADDR, request, 5);
+
+      WaitForGap();
+      bool sent = write(fd_, request, sizeof(request)) ==
+                  static_cast<ssize_t>(sizeof(request));
+      ssize_t bytesRead = -1;
+      uint8_t response[64] = {};
+      if (sent) {
+        usleep(kDdcReplyDelayUs);
+        bytesRead = read(fd_, response, sizeof(response));
+      }
+      MarkDone();
+
+      const uint8_t* data = nullptr;
+      size_t dataLen = 0;
+      if (!ParseCapsFragment(response, bytesRead, offset, data, dataLen)) {
+        if (++retries > kMccsFragmentRetries) return false;
+        continue;
+      }
+      retries = 0;
+      if (dataLen == 0) break;  // End of string.
+      out.append(reinterpret_cast<const char*>(data), dataLen);
+    }
+
+    // Some monitors NUL-terminate the final fragment.
+    while (!out.empty() && out.back() == '\0') out.pop_back();
+    return !out.empty();
+  }
 
   // Find the VCP Feature Reply opcode (0x02) in the response.
   // Format: [opcode=0x02][result][vcp_code][type][max_hi][max_lo][cur_hi][cur_lo]
-  int offset = -1;
-  for (int i = 0; i < bytesRead - 8; ++i) {
-    if (response[i] == 0x02 && response[i + 2] == VCP_BRIGHTNESS) {
-      offset = i;
-      break;
+  static bool ParseVcpReply(uint8_t code, const uint8_t* response, ssize_t len,
+                            int& outCurrent, int& outMax) {
+    if (len < 9) return false;
+    int offset = -1;
+    for (int i = 0; i < len - 8; ++i) {
+      if (response[i] == DDC_OP_GET_VCP_REPLY && response[i + 2] == code) {
+        offset = i;
+        break;
+      }
     }
+    if (offset < 0) return false;
+    if (response[offset + 1] != 0x00) return false;  // Unsupported VCP code.
+
+    // offset+3 = VCP type code (skip it).
+    int maximum = (response[offset + 4] << 8) | response[offset + 5];
+    int current = (response[offset + 6] << 8) | response[offset + 7];
+    // Non-continuous features (e.g. input source) may report max 0.
+    if (maximum <= 0 && code == VCP_BRIGHTNESS) return false;
+    outMax = maximum;
+    outCurrent = current;
+    return true;
+  }
+
+ private:
+  // Validate a Capabilities Reply fragment for |offset| and locate its data.
+  static bool ParseCapsFragment(const uint8_t* response, ssize_t len,
+                                uint16_t offset, const uint8_t*& outData,
+                                size_t& outLen) {
+    if (len < 6) return false;
+    if (response[0] != DDC_DEST_ADDR || !(response[1] & 0x80)) return false;
+    size_t payloadLen = response[1] & 0x7F;  // Opcode + offset + data.
+    if (payloadLen < 3 || static_cast<size_t>(len) < payloadLen + 3) return false;
+    if (response[2] != DDC_OP_CAPS_REPLY) return false;
+    uint16_t echoed = static_cast<uint16_t>((response[3] << 8) | response[4]);
+    if (echoed != offset) return false;
+
+    // Replies are checksummed against the virtual host address 0x50.
+    uint8_t chk = DdcChecksum(0x50, response, payloadLen + 2);
+    if (chk != response[payloadLen + 2]) return false;
+
+    outData = response + 5;
+    outLen = payloadLen - 3;
+    return true;
   }
-  if (offset < 0) return false;
 
-  if (response[offset + 1] != 0x00) return false;  // Result code error.
+  void WaitForGap() {
+    gint64 remaining = GapRemainingUs();
+    if (remaining > 0) usleep(static_cast<useconds_t>(remaining));
+  }
 
-  // offset+3 = VCP type code (skip it).
-  outMax = (response[offset + 4] << 8) | response[offset + 5];
-  outCurrent = (response[offset + 6] << 8) | response[offset + 7];
+  int busNum_;
+  DdcBusState& bus_;
+  std::lock_guard<std::mutex> busLock_;
+  int fd_ = -1;
+};
 
-  if (outMax <= 0) return false;
-  return true;
+// Try to get brightness via DDC/CI on a given I2C bus.
+// Returns true if successful, with brightness in [0..100].
+static bool DdcGetBrightness(int busNum, int& outCurrent, int& outMax) {
+  DdcSession session(busNum);
+  return session.GetVcp(VCP_BRIGHTNESS, outCurrent, outMax);
 }
 
 // Set brightness via DDC/CI on a given I2C bus.
 static bool DdcSetBrightness(int busNum, int value) {
-  std::string devPath = "/dev/i2c-" + std::to_string(busNum);
-  int fd = open(devPath.c_str(), O_RDWR);
-  if (fd < 0) return false;
+  DdcSession session(busNum);
+  return session.SetVcp(VCP_BRIGHTNESS, value);
+}
 
-  if (ioctl(fd, I2C_SLAVE, DDC_CI_ADDR) < 0) {
-    close(fd);
+// ── io_uring DDC/CI transport ──────────────────────────────────────
+//
+// A video wall can put a dozen monitors on separate I2C adapters.  Running
+// write / 50ms wait / read per bus in turn costs 50ms per monitor, and a
+// thread per bus costs a thread per bus.  RunDdcTransactions() instead
+// queues one chain per bus on a single io_uring:
+//
+//   Get:  [gap] ─ WRITE request ─ TIMEOUT 50ms ─ READ reply + LINK_TIMEOUT
+//   Set:  [gap] ─ WRITE command + LINK_TIMEOUT
+//
+// and waits once for every completion.  i2c-dev has no non-blocking I/O,
+// so the kernel runs each chain on its io-wq workers, in parallel across
+// buses; the linked timeout bounds a wedged adapter.  A second transaction
+// on the same bus goes in the next round behind a kDdcCommandGapUs timeout.
+//
+// The ring is created on first use and kept for the life of the process,
+// so batches (each on a fresh coordinator thread) do not pay for
+// io_uring_setup and the mmaps every time.  Callers take turns on it under
+// g_ddcRingMutex; one caller's round already covers every bus it needs.
+// The buses themselves are held through DdcSessions for the whole call, so
+// the gap before a bus's first chain covers the previous caller too.
+//
+// The ring is driven through raw syscalls (no liburing).  The delays need
+// IORING_TIMEOUT_ETIME_SUCCESS (Linux 5.16) so an expiring timeout does not
+// break its chain.  When io_uring is missing, disabled (sysctl, seccomp) or
+// too old, transactions run through blocking DdcSessions one at a time.
+
+struct DdcTransaction {
+  int bus;
+  uint8_t code;
+  bool isSet;
+  int value;  // Value to write (isSet only).
+  // Results.
+  bool ok;
+  int current;
+  int maximum;
+};
+
+static const unsigned kDdcRingEntries = 64;
+static const size_t kDdcRingMaxChains = 12;  // At most 5 SQEs per chain.
+static const gint64 kDdcTransferTimeoutUs = 1000000;
+
+static std::atomic<bool> g_ddcRingDisabled{false};
+static std::mutex g_ddcRingMutex;  // Held while using DdcRing::Shared().
+
+struct DdcChain {
+  DdcTransaction* tx;
+  int fd;
+  bool gapFirst;  // The bus was used less than kDdcCommandGapUs ago.
+  __kernel_timespec gapTs;
+  std::array<uint8_t, 7> frame;
+  size_t frameLen;
+  uint8_t reply[12];
+  int writeRes;
+  int readRes;
+  bool rejected;  // Kernel refused an opcode or flag.
+  gint64 doneUs;  // Last completion seen, for tracing.
+};
+
+static __kernel_timespec DdcTimespec(gint64 us) {
+  __kernel_timespec ts = {};
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+  return ts;
+}
+
+class DdcRing {
+ public:
+  // The process-wide ring, created on first use and replaced if it broke.
+  // nullptr when io_uring cannot be used.  Call with g_ddcRingMutex held.
+  static DdcRing* Shared() {
+    static std::unique_ptr<DdcRing> ring;
+    static bool unavailable = false;
+    if (g_ddcRingDisabled || unavailable) return nullptr;
+    if (!ring || ring->broken_) {
+      ring = std::make_unique<DdcRing>();
+      if (!ring->Init()) {
+        ring.reset();
+        unavailable = true;
+      }
+    }
+    return ring.get();
+  }
+
+  DdcRing() = default;
+  ~DdcRing() {
+    if (sqes_) munmap(sqes_, sqeBytes_);
+    if (ring_) munmap(ring_, ringBytes_);
+    if (fd_ >= 0) close(fd_);
+  }
+  DdcRing(const DdcRing&) = delete;
+  DdcRing& operator=(const DdcRing&) = delete;
+
+  // Start every chain at once and wait for all of them.  Returns false if
+  // the ring itself failed; per-chain results are in |chains|.
+  bool RunRound(std::vector<DdcChain>& chains) {
+    const __kernel_timespec delayTs = DdcTimespec(kDdcReplyDelayUs);
+    const __kernel_timespec limitTs = DdcTimespec(kDdcTransferTimeoutUs);
+
+    unsigned tail = *sqTail_;  // Only the g_ddcRingMutex holder produces.
+    unsigned queued = 0;
+    auto next = [&](uint64_t userData, uint8_t flags) {
+      unsigned idx = tail++ & sqMask_;
+      io_uring_sqe* sqe = &sqes_[idx];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->flags = flags;
+      sqe->user_data = userData;
+      sqArray_[idx] = idx;
+      queued++;
+      return sqe;
+    };
+    auto prepTimeout = [](io_uring_sqe* sqe, uint8_t opcode, const __kernel_timespec* ts) {
+      sqe->opcode = opcode;
+      sqe->fd = -1;
+      sqe->addr = reinterpret_cast<uintptr_t>(ts);
+      sqe->len = 1;
+      if (opcode == IORING_OP_TIMEOUT) sqe->timeout_flags = IORING_TIMEOUT_ETIME_SUCCESS;
+    };
+    auto prepRw = [](io_uring_sqe* sqe, uint8_t opcode, int fd, const void* buf, size_t len) {
+      sqe->opcode = opcode;
+      sqe->fd = fd;
+      sqe->addr = reinterpret_cast<uintptr_t>(buf);
+      sqe->len = static_cast<uint32_t>(len);
+      sqe->off = static_cast<uint64_t>(-1);  // Current position; i2c-dev ignores it.
+    };
+
+    for (size_t i = 0; i < chains.size(); i++) {
+      DdcChain& c = chains[i];
+      uint64_t base = static_cast<uint64_t>(i) << 3;
+      if (c.gapFirst) prepTimeout(next(base | kStageGap, IOSQE_IO_LINK), IORING_OP_TIMEOUT, &c.gapTs);
+      prepRw(next(base | kStageWrite, IOSQE_IO_LINK), IORING_OP_WRITE, c.fd, c.frame.data(),
+             c.frameLen);
+      if (!c.tx->isSet) {
+        prepTimeout(next(base | kStageDelay, IOSQE_IO_LINK), IORING_OP_TIMEOUT, &delayTs);
+        prepRw(next(base | kStageRead, IOSQE_IO_LINK), IORING_OP_READ, c.fd, c.reply,
+               sizeof(c.reply));
+      }
+      prepTimeout(next(base | kStageLimit, 0), IORING_OP_LINK_TIMEOUT, &limitTs);
+    }
+    __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    while (submitted < queued) {
+      int ret = Enter(queued - submitted, 0, 0);
+      if (ret < 0 && errno == EINTR) continue;
+      if (ret <= 0) {
+        // SQEs left in the ring would be submitted by the next round.
+        broken_ = true;
+        if (submitted == 0) return false;
+        break;
+      }
+      submitted += static_cast<unsigned>(ret);
+    }
+
+    unsigned completed = 0;
+    while (completed < submitted) {
+      completed += Reap(chains);
+      if (completed >= submitted) break;
+      // The chains reference |chains| and the timespecs above, so this
+      // cannot return before every submitted SQE has completed.
+      if (Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN &&
+          errno != EBUSY) {
+        broken_ = true;
+        usleep(1000);
+      }
+    }
+    return !broken_;
+  }
+
+ private:
+  enum : uint64_t { kStageGap, kStageWrite, kStageDelay, kStageRead, kStageLimit };
+
+  bool Init() {
+#ifdef __NR_io_uring_setup
+    io_uring_params params = {};
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, kDdcRingEntries, &params));
+    if (fd_ < 0) return false;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) return false;
+
+    ringBytes_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                  params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    void* ring = mmap(nullptr, ringBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd_, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) return false;
+    ring_ = ring;
+    sqeBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqeBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* base = static_cast<uint8_t*>(ring_);
+    sqTail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    return true;
+#else
     return false;
+#endif
+  }
+
+  int Enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+#ifdef __NR_io_uring_enter
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags,
+                                    nullptr, 0));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
   }
 
-  uint8_t valueHi = static_cast<uint8_t>((value >> 8) & 0xFF);
-  uint8_t valueLo = static_cast<uint8_t>(value & 0xFF);
-  uint8_t cmd[] = {0x51, 0x84, 0x03, VCP_BRIGHTNESS, valueHi, valueLo, 0x00};
-  cmd[6] = DdcChecksum(0x6E, cmd, 6);
+  unsigned Reap(std::vector<DdcChain>& chains) {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; head++, count++) {
+      const io_uring_cqe& cqe = cqes_[head & cqMask_];
+      DdcChain& c = chains[cqe.user_data >> 3];
+      uint64_t stage = cqe.user_data & 7;
+      if (stage == kStageWrite) c.writeRes = cqe.res;
+      if (stage == kStageRead) c.readRes = cqe.res;
+      if (cqe.res == -EINVAL) c.rejected = true;
+      c.doneUs = g_get_monotonic_time();
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return count;
+  }
 
-  ssize_t written = write(fd, cmd, sizeof(cmd));
-  close(fd);
+  int fd_ = -1;
+  bool broken_ = false;
+  void* ring_ = nullptr;
+  size_t ringBytes_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  size_t sqeBytes_ = 0;
+  unsigned* sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned* sqArray_ = nullptr;
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+static void RunDdcTransactionBlocking(DdcSession& session, DdcTransaction& tx) {
+  tx.ok = tx.isSet ? session.SetVcp(tx.code, tx.value)
+                   : session.GetVcp(tx.code, tx.current, tx.maximum);
+}
+
+// Run |txs| (any mix of buses, gets and sets) and fill in their results.
+// Transactions on the same bus run in order, the others concurrently.
+static void RunDdcTransactions(std::vector<DdcTransaction>& txs) {
+  std::map<int, std::unique_ptr<DdcSession>> sessions;
+  for (auto& tx : txs) {
+    tx.ok = false;
+    tx.current = 0;
+    tx.maximum = 0;
+    sessions[tx.bus];
+  }
+  // Map order is ascending, the lock order DdcBusState asks for.
+  for (auto& [bus, session] : sessions) session = std::make_unique<DdcSession>(bus);
+
+  std::vector<DdcTransaction*> pending;
+  for (auto& tx : txs) {
+    if (sessions[tx.bus]->ok()) pending.push_back(&tx);
+  }
+
+  std::unique_lock<std::mutex> ringLock(g_ddcRingMutex, std::defer_lock);
+  if (!pending.empty()) ringLock.lock();
+  while (!pending.empty()) {
+    DdcRing* ring = DdcRing::Shared();
+    if (!ring) break;
+
+    // One chain per bus per round.
+    std::vector<DdcChain> chains;
+    std::vector<DdcTransaction*> deferred;
+    std::map<int, bool> busTaken;
+    for (DdcTransaction* tx : pending) {
+      if (busTaken[tx->bus] || chains.size() >= kDdcRingMaxChains) {
+        deferred.push_back(tx);
+        continue;
+      }
+      busTaken[tx->bus] = true;
+      DdcChain c = {};
+      c.tx = tx;
+      c.fd = sessions[tx->bus]->fd();
+      gint64 gapUs = sessions[tx->bus]->GapRemainingUs();
+      c.gapFirst = gapUs > 0;
+      c.gapTs = DdcTimespec(gapUs);
+      if (tx->isSet) {
+        DdcSetFrame frame = MakeVcpSetFrame(
+            tx->code, static_cast<uint16_t>(std::clamp(tx->value, 0, 0xFFFF)));
+        std::copy(frame.begin(), frame.end(), c.frame.begin());
+        c.frameLen = frame.size();
+      } else {
+        const DdcGetFrame& frame = kVcpGetFrames[tx->code];
+        std::copy(frame.begin(), frame.end(), c.frame.begin());
+        c.frameLen = frame.size();
+      }
+      c.writeRes = -ECANCELED;
+      c.readRes = -ECANCELED;
+      chains.push_back(c);
+    }
+
+    gint64 roundStartUs = g_get_monotonic_time();
+    bool ringOk = ring->RunRound(chains);
+    bool rejected = false;
+    for (DdcChain& c : chains) {
+      sessions[c.tx->bus]->MarkDone();
+      if (TraceEnabled()) {
+        char detail[kTraceDetailLen];
+        snprintf(detail, sizeof(detail), "bus=%d code=0x%02x%s uring", c.tx->bus, c.tx->code,
+                 c.gapFirst ? " gap" : "");
+        TraceRecord("i2c", c.tx->isSet ? "SetVcp" : "GetVcp", roundStartUs,
+                    std::max(c.doneUs, roundStartUs), detail);
+      }
+      if (c.rejected) {
+        rejected = true;
+        deferred.push_back(c.tx);  // Retried below without the ring.
+        continue;
+      }
+      if (c.tx->isSet) {
+        c.tx->ok = c.writeRes == static_cast<int>(c.frameLen);
+      } else {
+        c.tx->ok = c.readRes > 0 &&
+                   DdcSession::ParseVcpReply(c.tx->code, c.reply, c.readRes,
+                                             c.tx->current, c.tx->maximum);
+      }
+    }
+    if (rejected && !g_ddcRingDisabled.exchange(true)) {
+      fprintf(stderr, "[BSDisplayControl] io_uring lacks features for DDC/CI; "
+                      "using blocking I/O.\n");
+    }
+    pending = std::move(deferred);
+    if (!ringOk) break;
+  }
+  if (ringLock.owns_lock()) ringLock.unlock();
+
+  // No ring (or it failed): the rest run one after another.
+  for (DdcTransaction* tx : pending) RunDdcTransactionBlocking(*sessions[tx->bus], *tx);
+}
 
-  return written == static_cast<ssize_t>(sizeof(cmd));
+// ── Batched VCP features ───────────────────────────────────────────
+//
+// Reads and/or writes several VCP features on one monitor in a single bus
+// session, so the bus is opened once and the DDC/CI delays overlap instead
+// of being paid per channel call.
+
+struct VcpOp {
+  uint8_t code;
+  bool isSet;
+  bool skip;     // Known unsupported; not sent to the monitor.
+  int value;     // Value to write (isSet only).
+  // Results.
+  bool ok;
+  int current;
+  int maximum;
+};
+
+// Named features accepted from Dart in place of raw codes.
+static int VcpCodeForName(const char* name) {
+  static const struct { const char* name; uint8_t code; } kNames[] = {
+    {"brightness", VCP_BRIGHTNESS},
+    {"contrast", VCP_CONTRAST},
+    {"colorPreset", VCP_COLOR_PRESET},
+    {"inputSource", VCP_INPUT_SOURCE},
+    {"volume", VCP_AUDIO_VOLUME},
+    {"mute", VCP_AUDIO_MUTE},
+    {"powerMode", VCP_POWER_MODE},
+  };
+  for (const auto& entry : kNames) {
+    if (strcmp(entry.name, name) == 0) return entry.code;
+  }
+  return -1;
+}
+
+// Run |ops| on the first bus that answers.  A bus is abandoned only if
+// every op on it failed (e.g. the wrong one of the two DDC buses).
+static bool RunVcpBatch(const std::vector<int>& buses, std::vector<VcpOp>& ops) {
+  for (int bus : buses) {
+    DdcSession session(bus);
+    if (!session.ok()) continue;
+
+    bool anyOk = false;
+    for (auto& op : ops) {
+      op.ok = false;
+      op.current = 0;
+      op.maximum = 0;
+      if (op.skip) continue;
+      if (op.isSet) {
+        op.ok = session.SetVcp(op.code, op.value);
+        if (op.ok) op.current = op.value;
+      } else {
+        op.ok = session.GetVcp(op.code, op.current, op.maximum);
+      }
+      anyOk = anyOk || op.ok;
+    }
+    if (anyOk) return true;
+  }
+  return false;
+}
+
+struct VcpBatchRequest {
+  FlMethodCall* call;
+  std::string displayId;
+  std::vector<int> buses;
+  std::vector<VcpOp> ops;
+};
+
+// The vcpBatch result: [{code, ok, current, max}] in request order.
+static void RespondVcpBatch(FlMethodCall* call, const std::vector<VcpOp>& ops) {
+  g_autoptr(FlValue) list = fl_value_new_list();
+  for (const auto& op : ops) {
+    g_autoptr(FlValue) entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "code", fl_value_new_int(op.code));
+    fl_value_set_string_take(entry, "ok", fl_value_new_bool(op.ok));
+    fl_value_set_string_take(entry, "current", fl_value_new_int(op.current));
+    fl_value_set_string_take(entry, "max", fl_value_new_int(op.maximum));
+    fl_value_append_take(list, fl_value_ref(entry));
+  }
+  fl_method_call_respond_success(call, list, nullptr);
+}
+
+static gboolean OnVcpBatchDone(gpointer user_data) {
+  auto* req = static_cast<VcpBatchRequest*>(user_data);
+  RespondVcpBatch(req->call, req->ops);
+  g_object_unref(req->call);
+  delete req;
+  return G_SOURCE_REMOVE;
+}
+
+// Run |ops| on a worker, since every op costs a DDC/CI round trip, and
+// respond from the main loop.  Takes a reference on |call|.
+static void StartVcpBatch(FlMethodCall* call, std::string displayId, std::vector<int> buses,
+                          std::vector<VcpOp> ops) {
+  auto* req = new VcpBatchRequest{FL_METHOD_CALL(g_object_ref(call)), std::move(displayId),
+                                  std::move(buses), std::move(ops)};
+  std::thread([req]() {
+    TimeBackendCall(req->displayId, StatsBackend::kDdc, false,
+                    [req] { return RunVcpBatch(req->buses, req->ops); });
+    g_idle_add(OnVcpBatchDone, req);
+  }).detach();
+}
+
+// ── DDC/CI via libddcutil (in-process, optional) ───────────────────
+//
+// When direct I2C fails, the ddcutil CLI costs hundreds of milliseconds a
+// call: every run reinitialises the library, rescans the buses and checks
+// the display before doing any work.  If libddcutil is installed it is
+// dlopen()ed instead, each bus's display handle is opened once and kept,
+// and a get/set is just the DDC/CI exchange.  The CLI below stays as the
+// fallback when the library is missing or a call through it fails.
+//
+// The few C API entry points used are declared here, so building does not
+// need the ddcutil development headers.
+
+typedef int DDCA_Status;
+typedef void* DDCA_Display_Identifier;
+typedef void* DDCA_Display_Ref;
+typedef void* DDCA_Display_Handle;
+
+struct DDCA_Non_Table_Vcp_Value {
+  uint8_t mh;
+  uint8_t ml;
+  uint8_t sh;
+  uint8_t sl;
+};
+
+struct LibDdcutilApi {
+  void* lib = nullptr;
+  DDCA_Status (*createBusnoDisplayIdentifier)(int, DDCA_Display_Identifier*) = nullptr;
+  DDCA_Status (*freeDisplayIdentifier)(DDCA_Display_Identifier) = nullptr;
+  DDCA_Status (*getDisplayRef)(DDCA_Display_Identifier, DDCA_Display_Ref*) = nullptr;
+  DDCA_Status (*openDisplay2)(DDCA_Display_Ref, bool, DDCA_Display_Handle*) = nullptr;
+  DDCA_Status (*closeDisplay)(DDCA_Display_Handle) = nullptr;
+  DDCA_Status (*getNonTableVcpValue)(DDCA_Display_Handle, uint8_t,
+                                     DDCA_Non_Table_Vcp_Value*) = nullptr;
+  DDCA_Status (*setNonTableVcpValue)(DDCA_Display_Handle, uint8_t, uint8_t, uint8_t) = nullptr;
+};
+
+// One per bus; entries are never erased, so pointers stay valid.
+struct LibDdcutilDisplay {
+  std::mutex mutex;  // One exchange at a time per monitor.
+  DDCA_Display_Handle handle = nullptr;
+  bool openFailed = false;
+};
+
+static std::once_flag g_libddcutilOnce;
+static LibDdcutilApi g_libddcutil;
+static std::mutex g_libddcutilDisplaysMutex;
+static std::map<int, std::unique_ptr<LibDdcutilDisplay>> g_libddcutilDisplays;
+
+template <typename Fn>
+static bool LoadSymbol(void* lib, const char* name, Fn& out) {
+  out = reinterpret_cast<Fn>(dlsym(lib, name));
+  return out != nullptr;
+}
+
+static const LibDdcutilApi* LoadLibDdcutil() {
+  std::call_once(g_libddcutilOnce, [] {
+    // libddcutil 2.x is soname 5, 1.x is soname 4.
+    for (const char* soname : {"libddcutil.so.5", "libddcutil.so.4", "libddcutil.so"}) {
+      void* lib = dlopen(soname, RTLD_NOW | RTLD_LOCAL);
+      if (!lib) continue;
+      LibDdcutilApi api;
+      api.lib = lib;
+      // 2.x renamed ddca_create_display_ref to ddca_get_display_ref.
+      bool ok =
+          LoadSymbol(lib, "ddca_create_busno_display_identifier",
+                     api.createBusnoDisplayIdentifier) &&
+          LoadSymbol(lib, "ddca_free_display_identifier", api.freeDisplayIdentifier) &&
+          (LoadSymbol(lib, "ddca_get_display_ref", api.getDisplayRef) ||
+           LoadSymbol(lib, "ddca_create_display_ref", api.getDisplayRef)) &&
+          LoadSymbol(lib, "ddca_open_display2", api.openDisplay2) &&
+          LoadSymbol(lib, "ddca_close_display", api.closeDisplay) &&
+          LoadSymbol(lib, "ddca_get_non_table_vcp_value", api.getNonTableVcpValue) &&
+          LoadSymbol(lib, "ddca_set_non_table_vcp_value", api.setNonTableVcpValue);
+      if (ok) {
+        g_libddcutil = api;
+        fprintf(stderr, "[BSDisplayControl] Loaded %s for in-process DDC/CI.\n", soname);
+        return;
+      }
+      dlclose(lib);
+    }
+  });
+  return g_libddcutil.lib ? &g_libddcutil : nullptr;
+}
+
+// Returns the open display on |bus| with its mutex held through |lock|,
+// opening the handle on first use.  nullptr if the library is missing or
+// nothing on the bus answers.
+static LibDdcutilDisplay* LibDdcutilDisplayFor(int bus, std::unique_lock<std::mutex>& lock) {
+  const LibDdcutilApi* api = LoadLibDdcutil();
+  if (!api) return nullptr;
+
+  LibDdcutilDisplay* disp;
+  {
+    std::lock_guard<std::mutex> mapLock(g_libddcutilDisplaysMutex);
+    auto& slot = g_libddcutilDisplays[bus];
+    if (!slot) slot = std::make_unique<LibDdcutilDisplay>();
+    disp = slot.get();
+  }
+
+  lock = std::unique_lock<std::mutex>(disp->mutex);
+  if (disp->handle) return disp;
+  if (disp->openFailed) return nullptr;
+
+  DDCA_Display_Identifier did = nullptr;
+  if (api->createBusnoDisplayIdentifier(bus, &did) == 0) {
+    DDCA_Display_Ref dref = nullptr;
+    if (api->getDisplayRef(did, &dref) != 0 || api->openDisplay2(dref, false, &disp->handle) != 0) {
+      disp->handle = nullptr;
+    }
+    api->freeDisplayIdentifier(did);
+  }
+  if (!disp->handle) {
+    disp->openFailed = true;
+    return nullptr;
+  }
+  return disp;
+}
+
+// A failed exchange closes the handle; the next call reopens it.
+static void LibDdcutilDropHandle(LibDdcutilDisplay& disp) {
+  g_libddcutil.closeDisplay(disp.handle);
+  disp.handle = nullptr;
+}
+
+static bool LibDdcutilGetVcp(int bus, uint8_t code, int& outCurrent, int& outMax) {
+  std::unique_lock<std::mutex> lock;
+  LibDdcutilDisplay* disp = LibDdcutilDisplayFor(bus, lock);
+  if (!disp) return false;
+
+  TraceSpan span("i2c", "ddca_get_non_table_vcp_value");
+  span.Detail("bus=%d code=0x%02x", bus, code);
+  DDCA_Non_Table_Vcp_Value value = {};
+  if (g_libddcutil.getNonTableVcpValue(disp->handle, code, &value) != 0) {
+    LibDdcutilDropHandle(*disp);
+    return false;
+  }
+  outCurrent = (value.sh << 8) | value.sl;
+  outMax = (value.mh << 8) | value.ml;
+  return outMax > 0;
+}
+
+static bool LibDdcutilSetVcp(int bus, uint8_t code, int value) {
+  std::unique_lock<std::mutex> lock;
+  LibDdcutilDisplay* disp = LibDdcutilDisplayFor(bus, lock);
+  if (!disp) return false;
+
+  TraceSpan span("i2c", "ddca_set_non_table_vcp_value");
+  span.Detail("bus=%d code=0x%02x value=%d", bus, code, value);
+  if (g_libddcutil.setNonTableVcpValue(disp->handle, code, (value >> 8) & 0xFF,
+                                       value & 0xFF) != 0) {
+    LibDdcutilDropHandle(*disp);
+    return false;
+  }
+  return true;
+}
+
+// Let buses that had no display be probed again (after a hotplug refresh).
+static void LibDdcutilForgetFailures() {
+  std::lock_guard<std::mutex> mapLock(g_libddcutilDisplaysMutex);
+  for (auto& entry : g_libddcutilDisplays) {
+    std::lock_guard<std::mutex> lock(entry.second->mutex);
+    entry.second->openFailed = false;
+  }
 }
 
 // ── DDC/CI via ddcutil command-line (fallback) ─────────────────────
@@ -424,48 +2148,32 @@ static bool IsDdcutilAvailable() {
   return g_ddcutil_available;
 }
 
+// ddcutil calls on one bus supersede each other: a newer request kills
+// an older one that is still waiting on the monitor.
+static SpawnOptions DdcutilSpawnOptions(int busNum) {
+  SpawnOptions opts;
+  opts.supersedeKey = "ddcutil:" + std::to_string(busNum);
+  return opts;
+}
+
+static std::vector<std::string> DdcutilSetArgs(int busNum, int value) {
+  return {"ddcutil", "setvcp", "10", std::to_string(value),
+          "--bus", std::to_string(busNum), "--noverify"};
+}
+
 // Get brightness using ddcutil for a specific I2C bus.
 // Returns true if successful, with brightness 0-100.
 static bool DdcutilGetBrightness(int busNum, int& outCurrent, int& outMax) {
   if (!IsDdcutilAvailable()) return false;
 
-  // Use fork/exec with pipe to capture output (no shell).
-  char busStr[16];
-  snprintf(busStr, sizeof(busStr), "%d", busNum);
-
-  int pipefd[2];
-  if (pipe(pipefd) != 0) return false;
-
-  pid_t pid = fork();
-  if (pid < 0) {
-    close(pipefd[0]);
-    close(pipefd[1]);
-    return false;
-  }
-  if (pid == 0) {
-    close(pipefd[0]);
-    dup2(pipefd[1], STDOUT_FILENO);
-    close(pipefd[1]);
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) { dup2(devnull, STDERR_FILENO); close(devnull); }
-    execlp("ddcutil", "ddcutil", "getvcp", "10", "--bus", busStr, "--brief", nullptr);
-    _exit(1);
-  }
-  close(pipefd[1]);
-
-  std::string output;
-  char buf[256];
-  ssize_t n;
-  while ((n = read(pipefd[0], buf, sizeof(buf) - 1)) > 0) {
-    buf[n] = '\0';
-    output += buf;
-  }
-  close(pipefd[0]);
-  waitpid(pid, nullptr, 0);
+  SpawnOptions opts;
+  opts.captureOutput = true;
+  SpawnResult result = RunProcess(
+      {"ddcutil", "getvcp", "10", "--bus", std::to_string(busNum), "--brief"}, opts);
 
   // Brief format: "VCP 10 C <current> <max>"
   int current = 0, maximum = 0;
-  if (sscanf(output.c_str(), "VCP %*x C %d %d", &current, &maximum) == 2 && maximum > 0) {
+  if (sscanf(result.output.c_str(), "VCP %*x C %d %d", &current, &maximum) == 2 && maximum > 0) {
     outCurrent = current;
     outMax = maximum;
     return true;
@@ -473,49 +2181,42 @@ static bool DdcutilGetBrightness(int busNum, int& outCurrent, int& outMax) {
   return false;
 }
 
-static bool DdcutilSetBrightness(int busNum, int value) {
-  if (!IsDdcutilAvailable()) return false;
-
-  // Use fork/exec instead of system() to avoid shell invocation.
-  char busStr[16], valueStr[16];
-  snprintf(busStr, sizeof(busStr), "%d", busNum);
-  snprintf(valueStr, sizeof(valueStr), "%d", value);
-
-  pid_t pid = fork();
-  if (pid < 0) return false;
-  if (pid == 0) {
-    // Child: redirect stdout/stderr to /dev/null.
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDOUT_FILENO);
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
-    }
-    execlp("ddcutil", "ddcutil", "setvcp", "10", valueStr,
-           "--bus", busStr, "--noverify", nullptr);
-    _exit(1);
-  }
-
-  int status = 0;
-  waitpid(pid, &status, 0);
-  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+static SpawnStatus DdcutilSetBrightness(int busNum, int value) {
+  if (!IsDdcutilAvailable()) return SpawnStatus::kFailed;
+  return RunProcess(DdcutilSetArgs(busNum, value), DdcutilSpawnOptions(busNum)).status;
 }
 
 // ── DRM-based display enumeration ──────────────────────────────────
 //
-// Enumerate connected displays by scanning /sys/class/drm/card*-*/.
-// For each connected connector:
-//   - Read EDID for human-readable name
+// Enumerate displays by scanning /sys/class/drm/card*-*/.
+// For each connector:
+//   - Read status; disconnected connectors are skipped at this point
+//     unless the caller asked for them
+//   - Decode EDID for the name and stable identity
 //   - Find the associated I2C bus (via i2c-* subdirectory or ddc symlink)
 //   - Map DRM connector name (e.g. "card1-DP-1") to xrandr name (e.g. "DP-1")
+//
+// The scan uses openat()/getdents64()/read() relative to directory fds,
+// with all buffers on the stack and reused across connectors, so a
+// connector costs a handful of syscalls and no allocations until it is
+// known to be wanted.
 
 struct DrmDisplay {
   std::string connector;   // e.g., "card1-DP-1"
   std::string xrandrName;  // e.g., "DP-1"
   std::string edidName;    // e.g., "DELL U2412M"
+  std::string stableId;    // e.g., "edid:3f2a...", empty if no EDID
+  EdidInfo edid;
   int i2cBus;              // Primary I2C bus (from i2c-* subdir), -1 if N/A
   int i2cBusDdc;           // Secondary I2C bus (from ddc symlink), -1 if N/A
   bool isBuiltIn;
+  bool connected;
+};
+
+struct DrmScanOptions {
+  // Stop after reading `status` for anything not connected.  When false,
+  // disconnected connectors are returned too (without EDID or I2C data).
+  bool connectedOnly = true;
 };
 
 static std::string DrmConnectorToXrandr(const std::string& connector) {
@@ -533,106 +2234,463 @@ static std::string DrmConnectorToXrandr(const std::string& connector) {
   return name;
 }
 
-static std::vector<DrmDisplay> EnumerateDrmDisplays() {
+// Raw directory entry as returned by getdents64 (glibc does not export it).
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// Calls |fn(name)| for every entry in the directory open at |dirFd|,
+// using |buf| as the getdents64 buffer.  Stops early if |fn| returns false.
+template <typename Fn>
+static void ForEachDirent(int dirFd, char* buf, size_t bufSize, Fn&& fn) {
+  for (;;) {
+    long n = syscall(SYS_getdents64, dirFd, buf, bufSize);
+    if (n <= 0) return;
+    for (long pos = 0; pos < n;) {
+      auto* d = reinterpret_cast<LinuxDirent64*>(buf + pos);
+      pos += d->d_reclen;
+      if (d->d_name[0] == '.') continue;
+      if (!fn(static_cast<const char*>(d->d_name))) return;
+    }
+  }
+}
+
+// Parse "i2c-<N>" into N, or -1.
+static int ParseI2cBusName(const char* name) {
+  if (strncmp(name, "i2c-", 4) != 0) return -1;
+  const char* p = name + 4;
+  if (*p == '\0') return -1;
+  int bus = 0;
+  for (; *p; ++p) {
+    if (*p < '0' || *p > '9' || bus > 100000) return -1;
+    bus = bus * 10 + (*p - '0');
+  }
+  return bus;
+}
+
+// Read a small sysfs attribute relative to |dirFd| into |buf|,
+// NUL-terminated with trailing newline stripped.  Returns length or -1.
+static ssize_t ReadSysfsAt(int dirFd, const char* name, char* buf, size_t bufSize) {
+  int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  ssize_t n = read(fd, buf, bufSize - 1);
+  close(fd);
+  if (n < 0) return -1;
+  while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' ')) --n;
+  buf[n] = '\0';
+  return n;
+}
+
+static std::vector<DrmDisplay> EnumerateDrmDisplays(const DrmScanOptions& opts = {}) {
+  TraceSpan span("enumerate", "EnumerateDrmDisplays");
   std::vector<DrmDisplay> displays;
-  const std::string drmBase = "/sys/class/drm";
 
-  if (!std::filesystem::exists(drmBase)) return displays;
+  int drmFd = open("/sys/class/drm", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (drmFd < 0) return displays;
 
-  for (const auto& entry : std::filesystem::directory_iterator(drmBase)) {
-    std::string dirname = entry.path().filename().string();
+  // Reused for every getdents64 / status / readlink call in this scan.
+  // The top-level listing needs its own buffer since it is still being
+  // iterated while connector subdirectories are listed.
+  alignas(8) char topDents[8192];
+  alignas(8) char subDents[4096];
+  char small[256];
+
+  ForEachDirent(drmFd, topDents, sizeof(topDents), [&](const char* dirname) {
     // Only look at connector entries like "card1-DP-1", not "card1" or "renderD128".
-    if (dirname.find("card") != 0) continue;
-    if (dirname.find('-') == std::string::npos) continue;
-    if (dirname.find("Writeback") != std::string::npos) continue;
+    if (strncmp(dirname, "card", 4) != 0) return true;
+    if (!strchr(dirname, '-')) return true;
+    if (strstr(dirname, "Writeback")) return true;
+
+    int connFd = openat(drmFd, dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (connFd < 0) return true;
 
-    std::string statusPath = entry.path().string() + "/status";
-    std::ifstream statusFile(statusPath);
-    if (!statusFile.is_open()) continue;
-    std::string status;
-    std::getline(statusFile, status);
-    if (status != "connected") continue;
+    if (ReadSysfsAt(connFd, "status", small, sizeof(small)) < 0) {
+      close(connFd);
+      return true;
+    }
+    bool connected = strcmp(small, "connected") == 0;
+    if (!connected && opts.connectedOnly) {
+      close(connFd);
+      return true;
+    }
 
     DrmDisplay disp;
     disp.connector = dirname;
-    disp.xrandrName = DrmConnectorToXrandr(dirname);
+    disp.xrandrName = DrmConnectorToXrandr(disp.connector);
     disp.i2cBus = -1;
     disp.i2cBusDdc = -1;
+    disp.connected = connected;
 
     // Check if this is a built-in display.
     disp.isBuiltIn = (disp.xrandrName.find("eDP") == 0 ||
                       disp.xrandrName.find("LVDS") == 0 ||
                       disp.xrandrName.find("DSI") == 0);
 
-    // Read EDID for display name.
-    std::string edidPath = entry.path().string() + "/edid";
-    disp.edidName = ParseEdidName(edidPath);
-
-    // Find I2C bus: look for i2c-* subdirectory first, then ddc symlink.
-    for (const auto& sub : std::filesystem::directory_iterator(entry.path())) {
-      std::string subname = sub.path().filename().string();
-      if (subname.find("i2c-") == 0) {
-        try {
-          disp.i2cBus = std::stoi(subname.substr(4));
-        } catch (...) {}
-        break;
-      }
+    if (!connected) {
+      memset(&disp.edid, 0, sizeof(disp.edid));
+      close(connFd);
+      displays.push_back(std::move(disp));
+      return true;
     }
 
-    if (disp.i2cBus < 0) {
-      // Check for "ddc" symlink (common for HDMI).
-      std::string ddcLink = entry.path().string() + "/ddc";
-      if (std::filesystem::is_symlink(ddcLink)) {
-        std::string target = std::filesystem::read_symlink(ddcLink).filename().string();
-        if (target.find("i2c-") == 0) {
-          try {
-            disp.i2cBus = std::stoi(target.substr(4));
-          } catch (...) {}
-        }
-      }
-    } else {
-      // We have an i2c-* subdir bus; also check for "ddc" symlink as fallback.
-      std::string ddcLink = entry.path().string() + "/ddc";
-      if (std::filesystem::is_symlink(ddcLink)) {
-        std::string target = std::filesystem::read_symlink(ddcLink).filename().string();
-        if (target.find("i2c-") == 0) {
-          try {
-            disp.i2cBusDdc = std::stoi(target.substr(4));
-          } catch (...) {}
-        }
+    // Decode EDID for the display name and port-independent identity.
+    ReadEdid(connFd, "edid", disp.edid);
+    disp.edidName = EdidDisplayName(disp.edid);
+    disp.stableId = EdidStableId(disp.edid, disp.connector);
+
+    // Find I2C bus: look for i2c-* subdirectory first, then ddc symlink.
+    ForEachDirent(connFd, subDents, sizeof(subDents), [&](const char* subname) {
+      int bus = ParseI2cBusName(subname);
+      if (bus < 0) return true;
+      disp.i2cBus = bus;
+      return false;
+    });
+
+    // "ddc" symlink (common for HDMI); a fallback when the subdir bus exists.
+    ssize_t linkLen = readlinkat(connFd, "ddc", small, sizeof(small) - 1);
+    if (linkLen > 0) {
+      small[linkLen] = '\0';
+      const char* base = strrchr(small, '/');
+      int bus = ParseI2cBusName(base ? base + 1 : small);
+      if (disp.i2cBus < 0) {
+        disp.i2cBus = bus;
+      } else {
+        disp.i2cBusDdc = bus;
       }
     }
 
-    displays.push_back(disp);
-  }
+    close(connFd);
+    displays.push_back(std::move(disp));
+    return true;
+  });
 
+  close(drmFd);
+  span.Detail("%zu connected", displays.size());
   return displays;
 }
 
-// ── Get brightness for a display (try DDC/CI, then ddcutil, then xrandr) ──
-// Try both I2C buses (primary from i2c-* subdir, fallback from ddc symlink).
-
-static double GetDisplayBrightness(const DrmDisplay& disp) {
-  // Collect candidate I2C buses to try.
+// Candidate I2C buses for DDC/CI: primary from the i2c-* subdir, then the
+// ddc symlink target.
+static std::vector<int> DdcBusesFor(const DrmDisplay& disp) {
   std::vector<int> buses;
   if (disp.i2cBus >= 0) buses.push_back(disp.i2cBus);
   if (disp.i2cBusDdc >= 0 && disp.i2cBusDdc != disp.i2cBus)
     buses.push_back(disp.i2cBusDdc);
+  return buses;
+}
 
-  if (!buses.empty()) {
-    // Ensure I2C permissions are set up (one-time, prompts user if needed).
-    if (!g_i2c_accessible && !g_i2c_setup_attempted) {
-      SetupI2cPermissions();
-    }
+// ── MCCS capabilities ──────────────────────────────────────────────
+//
+// The capabilities string lists which VCP codes a monitor implements, e.g.
+//   (prot(monitor)type(lcd)model(U2412M)cmds(01 02 03 07 0C E3 F3)
+//    vcp(02 04 05 08 10 12 14(05 08 0B) 60(01 03 0F) 62 D6(01 04 05))
+//    mccs_ver(2.1))
+// It is fetched once per physical monitor (keyed on the EDID stable ID),
+// kept in memory, and persisted under the user cache directory so later
+// sessions can skip unsupported features without probing the bus.  The
+// disk cache is read at most once per monitor and session; a miss is
+// remembered too.
+//
+// Monitors that do not answer the request on any bus are remembered as
+// DDC-unresponsive for the rest of the session, so the capabilities are
+// not requested again unless refreshed.  That says nothing about single
+// features (many monitors answer VCP 0x10 but not the capabilities
+// request), so their support stays unknown.
+
+struct MccsCapabilities {
+  std::string raw;
+  std::string model;
+  std::string type;
+  std::string mccsVersion;
+  std::bitset<256> vcp;                           // Supported VCP codes.
+  std::map<uint8_t, std::vector<uint16_t>> vcpValues;  // Allowed values for NC codes.
+};
 
-    for (int bus : buses) {
-      int current = 0, maximum = 100;
-      // Try direct I2C DDC/CI.
-      if (DdcGetBrightness(bus, current, maximum)) {
+enum class DdcSupport { kUnknown, kSupported, kUnsupported };
+
+// Everything known about one monitor's capabilities, including misses.
+struct MccsCacheEntry {
+  bool valid = false;         // |caps| parsed, from the monitor or disk.
+  bool unresponsive = false;  // The last fetch got no answer.
+  MccsCapabilities caps;
+};
+
+// Entries are never erased, so a pointer into the map stays valid.  Only
+// the main thread fetches; display probes look entries up from a worker.
+static std::map<std::string, MccsCacheEntry> g_mccsCaps;
+static std::mutex g_mccsMutex;  // Guards g_mccsCaps and its entries.
+
+static bool IsHexDigit(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Parse a whitespace-separated list of hex codes, each optionally followed
+// by a parenthesised list of allowed values.
+static void ParseMccsVcpList(const std::string& body, MccsCapabilities& caps) {
+  size_t i = 0;
+  int lastCode = -1;
+  while (i < body.size()) {
+    char c = body[i];
+    if (IsHexDigit(c)) {
+      size_t start = i;
+      while (i < body.size() && IsHexDigit(body[i])) ++i;
+      lastCode = static_cast<int>(strtol(body.substr(start, i - start).c_str(), nullptr, 16));
+      if (lastCode >= 0 && lastCode <= 0xFF) {
+        caps.vcp.set(static_cast<size_t>(lastCode));
+      } else {
+        lastCode = -1;
+      }
+    } else if (c == '(') {
+      size_t close = body.find(')', i);
+      if (close == std::string::npos) return;
+      if (lastCode >= 0) {
+        std::vector<uint16_t>& values = caps.vcpValues[static_cast<uint8_t>(lastCode)];
+        size_t j = i + 1;
+        while (j < close) {
+          if (IsHexDigit(body[j])) {
+            size_t start = j;
+            while (j < close && IsHexDigit(body[j])) ++j;
+            values.push_back(static_cast<uint16_t>(
+                strtol(body.substr(start, j - start).c_str(), nullptr, 16)));
+          } else {
+            ++j;
+          }
+        }
+      }
+      i = close + 1;
+    } else {
+      ++i;
+    }
+  }
+}
+
+static bool ParseMccsCapabilities(const std::string& raw, MccsCapabilities& caps) {
+  caps = MccsCapabilities();
+  caps.raw = raw;
+
+  // Walk "key(value)" pairs at nesting depth 1 (inside the outer parens).
+  size_t i = raw.find('(');
+  if (i == std::string::npos) return false;
+  ++i;
+  bool any = false;
+  while (i < raw.size()) {
+    while (i < raw.size() && (raw[i] == ' ' || raw[i] == '\n' || raw[i] == '\r')) ++i;
+    size_t keyStart = i;
+    while (i < raw.size() && raw[i] != '(' && raw[i] != ')') ++i;
+    if (i >= raw.size() || raw[i] == ')') break;
+    std::string key = raw.substr(keyStart, i - keyStart);
+
+    // Find the matching close paren for this value.
+    int depth = 0;
+    size_t valueStart = i + 1;
+    size_t j = i;
+    for (; j < raw.size(); ++j) {
+      if (raw[j] == '(') ++depth;
+      else if (raw[j] == ')' && --depth == 0) break;
+    }
+    if (j >= raw.size()) break;
+    std::string value = raw.substr(valueStart, j - valueStart);
+    i = j + 1;
+
+    if (key == "vcp") {
+      ParseMccsVcpList(value, caps);
+      any = true;
+    } else if (key == "model") {
+      caps.model = value;
+    } else if (key == "type") {
+      caps.type = value;
+    } else if (key == "mccs_ver") {
+      caps.mccsVersion = value;
+    }
+  }
+  return any;
+}
+
+// Cache key for per-monitor state: the EDID stable ID, or the DRM
+// connector for displays without a usable EDID.
+static std::string DisplayKey(const DrmDisplay& disp) {
+  return disp.stableId.empty() ? "drm:" + disp.connector : disp.stableId;
+}
+
+static std::string MccsCachePath(const std::string& key) {
+  std::string name = key;
+  for (char& c : name) {
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '-' || c == '_')) c = '_';
+  }
+  g_autofree gchar* path = g_build_filename(
+      g_get_user_cache_dir(), "bs_display_control", "mccs", name.c_str(), nullptr);
+  return path;
+}
+
+// The in-memory entry for |disp|, loaded from the disk cache on first use.
+// Call with g_mccsMutex held.
+static MccsCacheEntry& MccsEntryFor(const DrmDisplay& disp) {
+  std::string key = DisplayKey(disp);
+  auto it = g_mccsCaps.find(key);
+  if (it != g_mccsCaps.end()) return it->second;
+
+  MccsCacheEntry& entry = g_mccsCaps[key];
+  // Only stable IDs are persisted; connector-keyed entries are not worth
+  // trusting across sessions.
+  if (disp.stableId.empty()) return entry;
+
+  g_autofree gchar* contents = nullptr;
+  gsize length = 0;
+  if (g_file_get_contents(MccsCachePath(key).c_str(), &contents, &length, nullptr)) {
+    entry.valid = ParseMccsCapabilities(std::string(contents, length), entry.caps);
+  }
+  return entry;
+}
+
+// Fetch (or refresh) the capabilities for |disp| from the monitor and copy
+// them to |out|.  Returns false if none are known.  Blocks on the bus for
+// as long as the monitor takes, so callers run it on a worker thread.
+static bool FetchMccsCapabilities(const DrmDisplay& disp, bool refresh, MccsCapabilities& out) {
+  std::string key = DisplayKey(disp);
+  std::unique_lock<std::mutex> lock(g_mccsMutex);
+  MccsCacheEntry& entry = MccsEntryFor(disp);
+  if (!refresh && (entry.valid || entry.unresponsive)) {
+    if (entry.valid) out = entry.caps;
+    return entry.valid;
+  }
+  entry.unresponsive = false;
+  lock.unlock();
+
+  std::vector<int> buses = DdcBusesFor(disp);
+  if (buses.empty()) return false;
+
+  bool anyBusOpened = false;
+  for (int bus : buses) {
+    DdcSession session(bus);
+    if (!session.ok()) continue;
+    anyBusOpened = true;
+
+    std::string raw;
+    MccsCapabilities caps;
+    if (!session.GetCapabilities(raw) || !ParseMccsCapabilities(raw, caps)) continue;
+
+    if (!disp.stableId.empty()) {
+      std::string path = MccsCachePath(key);
+      g_autofree gchar* dir = g_path_get_dirname(path.c_str());
+      g_mkdir_with_parents(dir, 0700);
+      g_file_set_contents(path.c_str(), raw.data(), static_cast<gssize>(raw.size()), nullptr);
+    }
+    fprintf(stderr, "[BSDisplayControl] MCCS caps for %s: %zu VCP codes (model %s)\n",
+            disp.connector.c_str(), caps.vcp.count(), caps.model.c_str());
+    out = caps;
+    lock.lock();
+    entry.caps = std::move(caps);
+    entry.valid = true;
+    return true;
+  }
+
+  // The bus opened but the monitor never answered the request.  If no bus
+  // could be opened at all this is a permission problem, not the monitor.
+  lock.lock();
+  if (anyBusOpened) entry.unresponsive = true;
+  if (entry.valid) out = entry.caps;
+  return entry.valid;
+}
+
+// Whether |code| can be used on |disp| over DDC/CI, from cached knowledge
+// only.  kUnknown means "try it"; without parsed capabilities every code
+// is unknown.
+static DdcSupport DdcFeatureSupport(const DrmDisplay& disp, uint8_t code) {
+  std::lock_guard<std::mutex> lock(g_mccsMutex);
+  const MccsCacheEntry& entry = MccsEntryFor(disp);
+  if (!entry.valid) return DdcSupport::kUnknown;
+  return entry.caps.vcp.test(code) ? DdcSupport::kSupported : DdcSupport::kUnsupported;
+}
+
+static FlValue* MccsCapabilitiesToFlValue(const MccsCapabilities& caps) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "raw", fl_value_new_string(caps.raw.c_str()));
+  fl_value_set_string_take(map, "model", fl_value_new_string(caps.model.c_str()));
+  fl_value_set_string_take(map, "type", fl_value_new_string(caps.type.c_str()));
+  fl_value_set_string_take(map, "mccsVersion", fl_value_new_string(caps.mccsVersion.c_str()));
+
+  FlValue* codes = fl_value_new_list();
+  FlValue* values = fl_value_new_map();
+  for (size_t code = 0; code < caps.vcp.size(); ++code) {
+    if (!caps.vcp.test(code)) continue;
+    fl_value_append_take(codes, fl_value_new_int(static_cast<int64_t>(code)));
+  }
+  for (const auto& entry : caps.vcpValues) {
+    FlValue* list = fl_value_new_list();
+    for (uint16_t v : entry.second) fl_value_append_take(list, fl_value_new_int(v));
+    char key[8];
+    snprintf(key, sizeof(key), "%02X", entry.first);
+    fl_value_set_string_take(values, key, list);
+  }
+  fl_value_set_string_take(map, "vcpCodes", codes);
+  fl_value_set_string_take(map, "vcpValues", values);
+  return map;
+}
+
+struct CapabilitiesRequest {
+  FlMethodCall* call;
+  DrmDisplay disp;
+  bool refresh;
+  bool found;
+  MccsCapabilities caps;
+};
+
+static gboolean OnCapabilitiesFetched(gpointer user_data) {
+  auto* req = static_cast<CapabilitiesRequest*>(user_data);
+  g_autoptr(FlValue) result =
+      req->found ? MccsCapabilitiesToFlValue(req->caps) : fl_value_new_null();
+  fl_method_call_respond_success(req->call, result, nullptr);
+  g_object_unref(req->call);
+  delete req;
+  return G_SOURCE_REMOVE;
+}
+
+// Answer getCapabilities for |disp| from a worker thread: a fetch can take
+// seconds of DDC/CI round trips.  Takes a reference on |call|.
+static void StartCapabilitiesFetch(FlMethodCall* call, const DrmDisplay& disp, bool refresh) {
+  auto* req =
+      new CapabilitiesRequest{FL_METHOD_CALL(g_object_ref(call)), disp, refresh, false, {}};
+  std::thread([req]() {
+    req->found = FetchMccsCapabilities(req->disp, req->refresh, req->caps);
+    g_idle_add(OnCapabilitiesFetched, req);
+  }).detach();
+}
+
+// ── Get brightness for a display (try DDC/CI, then ddcutil, then xrandr) ──
+// Try both I2C buses (primary from i2c-* subdir, fallback from ddc symlink).
+// |probedBus| is a bus where direct DDC/CI was already tried and failed.
+
+static double GetDisplayBrightness(const DrmDisplay& disp, int probedBus = -1) {
+  std::vector<int> buses;
+  if (DdcFeatureSupport(disp, VCP_BRIGHTNESS) != DdcSupport::kUnsupported)
+    buses = DdcBusesFor(disp);
+
+  if (!buses.empty()) {
+
+    std::string displayId = "drm:" + disp.connector;
+    for (int bus : buses) {
+      int current = 0, maximum = 100;
+      // Try direct I2C DDC/CI.
+      if (bus != probedBus &&
+          TimeBackendCall(displayId, StatsBackend::kDdc, true,
+                          [&] { return DdcGetBrightness(bus, current, maximum); })) {
+        RecordReadDdcLevel(displayId, current, maximum);
         return static_cast<double>(current) / static_cast<double>(maximum);
       }
-      // Try ddcutil as fallback.
-      if (DdcutilGetBrightness(bus, current, maximum)) {
+      // Try libddcutil in process, then the ddcutil CLI.
+      if ((LoadLibDdcutil() &&
+           TimeBackendCall(displayId, StatsBackend::kLibDdcutil, true, [&] {
+             return LibDdcutilGetVcp(bus, VCP_BRIGHTNESS, current, maximum);
+           })) ||
+          (IsDdcutilAvailable() &&
+           TimeBackendCall(displayId, StatsBackend::kDdcutil, true,
+                           [&] { return DdcutilGetBrightness(bus, current, maximum); }))) {
+        RecordReadDdcLevel(displayId, current, maximum);
         return static_cast<double>(current) / static_cast<double>(maximum);
       }
     }
@@ -648,37 +2706,14 @@ static double GetDisplayBrightness(const DrmDisplay& disp) {
     }
   }
 
-  // Use fork/exec for xrandr, then parse output in parent.
-  int pipefd[2];
-  if (pipe(pipefd) != 0) return 1.0;
-
-  pid_t xrPid = fork();
-  if (xrPid < 0) {
-    close(pipefd[0]);
-    close(pipefd[1]);
-    return 1.0;
-  }
-  if (xrPid == 0) {
-    close(pipefd[0]);
-    dup2(pipefd[1], STDOUT_FILENO);
-    close(pipefd[1]);
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) { dup2(devnull, STDERR_FILENO); close(devnull); }
-    execlp("xrandr", "xrandr", "--verbose", nullptr);
-    _exit(1);
-  }
-  close(pipefd[1]);
-
-  // Read xrandr output from pipe.
-  std::string output;
-  char buf[4096];
-  ssize_t n;
-  while ((n = read(pipefd[0], buf, sizeof(buf) - 1)) > 0) {
-    buf[n] = '\0';
-    output += buf;
-  }
-  close(pipefd[0]);
-  waitpid(xrPid, nullptr, 0);
+  SpawnOptions opts;
+  opts.captureOutput = true;
+  gint64 start = g_get_monotonic_time();
+  SpawnResult result = RunProcess({"xrandr", "--verbose"}, opts);
+  RecordBackendCall("drm:" + disp.connector, StatsBackend::kXrandr,
+                    g_get_monotonic_time() - start,
+                    result.status == SpawnStatus::kOk ? CallOutcome::kOk : CallOutcome::kFailed);
+  const std::string& output = result.output;
 
   // Search for "OUTPUTNAME connected" and extract Brightness value.
   std::string marker = safeName + " connected";
@@ -694,7 +2729,10 @@ static double GetDisplayBrightness(const DrmDisplay& disp) {
       auto nlpos = val.find('\n');
       if (nlpos != std::string::npos) val = val.substr(0, nlpos);
       try {
-        return std::stod(val);
+        double brightness = std::stod(val);
+        RecordApplied("drm:" + disp.connector, WriteBackend::kXrandr,
+                      static_cast<int>(std::clamp(brightness, 0.0, 1.0) * 100));
+        return brightness;
       } catch (...) {}
     }
   }
@@ -704,356 +2742,4238 @@ static double GetDisplayBrightness(const DrmDisplay& disp) {
 
 // ── Set brightness for a display ───────────────────────────────────
 
-static bool SetDisplayBrightness(const DrmDisplay& disp, double brightness) {
-  int value = static_cast<int>(std::clamp(brightness, 0.0, 1.0) * 100);
+// xrandr --brightness on one output: newer calls supersede older ones.
+static std::vector<std::string> XrandrBrightnessArgs(const std::string& outputName,
+                                                     double value, int precision) {
+  char valueStr[32];
+  snprintf(valueStr, sizeof(valueStr), "%.*f", precision, std::clamp(value, 0.0, 1.0));
+  return {"xrandr", "--output", outputName, "--brightness", valueStr};
+}
 
-  // Collect candidate I2C buses to try.
-  std::vector<int> buses;
-  if (disp.i2cBus >= 0) buses.push_back(disp.i2cBus);
-  if (disp.i2cBusDdc >= 0 && disp.i2cBusDdc != disp.i2cBus)
-    buses.push_back(disp.i2cBusDdc);
+static SpawnOptions XrandrSpawnOptions(const std::string& outputName) {
+  SpawnOptions opts;
+  opts.supersedeKey = "xrandr:" + outputName;
+  return opts;
+}
+
+// Cascade over an explicit list of DDC buses.  Consults no cached state,
+// so it can run on worker threads once IsDdcutilAvailable() is primed.
+// Blocks on ddcutil/xrandr; the main thread uses SetDisplayBrightnessAsync.
+static bool SetDisplayBrightnessOnBuses(const DrmDisplay& disp,
+                                        const std::vector<int>& buses,
+                                        double brightness) {
+  int value = static_cast<int>(std::clamp(brightness, 0.0, 1.0) * 100);
+  std::string displayId = "drm:" + disp.connector;
 
+  if (!buses.empty() && AppliedMatches(displayId, WriteBackend::kDdc, value)) return true;
   for (int bus : buses) {
-    // Try direct I2C DDC/CI first.
-    if (DdcSetBrightness(bus, value)) {
-      return true;
+    // Try direct I2C DDC/CI first, then libddcutil, then the ddcutil CLI.
+    SpawnStatus status = SpawnStatus::kFailed;
+    if (TimeBackendCall(displayId, StatsBackend::kDdc, true,
+                        [&] { return DdcSetBrightness(bus, value); }) ||
+        (LoadLibDdcutil() &&
+         TimeBackendCall(displayId, StatsBackend::kLibDdcutil, true,
+                         [&] { return LibDdcutilSetVcp(bus, VCP_BRIGHTNESS, value); }))) {
+      status = SpawnStatus::kOk;
+    } else if (IsDdcutilAvailable()) {
+      gint64 start = g_get_monotonic_time();
+      status = DdcutilSetBrightness(bus, value);
+      RecordSpawnCall(displayId, StatsBackend::kDdcutil, start, status, true);
     }
-    // Try ddcutil as fallback.
-    if (DdcutilSetBrightness(bus, value)) {
+    if (status == SpawnStatus::kOk) {
+      RecordApplied(displayId, WriteBackend::kDdc, value);
       return true;
     }
+    // A newer write to this bus replaced ours; it owns the outcome.
+    if (status == SpawnStatus::kSuperseded) return false;
   }
 
   // Fallback: xrandr software brightness (gamma).
-  double clamped = std::clamp(brightness, 0.0, 1.0);
-  char brightnessStr[32];
-  snprintf(brightnessStr, sizeof(brightnessStr), "%.2f", clamped);
+  if (AppliedMatches(displayId, WriteBackend::kXrandr, value)) return true;
+  gint64 start = g_get_monotonic_time();
+  SpawnStatus status = RunProcess(XrandrBrightnessArgs(disp.xrandrName, brightness, 2),
+                                  XrandrSpawnOptions(disp.xrandrName)).status;
+  RecordSpawnCall(displayId, StatsBackend::kXrandr, start, status, false);
+  bool ok = status == SpawnStatus::kOk;
+  if (ok) RecordApplied(displayId, WriteBackend::kXrandr, value);
+  return ok;
+}
 
-  pid_t pid = fork();
-  if (pid < 0) return false;
-  if (pid == 0) {
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDOUT_FILENO);
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
-    }
-    execlp("xrandr", "xrandr", "--output", disp.xrandrName.c_str(),
-           "--brightness", brightnessStr, nullptr);
-    _exit(1);
+// Same cascade for the main thread.  Direct I2C and libddcutil writes run
+// inline; the ddcutil CLI and xrandr fallbacks are spawned asynchronously
+// and chained from their completion callbacks.  |done| runs exactly once on the main loop
+// (or before returning, if no spawn was needed).
+struct AsyncBrightnessSet {
+  std::string displayId;
+  std::string xrandrName;
+  std::vector<int> buses;
+  size_t nextBus = 0;
+  int value = 0;
+  double brightness = 0.0;
+  std::function<void(bool)> done;
+};
+
+static void StepAsyncBrightnessSet(std::shared_ptr<AsyncBrightnessSet> op) {
+  if (IsDdcutilAvailable() && op->nextBus < op->buses.size()) {
+    int bus = op->buses[op->nextBus++];
+    gint64 start = g_get_monotonic_time();
+    bool started = SpawnAsync(DdcutilSetArgs(bus, op->value), DdcutilSpawnOptions(bus),
+                              [op, start](const SpawnResult& result) {
+      RecordSpawnCall(op->displayId, StatsBackend::kDdcutil, start, result.status, true);
+      if (result.status == SpawnStatus::kOk) {
+        RecordApplied(op->displayId, WriteBackend::kDdc, op->value);
+        op->done(true);
+      } else if (result.status == SpawnStatus::kSuperseded) {
+        op->done(false);
+      } else {
+        StepAsyncBrightnessSet(op);
+      }
+    });
+    if (!started) StepAsyncBrightnessSet(op);
+    return;
   }
 
-  int status = 0;
-  waitpid(pid, &status, 0);
-  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (AppliedMatches(op->displayId, WriteBackend::kXrandr, op->value)) {
+    op->done(true);
+    return;
+  }
+  gint64 start = g_get_monotonic_time();
+  bool started = SpawnAsync(XrandrBrightnessArgs(op->xrandrName, op->brightness, 2),
+                            XrandrSpawnOptions(op->xrandrName),
+                            [op, start](const SpawnResult& result) {
+    RecordSpawnCall(op->displayId, StatsBackend::kXrandr, start, result.status, false);
+    bool ok = result.status == SpawnStatus::kOk;
+    if (ok) RecordApplied(op->displayId, WriteBackend::kXrandr, op->value);
+    op->done(ok);
+  });
+  if (!started) op->done(false);
 }
 
-// ── Cached display list ────────────────────────────────────────────
-
-static std::vector<DrmDisplay> g_drmDisplays;
+static void SetDisplayBrightnessAsync(const DrmDisplay& disp, double brightness,
+                                      std::function<void(bool)> done) {
+  auto op = std::make_shared<AsyncBrightnessSet>();
+  op->displayId = "drm:" + disp.connector;
+  op->xrandrName = disp.xrandrName;
+  op->brightness = std::clamp(brightness, 0.0, 1.0);
+  op->value = static_cast<int>(op->brightness * 100);
+  op->done = std::move(done);
+  if (DdcFeatureSupport(disp, VCP_BRIGHTNESS) != DdcSupport::kUnsupported)
+    op->buses = DdcBusesFor(disp);
+
+  if (!op->buses.empty() && AppliedMatches(op->displayId, WriteBackend::kDdc, op->value)) {
+    op->done(true);
+    return;
+  }
+  for (int bus : op->buses) {
+    if (TimeBackendCall(op->displayId, StatsBackend::kDdc, true,
+                        [&] { return DdcSetBrightness(bus, op->value); }) ||
+        (LoadLibDdcutil() &&
+         TimeBackendCall(op->displayId, StatsBackend::kLibDdcutil, true,
+                         [&] { return LibDdcutilSetVcp(bus, VCP_BRIGHTNESS, op->value); }))) {
+      RecordApplied(op->displayId, WriteBackend::kDdc, op->value);
+      op->done(true);
+      return;
+    }
+  }
+  StepAsyncBrightnessSet(op);
+}
 
-// ── Software brightness (gamma) via Mutter D-Bus or xrandr ─────────
-//
-// On GNOME/Wayland: use org.gnome.Mutter.DisplayConfig SetCrtcGamma
-// via GDBus.  This is the only way to set per-output gamma on Wayland
-// since xrandr --brightness only affects the XWayland virtual display.
+// ── Display registry ───────────────────────────────────────────────
 //
-// On X11: fall back to xrandr --output NAME --brightness FACTOR.
+// What is known about the connected displays and Mutter's outputs, as an
+// immutable snapshot.  The main thread builds a new snapshot for every
+// change (a getDisplays probe, the startup probe, a Mutter re-query) and
+// publishes it with one atomic exchange; |version| grows by one per
+// publish.  Any thread reads the current snapshot through a RegistryView,
+// which takes no lock, and finds a display by ID or a Mutter output by
+// name in O(1) without building a string.
 //
-// The Mutter D-Bus API:
-//   GetResources() -> (serial, crtcs[], outputs[], modes[], ...)
-//   GetCrtcGamma(serial, crtc_id) -> (aq red, aq green, aq blue)
-//   SetCrtcGamma(serial, crtc_id, aq red, aq green, aq blue)
+// A replaced snapshot is deleted once no RegistryView is open.  Views are
+// meant to be short: code that keeps display data across a blocking call
+// or a main-loop turn copies what it needs, as transitions and batch jobs
+// do.
 
 struct MutterOutputInfo {
   std::string name;   // e.g., "DP-1", "HDMI-1"
   int crtcId;         // Mutter CRTC index (not DRM winsys ID)
   int gammaSize;      // LUT entries (typically 4096)
+  uint32_t serial;    // GetResources serial the CRTC belongs to
 };
 
-static uint32_t g_mutterSerial = 0;
-static std::vector<MutterOutputInfo> g_mutterOutputs;
-static bool g_mutterQueried = false;
-static bool g_isWayland = false;
+class DisplayRegistry {
+ public:
+  DisplayRegistry() = default;
+  DisplayRegistry(uint64_t version, std::vector<DrmDisplay> drmDisplays,
+                  bool mutterQueried, std::vector<MutterOutputInfo> mutterOutputs)
+      : version(version),
+        drmDisplays(std::move(drmDisplays)),
+        mutterQueried(mutterQueried),
+        mutterOutputs(std::move(mutterOutputs)) {
+    // The maps hold views into the vectors above, which never change.
+    drmIds_.reserve(this->drmDisplays.size());
+    for (const auto& disp : this->drmDisplays) drmIds_.push_back("drm:" + disp.connector);
+    for (size_t i = 0; i < drmIds_.size(); i++) {
+      drmById_.emplace(drmIds_[i], i);
+      if (builtIn_ < 0 && this->drmDisplays[i].isBuiltIn) builtIn_ = static_cast<int>(i);
+    }
+    for (size_t i = 0; i < this->mutterOutputs.size(); i++)
+      mutterByName_.emplace(this->mutterOutputs[i].name, i);
+  }
+  DisplayRegistry(const DisplayRegistry&) = delete;
+  DisplayRegistry& operator=(const DisplayRegistry&) = delete;
 
-// Detect if we're running on native Wayland.
-static bool IsWayland() {
-  static bool checked = false;
-  static bool result = false;
-  if (!checked) {
-    checked = true;
-    const char* wl = getenv("WAYLAND_DISPLAY");
-    const char* st = getenv("XDG_SESSION_TYPE");
-    result = (wl && wl[0] != '\0') || (st && strcmp(st, "wayland") == 0);
+  const DrmDisplay* FindDrm(std::string_view id) const {
+    auto it = drmById_.find(id);
+    return it == drmById_.end() ? nullptr : &drmDisplays[it->second];
   }
-  return result;
-}
 
-// Query Mutter's DisplayConfig.GetResources to build output -> CRTC mapping.
-// Also fetches gamma LUT size for each active CRTC.
-static bool QueryMutterResources() {
-  if (g_mutterQueried) return !g_mutterOutputs.empty();
-  g_mutterQueried = true;
-  g_mutterOutputs.clear();
+  const DrmDisplay* BuiltIn() const {
+    return builtIn_ < 0 ? nullptr : &drmDisplays[builtIn_];
+  }
 
-  g_autoptr(GError) error = nullptr;
-  g_autoptr(GDBusConnection) bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
-  if (!bus) {
-    fprintf(stderr, "[BSDisplayControl] D-Bus session bus unavailable: %s\n",
-            error ? error->message : "unknown");
-    return false;
+  const MutterOutputInfo* FindMutterOutput(std::string_view name) const {
+    auto it = mutterByName_.find(name);
+    return it == mutterByName_.end() ? nullptr : &mutterOutputs[it->second];
   }
 
-  // Call GetResources: returns (u serial, a(uxiiiiiuaua{sv}) crtcs,
-  //   a(uxiausauaua{sv}) outputs, a(uxuudu) modes, i max_w, i max_h)
-  g_autoptr(GVariant) res = g_dbus_connection_call_sync(
-      bus, "org.gnome.Shell",
-      "/org/gnome/Mutter/DisplayConfig",
-      "org.gnome.Mutter.DisplayConfig",
-      "GetResources", nullptr, nullptr,
-      G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error);
+  const uint64_t version = 0;
+  const std::vector<DrmDisplay> drmDisplays;
+  const bool mutterQueried = false;  // mutterOutputs reflects a GetResources call.
+  const std::vector<MutterOutputInfo> mutterOutputs;
 
-  if (!res) {
-    fprintf(stderr, "[BSDisplayControl] Mutter GetResources failed: %s\n",
-            error ? error->message : "unknown");
-    return false;
+ private:
+  std::vector<std::string> drmIds_;  // "drm:" + connector, parallel to drmDisplays.
+  std::unordered_map<std::string_view, size_t> drmById_;
+  std::unordered_map<std::string_view, size_t> mutterByName_;
+  int builtIn_ = -1;
+};
+
+static std::atomic<const DisplayRegistry*> g_registry{new DisplayRegistry()};
+static std::atomic<int> g_registryReaders{0};
+static std::vector<const DisplayRegistry*> g_retiredRegistries;  // Main thread.
+static guint g_registryReclaimSource = 0;
+static const guint kRegistryReclaimRetryMs = 100;
+
+// Pins the current snapshot for the view's lifetime.
+//
+// A publisher exchanges the pointer and then checks the reader count; a
+// view bumps the count and then loads the pointer.  With both sequentially
+// consistent, a publisher that sees no readers knows every later view will
+// load the new snapshot, so the retired ones are free.
+class RegistryView {
+ public:
+  RegistryView() {
+    g_registryReaders.fetch_add(1, std::memory_order_seq_cst);
+    snapshot_ = g_registry.load(std::memory_order_seq_cst);
   }
+  ~RegistryView() { g_registryReaders.fetch_sub(1, std::memory_order_release); }
+  RegistryView(const RegistryView&) = delete;
+  RegistryView& operator=(const RegistryView&) = delete;
 
-  // Extract serial (first element).
-  g_autoptr(GVariant) vSerial = g_variant_get_child_value(res, 0);
-  g_mutterSerial = g_variant_get_uint32(vSerial);
+  const DisplayRegistry* operator->() const { return snapshot_; }
+  const DisplayRegistry& operator*() const { return *snapshot_; }
 
-  // Extract outputs array (third element, index 2).
-  // Each output: (u id, x winsys_id, i crtc_id, au possible_crtcs,
-  //               s name, au modes, au clones, a{sv} properties)
-  g_autoptr(GVariant) vOutputs = g_variant_get_child_value(res, 2);
-  gsize numOutputs = g_variant_n_children(vOutputs);
+ private:
+  const DisplayRegistry* snapshot_;
+};
 
-  for (gsize i = 0; i < numOutputs; i++) {
-    g_autoptr(GVariant) vOut = g_variant_get_child_value(vOutputs, i);
+static void ReclaimRegistries();
 
-    // crtc_id is at index 2 (int32).
-    g_autoptr(GVariant) vCrtcId = g_variant_get_child_value(vOut, 2);
-    gint32 crtcId = g_variant_get_int32(vCrtcId);
+static gboolean OnReclaimRegistries(gpointer user_data) {
+  g_registryReclaimSource = 0;
+  ReclaimRegistries();
+  return G_SOURCE_REMOVE;
+}
 
-    // name is at index 4 (string).
-    g_autoptr(GVariant) vName = g_variant_get_child_value(vOut, 4);
-    const gchar* name = g_variant_get_string(vName, nullptr);
+static void ReclaimRegistries() {
+  if (g_retiredRegistries.empty()) return;
+  if (g_registryReaders.load(std::memory_order_seq_cst) != 0) {
+    if (!g_registryReclaimSource)
+      g_registryReclaimSource =
+          g_timeout_add(kRegistryReclaimRetryMs, OnReclaimRegistries, nullptr);
+    return;
+  }
+  for (const DisplayRegistry* registry : g_retiredRegistries) delete registry;
+  g_retiredRegistries.clear();
+}
 
-    if (crtcId < 0) continue;  // Output not active.
+// Main thread only.  The publisher is the only writer, so it may read the
+// current snapshot without a view.
+static const DisplayRegistry& CurrentRegistry() {
+  return *g_registry.load(std::memory_order_relaxed);
+}
 
-    MutterOutputInfo info;
-    info.name = name;
-    info.crtcId = crtcId;
-    info.gammaSize = 0;
+static void PublishRegistry(std::vector<DrmDisplay> drmDisplays, bool mutterQueried,
+                            std::vector<MutterOutputInfo> mutterOutputs) {
+  auto* next = new DisplayRegistry(CurrentRegistry().version + 1, std::move(drmDisplays),
+                                   mutterQueried, std::move(mutterOutputs));
+  g_retiredRegistries.push_back(g_registry.exchange(next, std::memory_order_seq_cst));
+  ReclaimRegistries();
+}
 
-    // Query gamma LUT size for this CRTC.
-    g_autoptr(GError) gammaError = nullptr;
-    g_autoptr(GVariant) gammaRes = g_dbus_connection_call_sync(
-        bus, "org.gnome.Shell",
-        "/org/gnome/Mutter/DisplayConfig",
-        "org.gnome.Mutter.DisplayConfig",
-        "GetCrtcGamma",
-        g_variant_new("(uu)", g_mutterSerial, (guint32)crtcId),
-        nullptr, G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &gammaError);
+// Replace the display list, keeping the Mutter outputs.
+static void PublishDrmDisplays(std::vector<DrmDisplay> drmDisplays) {
+  const DisplayRegistry& current = CurrentRegistry();
+  PublishRegistry(std::move(drmDisplays), current.mutterQueried, current.mutterOutputs);
+}
 
-    if (gammaRes) {
-      // Result: (aq red, aq green, aq blue)
-      g_autoptr(GVariant) vRed = g_variant_get_child_value(gammaRes, 0);
-      info.gammaSize = static_cast<int>(g_variant_n_children(vRed));
-    }
+// Replace the Mutter outputs, keeping the display list.
+static void PublishMutterOutputs(bool queried, std::vector<MutterOutputInfo> outputs) {
+  PublishRegistry(CurrentRegistry().drmDisplays, queried, std::move(outputs));
+}
 
-    g_mutterOutputs.push_back(info);
-  }
+// ── Software brightness (gamma) via KMS GAMMA_LUT ──────────────────
+//
+// For kiosk and TTY deployments with no X11 or Wayland compositor, where
+// neither Mutter nor xrandr is there to take the gamma ramp.  The CRTC
+// driving the connector gets a new GAMMA_LUT property blob through an
+// atomic commit on /dev/dri/cardN.  Each CRTC keeps the blob it last
+// committed and the level it encodes; a write at the same level is a
+// no-op, and a new level creates one blob, commits it and destroys the
+// previous one.
+//
+// Atomic commits need DRM master, which a process holds when nothing
+// else (no compositor, no other kiosk client) has the card open as
+// master.  The structures and ioctl numbers (kms_uapi.h) mirror the
+// stable <drm/drm.h> and <drm/drm_mode.h> UAPI, so neither libdrm nor its
+// headers are needed.
+//
+// Used when BS_DISPLAY_CONTROL_GAMMA=kms, or automatically when neither
+// WAYLAND_DISPLAY nor DISPLAY is set (e.g. the headless --set/--serve
+// modes on a console).  Any thread; the state is behind g_kmsMutex.
+
+// Connector type names as the kernel prints them in sysfs (card1-HDMI-A-1).
+static const char* const kDrmConnectorTypeNames[] = {
+    "Unknown", "VGA",  "DVI-I",   "DVI-D", "DVI-A", "Composite", "SVIDEO",
+    "LVDS",    "Component", "DIN", "DP",    "HDMI-A", "HDMI-B",   "TV",
+    "eDP",     "Virtual", "DSI",  "DPI",   "Writeback", "SPI",   "USB"};
+
+struct KmsCrtcGamma {
+  std::string card;          // e.g., "card1".
+  uint32_t crtcId = 0;
+  uint32_t gammaLutProp = 0;
+  uint32_t lutSize = 0;
+  uint32_t blobId = 0;       // Blob currently committed by us, 0 if none.
+  int level = -1;            // 16-bit gamma level encoded in blobId.
+};
 
-  fprintf(stderr, "[BSDisplayControl] Mutter: serial=%u, %zu outputs mapped\n",
-          g_mutterSerial, g_mutterOutputs.size());
-  for (const auto& o : g_mutterOutputs) {
-    fprintf(stderr, "[BSDisplayControl]   %s -> CRTC %d, gamma %d\n",
-            o.name.c_str(), o.crtcId, o.gammaSize);
-  }
+static std::mutex g_kmsMutex;
+static std::map<std::string, int> g_kmsCards;             // Card name -> fd.
+static std::map<std::string, KmsCrtcGamma> g_kmsConnectors;  // By DRM connector.
 
-  return !g_mutterOutputs.empty();
+static bool UseKmsGamma() {
+  static const bool result = [] {
+    const char* forced = getenv("BS_DISPLAY_CONTROL_GAMMA");
+    if (forced && *forced) return strcmp(forced, "kms") == 0;
+    const char* wl = getenv("WAYLAND_DISPLAY");
+    const char* x = getenv("DISPLAY");
+    return !(wl && *wl) && !(x && *x);
+  }();
+  return result;
 }
 
-// Set gamma via Mutter D-Bus SetCrtcGamma.
-// factor: 0.0 = black, 1.0 = normal (linear ramp).
-static bool SetSoftwareBrightnessWayland(const MutterOutputInfo& output, double factor) {
-  double clamped = std::clamp(factor, 0.0, 1.0);
-  int size = output.gammaSize;
-  if (size <= 0) return false;
+static int KmsCardFd(const std::string& card) {
+  auto it = g_kmsCards.find(card);
+  if (it != g_kmsCards.end()) return it->second;
+  std::string path = "/dev/dri/" + card;
+  int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd >= 0) {
+    KmsSetClientCap universal = {kDrmClientCapUniversalPlanes, 1};
+    KmsSetClientCap atomic = {kDrmClientCapAtomic, 1};
+    if (ioctl(fd, kDrmIoctlSetClientCap, &universal) != 0 ||
+        ioctl(fd, kDrmIoctlSetClientCap, &atomic) != 0) {
+      fprintf(stderr, "[BSDisplayControl] KMS: %s has no atomic modesetting\n", card.c_str());
+      CloseFd(fd);
+    }
+  } else {
+    fprintf(stderr, "[BSDisplayControl] KMS: cannot open %s: %s\n", path.c_str(),
+            strerror(errno));
+  }
+  g_kmsCards[card] = fd;  // -1 is remembered too.
+  return fd;
+}
 
-  g_autoptr(GError) error = nullptr;
-  g_autoptr(GDBusConnection) bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
-  if (!bus) return false;
+// Property ID of |name| on |objId|, and its value.
+static bool KmsFindProperty(int fd, uint32_t objId, uint32_t objType, const char* name,
+                            uint32_t& propId, uint64_t& value) {
+  KmsObjGetProperties req = {};
+  req.objId = objId;
+  req.objType = objType;
+  if (ioctl(fd, kDrmIoctlObjGetProperties, &req) != 0) return false;
+  std::vector<uint32_t> ids(req.countProps);
+  std::vector<uint64_t> values(req.countProps);
+  req.propsPtr = reinterpret_cast<uintptr_t>(ids.data());
+  req.propValuesPtr = reinterpret_cast<uintptr_t>(values.data());
+  if (ioctl(fd, kDrmIoctlObjGetProperties, &req) != 0) return false;
+  for (uint32_t i = 0; i < std::min<uint32_t>(req.countProps, ids.size()); i++) {
+    KmsGetProperty prop = {};
+    prop.propId = ids[i];
+    if (ioctl(fd, kDrmIoctlGetProperty, &prop) != 0) continue;
+    if (strncmp(prop.name, name, sizeof(prop.name)) == 0) {
+      propId = ids[i];
+      value = values[i];
+      return true;
+    }
+  }
+  return false;
+}
 
-  // Build gamma LUT: linear ramp scaled by factor.
-  // Each entry: value = (i / (size-1)) * 65535 * factor, as uint16.
-  GVariantBuilder redBuilder, greenBuilder, blueBuilder;
-  g_variant_builder_init(&redBuilder, G_VARIANT_TYPE("aq"));
-  g_variant_builder_init(&greenBuilder, G_VARIANT_TYPE("aq"));
-  g_variant_builder_init(&blueBuilder, G_VARIANT_TYPE("aq"));
+// Find the CRTC currently driving |connector| ("card1-DP-1") and its
+// GAMMA_LUT property.
+static bool ResolveKmsCrtc(const std::string& connector, KmsCrtcGamma& out) {
+  auto dash = connector.find('-');
+  if (dash == std::string::npos) return false;
+  out.card = connector.substr(0, dash);
+  std::string name = connector.substr(dash + 1);
+  int fd = KmsCardFd(out.card);
+  if (fd < 0) return false;
 
-  double denom = (size > 1) ? static_cast<double>(size - 1) : 1.0;
-  for (int i = 0; i < size; i++) {
-    guint16 val = static_cast<guint16>(
-        std::clamp(static_cast<double>(i) / denom * 65535.0 * clamped, 0.0, 65535.0));
-    g_variant_builder_add(&redBuilder, "q", val);
-    g_variant_builder_add(&greenBuilder, "q", val);
-    g_variant_builder_add(&blueBuilder, "q", val);
+  KmsCardRes res = {};
+  if (ioctl(fd, kDrmIoctlGetResources, &res) != 0) return false;
+  std::vector<uint32_t> connectors(res.countConnectors);
+  res = {};
+  res.countConnectors = static_cast<uint32_t>(connectors.size());
+  res.connectorIdPtr = reinterpret_cast<uintptr_t>(connectors.data());
+  if (ioctl(fd, kDrmIoctlGetResources, &res) != 0) return false;
+
+  for (uint32_t i = 0; i < std::min<uint32_t>(res.countConnectors, connectors.size()); i++) {
+    // Asking for one mode keeps the kernel from reprobing the connector.
+    alignas(8) uint8_t mode[kDrmModeInfoSize];
+    KmsGetConnector conn = {};
+    conn.connectorId = connectors[i];
+    conn.countModes = 1;
+    conn.modesPtr = reinterpret_cast<uintptr_t>(mode);
+    if (ioctl(fd, kDrmIoctlGetConnector, &conn) != 0) continue;
+    const char* type = conn.connectorType < std::size(kDrmConnectorTypeNames)
+                           ? kDrmConnectorTypeNames[conn.connectorType]
+                           : "Unknown";
+    if (name != std::string(type) + "-" + std::to_string(conn.connectorTypeId)) continue;
+    if (conn.encoderId == 0) break;  // Not lit.
+
+    KmsGetEncoder enc = {};
+    enc.encoderId = conn.encoderId;
+    if (ioctl(fd, kDrmIoctlGetEncoder, &enc) != 0 || enc.crtcId == 0) break;
+    out.crtcId = enc.crtcId;
+
+    uint64_t lutSize = 0, blob = 0;
+    uint32_t sizeProp = 0;
+    if (!KmsFindProperty(fd, enc.crtcId, kDrmObjectCrtc, "GAMMA_LUT_SIZE", sizeProp, lutSize) ||
+        !KmsFindProperty(fd, enc.crtcId, kDrmObjectCrtc, "GAMMA_LUT", out.gammaLutProp, blob) ||
+        lutSize == 0) {
+      fprintf(stderr, "[BSDisplayControl] KMS: CRTC %u of %s has no GAMMA_LUT\n", enc.crtcId,
+              connector.c_str());
+      return false;
+    }
+    out.lutSize = static_cast<uint32_t>(lutSize);
+    return true;
   }
+  fprintf(stderr, "[BSDisplayControl] KMS: %s is not driven by a CRTC\n", connector.c_str());
+  return false;
+}
 
-  g_autoptr(GVariant) result = g_dbus_connection_call_sync(
-      bus, "org.gnome.Shell",
-      "/org/gnome/Mutter/DisplayConfig",
-      "org.gnome.Mutter.DisplayConfig",
-      "SetCrtcGamma",
-      g_variant_new("(uu@aq@aq@aq)",
-                     g_mutterSerial,
-                     static_cast<guint32>(output.crtcId),
-                     g_variant_builder_end(&redBuilder),
-                     g_variant_builder_end(&greenBuilder),
-                     g_variant_builder_end(&blueBuilder)),
-      nullptr, G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error);
+static void DestroyKmsBlob(int fd, uint32_t& blobId) {
+  if (blobId == 0) return;
+  KmsDestroyBlob destroy = {blobId};
+  ioctl(fd, kDrmIoctlDestroyBlob, &destroy);
+  blobId = 0;
+}
 
-  if (!result) {
-    fprintf(stderr, "[BSDisplayControl] SetCrtcGamma failed for %s: %s\n",
-            output.name.c_str(), error ? error->message : "unknown");
+// Commit a linear ramp scaled by |level| / 65535 to |crtc|.
+static bool CommitKmsGamma(int fd, KmsCrtcGamma& crtc, int level) {
+  std::vector<KmsColorLut> lut(crtc.lutSize);
+  double denom = crtc.lutSize > 1 ? static_cast<double>(crtc.lutSize - 1) : 1.0;
+  for (uint32_t i = 0; i < crtc.lutSize; i++) {
+    auto v = static_cast<uint16_t>(std::lround(i / denom * level));
+    lut[i] = {v, v, v, 0};
+  }
+  KmsCreateBlob create = {};
+  create.data = reinterpret_cast<uintptr_t>(lut.data());
+  create.length = static_cast<uint32_t>(lut.size() * sizeof(KmsColorLut));
+  if (ioctl(fd, kDrmIoctlCreateBlob, &create) != 0) return false;
+
+  uint32_t objs[] = {crtc.crtcId};
+  uint32_t counts[] = {1};
+  uint32_t props[] = {crtc.gammaLutProp};
+  uint64_t values[] = {create.blobId};
+  KmsAtomic commit = {};
+  commit.flags = kDrmAtomicNonblock;
+  commit.countObjs = 1;
+  commit.objsPtr = reinterpret_cast<uintptr_t>(objs);
+  commit.countPropsPtr = reinterpret_cast<uintptr_t>(counts);
+  commit.propsPtr = reinterpret_cast<uintptr_t>(props);
+  commit.propValuesPtr = reinterpret_cast<uintptr_t>(values);
+  int rc = ioctl(fd, kDrmIoctlAtomic, &commit);
+  if (rc != 0 && errno == EBUSY) {
+    // A previous commit is still pending; wait for it instead.
+    commit.flags = 0;
+    rc = ioctl(fd, kDrmIoctlAtomic, &commit);
+  }
+  if (rc != 0) {
+    int err = errno;
+    DestroyKmsBlob(fd, create.blobId);
+    fprintf(stderr, "[BSDisplayControl] KMS: GAMMA_LUT commit on CRTC %u failed: %s%s\n",
+            crtc.crtcId, strerror(err), err == EACCES ? " (not DRM master)" : "");
+    errno = err;
     return false;
   }
+  // The committed state holds its own reference to the new blob.
+  DestroyKmsBlob(fd, crtc.blobId);
+  crtc.blobId = create.blobId;
+  crtc.level = level;
   return true;
 }
 
-// Set gamma via xrandr (X11 fallback).
-static bool SetSoftwareBrightnessX11(const std::string& outputName, double factor) {
-  double clamped = std::clamp(factor, 0.0, 1.0);
-  char gammaStr[32];
-  snprintf(gammaStr, sizeof(gammaStr), "%.4f", clamped);
-
-  pid_t pid = fork();
-  if (pid < 0) return false;
-  if (pid == 0) {
-    int devnull = open("/dev/null", O_WRONLY);
-    if (devnull >= 0) {
-      dup2(devnull, STDOUT_FILENO);
-      dup2(devnull, STDERR_FILENO);
-      close(devnull);
+// factor: 0.0 = black, 1.0 = normal.  Blocks for at most one vblank.
+static bool SetSoftwareBrightnessKms(const std::string& connector, double factor) {
+  int level = static_cast<int>(std::lround(std::clamp(factor, 0.0, 1.0) * 65535.0));
+  std::lock_guard<std::mutex> lock(g_kmsMutex);
+  TraceSpan span("kms", "GAMMA_LUT");
+  span.Detail("%s gamma=%.3f", connector.c_str(), level / 65535.0);
+  // Resolve once per connector; after a failure (e.g. the CRTC was
+  // reassigned) resolve again and retry once.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    auto it = g_kmsConnectors.find(connector);
+    if (it == g_kmsConnectors.end()) {
+      KmsCrtcGamma crtc;
+      if (!ResolveKmsCrtc(connector, crtc)) return false;
+      it = g_kmsConnectors.emplace(connector, std::move(crtc)).first;
     }
-    execlp("xrandr", "xrandr", "--output", outputName.c_str(),
-           "--brightness", gammaStr, nullptr);
-    _exit(1);
+    KmsCrtcGamma& crtc = it->second;
+    if (crtc.level == level) return true;
+    int fd = KmsCardFd(crtc.card);
+    if (CommitKmsGamma(fd, crtc, level)) return true;
+    bool denied = errno == EACCES;
+    DestroyKmsBlob(fd, crtc.blobId);
+    g_kmsConnectors.erase(it);
+    if (denied) return false;
   }
-
-  int status = 0;
-  waitpid(pid, &status, 0);
-  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  return false;
 }
 
-// Find the output name for a given display ID (used for both Wayland and X11).
-static std::string FindOutputName(const char* displayId) {
-  std::string idStr(displayId);
+// ── Software brightness (gamma) via wlr-gamma-control ──────────────
+//
+// wlroots compositors (sway, Hyprland, river, ...) have no Mutter
+// DisplayConfig and ignore xrandr, but offer zwlr_gamma_control_manager_v1.
+// The runner keeps its own Wayland connection (independent of GTK's, so
+// the headless --serve mode can use it too) and holds one gamma control per
+// output for as long as it runs: the compositor restores the original ramp
+// as soon as a control is destroyed, so a long-lived control is what makes
+// a setting stick.
+//
+// The protocol takes each ramp as an fd to read.  Every output owns two
+// memfds, mapped once and sized for its ramp; an update writes the ramp in
+// place into the idle one, rewinds it and passes the fd.  Alternating
+// means the compositor never reads a ramp being rewritten unless it lags
+// two updates behind.
+//
+// libwayland-client is dlopen()ed and the two protocol interfaces are
+// declared here, so building needs neither the Wayland headers nor
+// wayland-scanner.  Main thread only.
 
-  if (idStr == "backlight") {
-    for (const auto& disp : g_drmDisplays) {
-      if (disp.isBuiltIn) return disp.xrandrName;
+struct WlInterface;
+
+struct WlMessage {
+  const char* name;
+  const char* signature;
+  const WlInterface** types;
+};
+
+// Layout of struct wl_interface.
+struct WlInterface {
+  const char* name;
+  int version;
+  int methodCount;
+  const WlMessage* methods;
+  int eventCount;
+  const WlMessage* events;
+};
+
+// union wl_argument.
+union WlArgument {
+  int32_t i;
+  uint32_t u;
+  const char* s;
+  void* o;
+  uint32_t n;
+  int32_t h;
+};
+
+struct WlProxy;  // Opaque wl_proxy (wl_display is one too).
+
+struct LibWaylandApi {
+  void* lib = nullptr;
+  WlProxy* (*displayConnect)(const char*) = nullptr;
+  void (*displayDisconnect)(WlProxy*) = nullptr;
+  int (*displayGetFd)(WlProxy*) = nullptr;
+  int (*displayRoundtrip)(WlProxy*) = nullptr;
+  int (*displayDispatch)(WlProxy*) = nullptr;
+  int (*displayFlush)(WlProxy*) = nullptr;
+  WlProxy* (*proxyMarshalArrayFlags)(WlProxy*, uint32_t, const WlInterface*, uint32_t,
+                                     uint32_t, WlArgument*) = nullptr;
+  int (*proxyAddListener)(WlProxy*, void (**)(void), void*) = nullptr;
+  void (*proxyDestroy)(WlProxy*) = nullptr;
+  const WlInterface* registryInterface = nullptr;
+  const WlInterface* outputInterface = nullptr;
+};
+
+static const uint32_t kWlMarshalFlagDestroy = 1;
+
+// zwlr_gamma_control_v1 / zwlr_gamma_control_manager_v1, version 1.
+static const WlInterface* g_wlrNullTypes[] = {nullptr, nullptr};
+static const WlMessage kWlrGammaControlRequests[] = {
+    {"set_gamma", "h", g_wlrNullTypes},
+    {"destroy", "", g_wlrNullTypes},
+};
+static const WlMessage kWlrGammaControlEvents[] = {
+    {"gamma_size", "u", g_wlrNullTypes},
+    {"failed", "", g_wlrNullTypes},
+};
+static const WlInterface kWlrGammaControlInterface = {
+    "zwlr_gamma_control_v1", 1, 2, kWlrGammaControlRequests, 2, kWlrGammaControlEvents};
+// Filled in with wl_output_interface once libwayland-client is loaded.
+static const WlInterface* g_wlrGetGammaControlTypes[] = {&kWlrGammaControlInterface, nullptr};
+static const WlMessage kWlrGammaManagerRequests[] = {
+    {"get_gamma_control", "no", g_wlrGetGammaControlTypes},
+    {"destroy", "", g_wlrNullTypes},
+};
+static const WlInterface kWlrGammaManagerInterface = {
+    "zwlr_gamma_control_manager_v1", 1, 2, kWlrGammaManagerRequests, 0, nullptr};
+
+struct WlrGammaOutput {
+  uint32_t global = 0;
+  WlProxy* output = nullptr;
+  std::string name;             // wl_output.name (v4), e.g. "DP-1".
+  WlProxy* control = nullptr;
+  uint32_t gammaSize = 0;       // Entries per channel, 0 until announced.
+  bool failed = false;          // Another client owns the gamma.
+  int memfd[2] = {-1, -1};
+  uint16_t* ramp[2] = {nullptr, nullptr};
+  size_t rampBytes = 0;
+  int nextBuffer = 0;
+  int level = -1;               // 16-bit gamma level last sent.
+  int pendingLevel = -1;        // Requested before the size was known.
+};
+
+struct WlrGamma {
+  bool checked = false;
+  WlProxy* display = nullptr;
+  WlProxy* registry = nullptr;
+  WlProxy* manager = nullptr;
+  guint source = 0;
+  std::map<uint32_t, WlrGammaOutput> outputs;  // By registry name.
+};
+
+static std::once_flag g_libwaylandOnce;
+static LibWaylandApi g_libwayland;
+static WlrGamma g_wlr;
+// Set by a one-shot headless --set.  Its controls die with the process,
+// and the compositor then puts the original ramp back, so dimming cannot
+// outlive the command.
+static bool g_wlrOneShot = false;
+
+static const LibWaylandApi* LoadLibWayland() {
+  std::call_once(g_libwaylandOnce, [] {
+    void* lib = dlopen("libwayland-client.so.0", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) return;
+    LibWaylandApi api;
+    api.lib = lib;
+    bool ok = LoadSymbol(lib, "wl_display_connect", api.displayConnect) &&
+              LoadSymbol(lib, "wl_display_disconnect", api.displayDisconnect) &&
+              LoadSymbol(lib, "wl_display_get_fd", api.displayGetFd) &&
+              LoadSymbol(lib, "wl_display_roundtrip", api.displayRoundtrip) &&
+              LoadSymbol(lib, "wl_display_dispatch", api.displayDispatch) &&
+              LoadSymbol(lib, "wl_display_flush", api.displayFlush) &&
+              // Added in libwayland 1.20.
+              LoadSymbol(lib, "wl_proxy_marshal_array_flags", api.proxyMarshalArrayFlags) &&
+              LoadSymbol(lib, "wl_proxy_add_listener", api.proxyAddListener) &&
+              LoadSymbol(lib, "wl_proxy_destroy", api.proxyDestroy);
+    api.registryInterface = static_cast<const WlInterface*>(dlsym(lib, "wl_registry_interface"));
+    api.outputInterface = static_cast<const WlInterface*>(dlsym(lib, "wl_output_interface"));
+    if (!ok || !api.registryInterface || !api.outputInterface) {
+      fprintf(stderr, "[BSDisplayControl] libwayland-client is too old for wlr-gamma-control\n");
+      dlclose(lib);
+      return;
+    }
+    g_wlrGetGammaControlTypes[1] = api.outputInterface;
+    g_libwayland = api;
+  });
+  return g_libwayland.lib ? &g_libwayland : nullptr;
+}
+
+static void ReleaseWlrGammaOutput(WlrGammaOutput& out) {
+  const LibWaylandApi* wl = &g_libwayland;
+  if (out.control) {
+    WlArgument none[1] = {};
+    wl->proxyMarshalArrayFlags(out.control, 1, nullptr, 1, kWlMarshalFlagDestroy, none);
+    out.control = nullptr;
+  }
+  if (out.output) wl->proxyDestroy(out.output);
+  out.output = nullptr;
+  for (int i = 0; i < 2; i++) {
+    if (out.ramp[i]) munmap(out.ramp[i], out.rampBytes);
+    out.ramp[i] = nullptr;
+    CloseFd(out.memfd[i]);
+  }
+}
+
+// Write the ramp for |level| into the idle memfd and hand it over.
+static bool SendWlrGamma(WlrGammaOutput& out, int level) {
+  if (!out.control || out.gammaSize == 0) return false;
+  int buffer = out.nextBuffer;
+  uint16_t* ramp = out.ramp[buffer];
+  double denom = out.gammaSize > 1 ? static_cast<double>(out.gammaSize - 1) : 1.0;
+  for (uint32_t i = 0; i < out.gammaSize; i++) {
+    auto v = static_cast<uint16_t>(std::lround(i / denom * level));
+    ramp[i] = ramp[out.gammaSize + i] = ramp[2 * out.gammaSize + i] = v;
+  }
+  // The compositor gets a dup sharing our file offset; some read() it.
+  lseek(out.memfd[buffer], 0, SEEK_SET);
+  WlArgument args[1];
+  args[0].h = out.memfd[buffer];
+  g_libwayland.proxyMarshalArrayFlags(out.control, 0, nullptr, 1, 0, args);
+  g_libwayland.displayFlush(g_wlr.display);
+  out.nextBuffer ^= 1;
+  out.level = level;
+  return true;
+}
+
+static void OnWlrGammaSize(void* data, WlProxy* control, uint32_t size) {
+  auto* out = static_cast<WlrGammaOutput*>(data);
+  size_t bytes = static_cast<size_t>(size) * 3 * sizeof(uint16_t);
+  for (int i = 0; i < 2; i++) {
+    out->memfd[i] = memfd_create("bs-display-gamma", MFD_CLOEXEC);
+    if (out->memfd[i] < 0 || ftruncate(out->memfd[i], static_cast<off_t>(bytes)) != 0) break;
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, out->memfd[i], 0);
+    if (map == MAP_FAILED) break;
+    out->ramp[i] = static_cast<uint16_t*>(map);
+  }
+  if (!out->ramp[0] || !out->ramp[1]) {
+    fprintf(stderr, "[BSDisplayControl] wlr-gamma: no ramp buffer for %s: %s\n",
+            out->name.c_str(), strerror(errno));
+    return;
+  }
+  out->rampBytes = bytes;
+  out->gammaSize = size;
+  fprintf(stderr, "[BSDisplayControl] wlr-gamma: %s has %u ramp entries\n", out->name.c_str(),
+          size);
+  if (out->pendingLevel >= 0) SendWlrGamma(*out, out->pendingLevel);
+  out->pendingLevel = -1;
+}
+
+static void OnWlrGammaFailed(void* data, WlProxy* control) {
+  auto* out = static_cast<WlrGammaOutput*>(data);
+  fprintf(stderr, "[BSDisplayControl] wlr-gamma: control for %s failed "
+          "(another client owns its gamma, or it has none)\n", out->name.c_str());
+  WlArgument none[1] = {};
+  g_libwayland.proxyMarshalArrayFlags(out->control, 1, nullptr, 1, kWlMarshalFlagDestroy, none);
+  out->control = nullptr;
+  out->failed = true;
+}
+
+static void (*const kWlrGammaControlListener[])(void) = {
+    reinterpret_cast<void (*)(void)>(OnWlrGammaSize),
+    reinterpret_cast<void (*)(void)>(OnWlrGammaFailed),
+};
+
+static void CreateWlrGammaControl(WlrGammaOutput& out) {
+  if (out.control || out.failed || !g_wlr.manager || out.name.empty()) return;
+  WlArgument args[2];
+  args[0].o = nullptr;  // new_id, filled in by libwayland.
+  args[1].o = out.output;
+  out.control = g_libwayland.proxyMarshalArrayFlags(g_wlr.manager, 0, &kWlrGammaControlInterface,
+                                                    1, 0, args);
+  if (out.control) {
+    g_libwayland.proxyAddListener(out.control,
+                                  const_cast<void (**)(void)>(kWlrGammaControlListener), &out);
+  }
+}
+
+static void OnWlOutputGeometry(void*, WlProxy*, int32_t, int32_t, int32_t, int32_t, int32_t,
+                               const char*, const char*, int32_t) {}
+static void OnWlOutputMode(void*, WlProxy*, uint32_t, int32_t, int32_t, int32_t) {}
+static void OnWlOutputDone(void*, WlProxy*) {}
+static void OnWlOutputScale(void*, WlProxy*, int32_t) {}
+static void OnWlOutputDescription(void*, WlProxy*, const char*) {}
+
+static void OnWlOutputName(void* data, WlProxy* output, const char* name) {
+  auto* out = static_cast<WlrGammaOutput*>(data);
+  out->name = name;
+  CreateWlrGammaControl(*out);
+}
+
+static void (*const kWlOutputListener[])(void) = {
+    reinterpret_cast<void (*)(void)>(OnWlOutputGeometry),
+    reinterpret_cast<void (*)(void)>(OnWlOutputMode),
+    reinterpret_cast<void (*)(void)>(OnWlOutputDone),
+    reinterpret_cast<void (*)(void)>(OnWlOutputScale),
+    reinterpret_cast<void (*)(void)>(OnWlOutputName),
+    reinterpret_cast<void (*)(void)>(OnWlOutputDescription),
+};
+
+static WlProxy* BindWlGlobal(uint32_t name, const WlInterface* iface, uint32_t version) {
+  WlArgument args[4];
+  args[0].u = name;
+  args[1].s = iface->name;
+  args[2].u = version;
+  args[3].o = nullptr;  // new_id.
+  return g_libwayland.proxyMarshalArrayFlags(g_wlr.registry, 0, iface, version, 0, args);
+}
+
+static void OnWlRegistryGlobal(void* data, WlProxy* registry, uint32_t name,
+                               const char* interface, uint32_t version) {
+  if (strcmp(interface, kWlrGammaManagerInterface.name) == 0 && !g_wlr.manager) {
+    g_wlr.manager = BindWlGlobal(name, &kWlrGammaManagerInterface, 1);
+    for (auto& [global, out] : g_wlr.outputs) CreateWlrGammaControl(out);
+  } else if (strcmp(interface, "wl_output") == 0) {
+    if (version < 4) {
+      // Names arrived with version 4; without one the output cannot be
+      // matched to a display.
+      fprintf(stderr, "[BSDisplayControl] wlr-gamma: wl_output v%u has no name\n", version);
+      return;
+    }
+    WlrGammaOutput& out = g_wlr.outputs[name];
+    out.global = name;
+    out.output = BindWlGlobal(name, g_libwayland.outputInterface, 4);
+    if (out.output) {
+      g_libwayland.proxyAddListener(out.output, const_cast<void (**)(void)>(kWlOutputListener),
+                                    &out);
+    }
+  }
+}
+
+static void OnWlRegistryGlobalRemove(void* data, WlProxy* registry, uint32_t name) {
+  auto it = g_wlr.outputs.find(name);
+  if (it == g_wlr.outputs.end()) return;
+  ReleaseWlrGammaOutput(it->second);
+  g_wlr.outputs.erase(it);
+}
+
+static void (*const kWlRegistryListener[])(void) = {
+    reinterpret_cast<void (*)(void)>(OnWlRegistryGlobal),
+    reinterpret_cast<void (*)(void)>(OnWlRegistryGlobalRemove),
+};
+
+static void StopWlrGamma() {
+  if (!g_wlr.display) return;
+  if (g_wlr.source) g_source_remove(g_wlr.source);
+  g_wlr.source = 0;
+  for (auto& [global, out] : g_wlr.outputs) ReleaseWlrGammaOutput(out);
+  g_wlr.outputs.clear();
+  if (g_wlr.manager) {
+    WlArgument none[1] = {};
+    g_libwayland.proxyMarshalArrayFlags(g_wlr.manager, 1, nullptr, 1, kWlMarshalFlagDestroy,
+                                        none);
+  }
+  g_wlr.manager = nullptr;
+  if (g_wlr.registry) g_libwayland.proxyDestroy(g_wlr.registry);
+  g_wlr.registry = nullptr;
+  g_libwayland.displayDisconnect(g_wlr.display);  // Flushes the destroys.
+  g_wlr.display = nullptr;
+}
+
+static gboolean OnWlrGammaEvents(gint fd, GIOCondition condition, gpointer user_data) {
+  if ((condition & (G_IO_HUP | G_IO_ERR)) || g_libwayland.displayDispatch(g_wlr.display) < 0) {
+    fprintf(stderr, "[BSDisplayControl] wlr-gamma: compositor connection lost\n");
+    g_wlr.source = 0;
+    StopWlrGamma();
+    g_wlr.checked = false;  // Reconnect on next use.
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Connect on first use and keep the connection if the compositor offers
+// zwlr_gamma_control_manager_v1.  Checked once per process.
+static bool WlrGammaAvailable() {
+  if (g_wlr.checked) return g_wlr.display != nullptr;
+  g_wlr.checked = true;
+  const char* forced = getenv("BS_DISPLAY_CONTROL_GAMMA");
+  if (forced && *forced && strcmp(forced, "wlr") != 0) return false;
+  const LibWaylandApi* wl = LoadLibWayland();
+  if (!wl) return false;
+  g_wlr.display = wl->displayConnect(nullptr);
+  if (!g_wlr.display) return false;
+
+  TraceSpan span("wayland", "wlr-gamma connect");
+  WlArgument args[1];
+  args[0].o = nullptr;  // new_id.
+  // wl_display.get_registry.
+  g_wlr.registry =
+      wl->proxyMarshalArrayFlags(g_wlr.display, 1, wl->registryInterface, 1, 0, args);
+  if (g_wlr.registry) {
+    wl->proxyAddListener(g_wlr.registry, const_cast<void (**)(void)>(kWlRegistryListener),
+                         nullptr);
+  }
+  // Globals, then output names (creating the controls), then ramp sizes.
+  for (int i = 0; i < 3 && g_wlr.registry; i++) {
+    if (wl->displayRoundtrip(g_wlr.display) < 0) break;
+  }
+  if (!g_wlr.manager) {
+    StopWlrGamma();
+    return false;
+  }
+  g_wlr.source = g_unix_fd_add(wl->displayGetFd(g_wlr.display),
+                               static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+                               OnWlrGammaEvents, nullptr);
+  fprintf(stderr, "[BSDisplayControl] wlr-gamma: %zu outputs\n", g_wlr.outputs.size());
+  return true;
+}
+
+// factor: 0.0 = black, 1.0 = normal.  |outputName| is the Wayland output
+// name.  Never blocks.
+static bool SetSoftwareBrightnessWlr(const std::string& outputName, double factor) {
+  int level = static_cast<int>(std::lround(std::clamp(factor, 0.0, 1.0) * 65535.0));
+  for (auto& [global, out] : g_wlr.outputs) {
+    if (out.name != outputName) continue;
+    if (!out.control) return false;
+    if (out.level == level) return true;
+    if (g_wlrOneShot) {
+      // Holding a control means no other client owns the gamma, so the
+      // ramp is the original one, and stays so after exit.
+      if (level == 65535) return true;
+      fprintf(stderr,
+              "[BSDisplayControl] wlr-gamma: %s would revert when this process exits; "
+              "use --serve or the app\n",
+              outputName.c_str());
+      return false;
+    }
+    TraceSpan span("wayland", "set_gamma");
+    span.Detail("%s gamma=%.3f", outputName.c_str(), level / 65535.0);
+    if (out.gammaSize == 0) {
+      out.pendingLevel = level;  // Sent once the size arrives.
+      return true;
+    }
+    return SendWlrGamma(out, level);
+  }
+  fprintf(stderr, "[BSDisplayControl] wlr-gamma: no output named %s\n", outputName.c_str());
+  return false;
+}
+
+// ── Software brightness (gamma) via Mutter D-Bus or xrandr ─────────
+//
+// On GNOME/Wayland: use org.gnome.Mutter.DisplayConfig SetCrtcGamma
+// via GDBus.  This is the only way to set per-output gamma on Wayland
+// since xrandr --brightness only affects the XWayland virtual display.
+//
+// On X11: fall back to xrandr --output NAME --brightness FACTOR.
+//
+// The Mutter D-Bus API:
+//   GetResources() -> (serial, crtcs[], outputs[], modes[], ...)
+//   GetCrtcGamma(serial, crtc_id) -> (aq red, aq green, aq blue)
+//   SetCrtcGamma(serial, crtc_id, aq red, aq green, aq blue)
+
+static bool g_isWayland = false;
+
+// Detect if we're running on native Wayland.
+static bool IsWayland() {
+  static bool checked = false;
+  static bool result = false;
+  if (!checked) {
+    checked = true;
+    const char* wl = getenv("WAYLAND_DISPLAY");
+    const char* st = getenv("XDG_SESSION_TYPE");
+    result = (wl && wl[0] != '\0') || (st && strcmp(st, "wayland") == 0);
+  }
+  return result;
+}
+
+// Query Mutter's DisplayConfig.GetResources to build output -> CRTC mapping.
+// Also fetches gamma LUT size for each active CRTC.  Publishes the result
+// (even a failed query, so it is not retried on every call).  Main thread.
+static bool QueryMutterResources() {
+  if (CurrentRegistry().mutterQueried) return !CurrentRegistry().mutterOutputs.empty();
+  std::vector<MutterOutputInfo> outputs;
+  struct Publish {
+    std::vector<MutterOutputInfo>& outputs;
+    ~Publish() { PublishMutterOutputs(true, std::move(outputs)); }
+  } publish{outputs};
+
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GDBusConnection) bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+  if (!bus) {
+    fprintf(stderr, "[BSDisplayControl] D-Bus session bus unavailable: %s\n",
+            error ? error->message : "unknown");
+    return false;
+  }
+
+  TraceSpan span("dbus", "GetResources");
+
+  // Call GetResources: returns (u serial, a(uxiiiiiuaua{sv}) crtcs,
+  //   a(uxiausauaua{sv}) outputs, a(uxuudu) modes, i max_w, i max_h)
+  g_autoptr(GVariant) res = g_dbus_connection_call_sync(
+      bus, "org.gnome.Shell",
+      "/org/gnome/Mutter/DisplayConfig",
+      "org.gnome.Mutter.DisplayConfig",
+      "GetResources", nullptr, nullptr,
+      G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error);
+
+  if (!res) {
+    fprintf(stderr, "[BSDisplayControl] Mutter GetResources failed: %s\n",
+            error ? error->message : "unknown");
+    return false;
+  }
+
+  // Extract serial (first element).
+  g_autoptr(GVariant) vSerial = g_variant_get_child_value(res, 0);
+  uint32_t serial = g_variant_get_uint32(vSerial);
+
+  // Extract outputs array (third element, index 2).
+  // Each output: (u id, x winsys_id, i crtc_id, au possible_crtcs,
+  //               s name, au modes, au clones, a{sv} properties)
+  g_autoptr(GVariant) vOutputs = g_variant_get_child_value(res, 2);
+  gsize numOutputs = g_variant_n_children(vOutputs);
+
+  for (gsize i = 0; i < numOutputs; i++) {
+    g_autoptr(GVariant) vOut = g_variant_get_child_value(vOutputs, i);
+
+    // crtc_id is at index 2 (int32).
+    g_autoptr(GVariant) vCrtcId = g_variant_get_child_value(vOut, 2);
+    gint32 crtcId = g_variant_get_int32(vCrtcId);
+
+    // name is at index 4 (string).
+    g_autoptr(GVariant) vName = g_variant_get_child_value(vOut, 4);
+    const gchar* name = g_variant_get_string(vName, nullptr);
+
+    if (crtcId < 0) continue;  // Output not active.
+
+    MutterOutputInfo info;
+    info.name = name;
+    info.crtcId = crtcId;
+    info.gammaSize = 0;
+    info.serial = serial;
+
+    // Query gamma LUT size for this CRTC.
+    g_autoptr(GError) gammaError = nullptr;
+    TraceSpan gammaSpan("dbus", "GetCrtcGamma");
+    gammaSpan.Detail("%s crtc=%d", name, crtcId);
+    g_autoptr(GVariant) gammaRes = g_dbus_connection_call_sync(
+        bus, "org.gnome.Shell",
+        "/org/gnome/Mutter/DisplayConfig",
+        "org.gnome.Mutter.DisplayConfig",
+        "GetCrtcGamma",
+        g_variant_new("(uu)", serial, (guint32)crtcId),
+        nullptr, G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &gammaError);
+
+    if (gammaRes) {
+      // Result: (aq red, aq green, aq blue)
+      g_autoptr(GVariant) vRed = g_variant_get_child_value(gammaRes, 0);
+      info.gammaSize = static_cast<int>(g_variant_n_children(vRed));
+    }
+
+    outputs.push_back(info);
+  }
+
+  fprintf(stderr, "[BSDisplayControl] Mutter: serial=%u, %zu outputs mapped\n",
+          serial, outputs.size());
+  for (const auto& o : outputs) {
+    fprintf(stderr, "[BSDisplayControl]   %s -> CRTC %d, gamma %d\n",
+            o.name.c_str(), o.crtcId, o.gammaSize);
+  }
+
+  return !outputs.empty();
+}
+
+// Set gamma via Mutter D-Bus SetCrtcGamma.
+// factor: 0.0 = black, 1.0 = normal (linear ramp).  |output| is a copy, so
+// this may run on a worker thread.
+static bool SetSoftwareBrightnessWayland(const MutterOutputInfo& output, double factor) {
+  double clamped = std::clamp(factor, 0.0, 1.0);
+  int size = output.gammaSize;
+  if (size <= 0) return false;
+
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GDBusConnection) bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+  if (!bus) return false;
+
+  // Build gamma LUT: linear ramp scaled by factor.
+  // Each entry: value = (i / (size-1)) * 65535 * factor, as uint16.
+  GVariantBuilder redBuilder, greenBuilder, blueBuilder;
+  g_variant_builder_init(&redBuilder, G_VARIANT_TYPE("aq"));
+  g_variant_builder_init(&greenBuilder, G_VARIANT_TYPE("aq"));
+  g_variant_builder_init(&blueBuilder, G_VARIANT_TYPE("aq"));
+
+  double denom = (size > 1) ? static_cast<double>(size - 1) : 1.0;
+  for (int i = 0; i < size; i++) {
+    guint16 val = static_cast<guint16>(
+        std::clamp(static_cast<double>(i) / denom * 65535.0 * clamped, 0.0, 65535.0));
+    g_variant_builder_add(&redBuilder, "q", val);
+    g_variant_builder_add(&greenBuilder, "q", val);
+    g_variant_builder_add(&blueBuilder, "q", val);
+  }
+
+  TraceSpan span("dbus", "SetCrtcGamma");
+  span.Detail("%s gamma=%.3f", output.name.c_str(), clamped);
+  g_autoptr(GVariant) result = g_dbus_connection_call_sync(
+      bus, "org.gnome.Shell",
+      "/org/gnome/Mutter/DisplayConfig",
+      "org.gnome.Mutter.DisplayConfig",
+      "SetCrtcGamma",
+      g_variant_new("(uu@aq@aq@aq)",
+                     output.serial,
+                     static_cast<guint32>(output.crtcId),
+                     g_variant_builder_end(&redBuilder),
+                     g_variant_builder_end(&greenBuilder),
+                     g_variant_builder_end(&blueBuilder)),
+      nullptr, G_DBUS_CALL_FLAGS_NONE, 5000, nullptr, &error);
+
+  if (!result) {
+    fprintf(stderr, "[BSDisplayControl] SetCrtcGamma failed for %s: %s\n",
+            output.name.c_str(), error ? error->message : "unknown");
+    return false;
+  }
+  return true;
+}
+
+// Set gamma via xrandr (X11 fallback).  Blocking; for worker threads.
+static bool SetSoftwareBrightnessX11(const std::string& outputName, double factor) {
+  return RunProcess(XrandrBrightnessArgs(outputName, factor, 4),
+                    XrandrSpawnOptions(outputName)).status == SpawnStatus::kOk;
+}
+
+// Find the output name for a given display ID (used for both Wayland and X11).
+// "wayland:NAME" names a compositor output with no DRM connector of its own,
+// e.g. a headless sway output.
+static std::string FindOutputName(const char* displayId) {
+  if (g_str_has_prefix(displayId, "wayland:")) return displayId + strlen("wayland:");
+  RegistryView registry;
+  if (strcmp(displayId, "backlight") == 0) {
+    if (const DrmDisplay* panel = registry->BuiltIn()) return panel->xrandrName;
+    return "eDP-1";  // The usual name of a laptop panel.
+  }
+
+  // DRM display: extract xrandr/output name from cached DrmDisplay.
+  const DrmDisplay* disp = registry->FindDrm(displayId);
+  return disp ? disp->xrandrName : "";
+}
+
+// DRM connector (e.g. "card1-DP-1") for a display ID, for the KMS backend.
+static std::string FindDrmConnector(const char* displayId) {
+  RegistryView registry;
+  const DrmDisplay* disp = strcmp(displayId, "backlight") == 0 ? registry->BuiltIn()
+                                                               : registry->FindDrm(displayId);
+  return disp ? disp->connector : "";
+}
+
+// wl_output name for a display ID: the DRM connector without its card
+// prefix ("card1-HDMI-A-1" -> "HDMI-A-1"), as wlroots names outputs.
+static std::string FindWaylandOutputName(const char* displayId) {
+  if (g_str_has_prefix(displayId, "wayland:")) return displayId + strlen("wayland:");
+  std::string connector = FindDrmConnector(displayId);
+  auto dash = connector.find('-');
+  return dash == std::string::npos ? "" : connector.substr(dash + 1);
+}
+
+// Copy the Mutter output for |outputName| into |out|, re-querying once in
+// case monitors changed.  Returns false if Mutter does not know it.  Main
+// thread.
+static bool FindMutterOutput(const std::string& outputName, MutterOutputInfo& out) {
+  QueryMutterResources();
+  if (const MutterOutputInfo* found = CurrentRegistry().FindMutterOutput(outputName)) {
+    out = *found;
+    return true;
+  }
+
+  // Output not found — re-query in case monitors changed.
+  PublishMutterOutputs(false, {});
+  QueryMutterResources();
+  if (const MutterOutputInfo* found = CurrentRegistry().FindMutterOutput(outputName)) {
+    out = *found;
+    return true;
+  }
+
+  fprintf(stderr, "[BSDisplayControl] Mutter output '%s' not found\n",
+          outputName.c_str());
+  return false;
+}
+
+// Gamma is compared at the resolution of a 16-bit LUT entry.
+static int GammaLevel(double gamma) {
+  return static_cast<int>(std::lround(std::clamp(gamma, 0.0, 1.0) * 65535.0));
+}
+
+// Last gamma successfully applied to |displayId|; 1.0 (normal) if unknown.
+static double AppliedGamma(const std::string& displayId) {
+  int level = AppliedLevel(displayId, WriteBackend::kGamma);
+  return level < 0 ? 1.0 : level / 65535.0;
+}
+
+// Whether this process has applied gamma to |displayId|.  Until it has,
+// the ramp is unknown: a previous run may have left it dimmed.
+static bool AppliedGammaKnown(const std::string& displayId) {
+  return AppliedLevel(displayId, WriteBackend::kGamma) >= 0;
+}
+
+static void RecordAppliedGamma(const std::string& displayId, double gamma) {
+  RecordApplied(displayId, WriteBackend::kGamma, GammaLevel(gamma));
+}
+
+// Set software brightness for a display.
+// Dispatches to KMS (no compositor), wlr-gamma-control (wlroots), Mutter
+// D-Bus (other Wayland) or xrandr (X11) based on session type.
+// On X11 xrandr runs asynchronously: the return value only says it was
+// started, and |done| (if given) gets the outcome on the main loop; a newer
+// call for the same output supersedes an older one still in flight.  In
+// every other case |done| runs before returning.
+static bool SetSoftwareBrightness(const char* displayId, double gamma,
+                                  std::function<void(bool)> done = nullptr) {
+  std::string outputName = FindOutputName(displayId);
+  bool ok = false;
+  if (outputName.empty()) {
+    ok = false;
+  } else if (AppliedMatches(displayId, WriteBackend::kGamma, GammaLevel(gamma))) {
+    ok = true;
+  } else if (UseKmsGamma()) {
+    std::string connector = FindDrmConnector(displayId);
+    ok = !connector.empty() &&
+         TimeBackendCall(displayId, StatsBackend::kKms, false,
+                         [&] { return SetSoftwareBrightnessKms(connector, gamma); });
+    if (ok) RecordAppliedGamma(displayId, std::clamp(gamma, 0.0, 1.0));
+  } else if (IsWayland() && WlrGammaAvailable()) {
+    std::string wlName = FindWaylandOutputName(displayId);
+    ok = TimeBackendCall(displayId, StatsBackend::kWlr, false,
+                         [&] { return SetSoftwareBrightnessWlr(wlName, gamma); });
+    if (ok) RecordAppliedGamma(displayId, std::clamp(gamma, 0.0, 1.0));
+  } else if ((g_isWayland = IsWayland())) {
+    // Wayland: use Mutter D-Bus.
+    MutterOutputInfo out;
+    ok = FindMutterOutput(outputName, out) &&
+         TimeBackendCall(displayId, StatsBackend::kMutter, false,
+                         [&] { return SetSoftwareBrightnessWayland(out, gamma); });
+    if (ok) RecordAppliedGamma(displayId, std::clamp(gamma, 0.0, 1.0));
+  } else {
+    // X11: use xrandr.
+    std::string id(displayId);
+    double clamped = std::clamp(gamma, 0.0, 1.0);
+    gint64 start = g_get_monotonic_time();
+    bool started = SpawnAsync(XrandrBrightnessArgs(outputName, gamma, 4),
+                              XrandrSpawnOptions(outputName),
+                              [id, clamped, start, done](const SpawnResult& result) {
+      RecordSpawnCall(id, StatsBackend::kXrandr, start, result.status, false);
+      bool applied = result.status == SpawnStatus::kOk;
+      if (applied) RecordAppliedGamma(id, clamped);
+      if (done) done(applied);
+    });
+    if (started) return true;
+  }
+  if (done) done(ok);
+  return ok;
+}
+
+// ── Brightness change feed ─────────────────────────────────────────
+//
+// The last known unified value (-0.5 to 1.0) of every display, updated by
+// each successful set and by getDisplays.  Listeners (the control socket's
+// subscribers) hear about every change.  Main thread only.
+
+using BrightnessListener = std::function<void(const std::string& displayId, double value)>;
+
+static std::map<std::string, double> g_knownBrightness;
+static std::vector<BrightnessListener> g_brightnessListeners;
+
+static void NoteBrightness(const std::string& displayId, double value) {
+  auto [it, inserted] = g_knownBrightness.emplace(displayId, value);
+  if (!inserted && std::fabs(it->second - value) < 1e-6) return;
+  it->second = value;
+  for (const auto& listener : g_brightnessListeners) listener(displayId, value);
+}
+
+// Seed the feed from a ListDisplays() result.  A hardware reading of 0
+// does not override a known negative (gamma-dimmed) value.
+static void NoteListedBrightness(FlValue* list) {
+  for (size_t i = 0; i < fl_value_get_length(list); i++) {
+    FlValue* display = fl_value_get_list_value(list, i);
+    FlValue* idVal = fl_value_lookup_string(display, "id");
+    FlValue* brVal = fl_value_lookup_string(display, "brightness");
+    if (!idVal || !brVal) continue;
+    std::string id = fl_value_get_string(idVal);
+    double brightness = fl_value_get_float(brVal);
+    auto known = g_knownBrightness.find(id);
+    if (known != g_knownBrightness.end() && known->second < 0.0 && brightness <= 0.0) continue;
+    NoteBrightness(id, brightness);
+  }
+}
+
+// ── Brightness transitions ─────────────────────────────────────────
+//
+// A fade runs natively on one GLib timeout that drives every active
+// transition, so Dart sends a single transitionBrightness call per fade.
+//
+// DDC/CI displays only take integer levels and need kDdcCommandGapUs
+// between writes, so the hardware level is moved in whole steps, never
+// faster than the monitor accepts, and only when the level changes.  In
+// between, the gamma ramp trims the output down to the exact intermediate
+// value (hardware is kept at ceil(value) and gamma = value / hardware).
+// At the end the hardware holds the target and gamma is restored to 1.0.
+//
+// Displays without working DDC/CI fade through gamma alone, then restore
+// gamma and finish with the normal SetDisplayBrightnessAsync cascade.  A
+// cancelled fade restores gamma too, unless a new fade takes over from
+// it.  The backlight has fine sysfs steps, so it is written directly
+// whenever its integer level changes.
+
+enum class TransitionCurve { kLinear, kEaseIn, kEaseOut, kEaseInOut };
+
+static const guint kTransitionTickMs = 16;
+// Smallest gamma change worth uploading (one 8-bit output step).
+static const double kTransitionGammaEpsilon = 1.0 / 256.0;
+// xrandr spawns a process per call, so X11 gamma updates are throttled.
+static const gint64 kTransitionXrandrIntervalUs = 100000;
+
+struct BrightnessTransition {
+  std::string displayId;
+  bool isBacklight;
+  DrmDisplay disp;              // Copy; the registry may be replaced mid-fade.
+  std::string backlightPath;
+  int backlightMax;
+  double from;
+  double to;
+  double current;               // Value at the last tick.
+  gint64 startUs;
+  gint64 durationUs;
+  TransitionCurve curve;
+  int ddcBus;                   // Bus that accepted a write, -1 if none yet.
+  bool ddcFailed;               // No bus accepts writes: gamma-only fade.
+  int lastLevel;                // Last hardware level written, -1 if none.
+  gint64 lastLevelUs;
+  bool useGamma;
+  double lastGamma;
+  gint64 lastGammaUs;
+  FlMethodCall* call;           // Responded to when the fade ends.
+};
+
+static std::map<std::string, BrightnessTransition> g_transitions;
+static guint g_transitionSource = 0;
+
+static TransitionCurve TransitionCurveFromName(const char* name) {
+  if (!name) return TransitionCurve::kLinear;
+  if (strcmp(name, "easeIn") == 0) return TransitionCurve::kEaseIn;
+  if (strcmp(name, "easeOut") == 0) return TransitionCurve::kEaseOut;
+  if (strcmp(name, "easeInOut") == 0) return TransitionCurve::kEaseInOut;
+  return TransitionCurve::kLinear;
+}
+
+static double ApplyTransitionCurve(TransitionCurve curve, double t) {
+  switch (curve) {
+    case TransitionCurve::kEaseIn: return t * t;
+    case TransitionCurve::kEaseOut: return 1.0 - (1.0 - t) * (1.0 - t);
+    case TransitionCurve::kEaseInOut: return t * t * (3.0 - 2.0 * t);
+    case TransitionCurve::kLinear: break;
+  }
+  return t;
+}
+
+static void FinishTransition(BrightnessTransition& tr, bool success) {
+  if (success) NoteBrightness(tr.displayId, tr.to);
+  if (tr.call) {
+    g_autoptr(FlValue) result = fl_value_new_bool(success);
+    fl_method_call_respond_success(tr.call, result, nullptr);
+    g_object_unref(tr.call);
+    tr.call = nullptr;
+  }
+}
+
+// Write DDC level |level|, remembering which bus works.
+static bool TransitionWriteDdc(BrightnessTransition& tr, int level) {
+  // A failure hands the fade over to gamma, so it counts as a fallback.
+  auto write = [&](int bus) {
+    return TimeBackendCall(tr.displayId, StatsBackend::kDdc, true,
+                           [&] { return DdcSetBrightness(bus, level); });
+  };
+  bool ok = false;
+  if (tr.ddcBus >= 0) {
+    ok = write(tr.ddcBus);
+  } else if (DdcFeatureSupport(tr.disp, VCP_BRIGHTNESS) != DdcSupport::kUnsupported) {
+    for (int bus : DdcBusesFor(tr.disp)) {
+      if (write(bus)) {
+        tr.ddcBus = bus;
+        ok = true;
+        break;
+      }
+    }
+  }
+  if (ok) RecordApplied(tr.displayId, WriteBackend::kDdc, level);
+  return ok;
+}
+
+static void TransitionWriteGamma(BrightnessTransition& tr, double gamma, gint64 now, bool force) {
+  if (!tr.useGamma) return;
+  if (!force) {
+    if (std::fabs(gamma - tr.lastGamma) < kTransitionGammaEpsilon) return;
+    if (!IsWayland() && !UseKmsGamma() && now - tr.lastGammaUs < kTransitionXrandrIntervalUs)
+      return;
+  } else if (gamma == tr.lastGamma) {
+    return;
+  }
+  if (SetSoftwareBrightness(tr.displayId.c_str(), gamma)) {
+    tr.lastGamma = gamma;
+    tr.lastGammaUs = now;
+  } else {
+    tr.useGamma = false;
+  }
+}
+
+// Stop any fade on |displayId| (e.g. because a direct set arrived).  The
+// gamma trim goes back to 1.0 unless |restoreGamma| is false, for a new
+// fade that continues from what the display shows.
+static void CancelTransition(const std::string& displayId, bool restoreGamma = true) {
+  auto it = g_transitions.find(displayId);
+  if (it == g_transitions.end()) return;
+  if (restoreGamma) TransitionWriteGamma(it->second, 1.0, g_get_monotonic_time(), true);
+  FinishTransition(it->second, false);
+  g_transitions.erase(it);
+}
+
+// Advance one transition.  Returns true when it has finished.
+static bool StepTransition(BrightnessTransition& tr, gint64 now) {
+  double t = tr.durationUs > 0
+                 ? std::clamp(static_cast<double>(now - tr.startUs) /
+                                  static_cast<double>(tr.durationUs), 0.0, 1.0)
+                 : 1.0;
+  bool done = t >= 1.0;
+  double v = done ? tr.to : tr.from + (tr.to - tr.from) * ApplyTransitionCurve(tr.curve, t);
+  tr.current = v;
+
+  if (tr.isBacklight) {
+    int level = static_cast<int>(v * tr.backlightMax);
+    if (level < 1 && v > 0.0) level = 1;
+    if (level != tr.lastLevel) {
+      if (!SetBacklightBrightness(tr.backlightPath, v)) {
+        FinishTransition(tr, false);
+        return true;
+      }
+      tr.lastLevel = level;
+    }
+    if (done) FinishTransition(tr, true);
+    return done;
+  }
+
+  if (!tr.ddcFailed) {
+    // Keep hardware at or above the value so gamma only ever trims down.
+    // The final level uses the same rounding as SetDisplayBrightness.
+    int level = done ? static_cast<int>(v * 100)
+                     : static_cast<int>(std::ceil(v * 100.0 - 1e-9));
+    bool gapElapsed = now - tr.lastLevelUs >= kDdcCommandGapUs;
+    if (level != tr.lastLevel && (done || gapElapsed)) {
+      if (TransitionWriteDdc(tr, level)) {
+        tr.lastLevel = level;
+        tr.lastLevelUs = now;
+      } else {
+        tr.ddcFailed = true;
+      }
+    }
+  }
+
+  if (tr.ddcFailed) {
+    // Gamma carries the whole fade; the cascade sets the final value.
+    if (!done) {
+      TransitionWriteGamma(tr, v, now, false);
+      return false;
+    }
+    // Restored first: on X11 the cascade's xrandr call supersedes it.
+    TransitionWriteGamma(tr, 1.0, now, true);
+    FlMethodCall* call = tr.call;
+    tr.call = nullptr;
+    SetDisplayBrightnessAsync(tr.disp, tr.to, [call](bool ok) {
+      if (!call) return;
+      g_autoptr(FlValue) result = fl_value_new_bool(ok);
+      fl_method_call_respond_success(call, result, nullptr);
+      g_object_unref(call);
+    });
+    return true;
+  }
+
+  if (done) {
+    TransitionWriteGamma(tr, 1.0, now, true);
+    FinishTransition(tr, true);
+    return true;
+  }
+
+  double hw = tr.lastLevel > 0 ? tr.lastLevel / 100.0 : 0.0;
+  double gamma = hw > 0.0 ? std::clamp(v / hw, 0.0, 1.0) : 1.0;
+  TransitionWriteGamma(tr, gamma, now, false);
+  return false;
+}
+
+static gboolean TransitionTick(gpointer user_data) {
+  gint64 now = g_get_monotonic_time();
+  for (auto it = g_transitions.begin(); it != g_transitions.end();) {
+    if (StepTransition(it->second, now)) {
+      it = g_transitions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (g_transitions.empty()) {
+    g_transitionSource = 0;
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Start a fade.  |from| < 0 means "current value": taken from a running
+// fade on the same display, else read from the hardware once.  Takes a
+// reference on |call| and responds to it when the fade ends (false if it
+// was cancelled or the hardware rejected it).
+static bool StartTransition(const char* displayId, double target, double from,
+                            gint64 durationMs, TransitionCurve curve,
+                            FlMethodCall* call) {
+  BrightnessTransition tr = {};
+  tr.displayId = displayId;
+  tr.isBacklight = strcmp(displayId, "backlight") == 0;
+  tr.to = std::clamp(target, 0.0, 1.0);
+  tr.curve = curve;
+  tr.ddcBus = -1;
+  tr.lastLevel = -1;
+  // Unknown gamma counts as trimmed, so the end of the fade resets it.
+  tr.lastGamma = AppliedGammaKnown(tr.displayId) ? AppliedGamma(tr.displayId) : -1.0;
+  tr.useGamma = !tr.isBacklight;
+
+  if (tr.isBacklight) {
+    tr.backlightPath = FindBacklightPath();
+    if (tr.backlightPath.empty()) return false;
+    std::ifstream maxFile(tr.backlightPath + "/max_brightness");
+    maxFile >> tr.backlightMax;
+    if (tr.backlightMax <= 0) return false;
+  } else {
+    RegistryView registry;
+    const DrmDisplay* disp = registry->FindDrm(tr.displayId);
+    if (!disp) return false;
+    tr.disp = *disp;
+  }
+
+  auto running = g_transitions.find(tr.displayId);
+  if (from < 0.0) {
+    if (running != g_transitions.end()) {
+      from = running->second.current;
+    } else if (tr.isBacklight) {
+      from = GetBacklightBrightness(tr.backlightPath);
+    } else {
+      from = GetDisplayBrightness(tr.disp);
+    }
+  }
+  if (running != g_transitions.end()) {
+    // Carry over what the display is showing right now.
+    tr.lastGamma = running->second.lastGamma;
+    tr.ddcBus = running->second.ddcBus;
+    CancelTransition(tr.displayId, false);
+  }
+
+  tr.from = std::clamp(from, 0.0, 1.0);
+  tr.current = tr.from;
+  tr.startUs = g_get_monotonic_time();
+  tr.durationUs = std::max<gint64>(durationMs, 0) * 1000;
+  tr.call = call ? FL_METHOD_CALL(g_object_ref(call)) : nullptr;
+
+  std::string key = tr.displayId;
+  auto& stored = g_transitions[key] = std::move(tr);
+  if (StepTransition(stored, stored.startUs)) {
+    g_transitions.erase(key);
+    return true;
+  }
+  if (g_transitionSource == 0) {
+    g_transitionSource = g_timeout_add(kTransitionTickMs, TransitionTick, nullptr);
+  }
+  return true;
+}
+
+// ── Effective brightness ───────────────────────────────────────────
+//
+// The UI exposes one slider from -0.5 to 1.0:
+//   [0.0, 1.0]   hardware brightness = value, gamma = 1.0
+//   [-0.5, 0.0)  hardware brightness = 0, gamma = 1.0 + 2 * value
+// SetEffectiveBrightness does the split natively.  The gamma path is only
+// touched while in the software range or when leaving it (to restore 1.0),
+// so ordinary hardware-range changes cost no D-Bus/xrandr call.  The first
+// set of a display also writes 1.0, since the ramp left by an earlier run
+// is not known.
+
+static const double kMinEffectiveBrightness = -0.5;
+
+static void DecomposeEffectiveBrightness(double value, double& outHardware, double& outGamma) {
+  value = std::clamp(value, kMinEffectiveBrightness, 1.0);
+  if (value >= 0.0) {
+    outHardware = value;
+    outGamma = 1.0;
+  } else {
+    outHardware = 0.0;
+    outGamma = 1.0 + value * 2.0;
+  }
+}
+
+// Joins the hardware and gamma halves: |done| gets the AND of both once
+// the later one completes.
+struct EffectiveBrightnessJoin {
+  int pending = 1;
+  bool ok = true;
+  std::function<void(bool)> done;
+};
+
+static void ResolveEffectiveBrightnessPart(const std::shared_ptr<EffectiveBrightnessJoin>& join,
+                                           bool ok) {
+  join->ok = join->ok && ok;
+  if (--join->pending == 0) join->done(join->ok);
+}
+
+static void SetEffectiveBrightness(const char* displayId, double value,
+                                   std::function<void(bool)> done) {
+  double hardware = 1.0, gamma = 1.0;
+  DecomposeEffectiveBrightness(value, hardware, gamma);
+  CancelTransition(displayId);
+
+  auto join = std::make_shared<EffectiveBrightnessJoin>();
+  join->done = [id = std::string(displayId), value = std::clamp(value, kMinEffectiveBrightness, 1.0),
+                done = std::move(done)](bool ok) {
+    if (ok) NoteBrightness(id, value);
+    if (done) done(ok);
+  };
+  auto part = [join](bool ok) { ResolveEffectiveBrightnessPart(join, ok); };
+
+  // Read before the hardware write can change it.
+  double previousGamma = AppliedGamma(displayId);
+  bool gammaKnown = AppliedGammaKnown(displayId);
+  bool found = false;
+  if (strcmp(displayId, "backlight") == 0) {
+    std::string backlightPath = FindBacklightPath();
+    if (!backlightPath.empty()) {
+      found = true;
+      join->pending++;
+      part(SetBacklightBrightness(backlightPath, hardware));
+    }
+  } else {
+    RegistryView registry;
+    if (const DrmDisplay* disp = registry->FindDrm(displayId)) {
+      found = true;
+      join->pending++;
+      SetDisplayBrightnessAsync(*disp, hardware, part);
+    }
+  }
+  if (!found) join->ok = false;
+
+  if (!gammaKnown || (gamma != previousGamma && (gamma < 1.0 || previousGamma < 1.0))) {
+    join->pending++;
+    SetSoftwareBrightness(displayId, gamma, part);
+  }
+  part(true);
+}
+
+// ── Ambient light auto-brightness ──────────────────────────────────
+//
+// Follows an ambient light sensor (ALS) under /sys/bus/iio/devices.  The
+// illuminance channel is read through the sensor's IIO buffer: its scan
+// element is enabled in sysfs, the buffer is switched on, and the
+// character device /dev/iio:deviceN is watched with g_unix_fd_add.  The
+// process wakes only when the sensor pushes a sample; sysfs is read once,
+// to seed the first value.
+//
+// Each sample is converted to lux ((raw + offset) * scale) and smoothed
+// with an exponential moving average in log space.  The weight of a
+// sample grows with the time since the previous one, so a sensor that
+// reports only on change moves straight to a new level after a quiet
+// spell, while a fast, noisy one is averaged.  The displays are only
+// retargeted when the smoothed level leaves the hysteresis band around the
+// level they were last set for.  Each display maps lux to brightness
+// through its own response curve (piecewise linear in log lux), plus an
+// offset learned from manual changes made while auto-brightness is on,
+// and fades there with the transition engine, so the backlight and DDC/CI
+// are written through their usual paths.
+//
+// For testing, BS_DISPLAY_CONTROL_IIO_ROOT replaces /sys/bus/iio/devices
+// and BS_DISPLAY_CONTROL_IIO_DEV replaces /dev: a directory tree with the
+// same attribute files and a FIFO named iio:device0 stand in for the
+// hardware.  Main thread only.
+
+static const char* const kIioDefaultRoot = "/sys/bus/iio/devices";
+static const char* const kIioDefaultDevDir = "/dev";
+static const double kAmbientSmoothingSeconds = 2.0;
+// Retarget when the smoothed level is this far from the last target's,
+// as a ratio of (lux + 1).  Darkening waits longer to avoid flicker from
+// passing shadows.
+static const double kAmbientBrightenRatio = 1.2;
+static const double kAmbientDarkenRatio = 0.75;
+static const double kAmbientMinStep = 0.02;      // Smallest brightness change applied.
+static const double kAmbientMaxOffset = 0.5;     // Bound on the learned offset.
+static const double kAmbientEchoEpsilon = 0.01;  // Own fades, as read back by getDisplays.
+static const gint64 kAmbientFadeMs = 1500;
+
+struct AmbientDisplay {
+  std::vector<AmbientCurvePoint> curve;  // Empty: kDefaultAmbientCurve.
+  double offset = 0.0;                   // Learned from manual changes.
+  double target = -1.0;                  // Last value faded to, -1 if none.
+};
+
+struct AmbientLight {
+  bool enabled = false;
+  bool listening = false;            // Brightness listener registered.
+  std::vector<std::string> only;     // Managed displays; empty: all known.
+  std::map<std::string, AmbientDisplay> displays;
+
+  std::string device;                // e.g., "iio:device0".
+  std::string sensorName;            // The device's "name" attribute.
+  int dirFd = -1;
+  int fd = -1;
+  guint source = 0;
+  bool bufferEnabled = false;        // We switched buffer/enable on.
+  IioScanElement illuminance;
+  size_t recordBytes = 0;
+  double scale = 1.0;
+  double rawOffset = 0.0;
+  std::string partial;               // Bytes of an incomplete record.
+  std::string error;                 // Why the sensor could not be used.
+
+  double lux = -1.0;                 // Smoothed; -1 before the first sample.
+  double anchorLux = -1.0;           // Level the displays were last set for.
+  gint64 lastSampleUs = 0;
+  uint64_t samples = 0;
+};
+
+static AmbientLight g_ambient;
+
+static std::string IioRoot() {
+  const char* env = getenv("BS_DISPLAY_CONTROL_IIO_ROOT");
+  return env && *env ? env : kIioDefaultRoot;
+}
+
+static std::string IioDevDir() {
+  const char* env = getenv("BS_DISPLAY_CONTROL_IIO_DEV");
+  return env && *env ? env : kIioDefaultDevDir;
+}
+
+// Write a sysfs attribute relative to |dirFd|.  O_TRUNC is a no-op on
+// sysfs but lets a fake tree of plain files behave the same.
+static bool WriteSysfsAt(int dirFd, const char* name, const char* value) {
+  int fd = openat(dirFd, name, O_WRONLY | O_TRUNC | O_CLOEXEC);
+  if (fd < 0) return false;
+  size_t len = strlen(value);
+  bool ok = write(fd, value, len) == static_cast<ssize_t>(len);
+  close(fd);
+  return ok;
+}
+
+static bool ReadSysfsDoubleAt(int dirFd, const char* name, double& out) {
+  char buf[64];
+  if (ReadSysfsAt(dirFd, name, buf, sizeof(buf)) <= 0) return false;
+  char* end = nullptr;
+  double value = strtod(buf, &end);
+  if (end == buf || !std::isfinite(value)) return false;
+  out = value;
+  return true;
+}
+
+// Read the enabled scan elements of |deviceDir| and lay out a record (see
+// ComputeIioRecordLayout).  Fills g_ambient.illuminance and recordBytes.
+static bool ReadIioRecordLayout(const std::string& deviceDir) {
+  std::string scanDir = deviceDir + "/scan_elements";
+  int scanFd = open(scanDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (scanFd < 0) return false;
+  std::vector<std::pair<std::string, IioScanElement>> elements;
+  bool parsed = true;
+  alignas(8) char dents[4096];
+  ForEachDirent(scanFd, dents, sizeof(dents), [&](const char* entry) {
+    size_t len = strlen(entry);
+    if (len <= 3 || strcmp(entry + len - 3, "_en") != 0) return true;
+    char buf[64];
+    if (ReadSysfsAt(scanFd, entry, buf, sizeof(buf)) <= 0 || strcmp(buf, "1") != 0)
+      return true;
+    std::string channel(entry, len - 3);
+    IioScanElement el;
+    if (ReadSysfsAt(scanFd, (channel + "_index").c_str(), buf, sizeof(buf)) <= 0) return true;
+    el.index = atoi(buf);
+    if (ReadSysfsAt(scanFd, (channel + "_type").c_str(), buf, sizeof(buf)) <= 0 ||
+        !ParseIioScanType(buf, el)) {
+      fprintf(stderr, "[BSDisplayControl] IIO: cannot parse scan type of %s\n", channel.c_str());
+      parsed = false;
+      return false;
+    }
+    elements.emplace_back(std::move(channel), el);
+    return true;
+  });
+  close(scanFd);
+  if (!parsed) return false;
+
+  g_ambient.recordBytes = ComputeIioRecordLayout(elements);
+  bool found = false;
+  for (const auto& [channel, el] : elements) {
+    if (channel == "in_illuminance") {
+      g_ambient.illuminance = el;
+      found = true;
+    }
+  }
+  return found && g_ambient.recordBytes > 0;
+}
+
+static void RetargetAmbientDisplays() {
+  std::vector<std::string> ids = g_ambient.only;
+  if (ids.empty()) {
+    for (const auto& [id, value] : g_knownBrightness) ids.push_back(id);
+  }
+  for (const std::string& id : ids) {
+    AmbientDisplay& d = g_ambient.displays[id];
+    double target =
+        std::clamp(EvaluateAmbientCurve(d.curve, g_ambient.lux) + d.offset, 0.0, 1.0);
+    if (d.target >= 0.0 && std::fabs(target - d.target) < kAmbientMinStep) continue;
+
+    // Start from the known value instead of reading the hardware back.
+    double from = -1.0;
+    auto known = g_knownBrightness.find(id);
+    if (g_transitions.find(id) == g_transitions.end() && known != g_knownBrightness.end() &&
+        known->second >= 0.0) {
+      from = known->second;
+    }
+    d.target = target;
+    if (!StartTransition(id.c_str(), target, from, kAmbientFadeMs, TransitionCurve::kEaseInOut,
+                         nullptr)) {
+      fprintf(stderr, "[BSDisplayControl] Auto-brightness: cannot fade %s\n", id.c_str());
+    }
+  }
+}
+
+static void OnAmbientSample(double lux) {
+  if (!std::isfinite(lux)) return;
+  lux = std::max(lux, 0.0);
+  gint64 now = g_get_monotonic_time();
+  g_ambient.samples++;
+  if (g_ambient.lux < 0.0) {
+    g_ambient.lux = lux;
+  } else {
+    double dt = static_cast<double>(now - g_ambient.lastSampleUs) / G_USEC_PER_SEC;
+    double alpha = 1.0 - std::exp(-dt / kAmbientSmoothingSeconds);
+    double smoothed = std::log1p(g_ambient.lux);
+    smoothed += alpha * (std::log1p(lux) - smoothed);
+    g_ambient.lux = std::expm1(smoothed);
+  }
+  g_ambient.lastSampleUs = now;
+
+  if (g_ambient.anchorLux >= 0.0) {
+    double ratio = (g_ambient.lux + 1.0) / (g_ambient.anchorLux + 1.0);
+    if (ratio < kAmbientBrightenRatio && ratio > kAmbientDarkenRatio) return;
+  }
+  g_ambient.anchorLux = g_ambient.lux;
+  RetargetAmbientDisplays();
+}
+
+// A manual change to a managed display becomes an offset on its curve, so
+// later retargets keep the user's preference.  The end of our own fade
+// reports exactly the target and is ignored.
+static void OnAmbientBrightnessNoted(const std::string& displayId, double value) {
+  if (!g_ambient.enabled || g_ambient.lux < 0.0) return;
+  auto it = g_ambient.displays.find(displayId);
+  if (it == g_ambient.displays.end() || it->second.target < 0.0) return;
+  if (g_transitions.find(displayId) != g_transitions.end()) return;
+  AmbientDisplay& d = it->second;
+  value = std::max(value, 0.0);
+  if (std::fabs(value - d.target) < kAmbientEchoEpsilon) return;
+  d.offset = std::clamp(value - EvaluateAmbientCurve(d.curve, g_ambient.lux),
+                        -kAmbientMaxOffset, kAmbientMaxOffset);
+  d.target = value;
+}
+
+static void CloseIioBuffer() {
+  if (g_ambient.source) g_source_remove(g_ambient.source);
+  g_ambient.source = 0;
+  CloseFd(g_ambient.fd);
+  if (g_ambient.bufferEnabled) WriteSysfsAt(g_ambient.dirFd, "buffer/enable", "0");
+  g_ambient.bufferEnabled = false;
+  CloseFd(g_ambient.dirFd);
+  g_ambient.partial.clear();
+}
+
+static void StopAmbientLight() {
+  g_ambient.enabled = false;
+  CloseIioBuffer();
+}
+
+static gboolean OnIioReadable(gint fd, GIOCondition condition, gpointer user_data) {
+  char buf[4096];
+  bool closed = false;
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n > 0) {
+      g_ambient.partial.append(buf, static_cast<size_t>(n));
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) break;
+    // EOF (the sensor went away, or a test FIFO's writer closed) or error.
+    closed = true;
+    break;
+  }
+
+  // Records that arrived together carry the same moment; only the newest
+  // counts.  Decoded before a close is handled, so the last sample a
+  // sensor pushed before going away is not lost.
+  size_t records = g_ambient.partial.size() / g_ambient.recordBytes;
+  if (records > 0) {
+    const auto* last = reinterpret_cast<const uint8_t*>(g_ambient.partial.data()) +
+                       (records - 1) * g_ambient.recordBytes;
+    double raw = IioSampleValue(g_ambient.illuminance, last);
+    g_ambient.partial.erase(0, records * g_ambient.recordBytes);
+    OnAmbientSample((raw + g_ambient.rawOffset) * g_ambient.scale);
+  }
+  if (!closed) return G_SOURCE_CONTINUE;
+
+  fprintf(stderr, "[BSDisplayControl] Auto-brightness: sensor %s closed\n",
+          g_ambient.device.c_str());
+  g_ambient.error = "sensor closed";
+  g_ambient.source = 0;
+  StopAmbientLight();
+  return G_SOURCE_REMOVE;
+}
+
+// The first iio:deviceN (in name order) with a buffered illuminance
+// channel, or "".
+static std::string FindIioLightSensor() {
+  int rootFd = open(IioRoot().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (rootFd < 0) return "";
+  std::vector<std::string> devices;
+  alignas(8) char dents[4096];
+  ForEachDirent(rootFd, dents, sizeof(dents), [&](const char* name) {
+    if (strncmp(name, "iio:device", 10) != 0) return true;
+    std::string enable = std::string(name) + "/scan_elements/in_illuminance_en";
+    if (faccessat(rootFd, enable.c_str(), F_OK, 0) == 0) devices.emplace_back(name);
+    return true;
+  });
+  close(rootFd);
+  if (devices.empty()) return "";
+  return *std::min_element(devices.begin(), devices.end());
+}
+
+// Point the device at its own data-ready trigger ("<name>-dev<N>") when
+// none is set.  Sensors that need no trigger lack the attribute.
+static void SelectIioTrigger(int dirFd) {
+  char current[64];
+  if (ReadSysfsAt(dirFd, "trigger/current_trigger", current, sizeof(current)) != 0) return;
+  std::string wanted =
+      g_ambient.sensorName + "-dev" + g_ambient.device.substr(strlen("iio:device"));
+  int rootFd = open(IioRoot().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (rootFd < 0) return;
+  alignas(8) char dents[4096];
+  ForEachDirent(rootFd, dents, sizeof(dents), [&](const char* entry) {
+    if (strncmp(entry, "trigger", 7) != 0) return true;
+    char name[64];
+    std::string namePath = std::string(entry) + "/name";
+    if (ReadSysfsAt(rootFd, namePath.c_str(), name, sizeof(name)) <= 0 || wanted != name)
+      return true;
+    WriteSysfsAt(dirFd, "trigger/current_trigger", wanted.c_str());
+    return false;
+  });
+  close(rootFd);
+}
+
+static bool OpenIioBuffer() {
+  g_ambient.error.clear();
+  g_ambient.device = FindIioLightSensor();
+  if (g_ambient.device.empty()) {
+    g_ambient.error = "no sensor";
+    return false;
+  }
+  std::string dir = IioRoot() + "/" + g_ambient.device;
+  g_ambient.dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (g_ambient.dirFd < 0) {
+    g_ambient.error = "no sensor";
+    return false;
+  }
+  char buf[64];
+  g_ambient.sensorName = ReadSysfsAt(g_ambient.dirFd, "name", buf, sizeof(buf)) > 0 ? buf : "";
+  g_ambient.scale = 1.0;
+  g_ambient.rawOffset = 0.0;
+  ReadSysfsDoubleAt(g_ambient.dirFd, "in_illuminance_scale", g_ambient.scale);
+  ReadSysfsDoubleAt(g_ambient.dirFd, "in_illuminance_offset", g_ambient.rawOffset);
+
+  // The scan layout can only change while the buffer is off, and a
+  // running buffer belongs to another reader (e.g., iio-sensor-proxy).
+  if (ReadSysfsAt(g_ambient.dirFd, "buffer/enable", buf, sizeof(buf)) > 0 &&
+      strcmp(buf, "0") != 0) {
+    g_ambient.error = "busy";
+  } else if (!WriteSysfsAt(g_ambient.dirFd, "scan_elements/in_illuminance_en", "1")) {
+    g_ambient.error = "permission";
+  } else if (!ReadIioRecordLayout(dir)) {
+    g_ambient.error = "unsupported";
+  } else {
+    std::string chardev = IioDevDir() + "/" + g_ambient.device;
+    // Opened before the buffer starts so no sample is missed; a FIFO opens
+    // without a writer this way.
+    g_ambient.fd = open(chardev.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (g_ambient.fd < 0) {
+      g_ambient.error = errno == EBUSY ? "busy" : "permission";
+    }
+  }
+  if (!g_ambient.error.empty()) {
+    fprintf(stderr, "[BSDisplayControl] Auto-brightness: %s unusable (%s)\n",
+            g_ambient.device.c_str(), g_ambient.error.c_str());
+    CloseIioBuffer();
+    return false;
+  }
+
+  if (ReadSysfsAt(g_ambient.dirFd, "buffer/length", buf, sizeof(buf)) > 0 &&
+      strcmp(buf, "0") == 0) {
+    WriteSysfsAt(g_ambient.dirFd, "buffer/length", "16");
+  }
+  SelectIioTrigger(g_ambient.dirFd);
+  if (!WriteSysfsAt(g_ambient.dirFd, "buffer/enable", "1")) {
+    g_ambient.error = "permission";
+    CloseIioBuffer();
+    return false;
+  }
+  g_ambient.bufferEnabled = true;
+  g_ambient.source = g_unix_fd_add(
+      g_ambient.fd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR), OnIioReadable,
+      nullptr);
+  fprintf(stderr, "[BSDisplayControl] Auto-brightness: %s (%s), %zu-byte records\n",
+          g_ambient.device.c_str(), g_ambient.sensorName.c_str(), g_ambient.recordBytes);
+  return true;
+}
+
+// Seed the filter from sysfs, since on-change sensors may stay silent
+// until the light changes.
+static void ReadInitialIlluminance() {
+  double value = 0.0;
+  if (ReadSysfsDoubleAt(g_ambient.dirFd, "in_illuminance_input", value)) {
+    OnAmbientSample(value);
+  } else if (ReadSysfsDoubleAt(g_ambient.dirFd, "in_illuminance_raw", value)) {
+    OnAmbientSample((value + g_ambient.rawOffset) * g_ambient.scale);
+  }
+}
+
+static bool StartAmbientLight() {
+  if (g_ambient.enabled) return true;
+  if (!OpenIioBuffer()) return false;
+  if (!g_ambient.listening) {
+    g_ambient.listening = true;
+    g_brightnessListeners.push_back(OnAmbientBrightnessNoted);
+  }
+  g_ambient.enabled = true;
+  g_ambient.lux = -1.0;
+  g_ambient.anchorLux = -1.0;
+  for (auto& [id, d] : g_ambient.displays) d.target = -1.0;
+  ReadInitialIlluminance();
+  return true;
+}
+
+// Parse [[lux, brightness], ...] with strictly increasing lux.
+static bool AmbientCurveFromFlValue(FlValue* value, std::vector<AmbientCurvePoint>& out) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_LIST || fl_value_get_length(value) == 0)
+    return false;
+  out.clear();
+  for (size_t i = 0; i < fl_value_get_length(value); i++) {
+    FlValue* point = fl_value_get_list_value(value, i);
+    if (fl_value_get_type(point) != FL_VALUE_TYPE_LIST || fl_value_get_length(point) != 2)
+      return false;
+    double coords[2];
+    for (size_t j = 0; j < 2; j++) {
+      FlValue* c = fl_value_get_list_value(point, j);
+      if (fl_value_get_type(c) == FL_VALUE_TYPE_FLOAT) {
+        coords[j] = fl_value_get_float(c);
+      } else if (fl_value_get_type(c) == FL_VALUE_TYPE_INT) {
+        coords[j] = static_cast<double>(fl_value_get_int(c));
+      } else {
+        return false;
+      }
+    }
+    if (!std::isfinite(coords[0]) || coords[0] < 0.0 || !std::isfinite(coords[1])) return false;
+    if (!out.empty() && coords[0] <= out.back().lux) return false;
+    out.push_back({coords[0], std::clamp(coords[1], 0.0, 1.0)});
+  }
+  return true;
+}
+
+// {available, enabled, sensor, lux, samples, error, displays: {id: {target, offset}}}.
+static FlValue* AmbientLightToFlValue() {
+  FlValue* result = fl_value_new_map();
+  bool available = g_ambient.enabled || !FindIioLightSensor().empty();
+  fl_value_set_string_take(result, "available", fl_value_new_bool(available));
+  fl_value_set_string_take(result, "enabled", fl_value_new_bool(g_ambient.enabled));
+  if (!g_ambient.sensorName.empty()) {
+    fl_value_set_string_take(result, "sensor", fl_value_new_string(g_ambient.sensorName.c_str()));
+  }
+  if (g_ambient.enabled && g_ambient.lux >= 0.0) {
+    fl_value_set_string_take(result, "lux", fl_value_new_float(g_ambient.lux));
+  }
+  fl_value_set_string_take(result, "samples",
+                           fl_value_new_int(static_cast<int64_t>(g_ambient.samples)));
+  if (!g_ambient.error.empty()) {
+    fl_value_set_string_take(result, "error", fl_value_new_string(g_ambient.error.c_str()));
+  }
+  FlValue* displays = fl_value_new_map();
+  for (const auto& [id, d] : g_ambient.displays) {
+    if (d.target < 0.0) continue;
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "target", fl_value_new_float(d.target));
+    fl_value_set_string_take(entry, "offset", fl_value_new_float(d.offset));
+    fl_value_set_string_take(displays, id.c_str(), entry);
+  }
+  fl_value_set_string_take(result, "displays", displays);
+  return result;
+}
+
+// ── Parallel batch set ─────────────────────────────────────────────
+//
+// setBrightnessBatch applies brightness (and optionally gamma) to several
+// displays at once.  Everything that touches shared state -- the display
+// list, MCCS caches, Mutter output lookup, lazy availability checks -- is
+// resolved on the main thread first.  A coordinator thread then writes
+// every DDC/CI level in one io_uring round, gives each display that still
+// needs a fallback or gamma its own worker thread for the blocking I2C /
+// sysfs / D-Bus / xrandr calls, joins them and posts the combined result
+// back to the main loop.
+
+struct BatchSetJob {
+  std::string displayId;
+  double brightness;
+  bool hasGamma;
+  double gamma;
+
+  // Resolved on the main thread.
+  bool found;
+  bool isBacklight;
+  std::string backlightPath;
+  DrmDisplay disp;
+  std::vector<int> ddcBuses;
+  std::string outputName;         // Gamma target (X11).
+  std::string kmsConnector;       // Gamma target (KMS), empty unless used.
+  bool gammaWlr;                  // Gamma already sent via wlr-gamma-control...
+  bool gammaWlrOk;                // ...with this outcome.
+  bool gammaWayland;
+  MutterOutputInfo mutterOutput;  // Gamma target (Wayland), crtcId < 0 if unknown.
+
+  bool hardwareDone;              // Set by the shared io_uring DDC/CI round.
+  bool ok;
+};
+
+struct BatchSetRequest {
+  FlMethodCall* call;
+  std::vector<BatchSetJob> jobs;
+};
+
+static void RunBatchSetJob(BatchSetJob* job) {
+  job->ok = false;
+  if (!job->found) return;
+
+  bool ok = job->hardwareDone ||
+            (job->isBacklight
+                 ? SetBacklightBrightness(job->backlightPath, job->brightness)
+                 : SetDisplayBrightnessOnBuses(job->disp, job->ddcBuses, job->brightness));
+
+  if (job->hasGamma) {
+    if (job->gammaWlr) {
+      ok = ok && job->gammaWlrOk;
+    } else if (!job->kmsConnector.empty()) {
+      ok = ok &&
+           TimeBackendCall(job->displayId, StatsBackend::kKms, false, [job] {
+             return SetSoftwareBrightnessKms(job->kmsConnector, job->gamma);
+           });
+    } else if (job->gammaWayland) {
+      ok = ok && job->mutterOutput.crtcId >= 0 &&
+           TimeBackendCall(job->displayId, StatsBackend::kMutter, false, [job] {
+             return SetSoftwareBrightnessWayland(job->mutterOutput, job->gamma);
+           });
+    } else {
+      ok = ok && !job->outputName.empty() &&
+           TimeBackendCall(job->displayId, StatsBackend::kXrandr, false, [job] {
+             return SetSoftwareBrightnessX11(job->outputName, job->gamma);
+           });
+    }
+  }
+  job->ok = ok;
+}
+
+static gboolean RespondBatchSet(gpointer user_data) {
+  auto* req = static_cast<BatchSetRequest*>(user_data);
+  g_autoptr(FlValue) list = fl_value_new_list();
+  for (const auto& job : req->jobs) {
+    if (job.ok && job.hasGamma) RecordAppliedGamma(job.displayId, std::clamp(job.gamma, 0.0, 1.0));
+    if (job.ok) {
+      double gamma = AppliedGamma(job.displayId);
+      NoteBrightness(job.displayId, gamma < 1.0 ? (gamma - 1.0) / 2.0 : job.brightness);
+    }
+    g_autoptr(FlValue) entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "displayId", fl_value_new_string(job.displayId.c_str()));
+    fl_value_set_string_take(entry, "ok", fl_value_new_bool(job.ok));
+    fl_value_append_take(list, fl_value_ref(entry));
+  }
+  fl_method_call_respond_success(req->call, list, nullptr);
+  g_object_unref(req->call);
+  delete req;
+  return G_SOURCE_REMOVE;
+}
+
+// Resolve every job's backend on the main thread.
+static void ResolveBatchSetJob(BatchSetJob& job) {
+  job.found = false;
+  job.isBacklight = job.displayId == "backlight";
+  if (job.isBacklight) {
+    job.backlightPath = FindBacklightPath();
+    job.found = !job.backlightPath.empty();
+  } else {
+    RegistryView registry;
+    if (const DrmDisplay* disp = registry->FindDrm(job.displayId)) {
+      job.disp = *disp;
+      job.found = true;
+    }
+    if (job.found && DdcFeatureSupport(job.disp, VCP_BRIGHTNESS) != DdcSupport::kUnsupported)
+      job.ddcBuses = DdcBusesFor(job.disp);
+  }
+
+  job.gammaWlr = false;
+  job.gammaWayland = false;
+  job.mutterOutput.crtcId = -1;
+  job.mutterOutput.gammaSize = 0;
+  job.mutterOutput.serial = 0;
+  if (!job.found || !job.hasGamma) return;
+  if (AppliedMatches(job.displayId, WriteBackend::kGamma, GammaLevel(job.gamma))) {
+    job.hasGamma = false;
+    return;
+  }
+
+  if (UseKmsGamma()) {
+    job.kmsConnector = FindDrmConnector(job.displayId.c_str());
+    return;
+  }
+  if (IsWayland() && WlrGammaAvailable()) {
+    // Not thread-safe, but never blocks: send it now.
+    std::string wlName = FindWaylandOutputName(job.displayId.c_str());
+    job.gammaWlr = true;
+    job.gammaWlrOk = TimeBackendCall(job.displayId, StatsBackend::kWlr, false,
+                                     [&] { return SetSoftwareBrightnessWlr(wlName, job.gamma); });
+    return;
+  }
+  job.outputName = FindOutputName(job.displayId.c_str());
+  if (job.outputName.empty()) return;
+  g_isWayland = IsWayland();
+  if (g_isWayland) {
+    job.gammaWayland = true;
+    FindMutterOutput(job.outputName, job.mutterOutput);
+  }
+}
+
+// Write every display's DDC/CI level in one io_uring round.  Jobs it
+// completes need no worker unless they also carry gamma.
+static void RunBatchDdcWrites(std::vector<BatchSetJob>& jobs) {
+  std::vector<DdcTransaction> txs;
+  std::vector<BatchSetJob*> owners;
+  for (auto& job : jobs) {
+    job.hardwareDone = false;
+    if (!job.found || job.isBacklight || job.ddcBuses.empty()) continue;
+    int value = static_cast<int>(std::clamp(job.brightness, 0.0, 1.0) * 100);
+    if (AppliedMatches(job.displayId, WriteBackend::kDdc, value)) {
+      job.hardwareDone = true;
+      continue;
+    }
+    txs.push_back({job.ddcBuses[0], VCP_BRIGHTNESS, true, value, false, 0, 0});
+    owners.push_back(&job);
+  }
+  if (txs.empty()) return;
+
+  // Every chain runs concurrently, so each is charged the whole round.
+  gint64 start = g_get_monotonic_time();
+  RunDdcTransactions(txs);
+  gint64 elapsed = g_get_monotonic_time() - start;
+  for (size_t i = 0; i < txs.size(); i++) {
+    RecordBackendCall(owners[i]->displayId, StatsBackend::kDdc, elapsed,
+                      txs[i].ok ? CallOutcome::kOk : CallOutcome::kFellBack);
+    if (!txs[i].ok) continue;
+    RecordApplied(owners[i]->displayId, WriteBackend::kDdc, txs[i].value);
+    owners[i]->hardwareDone = true;
+  }
+}
+
+// Takes a reference on |call| and responds asynchronously.
+static void StartBatchSet(FlMethodCall* call, std::vector<BatchSetJob> jobs) {
+  IsDdcutilAvailable();  // Prime the lazy check before threads read it.
+
+  for (auto& job : jobs) {
+    CancelTransition(job.displayId);
+    ResolveBatchSetJob(job);
+  }
+
+  auto* req = new BatchSetRequest{FL_METHOD_CALL(g_object_ref(call)), std::move(jobs)};
+  std::thread([req]() {
+    RunBatchDdcWrites(req->jobs);
+    std::vector<std::thread> workers;
+    workers.reserve(req->jobs.size());
+    for (auto& job : req->jobs) {
+      if (job.hardwareDone && !job.hasGamma) {
+        job.ok = true;
+        continue;
+      }
+      workers.emplace_back(RunBatchSetJob, &job);
+    }
+    for (auto& worker : workers) worker.join();
+    g_idle_add(RespondBatchSet, req);
+  }).detach();
+}
+
+// ── Display listing ────────────────────────────────────────────────
+
+struct DisplayProbe {
+  std::vector<DrmDisplay> drmDisplays;
+  FlValue* list = nullptr;  // Owned by whoever takes the result.
+  std::vector<AppliedSeed> seeds;  // For ReseedAppliedHardware().
+  uint64_t appliedUpdates = 0;
+};
+
+// Enumerate displays and read their brightness.  |list| is the getDisplays
+// result, a list of {id, name, stableId?, brightness, isBuiltIn} maps.
+// With |onlyId|, every display is still enumerated but only that one is
+// probed and listed.  Publishes nothing, so it may run on a worker thread
+// (see Startup display probe): DDC/CI reads take their bus like any other
+// caller, and the levels read are only collected in |seeds|.
+static DisplayProbe ProbeDisplays(const char* onlyId = nullptr) {
+  DisplayProbe probe;
+  FlValue* list = fl_value_new_list();
+  probe.list = list;
+  // A refresh re-reads hardware state, so what we think we wrote is
+  // replaced by these reads once the result is published.
+  probe.appliedUpdates = AppliedUpdates();
+  t_appliedSeeds = &probe.seeds;
+  LibDdcutilForgetFailures();
+
+  // 1) Try sysfs backlight (built-in laptop display).
+  std::string backlightPath = FindBacklightPath();
+  if (!backlightPath.empty() && (!onlyId || strcmp(onlyId, "backlight") == 0)) {
+    g_autoptr(FlValue) display = fl_value_new_map();
+    fl_value_set_string_take(display, "id", fl_value_new_string("backlight"));
+
+    std::string driverName = std::filesystem::path(backlightPath).filename().string();
+    std::string displayName = "Built-in Display (" + driverName + ")";
+    fl_value_set_string_take(display, "name", fl_value_new_string(displayName.c_str()));
+    fl_value_set_string_take(display, "brightness",
+                             fl_value_new_float(GetBacklightBrightness(backlightPath)));
+    fl_value_set_string_take(display, "isBuiltIn", fl_value_new_bool(TRUE));
+    fl_value_append_take(list, fl_value_ref(display));
+  }
+
+  // 2) Enumerate external monitors via DRM sysfs.
+  std::vector<DrmDisplay>& displays = probe.drmDisplays;
+  displays = EnumerateDrmDisplays();
+
+  // Read every monitor's brightness over its first DDC bus in one
+  // io_uring round; misses go through the full cascade below.
+  std::vector<DdcTransaction> probes;
+  std::vector<int> probeIndex(displays.size(), -1);
+  std::vector<int> allBuses;
+  for (size_t i = 0; i < displays.size(); i++) {
+    const auto& disp = displays[i];
+    if (!backlightPath.empty() && disp.isBuiltIn) continue;
+    std::vector<int> buses = DdcBusesFor(disp);
+    allBuses.insert(allBuses.end(), buses.begin(), buses.end());
+    if (onlyId && onlyId != "drm:" + disp.connector) continue;
+    if (DdcFeatureSupport(disp, VCP_BRIGHTNESS) == DdcSupport::kUnsupported) continue;
+    if (buses.empty()) continue;
+    probeIndex[i] = static_cast<int>(probes.size());
+    probes.push_back({buses[0], VCP_BRIGHTNESS, false, 0, false, 0, 0});
+  }
+  // Only checks access; setup is up to Dart (setupI2cPermissions).
+  RecordI2cBuses(std::move(allBuses));
+  gint64 probeUs = 0;
+  if (!probes.empty()) {
+    gint64 start = g_get_monotonic_time();
+    RunDdcTransactions(probes);
+    probeUs = g_get_monotonic_time() - start;
+  }
+
+  for (size_t i = 0; i < displays.size(); i++) {
+    const auto& disp = displays[i];
+    // Skip built-in displays if we already have a backlight entry.
+    if (!backlightPath.empty() && disp.isBuiltIn) continue;
+    std::string id = "drm:" + disp.connector;
+    if (onlyId && id != onlyId) continue;
+
+    g_autoptr(FlValue) display = fl_value_new_map();
+    fl_value_set_string_take(display, "id", fl_value_new_string(id.c_str()));
+
+    std::string name = disp.edidName.empty() ? disp.xrandrName : disp.edidName;
+    fl_value_set_string_take(display, "name", fl_value_new_string(name.c_str()));
+    if (!disp.stableId.empty()) {
+      fl_value_set_string_take(display, "stableId",
+                               fl_value_new_string(disp.stableId.c_str()));
+    }
+
+    double brightness;
+    const DdcTransaction* probe = probeIndex[i] >= 0 ? &probes[probeIndex[i]] : nullptr;
+    bool probed = probe && probe->ok && probe->maximum > 0;
+    if (probe) {
+      RecordBackendCall(id, StatsBackend::kDdc, probeUs,
+                        probed ? CallOutcome::kOk : CallOutcome::kFellBack);
+    }
+    if (probed) {
+      RecordReadDdcLevel(id, probe->current, probe->maximum);
+      brightness = static_cast<double>(probe->current) / static_cast<double>(probe->maximum);
+    } else {
+      brightness = GetDisplayBrightness(disp, probe ? probe->bus : -1);
+    }
+    fl_value_set_string_take(display, "brightness", fl_value_new_float(brightness));
+    fl_value_set_string_take(display, "isBuiltIn", fl_value_new_bool(disp.isBuiltIn));
+    fl_value_append_take(list, fl_value_ref(display));
+  }
+  t_appliedSeeds = nullptr;
+  return probe;
+}
+
+// ProbeDisplays() on the main thread, publishing the display list.
+static FlValue* ListDisplays(const char* onlyId = nullptr) {
+  DisplayProbe probe = ProbeDisplays(onlyId);
+  ReseedAppliedHardware(probe.seeds, probe.appliedUpdates);
+  PublishDrmDisplays(std::move(probe.drmDisplays));
+  return probe.list;
+}
+
+// ── Startup display probe ──────────────────────────────────────────
+//
+// Probing the hardware (DDC/CI reads, xrandr) and booting the engine and
+// isolate each take a noticeable time.  Instead of paying for them one
+// after the other, my_application_startup runs ProbeDisplays() on a
+// worker thread right away.  The first getDisplays is answered from its
+// result, waiting for it if needed; later calls probe afresh.
+//
+// Until the result reaches the main loop, getDisplays and the control
+// socket wait through WhenDisplaysReady().  The worker takes each I2C bus
+// through its DdcBusState like every other caller, the MCCS cache is
+// locked, and the applied cache is only reseeded from its reads once the
+// result is back on the main thread.
+// The control socket's refresh goes through the same worker with
+// RefreshDisplays(), so a slow monitor never stalls the main loop; that
+// result is only published, not kept for getDisplays.
+
+struct StartupProbe {
+  bool running = false;
+  bool startup = false;  // Keep |result| for the first getDisplays.
+  bool unused = false;   // |result| not yet handed to getDisplays.
+  DisplayProbe result;
+  std::vector<std::function<void()>> waiters;
+};
+
+static StartupProbe g_startupProbe;
+
+static gboolean OnStartupProbeDone(gpointer user_data) {
+  auto* probe = static_cast<DisplayProbe*>(user_data);
+  g_startupProbe.running = false;
+  ReseedAppliedHardware(probe->seeds, probe->appliedUpdates);
+  PublishDrmDisplays(probe->drmDisplays);
+  NoteListedBrightness(probe->list);
+  if (g_startupProbe.startup) {
+    if (g_startupProbe.result.list) fl_value_unref(g_startupProbe.result.list);
+    g_startupProbe.result = std::move(*probe);
+    g_startupProbe.unused = true;
+  } else {
+    fl_value_unref(probe->list);
+  }
+  delete probe;
+
+  std::vector<std::function<void()>> waiters = std::move(g_startupProbe.waiters);
+  g_startupProbe.waiters.clear();
+  for (auto& waiter : waiters) waiter();
+  return G_SOURCE_REMOVE;
+}
+
+static void StartDisplayProbe(bool startup) {
+  if (g_startupProbe.running) return;
+  IsDdcutilAvailable();  // Prime the lazy check before the worker reads it.
+  g_startupProbe.running = true;
+  g_startupProbe.startup = startup;
+  std::thread([startup]() {
+    gint64 start = g_get_monotonic_time();
+    auto* probe = new DisplayProbe(ProbeDisplays());
+    fprintf(stderr, "[BSDisplayControl] %s probe: %zu displays in %lld ms\n",
+            startup ? "Startup" : "Display", fl_value_get_length(probe->list),
+            static_cast<long long>((g_get_monotonic_time() - start) / 1000));
+    g_idle_add(OnStartupProbeDone, probe);
+  }).detach();
+}
+
+static void StartStartupProbe() {
+  StartDisplayProbe(true);
+}
+
+// Probe again on a worker and run |fn| on the main thread once the result
+// is published.  Joins a probe that is already running.
+static void RefreshDisplays(std::function<void()> fn) {
+  g_startupProbe.waiters.push_back(std::move(fn));
+  StartDisplayProbe(false);
+}
+
+// Run |fn| on the main thread once no startup probe is in flight.
+static void WhenDisplaysReady(std::function<void()> fn) {
+  if (g_startupProbe.running) {
+    g_startupProbe.waiters.push_back(std::move(fn));
+  } else {
+    fn();
+  }
+}
+
+// The getDisplays result: the startup probe's if still unused, else a
+// fresh probe.
+static FlValue* TakeDisplayList() {
+  if (g_startupProbe.unused) {
+    g_startupProbe.unused = false;
+    FlValue* list = g_startupProbe.result.list;
+    g_startupProbe.result = DisplayProbe();
+    return list;
+  }
+  return ListDisplays();
+}
+
+// ── Brightness schedule ────────────────────────────────────────────
+//
+// Time-of-day profiles: each entry sets displays to unified values
+// (-0.5 to 1.0) at a local clock time, or at sunrise/sunset (plus an
+// offset) when a location is known.  The entry in effect is the one that
+// fired most recently; the schedule keeps no per-day state, so after
+// suspend, a clock change or a restart the right profile is simply
+// recomputed from the wall clock.
+//
+// One timerfd on CLOCK_REALTIME is armed with TFD_TIMER_ABSTIME for the
+// exact time of the next entry, and the main loop sleeps until it fires.
+// Realtime timers count through suspend, so a transition missed while
+// asleep fires at resume.  TFD_TIMER_CANCEL_ON_SET makes a clock step
+// (NTP, manual set) wake the loop with ECANCELED, and timedated's
+// Timezone change signal covers time zone changes; both only recompute
+// and re-arm.  Nothing polls.
+//
+// Hardware-range targets fade with the transition engine over the
+// entry's ramp; gamma-range targets (below 0) go through
+// SetEffectiveBrightness.  The schedule is kept in
+// ~/.config/bs_display_control/schedule.ini.  Main thread only.
+
+enum class ScheduleAnchor { kClock, kSunrise, kSunset };
+
+struct ScheduleEntry {
+  ScheduleAnchor anchor = ScheduleAnchor::kClock;
+  int minutes = 0;      // kClock: after local midnight; sun anchors: offset.
+  gint64 rampMs = 0;
+  std::map<std::string, double> values;  // Display ID ("*": every display) -> value.
+};
+
+struct BrightnessSchedule {
+  std::vector<ScheduleEntry> entries;
+  bool hasLocation = false;
+  double latitude = 0.0;
+  double longitude = 0.0;
+
+  int timerFd = -1;
+  guint timerSource = 0;
+  GDBusConnection* systemBus = nullptr;
+  guint timezoneSignal = 0;
+  int activeIndex = -1;  // Entry in effect, -1 if none.
+  time_t activeAt = 0;   // When it took effect.
+  time_t nextAt = 0;     // When the timer fires, 0 if disarmed.
+};
+
+static BrightnessSchedule g_schedule;
+
+static const char* const kScheduleAnchorNames[] = {"clock", "sunrise", "sunset"};
+static const double kSunZenithDegrees = 90.833;  // Official: includes refraction.
+
+static std::string ScheduleConfigPath() {
+  g_autofree gchar* path = g_build_filename(g_get_user_config_dir(), "bs_display_control",
+                                            "schedule.ini", nullptr);
+  return path;
+}
+
+// Parse "HH:MM", "sunrise" or "sunset".
+static bool ParseScheduleAt(const char* at, ScheduleEntry& entry) {
+  if (strcmp(at, "sunrise") == 0) {
+    entry.anchor = ScheduleAnchor::kSunrise;
+    return true;
+  }
+  if (strcmp(at, "sunset") == 0) {
+    entry.anchor = ScheduleAnchor::kSunset;
+    return true;
+  }
+  int hours = -1, minutes = -1;
+  char tail = 0;
+  if (sscanf(at, "%d:%d%c", &hours, &minutes, &tail) != 2) return false;
+  if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59) return false;
+  entry.anchor = ScheduleAnchor::kClock;
+  entry.minutes = hours * 60 + minutes;
+  return true;
+}
+
+static std::string ScheduleAtString(const ScheduleEntry& entry) {
+  if (entry.anchor != ScheduleAnchor::kClock) {
+    return kScheduleAnchorNames[static_cast<int>(entry.anchor)];
+  }
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%02d:%02d", entry.minutes / 60, entry.minutes % 60);
+  return buf;
+}
+
+// Sunrise or sunset on the UTC day starting at |dayUtc|, from the
+// almanac algorithm (accurate to a minute or two).  False during polar
+// day or night.
+static bool SunEventUtc(time_t dayUtc, double latitude, double longitude, bool sunrise,
+                        time_t& out) {
+  const double rad = M_PI / 180.0;
+  struct tm tm;
+  gmtime_r(&dayUtc, &tm);
+  double lngHour = longitude / 15.0;
+  double t = (tm.tm_yday + 1) + ((sunrise ? 6.0 : 18.0) - lngHour) / 24.0;
+  double meanAnomaly = 0.9856 * t - 3.289;
+  double trueLongitude = std::fmod(meanAnomaly + 1.916 * std::sin(meanAnomaly * rad) +
+                                       0.020 * std::sin(2.0 * meanAnomaly * rad) + 282.634 + 360.0,
+                                   360.0);
+  double rightAscension =
+      std::fmod(std::atan(0.91764 * std::tan(trueLongitude * rad)) / rad + 360.0, 360.0);
+  rightAscension += std::floor(trueLongitude / 90.0) * 90.0 - std::floor(rightAscension / 90.0) * 90.0;
+  rightAscension /= 15.0;
+  double sinDec = 0.39782 * std::sin(trueLongitude * rad);
+  double cosDec = std::cos(std::asin(sinDec));
+  double cosH = (std::cos(kSunZenithDegrees * rad) - sinDec * std::sin(latitude * rad)) /
+                (cosDec * std::cos(latitude * rad));
+  if (cosH > 1.0 || cosH < -1.0) return false;
+  double hourAngle = std::acos(cosH) / rad;
+  if (sunrise) hourAngle = 360.0 - hourAngle;
+  double localMean = hourAngle / 15.0 + rightAscension - 0.06571 * t - 6.622;
+  double ut = std::fmod(localMean - lngHour + 48.0, 24.0);
+  out = dayUtc + static_cast<time_t>(ut * 3600.0);
+  return true;
+}
+
+// When |entry| occurs on the local calendar day starting at |midnight|.
+static bool ScheduleOccurrence(const ScheduleEntry& entry, time_t midnight, time_t nextMidnight,
+                               time_t& out) {
+  if (entry.anchor == ScheduleAnchor::kClock) {
+    struct tm tm;
+    localtime_r(&midnight, &tm);
+    tm.tm_hour = entry.minutes / 60;
+    tm.tm_min = entry.minutes % 60;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;  // Let mktime place it across DST changes.
+    out = mktime(&tm);
+    return out != static_cast<time_t>(-1);
+  }
+  if (!g_schedule.hasLocation) return false;
+  // Compute on the UTC date matching the local date, then shift by whole
+  // days into the local day; the sun moves little from one day to the next.
+  struct tm local;
+  localtime_r(&midnight, &local);
+  struct tm utcDay = {};
+  utcDay.tm_year = local.tm_year;
+  utcDay.tm_mon = local.tm_mon;
+  utcDay.tm_mday = local.tm_mday;
+  time_t at = 0;
+  if (!SunEventUtc(timegm(&utcDay), g_schedule.latitude, g_schedule.longitude,
+                   entry.anchor == ScheduleAnchor::kSunrise, at)) {
+    return false;
+  }
+  while (at < midnight) at += 86400;
+  while (at >= nextMidnight) at -= 86400;
+  out = at + static_cast<time_t>(entry.minutes) * 60;
+  return true;
+}
+
+// Local midnight |days| days after the one starting the day of |now|.
+static time_t LocalMidnight(time_t now, int days) {
+  struct tm tm;
+  localtime_r(&now, &tm);
+  tm.tm_mday += days;
+  tm.tm_hour = 0;
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
+
+static void ApplyScheduleEntry(const ScheduleEntry& entry) {
+  WhenDisplaysReady([values = entry.values, rampMs = entry.rampMs] {
+    std::map<std::string, double> targets;
+    auto all = values.find("*");
+    if (all != values.end()) {
+      for (const auto& [id, known] : g_knownBrightness) targets[id] = all->second;
+    }
+    for (const auto& [id, value] : values) {
+      if (id != "*") targets[id] = value;
+    }
+    for (const auto& [id, value] : targets) {
+      double target = std::clamp(value, kMinEffectiveBrightness, 1.0);
+      if (target < 0.0) {
+        SetEffectiveBrightness(id.c_str(), target, nullptr);
+        continue;
+      }
+      double from = -1.0;
+      auto known = g_knownBrightness.find(id);
+      if (g_transitions.find(id) == g_transitions.end() && known != g_knownBrightness.end() &&
+          known->second >= 0.0) {
+        from = known->second;
+      }
+      if (!StartTransition(id.c_str(), target, from, rampMs, TransitionCurve::kEaseInOut,
+                           nullptr)) {
+        fprintf(stderr, "[BSDisplayControl] Schedule: cannot set %s\n", id.c_str());
+      }
+    }
+  });
+}
+
+// Arm the timer for |at| (0 disarms).
+static void ArmScheduleTimer(time_t at) {
+  g_schedule.nextAt = at;
+  if (g_schedule.timerFd < 0) return;
+  struct itimerspec spec = {};
+  spec.it_value.tv_sec = at;
+  if (timerfd_settime(g_schedule.timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec,
+                      nullptr) != 0) {
+    fprintf(stderr, "[BSDisplayControl] Schedule: timerfd_settime failed: %s\n", strerror(errno));
+  }
+}
+
+// Find the entry in effect and the next one, apply the former if it took
+// effect since the last look (or always, with |force|), and re-arm.
+static void EvaluateSchedule(bool force) {
+  tzset();
+  time_t now = time(nullptr);
+  int active = -1;
+  time_t activeAt = 0;
+  time_t next = 0;
+  // Yesterday covers an entry still in effect after midnight; two days
+  // ahead covers a schedule whose only entry has already passed today.
+  for (int day = -1; day <= 2; day++) {
+    time_t midnight = LocalMidnight(now, day);
+    time_t nextMidnight = LocalMidnight(now, day + 1);
+    for (size_t i = 0; i < g_schedule.entries.size(); i++) {
+      time_t at = 0;
+      if (!ScheduleOccurrence(g_schedule.entries[i], midnight, nextMidnight, at)) continue;
+      if (at <= now) {
+        if (active < 0 || at >= activeAt) {
+          active = static_cast<int>(i);
+          activeAt = at;
+        }
+      } else if (next == 0 || at < next) {
+        next = at;
+      }
+    }
+  }
+
+  bool changed = active != g_schedule.activeIndex || activeAt != g_schedule.activeAt;
+  g_schedule.activeIndex = active;
+  g_schedule.activeAt = activeAt;
+  if (active >= 0 && (force || changed)) {
+    fprintf(stderr, "[BSDisplayControl] Schedule: applying entry %d (%s)\n", active,
+            ScheduleAtString(g_schedule.entries[active]).c_str());
+    ApplyScheduleEntry(g_schedule.entries[active]);
+  }
+  ArmScheduleTimer(next);
+}
+
+static gboolean OnScheduleTimer(gint fd, GIOCondition condition, gpointer user_data) {
+  uint64_t expirations = 0;
+  ssize_t n = read(fd, &expirations, sizeof(expirations));
+  if (n < 0 && errno == ECANCELED) {
+    fprintf(stderr, "[BSDisplayControl] Schedule: clock changed, recomputing\n");
+  } else if (n < 0 && errno == EAGAIN) {
+    return G_SOURCE_CONTINUE;
+  }
+  EvaluateSchedule(false);
+  return G_SOURCE_CONTINUE;
+}
+
+static void OnTimezoneChanged(GDBusConnection* connection, const gchar* sender,
+                              const gchar* path, const gchar* interface, const gchar* signal,
+                              GVariant* parameters, gpointer user_data) {
+  const gchar* changedInterface = nullptr;
+  g_autoptr(GVariant) changed = nullptr;
+  g_variant_get(parameters, "(&s@a{sv}@as)", &changedInterface, &changed, nullptr);
+  g_autoptr(GVariant) timezone = g_variant_lookup_value(changed, "Timezone", nullptr);
+  if (!timezone) return;
+  fprintf(stderr, "[BSDisplayControl] Schedule: time zone changed, recomputing\n");
+  EvaluateSchedule(false);
+}
+
+static void OnScheduleSystemBus(GObject* source, GAsyncResult* result, gpointer user_data) {
+  g_autoptr(GError) error = nullptr;
+  GDBusConnection* bus = g_bus_get_finish(result, &error);
+  if (!bus) return;  // No system bus: time zone changes go unnoticed.
+  if (g_schedule.timerFd < 0 || g_schedule.systemBus) {
+    g_object_unref(bus);
+    return;
+  }
+  g_schedule.systemBus = bus;
+  g_schedule.timezoneSignal = g_dbus_connection_signal_subscribe(
+      bus, "org.freedesktop.timedate1", "org.freedesktop.DBus.Properties", "PropertiesChanged",
+      "/org/freedesktop/timedate1", "org.freedesktop.timedate1", G_DBUS_SIGNAL_FLAGS_NONE,
+      OnTimezoneChanged, nullptr, nullptr);
+}
+
+static void StopSchedule() {
+  if (g_schedule.timerSource) g_source_remove(g_schedule.timerSource);
+  g_schedule.timerSource = 0;
+  CloseFd(g_schedule.timerFd);
+  if (g_schedule.timezoneSignal) {
+    g_dbus_connection_signal_unsubscribe(g_schedule.systemBus, g_schedule.timezoneSignal);
+  }
+  g_schedule.timezoneSignal = 0;
+  g_clear_object(&g_schedule.systemBus);
+  g_schedule.nextAt = 0;
+}
+
+// (Re)start the timer for the current entries; an empty schedule needs
+// neither the timer nor the bus.
+static void StartSchedule(bool applyNow) {
+  g_schedule.activeIndex = -1;
+  g_schedule.activeAt = 0;
+  if (g_schedule.entries.empty()) {
+    StopSchedule();
+    return;
+  }
+  if (g_schedule.timerFd < 0) {
+    g_schedule.timerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_schedule.timerFd < 0) {
+      fprintf(stderr, "[BSDisplayControl] Schedule: timerfd_create failed: %s\n",
+              strerror(errno));
+      return;
+    }
+    g_schedule.timerSource = g_unix_fd_add(g_schedule.timerFd, G_IO_IN, OnScheduleTimer, nullptr);
+    g_bus_get(G_BUS_TYPE_SYSTEM, nullptr, OnScheduleSystemBus, nullptr);
+  }
+  EvaluateSchedule(applyNow);
+}
+
+static void LoadSchedule() {
+  g_autoptr(GKeyFile) file = g_key_file_new();
+  if (!g_key_file_load_from_file(file, ScheduleConfigPath().c_str(), G_KEY_FILE_NONE, nullptr))
+    return;
+  g_schedule = BrightnessSchedule();
+  if (g_key_file_has_key(file, "schedule", "latitude", nullptr) &&
+      g_key_file_has_key(file, "schedule", "longitude", nullptr)) {
+    g_schedule.hasLocation = true;
+    g_schedule.latitude = g_key_file_get_double(file, "schedule", "latitude", nullptr);
+    g_schedule.longitude = g_key_file_get_double(file, "schedule", "longitude", nullptr);
+  }
+  g_auto(GStrv) groups = g_key_file_get_groups(file, nullptr);
+  for (gchar** group = groups; *group; ++group) {
+    if (!g_str_has_prefix(*group, "entry")) continue;
+    ScheduleEntry entry;
+    g_autofree gchar* at = g_key_file_get_string(file, *group, "at", nullptr);
+    if (!at || !ParseScheduleAt(at, entry)) continue;
+    if (entry.anchor != ScheduleAnchor::kClock) {
+      entry.minutes = g_key_file_get_integer(file, *group, "offsetMinutes", nullptr);
+    }
+    entry.rampMs = g_key_file_get_int64(file, *group, "rampMs", nullptr);
+    g_auto(GStrv) keys = g_key_file_get_keys(file, *group, nullptr, nullptr);
+    for (gchar** key = keys; key && *key; ++key) {
+      if (strcmp(*key, "at") == 0 || strcmp(*key, "offsetMinutes") == 0 ||
+          strcmp(*key, "rampMs") == 0) {
+        continue;
+      }
+      entry.values[*key] = g_key_file_get_double(file, *group, *key, nullptr);
+    }
+    if (!entry.values.empty()) g_schedule.entries.push_back(std::move(entry));
+  }
+}
+
+static bool SaveSchedule() {
+  g_autoptr(GKeyFile) file = g_key_file_new();
+  if (g_schedule.hasLocation) {
+    g_key_file_set_double(file, "schedule", "latitude", g_schedule.latitude);
+    g_key_file_set_double(file, "schedule", "longitude", g_schedule.longitude);
+  }
+  for (size_t i = 0; i < g_schedule.entries.size(); i++) {
+    const ScheduleEntry& entry = g_schedule.entries[i];
+    std::string group = "entry" + std::to_string(i);
+    g_key_file_set_string(file, group.c_str(), "at", ScheduleAtString(entry).c_str());
+    if (entry.anchor != ScheduleAnchor::kClock) {
+      g_key_file_set_integer(file, group.c_str(), "offsetMinutes", entry.minutes);
+    }
+    g_key_file_set_int64(file, group.c_str(), "rampMs", entry.rampMs);
+    for (const auto& [id, value] : entry.values) {
+      g_key_file_set_double(file, group.c_str(), id.c_str(), value);
+    }
+  }
+  std::string path = ScheduleConfigPath();
+  g_autofree gchar* dir = g_path_get_dirname(path.c_str());
+  g_mkdir_with_parents(dir, 0700);
+  return g_key_file_save_to_file(file, path.c_str(), nullptr);
+}
+
+// Parse {at, offsetMinutes?, rampMs?, values: {id: value}}.
+static bool ScheduleEntryFromFlValue(FlValue* value, ScheduleEntry& entry) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) return false;
+  FlValue* atVal = fl_value_lookup_string(value, "at");
+  FlValue* valuesVal = fl_value_lookup_string(value, "values");
+  if (!atVal || fl_value_get_type(atVal) != FL_VALUE_TYPE_STRING || !valuesVal ||
+      fl_value_get_type(valuesVal) != FL_VALUE_TYPE_MAP ||
+      !ParseScheduleAt(fl_value_get_string(atVal), entry)) {
+    return false;
+  }
+  FlValue* offsetVal = fl_value_lookup_string(value, "offsetMinutes");
+  if (entry.anchor != ScheduleAnchor::kClock && offsetVal &&
+      fl_value_get_type(offsetVal) == FL_VALUE_TYPE_INT) {
+    entry.minutes = static_cast<int>(std::clamp<int64_t>(fl_value_get_int(offsetVal), -720, 720));
+  }
+  FlValue* rampVal = fl_value_lookup_string(value, "rampMs");
+  if (rampVal && fl_value_get_type(rampVal) == FL_VALUE_TYPE_INT) {
+    entry.rampMs = std::max<int64_t>(fl_value_get_int(rampVal), 0);
+  }
+  for (size_t i = 0; i < fl_value_get_length(valuesVal); i++) {
+    FlValue* key = fl_value_get_map_key(valuesVal, i);
+    FlValue* v = fl_value_get_map_value(valuesVal, i);
+    if (fl_value_get_type(key) != FL_VALUE_TYPE_STRING) return false;
+    double target;
+    if (fl_value_get_type(v) == FL_VALUE_TYPE_FLOAT) {
+      target = fl_value_get_float(v);
+    } else if (fl_value_get_type(v) == FL_VALUE_TYPE_INT) {
+      target = static_cast<double>(fl_value_get_int(v));
+    } else {
+      return false;
+    }
+    if (!std::isfinite(target)) return false;
+    entry.values[fl_value_get_string(key)] = std::clamp(target, kMinEffectiveBrightness, 1.0);
+  }
+  return !entry.values.empty();
+}
+
+// {entries, latitude?, longitude?, active?, nextAtMs?}.
+static FlValue* ScheduleToFlValue() {
+  FlValue* result = fl_value_new_map();
+  FlValue* entries = fl_value_new_list();
+  for (const ScheduleEntry& entry : g_schedule.entries) {
+    FlValue* map = fl_value_new_map();
+    fl_value_set_string_take(map, "at", fl_value_new_string(ScheduleAtString(entry).c_str()));
+    if (entry.anchor != ScheduleAnchor::kClock) {
+      fl_value_set_string_take(map, "offsetMinutes", fl_value_new_int(entry.minutes));
+    }
+    fl_value_set_string_take(map, "rampMs", fl_value_new_int(entry.rampMs));
+    FlValue* values = fl_value_new_map();
+    for (const auto& [id, value] : entry.values) {
+      fl_value_set_string_take(values, id.c_str(), fl_value_new_float(value));
+    }
+    fl_value_set_string_take(map, "values", values);
+    fl_value_append_take(entries, map);
+  }
+  fl_value_set_string_take(result, "entries", entries);
+  if (g_schedule.hasLocation) {
+    fl_value_set_string_take(result, "latitude", fl_value_new_float(g_schedule.latitude));
+    fl_value_set_string_take(result, "longitude", fl_value_new_float(g_schedule.longitude));
+  }
+  if (g_schedule.activeIndex >= 0) {
+    fl_value_set_string_take(result, "active", fl_value_new_int(g_schedule.activeIndex));
+  }
+  if (g_schedule.nextAt > 0) {
+    fl_value_set_string_take(result, "nextAtMs",
+                             fl_value_new_int(static_cast<int64_t>(g_schedule.nextAt) * 1000));
+  }
+  return result;
+}
+
+// ── Control socket ─────────────────────────────────────────────────
+//
+// A Unix stream socket at $XDG_RUNTIME_DIR/bs_display_control.sock, so
+// hotkey daemons and status bars (sxhkd, i3, waybar) need no process per
+// keypress.  It is served from the main loop of the GUI, or of
+// `bs_display_control --serve` (no GTK, no engine).  One request per line;
+// every reply is one line of JSON:
+//
+//   get [ID]        {"ok":true,"displays":[{"id":"drm:card1-DP-1","value":0.4}]}
+//   refresh         re-reads the hardware on a worker, then answers like get
+//   set ID VALUE    answers like get, with the values written
+//   step ID DELTA   like set, relative to the latest requested value
+//   subscribe       {"ok":true}, then {"event":"brightness","id":...,"value":...}
+//                   for every change, whoever made it
+//
+// Errors are {"ok":false,"error":"..."}.  ID may be `*` for every known
+// display; set and step reject IDs the feed does not know, except
+// wayland:NAME outputs.
+// Values are the unified slider value, -0.5 to 1.0.  get answers from the
+// change feed without touching the hardware.  Writes go through
+// SetEffectiveBrightness like the UI's, sharing the last-applied cache,
+// subprocess supersede and stats.  At most one write per display is in
+// flight: requests that arrive meanwhile replace each other, and only the
+// latest is applied next, so a held key never builds a backlog.  Each
+// request is answered by the write that covered it.  Replies keep request
+// order per connection; events may arrive between them.
+
+static const size_t kControlMaxLine = 4096;
+static const size_t kControlMaxPendingOutput = 256 * 1024;
+
+struct ControlClient {
+  int fd = -1;
+  std::string in;
+  std::string out;
+  guint readSource = 0;
+  guint writeSource = 0;
+  bool subscribed = false;
+  bool peerClosed = false;  // Closed once every reply has been sent.
+  // Replies in request order; a write's slot is filled when it completes.
+  std::deque<std::shared_ptr<std::string>> replies;
+};
+
+using ControlWriteDone = std::function<void(bool ok, double applied)>;
+
+// Coalescing state of one display's writes.
+struct ControlWrite {
+  bool inFlight = false;
+  double current = 0.0;  // Value being written.
+  std::vector<ControlWriteDone> waiting;
+  bool hasNext = false;
+  double next = 0.0;     // Latest value requested while in flight.
+  std::vector<ControlWriteDone> nextWaiting;
+};
+
+static int g_controlFd = -1;
+static guint g_controlSource = 0;
+static std::string g_controlPath;
+static std::map<int, std::shared_ptr<ControlClient>> g_controlClients;
+static std::map<std::string, ControlWrite> g_controlWrites;
+
+static void CloseControlClient(int fd) {
+  auto it = g_controlClients.find(fd);
+  if (it == g_controlClients.end()) return;
+  if (it->second->readSource) g_source_remove(it->second->readSource);
+  if (it->second->writeSource) g_source_remove(it->second->writeSource);
+  close(fd);
+  it->second->fd = -1;
+  g_controlClients.erase(it);
+}
+
+static gboolean OnControlClientWritable(gint fd, GIOCondition condition, gpointer user_data);
+
+static void FlushControlClient(ControlClient& client) {
+  while (!client.out.empty()) {
+    ssize_t n = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+    if (n > 0) {
+      client.out.erase(0, static_cast<size_t>(n));
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      if (client.out.size() > kControlMaxPendingOutput) {
+        fprintf(stderr, "[BSDisplayControl] Dropping stalled control client\n");
+        CloseControlClient(client.fd);
+        return;
+      }
+      if (!client.writeSource) {
+        client.writeSource = g_unix_fd_add(client.fd, G_IO_OUT, OnControlClientWritable, nullptr);
+      }
+      return;
+    } else {
+      CloseControlClient(client.fd);
+      return;
+    }
+  }
+  if (client.peerClosed && client.replies.empty()) CloseControlClient(client.fd);
+}
+
+static gboolean OnControlClientWritable(gint fd, GIOCondition condition, gpointer user_data) {
+  auto it = g_controlClients.find(fd);
+  if (it == g_controlClients.end()) return G_SOURCE_REMOVE;
+  it->second->writeSource = 0;
+  FlushControlClient(*it->second);
+  return G_SOURCE_REMOVE;
+}
+
+// Move every finished reply at the head of the queue to the output.
+static void DrainControlReplies(ControlClient& client) {
+  while (!client.replies.empty() && !client.replies.front()->empty()) {
+    client.out += *client.replies.front();
+    client.replies.pop_front();
+  }
+  FlushControlClient(client);
+}
+
+// Reserve the client's next reply slot; fill it with FinishControlReply().
+static std::shared_ptr<std::string> ReserveControlReply(ControlClient& client) {
+  client.replies.push_back(std::make_shared<std::string>());
+  return client.replies.back();
+}
+
+static void FinishControlReply(int fd, const std::shared_ptr<std::string>& slot,
+                               std::string line) {
+  *slot = std::move(line);
+  slot->push_back('\n');
+  auto it = g_controlClients.find(fd);
+  if (it != g_controlClients.end()) DrainControlReplies(*it->second);
+}
+
+static std::string ControlErrorJson(const char* message) {
+  std::string json = "{\"ok\":false,\"error\":";
+  AppendJsonString(json, message);
+  json += '}';
+  return json;
+}
+
+static std::string ControlDisplaysJson(bool ok,
+                                       const std::vector<std::pair<std::string, double>>& values) {
+  std::string json = ok ? "{\"ok\":true,\"displays\":[" : "{\"ok\":false,\"displays\":[";
+  char buf[32];
+  for (size_t i = 0; i < values.size(); i++) {
+    json += i ? ",{\"id\":" : "{\"id\":";
+    AppendJsonString(json, values[i].first.c_str());
+    snprintf(buf, sizeof(buf), ",\"value\":%.4g}", values[i].second);
+    json += buf;
+  }
+  json += "]}";
+  return json;
+}
+
+static void BroadcastControlEvent(const std::string& displayId, double value) {
+  std::string json = "{\"event\":\"brightness\",\"id\":";
+  AppendJsonString(json, displayId.c_str());
+  char buf[32];
+  snprintf(buf, sizeof(buf), ",\"value\":%.4g}\n", value);
+  json += buf;
+
+  std::vector<int> subscribers;
+  for (const auto& [fd, client] : g_controlClients) {
+    if (client->subscribed) subscribers.push_back(fd);
+  }
+  for (int fd : subscribers) {
+    auto it = g_controlClients.find(fd);
+    if (it == g_controlClients.end()) continue;
+    it->second->out += json;
+    FlushControlClient(*it->second);
+  }
+}
+
+static void StartControlWrite(const std::string& displayId, double value,
+                              std::vector<ControlWriteDone> waiting) {
+  ControlWrite& w = g_controlWrites[displayId];
+  w.inFlight = true;
+  w.current = value;
+  w.waiting = std::move(waiting);
+  // May complete before returning; |w| is not touched afterwards.
+  SetEffectiveBrightness(displayId.c_str(), value, [displayId](bool ok) {
+    ControlWrite& w = g_controlWrites[displayId];
+    double applied = w.current;
+    std::vector<ControlWriteDone> done = std::move(w.waiting);
+    w.waiting.clear();
+    w.inFlight = false;
+    if (w.hasNext) {
+      w.hasNext = false;
+      std::vector<ControlWriteDone> next = std::move(w.nextWaiting);
+      w.nextWaiting.clear();
+      StartControlWrite(displayId, w.next, std::move(next));
+    }
+    for (auto& d : done) d(ok, applied);
+  });
+}
+
+// Write |value|, coalescing with any write already in flight.
+static void ControlSetBrightness(const std::string& displayId, double value,
+                                 ControlWriteDone done) {
+  ControlWrite& w = g_controlWrites[displayId];
+  if (w.inFlight) {
+    w.hasNext = true;
+    w.next = value;
+    w.nextWaiting.push_back(std::move(done));
+    return;
+  }
+  StartControlWrite(displayId, value, {std::move(done)});
+}
+
+// Base for `step`: the latest requested value, else the known one.
+static bool ControlRequestedBrightness(const std::string& displayId, double& out) {
+  auto w = g_controlWrites.find(displayId);
+  if (w != g_controlWrites.end() && w->second.hasNext) {
+    out = w->second.next;
+    return true;
+  }
+  if (w != g_controlWrites.end() && w->second.inFlight) {
+    out = w->second.current;
+    return true;
+  }
+  auto known = g_knownBrightness.find(displayId);
+  if (known == g_knownBrightness.end()) return false;
+  out = known->second;
+  return true;
+}
+
+// Collects the per-display results of one set/step request.
+struct ControlWriteJoin {
+  int fd;
+  std::shared_ptr<std::string> slot;
+  size_t pending = 0;
+  bool ok = true;
+  std::vector<std::pair<std::string, double>> values;
+};
+
+// Answer |line|.  A refresh, or any request before brightness is known,
+// first re-probes on a worker and runs again with |probed| set.
+static void RunControlRequest(int fd, const std::shared_ptr<std::string>& slot,
+                              const std::string& line, bool probed) {
+  char cmd[16] = {};
+  char id[128] = {};
+  char arg[64] = {};
+  int fields = sscanf(line.c_str(), "%15s %127s %63s", cmd, id, arg);
+  auto probeFirst = [&] {
+    RefreshDisplays([fd, slot, line] { RunControlRequest(fd, slot, line, true); });
+  };
+
+  if (strcmp(cmd, "subscribe") == 0) {
+    auto client = g_controlClients.find(fd);
+    if (client != g_controlClients.end()) client->second->subscribed = true;
+    FinishControlReply(fd, slot, "{\"ok\":true}");
+    return;
+  }
+
+  if (strcmp(cmd, "get") == 0 || strcmp(cmd, "refresh") == 0) {
+    if (!probed && (strcmp(cmd, "refresh") == 0 || g_knownBrightness.empty())) {
+      probeFirst();
+      return;
+    }
+    std::vector<std::pair<std::string, double>> values;
+    bool all = fields < 2 || strcmp(id, "*") == 0;
+    for (const auto& [displayId, value] : g_knownBrightness) {
+      if (all || displayId == id) values.emplace_back(displayId, value);
+    }
+    FinishControlReply(fd, slot, values.empty() && !all ? ControlErrorJson("unknown display")
+                                                        : ControlDisplaysJson(true, values));
+    return;
+  }
+
+  bool isStep = strcmp(cmd, "step") == 0;
+  if (!isStep && strcmp(cmd, "set") != 0) {
+    FinishControlReply(fd, slot, ControlErrorJson("unknown command"));
+    return;
+  }
+  char* end = nullptr;
+  double amount = fields == 3 ? g_ascii_strtod(arg, &end) : 0.0;
+  if (fields != 3 || end == arg || *end != '\0' || !std::isfinite(amount)) {
+    FinishControlReply(fd, slot, ControlErrorJson(isStep ? "usage: step ID DELTA"
+                                                         : "usage: set ID VALUE"));
+    return;
+  }
+
+  if (!probed && g_knownBrightness.empty()) {
+    probeFirst();
+    return;
+  }
+  // Only displays the feed knows, and wayland: outputs (which the probe
+  // does not list), are written, so a typo never reaches the cascade or
+  // leaves coalescing state behind.
+  std::vector<std::pair<std::string, double>> targets;
+  if (strcmp(id, "*") == 0) {
+    for (const auto& entry : g_knownBrightness) targets.emplace_back(entry.first, amount);
+  } else if (g_knownBrightness.count(id) || g_str_has_prefix(id, "wayland:")) {
+    targets.emplace_back(id, amount);
+  } else {
+    FinishControlReply(fd, slot, ControlErrorJson("unknown display"));
+    return;
+  }
+  if (isStep) {
+    for (auto& [target, value] : targets) {
+      double base = 0.0;
+      if (!ControlRequestedBrightness(target, base)) {
+        FinishControlReply(fd, slot, ControlErrorJson("no known brightness to step from"));
+        return;
+      }
+      value = base + amount;
+    }
+  }
+
+  auto join = std::make_shared<ControlWriteJoin>();
+  join->fd = fd;
+  join->slot = slot;
+  join->pending = 1;
+  auto finish = [join] {
+    if (--join->pending > 0) return;
+    FinishControlReply(join->fd, join->slot, ControlDisplaysJson(join->ok, join->values));
+  };
+  for (const auto& [target, requested] : targets) {
+    double value = std::clamp(requested, kMinEffectiveBrightness, 1.0);
+    join->pending++;
+    ControlSetBrightness(target, value, [join, target = target, finish](bool ok, double applied) {
+      join->ok = join->ok && ok;
+      join->values.emplace_back(target, applied);
+      finish();
+    });
+  }
+  finish();
+}
+
+static void HandleControlLine(ControlClient& client, const char* line) {
+  char first[2];
+  if (sscanf(line, "%1s", first) != 1) return;  // Blank line.
+  // Reserved now so replies keep request order across the wait.
+  auto slot = ReserveControlReply(client);
+  WhenDisplaysReady([fd = client.fd, slot, request = std::string(line)]() {
+    RunControlRequest(fd, slot, request, false);
+  });
+}
+
+static gboolean OnControlClientInput(gint fd, GIOCondition condition, gpointer user_data) {
+  auto it = g_controlClients.find(fd);
+  if (it == g_controlClients.end()) return G_SOURCE_REMOVE;
+  std::shared_ptr<ControlClient> client = it->second;
+
+  char buf[1024];
+  bool eof = false;
+  for (;;) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      client->in.append(buf, static_cast<size_t>(n));
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) break;
+    // EOF (or error): answer what was sent, then close.  `echo get |
+    // socat - UNIX-CONNECT:...` half-closes before reading the reply.
+    eof = true;
+    break;
+  }
+
+  size_t start = 0;
+  size_t newline;
+  while (client->fd >= 0 && (newline = client->in.find('\n', start)) != std::string::npos) {
+    std::string line = client->in.substr(start, newline - start);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    start = newline + 1;
+    HandleControlLine(*client, line.c_str());
+  }
+  if (client->fd < 0) return G_SOURCE_REMOVE;
+  client->in.erase(0, start);
+  if (client->in.size() > kControlMaxLine) {
+    CloseControlClient(fd);
+    return G_SOURCE_REMOVE;
+  }
+  if (eof) {
+    client->peerClosed = true;
+    client->readSource = 0;
+    FlushControlClient(*client);  // Closes now if nothing is pending.
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean OnControlAccept(gint fd, GIOCondition condition, gpointer user_data) {
+  for (;;) {
+    int clientFd = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (clientFd < 0) {
+      if (errno == EINTR) continue;
+      break;  // EAGAIN, or a transient error such as EMFILE.
+    }
+    auto client = std::make_shared<ControlClient>();
+    client->fd = clientFd;
+    client->readSource = g_unix_fd_add(
+        clientFd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+        OnControlClientInput, nullptr);
+    g_controlClients[clientFd] = client;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Start serving.  Returns false if the socket cannot be created or another
+// instance is already serving it.
+static bool StartControlSocket() {
+  if (g_controlFd >= 0) return true;
+  g_autofree gchar* path = g_build_filename(g_get_user_runtime_dir(),
+                                            "bs_display_control.sock", nullptr);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) return false;
+  memcpy(addr.sun_path, path, strlen(path) + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0) return false;
+  const sockaddr* sa = reinterpret_cast<const sockaddr*>(&addr);
+  int rc = bind(fd, sa, sizeof(addr));
+  if (rc != 0 && errno == EADDRINUSE) {
+    // Left behind by a crashed instance, unless someone still answers.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool live = probe >= 0 && connect(probe, sa, sizeof(addr)) == 0;
+    if (probe >= 0) close(probe);
+    if (live) {
+      fprintf(stderr, "[BSDisplayControl] Control socket %s is served by another instance\n",
+              path);
+      close(fd);
+      return false;
+    }
+    unlink(path);
+    rc = bind(fd, sa, sizeof(addr));
+  }
+  if (rc != 0 || listen(fd, 16) != 0) {
+    fprintf(stderr, "[BSDisplayControl] Control socket %s unavailable: %s\n", path,
+            strerror(errno));
+    close(fd);
+    return false;
+  }
+  chmod(path, 0600);
+
+  g_controlFd = fd;
+  g_controlPath = path;
+  g_controlSource = g_unix_fd_add(fd, G_IO_IN, OnControlAccept, nullptr);
+  g_brightnessListeners.push_back(BroadcastControlEvent);
+  fprintf(stderr, "[BSDisplayControl] Control socket listening on %s\n", path);
+  return true;
+}
+
+static void StopControlSocket() {
+  if (g_controlFd < 0) return;
+  g_source_remove(g_controlSource);
+  while (!g_controlClients.empty()) CloseControlClient(g_controlClients.begin()->first);
+  close(g_controlFd);
+  g_controlFd = -1;
+  unlink(g_controlPath.c_str());
+}
+
+// ── Brightness hotkeys ─────────────────────────────────────────────
+//
+// KEY_BRIGHTNESSUP/KEY_BRIGHTNESSDOWN normally reach only the laptop
+// backlight, through the desktop.  When enabled, every evdev device under
+// /dev/input that reports those keys is opened read-only (never grabbed,
+// so the desktop still sees them) and watched with g_unix_fd_add; the
+// process wakes only on input from those devices.  An inotify watch on the
+// directory picks up devices that appear later, including uinput ones.
+//
+// A press steps the target displays by kHotkeyStep through
+// ControlSetBrightness, which keeps at most one write in flight per
+// display and folds later steps into the pending one, so holding a key
+// never queues I2C traffic.  Auto-repeat events are additionally thinned
+// to one step per kHotkeyRepeatMs, so a held key sweeps the range at a
+// readable pace whatever the keyboard's repeat rate.
+//
+// Targets are "external" (default: every display but the built-in panel,
+// which the desktop already handles), "all", or a list of display IDs.
+// BS_DISPLAY_CONTROL_INPUT_DIR replaces /dev/input for testing.  Main
+// thread only.
+
+static const char* const kInputDefaultDir = "/dev/input";
+static const double kHotkeyStep = 0.05;
+static const gint64 kHotkeyRepeatMs = 100;
+
+struct HotkeyDevice {
+  std::string name;  // EVIOCGNAME.
+  int fd = -1;
+  guint source = 0;
+};
+
+struct BrightnessHotkeys {
+  bool enabled = false;
+  std::string targets = "external";  // "external", "all" or "list".
+  std::vector<std::string> only;     // Display IDs when targets is "list".
+  std::map<std::string, HotkeyDevice> devices;  // By node name, e.g. "event3".
+  std::string dir;
+  int inotifyFd = -1;
+  guint inotifySource = 0;
+  bool denied = false;  // A brightness-key device could not be opened.
+  int64_t lastKeyUs = 0;  // Last key counted, for repeat thinning.
+  uint64_t presses = 0;
+};
+
+static BrightnessHotkeys g_hotkeys;
+
+static bool TestInputBit(const unsigned long* bits, unsigned bit) {
+  const unsigned perLong = sizeof(unsigned long) * CHAR_BIT;
+  return (bits[bit / perLong] >> (bit % perLong)) & 1UL;
+}
+
+static void CloseHotkeyDevice(HotkeyDevice& dev) {
+  if (dev.source) g_source_remove(dev.source);
+  dev.source = 0;
+  CloseFd(dev.fd);
+}
+
+static void StepHotkeyTargets(int steps) {
+  if (steps == 0) return;
+  double amount = kHotkeyStep * steps;
+  std::vector<std::string> targets;
+  if (g_hotkeys.targets == "list") {
+    targets = g_hotkeys.only;
+  } else {
+    RegistryView registry;
+    for (const auto& entry : g_knownBrightness) {
+      if (g_hotkeys.targets == "external") {
+        if (entry.first == "backlight") continue;
+        const DrmDisplay* disp = registry->FindDrm(entry.first);
+        if (disp && disp->isBuiltIn) continue;
+      }
+      targets.push_back(entry.first);
+    }
+  }
+  for (const std::string& target : targets) {
+    double base = 0.0;
+    if (!ControlRequestedBrightness(target, base)) continue;
+    ControlSetBrightness(target, std::clamp(base + amount, kMinEffectiveBrightness, 1.0),
+                         [](bool, double) {});
+  }
+}
+
+static gboolean OnHotkeyInput(gint fd, GIOCondition condition, gpointer user_data) {
+  const std::string node = static_cast<const char*>(user_data);
+  struct input_event events[64];
+  int steps = 0;
+  bool lost = false;
+  for (;;) {
+    ssize_t n = read(fd, events, sizeof(events));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) break;
+    if (n <= 0) {
+      lost = true;  // ENODEV: unplugged.
+      break;
+    }
+    steps += HotkeySteps(events, static_cast<size_t>(n) / sizeof(events[0]),
+                         g_get_monotonic_time(), kHotkeyRepeatMs * 1000, g_hotkeys.lastKeyUs,
+                         g_hotkeys.presses);
+  }
+  if (steps != 0) {
+    WhenDisplaysReady([steps] { StepHotkeyTargets(steps); });
+  }
+  if (!lost) return G_SOURCE_CONTINUE;
+
+  // The inotify watch reopens the device if it comes back.
+  auto it = g_hotkeys.devices.find(node);
+  if (it != g_hotkeys.devices.end()) {
+    fprintf(stderr, "[BSDisplayControl] Hotkeys: lost %s\n", it->second.name.c_str());
+    it->second.source = 0;  // Removed by returning G_SOURCE_REMOVE.
+    CloseHotkeyDevice(it->second);
+    g_hotkeys.devices.erase(it);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// Open |node| if it is an evdev device with brightness keys.
+static void OpenHotkeyDevice(const std::string& node) {
+  if (!IsHotkeyCandidate(node.c_str()) || g_hotkeys.devices.count(node)) return;
+  std::string path = g_hotkeys.dir + "/" + node;
+  int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    // udev applies permissions after the node appears; IN_ATTRIB retries.
+    if (errno == EACCES || errno == EPERM) g_hotkeys.denied = true;
+    return;
+  }
+  unsigned long keys[KEY_MAX / (sizeof(unsigned long) * CHAR_BIT) + 1] = {};
+  if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 ||
+      (!TestInputBit(keys, KEY_BRIGHTNESSUP) && !TestInputBit(keys, KEY_BRIGHTNESSDOWN))) {
+    CloseFd(fd);
+    return;
+  }
+  char name[256] = {};
+  if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 0) {
+    snprintf(name, sizeof(name), "%s", node.c_str());
+  }
+
+  HotkeyDevice& dev = g_hotkeys.devices[node];
+  dev.name = name;
+  dev.fd = fd;
+  // The key is stable while the entry exists; the source is removed first.
+  dev.source = g_unix_fd_add(fd, G_IO_IN, OnHotkeyInput,
+                             const_cast<char*>(g_hotkeys.devices.find(node)->first.c_str()));
+  fprintf(stderr, "[BSDisplayControl] Hotkeys: listening on %s (%s)\n", node.c_str(), name);
+}
+
+static gboolean OnInputDirChanged(gint fd, GIOCondition condition, gpointer user_data) {
+  alignas(struct inotify_event) char buf[4096];
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    for (char* p = buf; p < buf + n;) {
+      const auto* ev = reinterpret_cast<const struct inotify_event*>(p);
+      if (ev->len > 0) OpenHotkeyDevice(ev->name);
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static void StopBrightnessHotkeys() {
+  for (auto& [node, dev] : g_hotkeys.devices) CloseHotkeyDevice(dev);
+  g_hotkeys.devices.clear();
+  if (g_hotkeys.inotifySource) g_source_remove(g_hotkeys.inotifySource);
+  g_hotkeys.inotifySource = 0;
+  CloseFd(g_hotkeys.inotifyFd);
+  g_hotkeys.enabled = false;
+}
+
+static void StartBrightnessHotkeys() {
+  if (g_hotkeys.enabled) return;
+  const char* dir = getenv("BS_DISPLAY_CONTROL_INPUT_DIR");
+  g_hotkeys.dir = dir && *dir ? dir : kInputDefaultDir;
+  g_hotkeys.denied = false;
+  g_hotkeys.enabled = true;
+
+  g_hotkeys.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (g_hotkeys.inotifyFd >= 0 &&
+      inotify_add_watch(g_hotkeys.inotifyFd, g_hotkeys.dir.c_str(), IN_CREATE | IN_ATTRIB) >= 0) {
+    g_hotkeys.inotifySource =
+        g_unix_fd_add(g_hotkeys.inotifyFd, G_IO_IN, OnInputDirChanged, nullptr);
+  } else {
+    fprintf(stderr, "[BSDisplayControl] Hotkeys: cannot watch %s: %s\n", g_hotkeys.dir.c_str(),
+            strerror(errno));
+    CloseFd(g_hotkeys.inotifyFd);
+  }
+
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(g_hotkeys.dir, ec)) {
+    OpenHotkeyDevice(entry.path().filename().string());
+  }
+  if (g_hotkeys.devices.empty()) {
+    fprintf(stderr, "[BSDisplayControl] Hotkeys: no readable device with brightness keys%s\n",
+            g_hotkeys.denied ? " (permission denied)" : "");
+  }
+}
+
+// {enabled, targets, displays?, devices, error?, presses}.
+static FlValue* BrightnessHotkeysToFlValue() {
+  FlValue* result = fl_value_new_map();
+  fl_value_set_string_take(result, "enabled", fl_value_new_bool(g_hotkeys.enabled));
+  fl_value_set_string_take(result, "targets", fl_value_new_string(g_hotkeys.targets.c_str()));
+  if (g_hotkeys.targets == "list") {
+    FlValue* ids = fl_value_new_list();
+    for (const auto& id : g_hotkeys.only) {
+      fl_value_append_take(ids, fl_value_new_string(id.c_str()));
+    }
+    fl_value_set_string_take(result, "displays", ids);
+  }
+  FlValue* devices = fl_value_new_list();
+  for (const auto& [node, dev] : g_hotkeys.devices) {
+    fl_value_append_take(devices, fl_value_new_string(dev.name.c_str()));
+  }
+  fl_value_set_string_take(result, "devices", devices);
+  if (g_hotkeys.enabled && g_hotkeys.devices.empty()) {
+    fl_value_set_string_take(result, "error",
+                             fl_value_new_string(g_hotkeys.denied ? "permission" : "no devices"));
+  }
+  fl_value_set_string_take(result, "presses",
+                           fl_value_new_int(static_cast<int64_t>(g_hotkeys.presses)));
+  return result;
+}
+
+// ── Resident tray mode ─────────────────────────────────────────────
+//
+// `bs_display_control --tray` keeps the process resident with its window
+// hidden, behind a StatusNotifierItem icon (KDE, waybar and most other
+// bars, GNOME with the AppIndicator extension).  The application is single
+// instance, so launching it again or clicking the icon only presents the
+// existing window: the engine, the display list and the last-applied
+// caches stay warm, and no display probe runs.  Closing the window hides
+// it.  Scrolling over the icon steps every display through the control
+// socket's coalescing writer; the icon's menu has Show and Quit.
+//
+// Nothing of ours polls while hidden, and the engine draws no frames.  On
+// hide the engine is told to drop its caches (memoryPressure) and, once it
+// has, malloc returns free pages to the kernel.  CPU time and resident
+// memory are read at the hide/show edges, so measuring idle cost needs no
+// timer either; getStats reports them under "resident".
+
+static const char kTrayIconName[] = "display-brightness-symbolic";
+static const char kTrayItemInterface[] = "org.kde.StatusNotifierItem";
+static const char kTrayMenuInterface[] = "com.canonical.dbusmenu";
+static const char kTrayWatcher[] = "org.kde.StatusNotifierWatcher";
+static const char kTrayItemPath[] = "/StatusNotifierItem";
+static const char kTrayMenuPath[] = "/MenuBar";
+static const double kTrayScrollStep = 0.05;  // Per wheel notch (120 units).
+static const guint kResidentTrimDelaySeconds = 5;
+
+struct ResidentUsage {
+  bool enabled = false;
+  bool hidden = false;
+  gint64 hiddenSinceUs = 0;
+  gint64 cpuAtHideUs = 0;
+  gint64 hiddenUs = 0;     // Completed hidden intervals.
+  gint64 hiddenCpuUs = 0;
+  long rssAtHideKb = -1;   // After the post-hide trim.
+  guint trimSource = 0;
+  int shows = 0;
+  gint64 showRequestedUs = 0;
+  gint64 lastShowUs = -1;  // Activation to window mapped.
+};
+
+static ResidentUsage g_resident;
+
+static gint64 ProcessCpuUs() {
+  rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<gint64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static long ProcessRssKb() {
+  FILE* f = fopen("/proc/self/statm", "re");
+  if (!f) return -1;
+  long size = 0, resident = 0;
+  int fields = fscanf(f, "%ld %ld", &size, &resident);
+  fclose(f);
+  return fields == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+static gboolean OnResidentTrim(gpointer user_data) {
+  g_resident.trimSource = 0;
+  malloc_trim(0);
+  g_resident.rssAtHideKb = ProcessRssKb();
+  fprintf(stderr, "[BSDisplayControl] Hidden: %ld KiB resident\n", g_resident.rssAtHideKb);
+  return G_SOURCE_REMOVE;
+}
+
+// The window was hidden.  The trim waits for the engine to act on
+// memoryPressure.
+static void ResidentWindowHidden() {
+  if (!g_resident.enabled || g_resident.hidden) return;
+  g_resident.hidden = true;
+  g_resident.hiddenSinceUs = g_get_monotonic_time();
+  g_resident.cpuAtHideUs = ProcessCpuUs();
+  g_resident.trimSource =
+      g_timeout_add_seconds(kResidentTrimDelaySeconds, OnResidentTrim, nullptr);
+}
+
+static void ResidentShowRequested() {
+  if (g_resident.enabled && g_resident.hidden)
+    g_resident.showRequestedUs = g_get_monotonic_time();
+}
+
+// The window was mapped again.
+static void ResidentWindowShown() {
+  if (!g_resident.enabled || !g_resident.hidden) return;
+  gint64 now = g_get_monotonic_time();
+  if (g_resident.trimSource) {
+    g_source_remove(g_resident.trimSource);
+    g_resident.trimSource = 0;
+  }
+  g_resident.hidden = false;
+  g_resident.hiddenUs += now - g_resident.hiddenSinceUs;
+  g_resident.hiddenCpuUs += ProcessCpuUs() - g_resident.cpuAtHideUs;
+  g_resident.shows++;
+  if (g_resident.showRequestedUs > 0) {
+    g_resident.lastShowUs = now - g_resident.showRequestedUs;
+    g_resident.showRequestedUs = 0;
+  }
+}
+
+// {hidden, hiddenMs, hiddenCpuMs, rssKb, rssAtHideKb, shows, lastShowMs},
+// the hidden totals including the current interval.
+static FlValue* ResidentUsageToFlValue() {
+  gint64 hiddenUs = g_resident.hiddenUs;
+  gint64 hiddenCpuUs = g_resident.hiddenCpuUs;
+  if (g_resident.hidden) {
+    hiddenUs += g_get_monotonic_time() - g_resident.hiddenSinceUs;
+    hiddenCpuUs += ProcessCpuUs() - g_resident.cpuAtHideUs;
+  }
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "hidden", fl_value_new_bool(g_resident.hidden));
+  fl_value_set_string_take(map, "hiddenMs", fl_value_new_int(hiddenUs / 1000));
+  fl_value_set_string_take(map, "hiddenCpuMs", fl_value_new_int(hiddenCpuUs / 1000));
+  fl_value_set_string_take(map, "rssKb", fl_value_new_int(ProcessRssKb()));
+  fl_value_set_string_take(map, "rssAtHideKb", fl_value_new_int(g_resident.rssAtHideKb));
+  fl_value_set_string_take(map, "shows", fl_value_new_int(g_resident.shows));
+  fl_value_set_string_take(map, "lastShowMs",
+                           g_resident.lastShowUs >= 0
+                               ? fl_value_new_float(g_resident.lastShowUs / 1000.0)
+                               : fl_value_new_null());
+  return map;
+}
+
+struct TrayIcon {
+  GDBusConnection* bus = nullptr;
+  GDBusNodeInfo* nodeInfo = nullptr;
+  std::string busName;
+  guint ownerId = 0;
+  guint watcherId = 0;
+  guint itemRegistration = 0;
+  guint menuRegistration = 0;
+  std::function<void()> toggle;
+  std::function<void()> show;
+  std::function<void()> quit;
+};
+
+static TrayIcon g_tray;
+
+static const char kTrayIntrospectionXml[] =
+    "<node>"
+    " <interface name='org.kde.StatusNotifierItem'>"
+    "  <property name='Category' type='s' access='read'/>"
+    "  <property name='Id' type='s' access='read'/>"
+    "  <property name='Title' type='s' access='read'/>"
+    "  <property name='Status' type='s' access='read'/>"
+    "  <property name='IconName' type='s' access='read'/>"
+    "  <property name='ToolTip' type='(sa(iiay)ss)' access='read'/>"
+    "  <property name='ItemIsMenu' type='b' access='read'/>"
+    "  <property name='Menu' type='o' access='read'/>"
+    "  <method name='Activate'>"
+    "   <arg name='x' type='i' direction='in'/><arg name='y' type='i' direction='in'/>"
+    "  </method>"
+    "  <method name='SecondaryActivate'>"
+    "   <arg name='x' type='i' direction='in'/><arg name='y' type='i' direction='in'/>"
+    "  </method>"
+    "  <method name='ContextMenu'>"
+    "   <arg name='x' type='i' direction='in'/><arg name='y' type='i' direction='in'/>"
+    "  </method>"
+    "  <method name='Scroll'>"
+    "   <arg name='delta' type='i' direction='in'/>"
+    "   <arg name='orientation' type='s' direction='in'/>"
+    "  </method>"
+    "  <signal name='NewToolTip'/>"
+    " </interface>"
+    " <interface name='com.canonical.dbusmenu'>"
+    "  <property name='Version' type='u' access='read'/>"
+    "  <property name='TextDirection' type='s' access='read'/>"
+    "  <property name='Status' type='s' access='read'/>"
+    "  <property name='IconThemePath' type='as' access='read'/>"
+    "  <method name='GetLayout'>"
+    "   <arg name='parentId' type='i' direction='in'/>"
+    "   <arg name='recursionDepth' type='i' direction='in'/>"
+    "   <arg name='propertyNames' type='as' direction='in'/>"
+    "   <arg name='revision' type='u' direction='out'/>"
+    "   <arg name='layout' type='(ia{sv}av)' direction='out'/>"
+    "  </method>"
+    "  <method name='GetGroupProperties'>"
+    "   <arg name='ids' type='ai' direction='in'/>"
+    "   <arg name='propertyNames' type='as' direction='in'/>"
+    "   <arg name='properties' type='a(ia{sv})' direction='out'/>"
+    "  </method>"
+    "  <method name='GetProperty'>"
+    "   <arg name='id' type='i' direction='in'/><arg name='name' type='s' direction='in'/>"
+    "   <arg name='value' type='v' direction='out'/>"
+    "  </method>"
+    "  <method name='Event'>"
+    "   <arg name='id' type='i' direction='in'/><arg name='eventId' type='s' direction='in'/>"
+    "   <arg name='data' type='v' direction='in'/><arg name='timestamp' type='u' direction='in'/>"
+    "  </method>"
+    "  <method name='EventGroup'>"
+    "   <arg name='events' type='a(isvu)' direction='in'/>"
+    "   <arg name='idErrors' type='ai' direction='out'/>"
+    "  </method>"
+    "  <method name='AboutToShow'>"
+    "   <arg name='id' type='i' direction='in'/><arg name='needUpdate' type='b' direction='out'/>"
+    "  </method>"
+    "  <method name='AboutToShowGroup'>"
+    "   <arg name='ids' type='ai' direction='in'/>"
+    "   <arg name='updatesNeeded' type='ai' direction='out'/>"
+    "   <arg name='idErrors' type='ai' direction='out'/>"
+    "  </method>"
+    "  <signal name='LayoutUpdated'>"
+    "   <arg name='revision' type='u'/><arg name='parent' type='i'/>"
+    "  </signal>"
+    " </interface>"
+    "</node>";
+
+// The menu never changes: id 0 is the root, the rest are its children.
+struct TrayMenuItem {
+  int id;
+  const char* label;
+};
+
+static const TrayMenuItem kTrayMenu[] = {{1, "Show BS Display Control"}, {2, "Quit"}};
+static const guint32 kTrayMenuRevision = 1;
+
+static const TrayMenuItem* FindTrayMenuItem(int id) {
+  for (const auto& item : kTrayMenu) {
+    if (item.id == id) return &item;
+  }
+  return nullptr;
+}
+
+static GVariant* TrayMenuProperties(int id) {
+  GVariantBuilder props;
+  g_variant_builder_init(&props, G_VARIANT_TYPE("a{sv}"));
+  if (id == 0) {
+    g_variant_builder_add(&props, "{sv}", "children-display", g_variant_new_string("submenu"));
+  } else if (const TrayMenuItem* item = FindTrayMenuItem(id)) {
+    g_variant_builder_add(&props, "{sv}", "label", g_variant_new_string(item->label));
+  }
+  return g_variant_builder_end(&props);
+}
+
+static GVariant* TrayMenuLayout(int id) {
+  GVariantBuilder children;
+  g_variant_builder_init(&children, G_VARIANT_TYPE("av"));
+  if (id == 0) {
+    for (const auto& item : kTrayMenu) g_variant_builder_add(&children, "v", TrayMenuLayout(item.id));
+  }
+  return g_variant_new("(i@a{sv}@av)", id, TrayMenuProperties(id),
+                       g_variant_builder_end(&children));
+}
+
+static void TrayMenuClicked(int id) {
+  if (id == 1 && g_tray.show) g_tray.show();
+  if (id == 2 && g_tray.quit) g_tray.quit();
+}
+
+static GVariant* TrayToolTip() {
+  std::string text;
+  for (const auto& [displayId, value] : g_knownBrightness) {
+    char line[160];
+    snprintf(line, sizeof(line), "%s%s  %ld%%", text.empty() ? "" : "\n", displayId.c_str(),
+             std::lround(value * 100.0));
+    text += line;
+  }
+  g_autofree gchar* escaped = g_markup_escape_text(text.c_str(), -1);
+  return g_variant_new("(s@a(iiay)ss)", kTrayIconName,
+                       g_variant_new_array(G_VARIANT_TYPE("(iiay)"), nullptr, 0),
+                       "BS Display Control", escaped);
+}
+
+// Step every known display; positive deltas brighten.
+static void TrayScroll(gint32 delta) {
+  double amount = kTrayScrollStep * delta / 120.0;
+  if (amount == 0.0) return;
+  std::vector<std::string> targets;
+  for (const auto& entry : g_knownBrightness) targets.push_back(entry.first);
+  for (const std::string& target : targets) {
+    double base = 0.0;
+    if (!ControlRequestedBrightness(target, base)) continue;
+    ControlSetBrightness(target, std::clamp(base + amount, kMinEffectiveBrightness, 1.0),
+                         [](bool, double) {});
+  }
+}
+
+static void HandleTrayMenuCall(const gchar* methodName, GVariant* parameters,
+                               GDBusMethodInvocation* invocation) {
+  if (strcmp(methodName, "GetLayout") == 0) {
+    gint32 parent = 0;
+    g_variant_get_child(parameters, 0, "i", &parent);
+    if (parent != 0 && !FindTrayMenuItem(parent)) {
+      g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                            "Unknown menu item %d", parent);
+      return;
     }
-    for (const auto& name : {"eDP-1", "eDP-2", "LVDS-1"}) {
-      return std::string(name);
+    g_dbus_method_invocation_return_value(
+        invocation, g_variant_new("(u@(ia{sv}av))", kTrayMenuRevision, TrayMenuLayout(parent)));
+
+  } else if (strcmp(methodName, "GetGroupProperties") == 0) {
+    GVariantIter* ids = nullptr;
+    g_variant_get_child(parameters, 0, "ai", &ids);
+    GVariantBuilder result;
+    g_variant_builder_init(&result, G_VARIANT_TYPE("a(ia{sv})"));
+    gint32 id = 0;
+    while (g_variant_iter_next(ids, "i", &id)) {
+      if (id == 0 || FindTrayMenuItem(id))
+        g_variant_builder_add(&result, "(i@a{sv})", id, TrayMenuProperties(id));
     }
-    return "";
+    g_variant_iter_free(ids);
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(@a(ia{sv}))", g_variant_builder_end(&result)));
+
+  } else if (strcmp(methodName, "GetProperty") == 0) {
+    gint32 id = 0;
+    const gchar* name = nullptr;
+    g_variant_get(parameters, "(i&s)", &id, &name);
+    const TrayMenuItem* item = FindTrayMenuItem(id);
+    if (!item || strcmp(name, "label") != 0) {
+      g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                                            "No property %s on menu item %d", name, id);
+      return;
+    }
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(v)", g_variant_new_string(item->label)));
+
+  } else if (strcmp(methodName, "Event") == 0) {
+    gint32 id = 0;
+    const gchar* eventId = nullptr;
+    g_variant_get(parameters, "(i&svu)", &id, &eventId, nullptr, nullptr);
+    bool clicked = strcmp(eventId, "clicked") == 0;
+    g_dbus_method_invocation_return_value(invocation, nullptr);
+    if (clicked) TrayMenuClicked(id);
+
+  } else if (strcmp(methodName, "EventGroup") == 0) {
+    GVariantIter* events = nullptr;
+    g_variant_get_child(parameters, 0, "a(isvu)", &events);
+    std::vector<int> clicked;
+    gint32 id = 0;
+    const gchar* eventId = nullptr;
+    while (g_variant_iter_next(events, "(i&svu)", &id, &eventId, nullptr, nullptr)) {
+      if (strcmp(eventId, "clicked") == 0) clicked.push_back(id);
+    }
+    g_variant_iter_free(events);
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("(ai)", nullptr));
+    for (int item : clicked) TrayMenuClicked(item);
+
+  } else if (strcmp(methodName, "AboutToShow") == 0) {
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("(b)", FALSE));
+
+  } else if (strcmp(methodName, "AboutToShowGroup") == 0) {
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("(aiai)", nullptr, nullptr));
+
+  } else {
+    g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                          "Unknown method %s", methodName);
+  }
+}
+
+static void OnTrayMethodCall(GDBusConnection* bus, const gchar* sender, const gchar* objectPath,
+                             const gchar* interfaceName, const gchar* methodName,
+                             GVariant* parameters, GDBusMethodInvocation* invocation,
+                             gpointer user_data) {
+  if (strcmp(interfaceName, kTrayMenuInterface) == 0) {
+    HandleTrayMenuCall(methodName, parameters, invocation);
+    return;
+  }
+
+  if (strcmp(methodName, "Scroll") == 0) {
+    gint32 delta = 0;
+    const gchar* orientation = nullptr;
+    g_variant_get(parameters, "(i&s)", &delta, &orientation);
+    bool vertical = strcmp(orientation, "vertical") == 0;
+    g_dbus_method_invocation_return_value(invocation, nullptr);
+    if (vertical) TrayScroll(delta);
+    return;
+  }
+  // ContextMenu: hosts show Menu themselves.
+  g_dbus_method_invocation_return_value(invocation, nullptr);
+  if ((strcmp(methodName, "Activate") == 0 || strcmp(methodName, "SecondaryActivate") == 0) &&
+      g_tray.toggle) {
+    g_tray.toggle();
+  }
+}
+
+static GVariant* OnTrayGetProperty(GDBusConnection* bus, const gchar* sender,
+                                   const gchar* objectPath, const gchar* interfaceName,
+                                   const gchar* propertyName, GError** error,
+                                   gpointer user_data) {
+  if (strcmp(interfaceName, kTrayMenuInterface) == 0) {
+    if (strcmp(propertyName, "Version") == 0) return g_variant_new_uint32(3);
+    if (strcmp(propertyName, "TextDirection") == 0) return g_variant_new_string("ltr");
+    if (strcmp(propertyName, "Status") == 0) return g_variant_new_string("normal");
+    if (strcmp(propertyName, "IconThemePath") == 0) return g_variant_new_strv(nullptr, 0);
+  } else {
+    if (strcmp(propertyName, "Category") == 0) return g_variant_new_string("Hardware");
+    if (strcmp(propertyName, "Id") == 0) return g_variant_new_string("bs_display_control");
+    if (strcmp(propertyName, "Title") == 0) return g_variant_new_string("BS Display Control");
+    if (strcmp(propertyName, "Status") == 0) return g_variant_new_string("Active");
+    if (strcmp(propertyName, "IconName") == 0) return g_variant_new_string(kTrayIconName);
+    if (strcmp(propertyName, "ToolTip") == 0) return TrayToolTip();
+    if (strcmp(propertyName, "ItemIsMenu") == 0) return g_variant_new_boolean(FALSE);
+    if (strcmp(propertyName, "Menu") == 0) return g_variant_new_object_path(kTrayMenuPath);
+  }
+  g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s",
+              propertyName);
+  return nullptr;
+}
+
+static const GDBusInterfaceVTable kTrayVTable = {OnTrayMethodCall, OnTrayGetProperty, nullptr, {}};
+
+static void OnTrayRegistered(GObject* source, GAsyncResult* res, gpointer user_data) {
+  g_autoptr(GError) error = nullptr;
+  g_autoptr(GVariant) reply =
+      g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+  if (!reply) {
+    fprintf(stderr, "[BSDisplayControl] Tray icon not registered: %s\n", error->message);
+    return;
+  }
+  fprintf(stderr, "[BSDisplayControl] Tray icon registered as %s\n", g_tray.busName.c_str());
+}
+
+// Also called when a tray host restarts.
+static void OnTrayWatcherAppeared(GDBusConnection* bus, const gchar* name,
+                                  const gchar* owner, gpointer user_data) {
+  g_dbus_connection_call(bus, kTrayWatcher, "/StatusNotifierWatcher", kTrayWatcher,
+                         "RegisterStatusNotifierItem",
+                         g_variant_new("(s)", g_tray.busName.c_str()), nullptr,
+                         G_DBUS_CALL_FLAGS_NONE, -1, nullptr, OnTrayRegistered, nullptr);
+}
+
+static void OnTrayWatcherVanished(GDBusConnection* bus, const gchar* name, gpointer user_data) {
+  fprintf(stderr, "[BSDisplayControl] No tray host running; launch the app again to "
+                  "show the window\n");
+}
+
+static void OnTrayNameAcquired(GDBusConnection* bus, const gchar* name, gpointer user_data) {
+  if (g_tray.watcherId) return;
+  g_tray.watcherId = g_bus_watch_name_on_connection(bus, kTrayWatcher,
+                                                    G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                    OnTrayWatcherAppeared, OnTrayWatcherVanished,
+                                                    nullptr, nullptr);
+}
+
+static void OnTrayBrightnessChanged(const std::string& displayId, double value) {
+  if (!g_tray.bus) return;
+  g_dbus_connection_emit_signal(g_tray.bus, nullptr, kTrayItemPath, kTrayItemInterface,
+                                "NewToolTip", nullptr, nullptr);
+}
+
+// Export the icon on |bus| (the application's session connection).
+static bool StartTrayIcon(GDBusConnection* bus) {
+  if (g_tray.bus) return true;
+  if (!bus) {
+    fprintf(stderr, "[BSDisplayControl] No session bus; tray icon unavailable\n");
+    return false;
+  }
+
+  g_autoptr(GError) error = nullptr;
+  GDBusNodeInfo* info = g_dbus_node_info_new_for_xml(kTrayIntrospectionXml, &error);
+  if (!info) {
+    fprintf(stderr, "[BSDisplayControl] Tray introspection data invalid: %s\n", error->message);
+    return false;
+  }
+  guint item = g_dbus_connection_register_object(
+      bus, kTrayItemPath, g_dbus_node_info_lookup_interface(info, kTrayItemInterface),
+      &kTrayVTable, nullptr, nullptr, &error);
+  guint menu = item ? g_dbus_connection_register_object(
+                          bus, kTrayMenuPath,
+                          g_dbus_node_info_lookup_interface(info, kTrayMenuInterface),
+                          &kTrayVTable, nullptr, nullptr, &error)
+                    : 0;
+  if (!menu) {
+    fprintf(stderr, "[BSDisplayControl] Tray icon not exported: %s\n", error->message);
+    if (item) g_dbus_connection_unregister_object(bus, item);
+    g_dbus_node_info_unref(info);
+    return false;
   }
 
-  // DRM display: extract xrandr/output name from cached DrmDisplay.
-  for (const auto& disp : g_drmDisplays) {
-    if (("drm:" + disp.connector) == idStr) {
-      return disp.xrandrName;
-    }
+  g_tray.bus = static_cast<GDBusConnection*>(g_object_ref(bus));
+  g_tray.nodeInfo = info;
+  g_tray.itemRegistration = item;
+  g_tray.menuRegistration = menu;
+  g_autofree gchar* busName = g_strdup_printf("org.kde.StatusNotifierItem-%d-1", getpid());
+  g_tray.busName = busName;
+  g_tray.ownerId = g_bus_own_name_on_connection(bus, busName, G_BUS_NAME_OWNER_FLAGS_NONE,
+                                                OnTrayNameAcquired, nullptr, nullptr, nullptr);
+  g_brightnessListeners.push_back(OnTrayBrightnessChanged);
+  return true;
+}
+
+static void StopTrayIcon() {
+  if (!g_tray.bus) return;
+  if (g_tray.watcherId) g_bus_unwatch_name(g_tray.watcherId);
+  g_bus_unown_name(g_tray.ownerId);
+  g_dbus_connection_unregister_object(g_tray.bus, g_tray.itemRegistration);
+  g_dbus_connection_unregister_object(g_tray.bus, g_tray.menuRegistration);
+  g_dbus_node_info_unref(g_tray.nodeInfo);
+  g_object_unref(g_tray.bus);
+  g_tray = TrayIcon();
+}
+
+// ── dart:ffi fast path ─────────────────────────────────────────────
+//
+// Slider writes skip the method channel: BrightnessService calls these C
+// symbols, exported from the executable (ENABLE_EXPORTS) and looked up
+// with DynamicLibrary.process(), so there is no codec, FlValue or string
+// dispatch per value.  bsdc_set_effective_brightness is a Dart leaf call:
+// it copies the request into a mailbox and wakes the main loop, and never
+// waits on hardware.  The main loop feeds the request to the control
+// socket's coalescing writer, so a fast drag costs one write per display
+// in flight, and posts [requestId, ok, applied] to the Dart port given to
+// bsdc_ffi_init.  Everything else still uses the channel.
+//
+// Bump kFfiAbiVersion whenever an exported signature changes.
+
+#define BSDC_EXPORT extern "C" __attribute__((visibility("default"), used))
+
+static const int32_t kFfiAbiVersion = 1;
+
+// The subset of Dart_CObject (dart_native_api.h) posted here.  The layout
+// is part of Dart's stable native API.
+enum DartCObjectType : int32_t {
+  kDartCObjectBool = 1,
+  kDartCObjectInt64 = 3,
+  kDartCObjectDouble = 4,
+  kDartCObjectArray = 6,
+};
+
+struct DartCObject {
+  DartCObjectType type;
+  union {
+    bool asBool;
+    int64_t asInt64;
+    double asDouble;
+    struct {
+      intptr_t length;
+      DartCObject** values;
+    } asArray;
+  } value;
+};
+
+// NativeApi.postCObject; callable from any thread.
+using DartPostCObjectFn = bool (*)(int64_t port, DartCObject* message);
+
+struct FfiRequest {
+  std::string displayId;
+  double value;
+  int64_t requestId;
+};
+
+static std::atomic<DartPostCObjectFn> g_ffiPost{nullptr};
+static std::atomic<int64_t> g_ffiPort{0};
+static std::mutex g_ffiMutex;
+static std::vector<FfiRequest> g_ffiQueue;  // Guarded by g_ffiMutex.
+static bool g_ffiScheduled = false;         // Guarded by g_ffiMutex.
+
+static void PostFfiResult(int64_t requestId, bool ok, double applied) {
+  DartPostCObjectFn post = g_ffiPost.load(std::memory_order_acquire);
+  if (!post) return;
+  DartCObject id = {kDartCObjectInt64, {}};
+  id.value.asInt64 = requestId;
+  DartCObject okObj = {kDartCObjectBool, {}};
+  okObj.value.asBool = ok;
+  DartCObject appliedObj = {kDartCObjectDouble, {}};
+  appliedObj.value.asDouble = applied;
+  DartCObject* values[] = {&id, &okObj, &appliedObj};
+  DartCObject message = {kDartCObjectArray, {}};
+  message.value.asArray.length = 3;
+  message.value.asArray.values = values;
+  // Copied by the VM before returning.
+  post(g_ffiPort.load(std::memory_order_relaxed), &message);
+}
+
+static gboolean DrainFfiRequests(gpointer user_data) {
+  std::vector<FfiRequest> requests;
+  {
+    std::lock_guard<std::mutex> lock(g_ffiMutex);
+    requests.swap(g_ffiQueue);
+    g_ffiScheduled = false;
   }
-  return "";
+  WhenDisplaysReady([requests = std::move(requests)] {
+    for (const FfiRequest& r : requests) {
+      double value = std::isfinite(r.value) ? r.value : 0.0;
+      ControlSetBrightness(r.displayId, std::clamp(value, kMinEffectiveBrightness, 1.0),
+                           [requestId = r.requestId](bool ok, double applied) {
+                             PostFfiResult(requestId, ok, applied);
+                           });
+    }
+  });
+  return G_SOURCE_REMOVE;
 }
 
-// Set software brightness for a display.
-// Dispatches to Wayland (Mutter D-Bus) or X11 (xrandr) based on session type.
-static bool SetSoftwareBrightness(const char* displayId, double gamma) {
-  std::string outputName = FindOutputName(displayId);
-  if (outputName.empty()) return false;
+BSDC_EXPORT int32_t bsdc_ffi_abi_version() {
+  return kFfiAbiVersion;
+}
 
-  g_isWayland = IsWayland();
+// |post| is NativeApi.postCObject; results go to |port|.
+BSDC_EXPORT void bsdc_ffi_init(DartPostCObjectFn post, int64_t port) {
+  g_ffiPort.store(port, std::memory_order_relaxed);
+  g_ffiPost.store(post, std::memory_order_release);
+}
 
-  if (g_isWayland) {
-    // Wayland: use Mutter D-Bus.
-    if (!g_mutterQueried) QueryMutterResources();
+// Queue a unified brightness write (-0.5 to 1.0).  |displayId| is UTF-8,
+// not NUL-terminated, and only read during the call.
+BSDC_EXPORT void bsdc_set_effective_brightness(const uint8_t* displayId, size_t length,
+                                               double value, int64_t requestId) {
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(g_ffiMutex);
+    g_ffiQueue.push_back(
+        {std::string(reinterpret_cast<const char*>(displayId), length), value, requestId});
+    schedule = !g_ffiScheduled;
+    g_ffiScheduled = true;
+  }
+  if (schedule) g_idle_add_full(G_PRIORITY_HIGH, DrainFfiRequests, nullptr, nullptr);
+}
 
-    for (const auto& out : g_mutterOutputs) {
-      if (out.name == outputName) {
-        return SetSoftwareBrightnessWayland(out, gamma);
-      }
-    }
+// ── Method channel handler ─────────────────────────────────────────
 
-    // Output not found — re-query in case monitors changed.
-    g_mutterQueried = false;
-    QueryMutterResources();
-    for (const auto& out : g_mutterOutputs) {
-      if (out.name == outputName) {
-        return SetSoftwareBrightnessWayland(out, gamma);
-      }
-    }
+// Completion for methods whose backends may finish asynchronously: holds a
+// reference on |method_call| and answers it with the bool result.
+static std::function<void(bool)> RespondBoolLater(FlMethodCall* method_call) {
+  FlMethodCall* call = FL_METHOD_CALL(g_object_ref(method_call));
+  return [call](bool ok) {
+    g_autoptr(FlValue) result = fl_value_new_bool(ok);
+    fl_method_call_respond_success(call, result, nullptr);
+    g_object_unref(call);
+  };
+}
 
-    fprintf(stderr, "[BSDisplayControl] Mutter output '%s' not found\n",
-            outputName.c_str());
+// Numeric argument: a Dart double arrives as FLOAT, but an int passed where
+// a double is expected (e.g. 1 instead of 1.0) arrives as INT.
+static bool NumberFromFlValue(FlValue* value, double& out) {
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_FLOAT) {
+    out = fl_value_get_float(value);
+  } else if (fl_value_get_type(value) == FL_VALUE_TYPE_INT) {
+    out = static_cast<double>(fl_value_get_int(value));
+  } else {
     return false;
   }
-
-  // X11: use xrandr.
-  return SetSoftwareBrightnessX11(outputName, gamma);
+  return true;
 }
 
-// ── Method channel handler ─────────────────────────────────────────
-
 static void brightness_method_call_handler(FlMethodChannel* channel,
                                            FlMethodCall* method_call,
                                            gpointer user_data) {
   const gchar* method = fl_method_call_get_name(method_call);
+  TraceSpan span("channel", method);
 
   if (strcmp(method, "getDisplays") == 0) {
-    g_autoptr(FlValue) list = fl_value_new_list();
-
-    // 1) Try sysfs backlight (built-in laptop display).
-    std::string backlightPath = FindBacklightPath();
-    if (!backlightPath.empty()) {
-      g_autoptr(FlValue) display = fl_value_new_map();
-      fl_value_set_string_take(display, "id", fl_value_new_string("backlight"));
-
-      std::string driverName = std::filesystem::path(backlightPath).filename().string();
-      std::string displayName = "Built-in Display (" + driverName + ")";
-      fl_value_set_string_take(display, "name", fl_value_new_string(displayName.c_str()));
-      fl_value_set_string_take(display, "brightness",
-                               fl_value_new_float(GetBacklightBrightness(backlightPath)));
-      fl_value_set_string_take(display, "isBuiltIn", fl_value_new_bool(TRUE));
-      fl_value_append_take(list, fl_value_ref(display));
-    }
-
-    // 2) Enumerate external monitors via DRM sysfs.
-    g_drmDisplays = EnumerateDrmDisplays();
-    for (const auto& disp : g_drmDisplays) {
-      // Skip built-in displays if we already have a backlight entry.
-      if (!backlightPath.empty() && disp.isBuiltIn) continue;
-
-      g_autoptr(FlValue) display = fl_value_new_map();
-
-      std::string id = "drm:" + disp.connector;
-      fl_value_set_string_take(display, "id", fl_value_new_string(id.c_str()));
-
-      std::string name = disp.edidName.empty() ? disp.xrandrName : disp.edidName;
-      fl_value_set_string_take(display, "name", fl_value_new_string(name.c_str()));
-
-      double brightness = GetDisplayBrightness(disp);
-      fl_value_set_string_take(display, "brightness", fl_value_new_float(brightness));
-      fl_value_set_string_take(display, "isBuiltIn", fl_value_new_bool(disp.isBuiltIn));
-      fl_value_append_take(list, fl_value_ref(display));
-    }
-
-    fl_method_call_respond_success(method_call, list, nullptr);
+    FlMethodCall* call = FL_METHOD_CALL(g_object_ref(method_call));
+    WhenDisplaysReady([call]() {
+      g_autoptr(FlValue) list = TakeDisplayList();
+      NoteListedBrightness(list);
+      fl_method_call_respond_success(call, list, nullptr);
+      g_object_unref(call);
+    });
 
   } else if (strcmp(method, "setBrightness") == 0) {
     FlValue* args = fl_method_call_get_args(method_call);
@@ -1073,26 +6993,29 @@ static void brightness_method_call_handler(FlMethodChannel* channel,
     const char* displayId = fl_value_get_string(idVal);
     double brightness = fl_value_get_float(brVal);
     bool success = false;
+    CancelTransition(displayId);
 
     if (strcmp(displayId, "backlight") == 0) {
       std::string backlightPath = FindBacklightPath();
       if (!backlightPath.empty()) {
         success = SetBacklightBrightness(backlightPath, brightness);
+        if (success && AppliedGamma(displayId) >= 1.0)
+          NoteBrightness(displayId, std::clamp(brightness, 0.0, 1.0));
       }
     } else {
-      // Find the matching DRM display from cached list.
-      std::string idStr(displayId);
-      bool found = false;
-      for (const auto& disp : g_drmDisplays) {
-        if (("drm:" + disp.connector) == idStr) {
-          success = SetDisplayBrightness(disp, brightness);
-          found = true;
-          break;
-        }
-      }
-      if (!found) {
-        // Display not found in cached list — likely stale data.
+      // Find the matching DRM display in the registry.
+      // ddcutil/xrandr fallbacks answer from the main loop.
+      RegistryView registry;
+      if (const DrmDisplay* disp = registry->FindDrm(displayId)) {
+        SetDisplayBrightnessAsync(*disp, brightness,
+                                  [id = std::string(displayId), brightness,
+                                   respond = RespondBoolLater(method_call)](bool ok) {
+          if (ok && AppliedGamma(id) >= 1.0) NoteBrightness(id, std::clamp(brightness, 0.0, 1.0));
+          respond(ok);
+        });
+        return;
       }
+      // Display not found in cached list — likely stale data.
     }
 
     g_autoptr(FlValue) result = fl_value_new_bool(success);
@@ -1115,10 +7038,428 @@ static void brightness_method_call_handler(FlMethodChannel* channel,
 
     const char* displayId = fl_value_get_string(idVal);
     double gamma = fl_value_get_float(gammaVal);
+    CancelTransition(displayId);
 
-    bool success = SetSoftwareBrightness(displayId, gamma);
+    SetSoftwareBrightness(displayId, gamma, RespondBoolLater(method_call));
 
-    g_autoptr(FlValue) result = fl_value_new_bool(success);
+  } else if (strcmp(method, "vcpBatch") == 0) {
+    // Args: {displayId, features: [{code: int|String, value?: int}]}.
+    // A feature with a value is written, one without is read.
+    FlValue* args = fl_method_call_get_args(method_call);
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Expected map", nullptr, nullptr);
+      return;
+    }
+
+    FlValue* idVal = fl_value_lookup_string(args, "displayId");
+    FlValue* featuresVal = fl_value_lookup_string(args, "features");
+    if (!idVal || !featuresVal ||
+        fl_value_get_type(featuresVal) != FL_VALUE_TYPE_LIST) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Missing displayId or features", nullptr, nullptr);
+      return;
+    }
+
+    std::vector<VcpOp> ops;
+    size_t count = fl_value_get_length(featuresVal);
+    for (size_t i = 0; i < count; i++) {
+      FlValue* f = fl_value_get_list_value(featuresVal, i);
+      FlValue* codeVal = fl_value_get_type(f) == FL_VALUE_TYPE_MAP
+                             ? fl_value_lookup_string(f, "code")
+                             : nullptr;
+      int code = -1;
+      if (codeVal && fl_value_get_type(codeVal) == FL_VALUE_TYPE_INT) {
+        code = static_cast<int>(fl_value_get_int(codeVal));
+      } else if (codeVal && fl_value_get_type(codeVal) == FL_VALUE_TYPE_STRING) {
+        code = VcpCodeForName(fl_value_get_string(codeVal));
+      }
+      if (code < 0 || code > 0xFF) {
+        fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                     "Unknown VCP code", nullptr, nullptr);
+        return;
+      }
+
+      VcpOp op = {};
+      op.code = static_cast<uint8_t>(code);
+      FlValue* valueVal = fl_value_lookup_string(f, "value");
+      if (valueVal && fl_value_get_type(valueVal) == FL_VALUE_TYPE_INT) {
+        op.isSet = true;
+        op.value = static_cast<int>(fl_value_get_int(valueVal));
+      }
+      ops.push_back(op);
+    }
+
+    std::string idStr(fl_value_get_string(idVal));
+    RegistryView registry;
+    const DrmDisplay* disp = registry->FindDrm(idStr);
+    if (!disp) {
+      RespondVcpBatch(method_call, ops);  // Every op fails.
+      return;
+    }
+    for (auto& op : ops) {
+      op.skip = DdcFeatureSupport(*disp, op.code) == DdcSupport::kUnsupported;
+    }
+    StartVcpBatch(method_call, std::move(idStr), DdcBusesFor(*disp), std::move(ops));
+
+  } else if (strcmp(method, "setEffectiveBrightness") == 0) {
+    // Args: {displayId, value} with value in [-0.5, 1.0].
+    FlValue* args = fl_method_call_get_args(method_call);
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Expected map", nullptr, nullptr);
+      return;
+    }
+    FlValue* idVal = fl_value_lookup_string(args, "displayId");
+    FlValue* valueVal = fl_value_lookup_string(args, "value");
+    if (!idVal || !valueVal) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Missing displayId or value", nullptr, nullptr);
+      return;
+    }
+    double value;
+    if (fl_value_get_type(idVal) != FL_VALUE_TYPE_STRING || !NumberFromFlValue(valueVal, value)) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Expected string displayId and numeric value", nullptr, nullptr);
+      return;
+    }
+
+    SetEffectiveBrightness(fl_value_get_string(idVal), value, RespondBoolLater(method_call));
+
+  } else if (strcmp(method, "setBrightnessBatch") == 0) {
+    // Args: {displays: [{displayId, brightness, gamma?}]}.  Responds with
+    // [{displayId, ok}] in request order once every display is done.
+    FlValue* args = fl_method_call_get_args(method_call);
+    FlValue* displaysVal = fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                               ? fl_value_lookup_string(args, "displays")
+                               : nullptr;
+    if (!displaysVal || fl_value_get_type(displaysVal) != FL_VALUE_TYPE_LIST) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Expected map with displays list", nullptr, nullptr);
+      return;
+    }
+
+    std::vector<BatchSetJob> jobs;
+    size_t count = fl_value_get_length(displaysVal);
+    for (size_t i = 0; i < count; i++) {
+      FlValue* entry = fl_value_get_list_value(displaysVal, i);
+      FlValue* idVal = fl_value_get_type(entry) == FL_VALUE_TYPE_MAP
+                           ? fl_value_lookup_string(entry, "displayId")
+                           : nullptr;
+      FlValue* brVal = idVal ? fl_value_lookup_string(entry, "brightness") : nullptr;
+      if (!idVal || !brVal) {
+        fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                     "Missing displayId or brightness", nullptr, nullptr);
+        return;
+      }
+      BatchSetJob job = {};
+      if (fl_value_get_type(idVal) != FL_VALUE_TYPE_STRING ||
+          !NumberFromFlValue(brVal, job.brightness)) {
+        fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                     "Expected string displayId and numeric brightness",
+                                     nullptr, nullptr);
+        return;
+      }
+      job.displayId = fl_value_get_string(idVal);
+      // Two jobs for one display would race each other on its bus.
+      for (const auto& other : jobs) {
+        if (other.displayId == job.displayId) {
+          fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                       "Duplicate displayId", nullptr, nullptr);
+          return;
+        }
+      }
+      FlValue* gammaVal = fl_value_lookup_string(entry, "gamma");
+      job.hasGamma = gammaVal && NumberFromFlValue(gammaVal, job.gamma);
+      if (!job.hasGamma) job.gamma = 1.0;
+      jobs.push_back(std::move(job));
+    }
+
+    StartBatchSet(method_call, std::move(jobs));
+
+  } else if (strcmp(method, "transitionBrightness") == 0) {
+    // Args: {displayId, target, durationMs, curve?, from?}.  Responds with
+    // a bool once the fade has finished.
+    FlValue* args = fl_method_call_get_args(method_call);
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Expected map", nullptr, nullptr);
+      return;
+    }
+    FlValue* idVal = fl_value_lookup_string(args, "displayId");
+    FlValue* targetVal = fl_value_lookup_string(args, "target");
+    FlValue* durationVal = fl_value_lookup_string(args, "durationMs");
+    if (!idVal || !targetVal || !durationVal) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Missing displayId, target or durationMs", nullptr, nullptr);
+      return;
+    }
+    double target;
+    if (fl_value_get_type(idVal) != FL_VALUE_TYPE_STRING || !NumberFromFlValue(targetVal, target) ||
+        fl_value_get_type(durationVal) != FL_VALUE_TYPE_INT) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Expected string displayId, numeric target and int durationMs",
+                                   nullptr, nullptr);
+      return;
+    }
+    FlValue* curveVal = fl_value_lookup_string(args, "curve");
+    FlValue* fromVal = fl_value_lookup_string(args, "from");
+
+    const char* curveName = curveVal && fl_value_get_type(curveVal) == FL_VALUE_TYPE_STRING
+                                ? fl_value_get_string(curveVal)
+                                : nullptr;
+    double from = fromVal && fl_value_get_type(fromVal) == FL_VALUE_TYPE_FLOAT
+                      ? fl_value_get_float(fromVal)
+                      : -1.0;
+
+    if (!StartTransition(fl_value_get_string(idVal), target, from,
+                         fl_value_get_int(durationVal), TransitionCurveFromName(curveName),
+                         method_call)) {
+      g_autoptr(FlValue) result = fl_value_new_bool(FALSE);
+      fl_method_call_respond_success(method_call, result, nullptr);
+    }
+
+  } else if (strcmp(method, "getCapabilities") == 0) {
+    // Args: {displayId, refresh?: bool}.  Returns the parsed MCCS
+    // capabilities, or null if the monitor does not provide them.
+    FlValue* args = fl_method_call_get_args(method_call);
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Expected map", nullptr, nullptr);
+      return;
+    }
+    FlValue* idVal = fl_value_lookup_string(args, "displayId");
+    if (!idVal) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                   "Missing displayId", nullptr, nullptr);
+      return;
+    }
+    FlValue* refreshVal = fl_value_lookup_string(args, "refresh");
+    bool refresh = refreshVal && fl_value_get_type(refreshVal) == FL_VALUE_TYPE_BOOL &&
+                   fl_value_get_bool(refreshVal);
+
+    RegistryView registry;
+    if (const DrmDisplay* disp = registry->FindDrm(fl_value_get_string(idVal))) {
+      StartCapabilitiesFetch(method_call, *disp, refresh);
+      return;
+    }
+
+    g_autoptr(FlValue) result = fl_value_new_null();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "getStats") == 0) {
+    // Args: {reset?: bool}.  Returns {bucketBoundsUs, backends, displays,
+    // skippedWrites, resident?}; see BackendStatsToFlValue for the
+    // per-backend map and ResidentUsageToFlValue for resident.
+    FlValue* args = fl_method_call_get_args(method_call);
+    FlValue* resetVal = fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                            ? fl_value_lookup_string(args, "reset")
+                            : nullptr;
+    bool reset = resetVal && fl_value_get_type(resetVal) == FL_VALUE_TYPE_BOOL &&
+                 fl_value_get_bool(resetVal);
+
+    g_autoptr(FlValue) result = fl_value_new_map();
+    fl_value_set_string_take(
+        result, "bucketBoundsUs",
+        fl_value_new_int64_list(kLatencyBucketBoundsUs, kLatencyBucketCount - 1));
+    fl_value_set_string_take(result, "backends", BackendStatsSetToFlValue(g_backendStats));
+
+    FlValue* displays = fl_value_new_map();
+    for (const auto& slot : g_displayStats) {
+      if (slot.state.load(std::memory_order_acquire) != 2) continue;
+      fl_value_set_string_take(displays, slot.id, BackendStatsSetToFlValue(slot.backends));
+    }
+    fl_value_set_string_take(result, "displays", displays);
+
+    FlValue* skipped = fl_value_new_map();
+    for (size_t i = 0; i < static_cast<size_t>(WriteBackend::kCount); i++) {
+      fl_value_set_string_take(
+          skipped, kWriteBackendNames[i],
+          fl_value_new_int(static_cast<int64_t>(g_skippedWrites[i].load(std::memory_order_relaxed))));
+    }
+    fl_value_set_string_take(result, "skippedWrites", skipped);
+    if (g_resident.enabled) fl_value_set_string_take(result, "resident", ResidentUsageToFlValue());
+
+    if (reset) {
+      for (auto& stats : g_backendStats) ResetBackendStats(stats);
+      for (auto& slot : g_displayStats) {
+        for (auto& stats : slot.backends) ResetBackendStats(stats);
+      }
+      for (auto& counter : g_skippedWrites) counter.store(0, std::memory_order_relaxed);
+    }
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "getAutoBrightness") == 0) {
+    g_autoptr(FlValue) result = AmbientLightToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "setAutoBrightness") == 0) {
+    // Args: {enabled, displays?: [id], curves?: {id: [[lux, brightness]]}}.
+    // Returns the getAutoBrightness map; "error" says why enabling failed.
+    FlValue* args = fl_method_call_get_args(method_call);
+    if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Expected map", nullptr, nullptr);
+      return;
+    }
+    FlValue* enabledVal = fl_value_lookup_string(args, "enabled");
+    if (!enabledVal || fl_value_get_type(enabledVal) != FL_VALUE_TYPE_BOOL) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Missing enabled", nullptr,
+                                   nullptr);
+      return;
+    }
+    std::map<std::string, std::vector<AmbientCurvePoint>> curves;
+    FlValue* curvesVal = fl_value_lookup_string(args, "curves");
+    if (curvesVal && fl_value_get_type(curvesVal) == FL_VALUE_TYPE_MAP) {
+      for (size_t i = 0; i < fl_value_get_length(curvesVal); i++) {
+        FlValue* key = fl_value_get_map_key(curvesVal, i);
+        std::vector<AmbientCurvePoint> curve;
+        if (fl_value_get_type(key) != FL_VALUE_TYPE_STRING ||
+            !AmbientCurveFromFlValue(fl_value_get_map_value(curvesVal, i), curve)) {
+          fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                       "Curves must be [[lux, brightness]] with rising lux",
+                                       nullptr, nullptr);
+          return;
+        }
+        curves[fl_value_get_string(key)] = std::move(curve);
+      }
+    }
+    FlValue* displaysVal = fl_value_lookup_string(args, "displays");
+    if (displaysVal && fl_value_get_type(displaysVal) == FL_VALUE_TYPE_LIST) {
+      g_ambient.only.clear();
+      for (size_t i = 0; i < fl_value_get_length(displaysVal); i++) {
+        FlValue* id = fl_value_get_list_value(displaysVal, i);
+        if (fl_value_get_type(id) == FL_VALUE_TYPE_STRING)
+          g_ambient.only.push_back(fl_value_get_string(id));
+      }
+    } else if (displaysVal) {
+      g_ambient.only.clear();  // null: every display.
+    }
+    for (auto& [id, curve] : curves) {
+      AmbientDisplay& d = g_ambient.displays[id];
+      d.curve = std::move(curve);
+      d.offset = 0.0;
+      d.target = -1.0;
+    }
+
+    if (!fl_value_get_bool(enabledVal)) {
+      StopAmbientLight();
+    } else if (g_ambient.enabled) {
+      if (g_ambient.lux >= 0.0) RetargetAmbientDisplays();
+    } else {
+      StartAmbientLight();
+    }
+    g_autoptr(FlValue) result = AmbientLightToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "getSchedule") == 0) {
+    g_autoptr(FlValue) result = ScheduleToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "setSchedule") == 0) {
+    // Args: {entries: [{at, offsetMinutes?, rampMs?, values}], latitude?,
+    // longitude?}.  Replaces the schedule, saves it and applies the entry
+    // now in effect.  Returns the getSchedule map.
+    FlValue* args = fl_method_call_get_args(method_call);
+    FlValue* entriesVal =
+        fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "entries")
+                                                     : nullptr;
+    if (!entriesVal || fl_value_get_type(entriesVal) != FL_VALUE_TYPE_LIST) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Missing entries", nullptr,
+                                   nullptr);
+      return;
+    }
+    std::vector<ScheduleEntry> entries;
+    for (size_t i = 0; i < fl_value_get_length(entriesVal); i++) {
+      ScheduleEntry entry;
+      if (!ScheduleEntryFromFlValue(fl_value_get_list_value(entriesVal, i), entry)) {
+        g_autofree gchar* message = g_strdup_printf("Invalid schedule entry %zu", i);
+        fl_method_call_respond_error(method_call, "INVALID_ARGS", message, nullptr, nullptr);
+        return;
+      }
+      entries.push_back(std::move(entry));
+    }
+    FlValue* latVal = fl_value_lookup_string(args, "latitude");
+    FlValue* lngVal = fl_value_lookup_string(args, "longitude");
+    bool hasLocation = latVal && lngVal && fl_value_get_type(latVal) == FL_VALUE_TYPE_FLOAT &&
+                       fl_value_get_type(lngVal) == FL_VALUE_TYPE_FLOAT;
+    double latitude = hasLocation ? fl_value_get_float(latVal) : 0.0;
+    double longitude = hasLocation ? fl_value_get_float(lngVal) : 0.0;
+    if (hasLocation && (std::fabs(latitude) > 90.0 || std::fabs(longitude) > 180.0)) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Location out of range",
+                                   nullptr, nullptr);
+      return;
+    }
+    g_schedule.entries = std::move(entries);
+    g_schedule.hasLocation = hasLocation;
+    g_schedule.latitude = latitude;
+    g_schedule.longitude = longitude;
+    if (!SaveSchedule()) {
+      fprintf(stderr, "[BSDisplayControl] Schedule: could not save %s\n",
+              ScheduleConfigPath().c_str());
+    }
+    StartSchedule(true);
+    g_autoptr(FlValue) result = ScheduleToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "getBrightnessHotkeys") == 0) {
+    g_autoptr(FlValue) result = BrightnessHotkeysToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "setBrightnessHotkeys") == 0) {
+    // Args: {enabled, displays?: "external" | "all" | [id]}.  Returns the
+    // getBrightnessHotkeys map; "error" says why no keyboard is listened to.
+    FlValue* args = fl_method_call_get_args(method_call);
+    FlValue* enabledVal =
+        fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "enabled")
+                                                     : nullptr;
+    if (!enabledVal || fl_value_get_type(enabledVal) != FL_VALUE_TYPE_BOOL) {
+      fl_method_call_respond_error(method_call, "INVALID_ARGS", "Missing enabled", nullptr,
+                                   nullptr);
+      return;
+    }
+    FlValue* displaysVal = fl_value_lookup_string(args, "displays");
+    if (displaysVal && fl_value_get_type(displaysVal) == FL_VALUE_TYPE_LIST) {
+      g_hotkeys.targets = "list";
+      g_hotkeys.only.clear();
+      for (size_t i = 0; i < fl_value_get_length(displaysVal); i++) {
+        FlValue* id = fl_value_get_list_value(displaysVal, i);
+        if (fl_value_get_type(id) == FL_VALUE_TYPE_STRING)
+          g_hotkeys.only.push_back(fl_value_get_string(id));
+      }
+    } else if (displaysVal && fl_value_get_type(displaysVal) == FL_VALUE_TYPE_STRING) {
+      const gchar* targets = fl_value_get_string(displaysVal);
+      if (strcmp(targets, "external") != 0 && strcmp(targets, "all") != 0) {
+        fl_method_call_respond_error(method_call, "INVALID_ARGS",
+                                     "displays must be \"external\", \"all\" or a list",
+                                     nullptr, nullptr);
+        return;
+      }
+      g_hotkeys.targets = targets;
+      g_hotkeys.only.clear();
+    }
+    if (fl_value_get_bool(enabledVal)) {
+      StartBrightnessHotkeys();
+    } else {
+      StopBrightnessHotkeys();
+    }
+    g_autoptr(FlValue) result = BrightnessHotkeysToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "getI2cStatus") == 0) {
+    // {access, setup, buses}; access is as of the last display probe.
+    g_autoptr(FlValue) result = I2cStatusToFlValue();
+    fl_method_call_respond_success(method_call, result, nullptr);
+
+  } else if (strcmp(method, "setupI2cPermissions") == 0) {
+    // Shows the PolicyKit dialog; answers with the new status once it is
+    // dismissed.  Never blocks the main loop.
+    FlMethodCall* call = FL_METHOD_CALL(g_object_ref(method_call));
+    StartI2cSetup([call] {
+      g_autoptr(FlValue) result = I2cStatusToFlValue();
+      fl_method_call_respond_success(call, result, nullptr);
+      g_object_unref(call);
+    });
+
+  } else if (strcmp(method, "flushTrace") == 0) {
+    // Path of the written trace file, or null when tracing is off.
+    g_autoptr(FlValue) result = FlushTrace() ? fl_value_new_string(g_tracePath.c_str())
+                                             : fl_value_new_null();
     fl_method_call_respond_success(method_call, result, nullptr);
 
   } else {
@@ -1126,23 +7467,299 @@ static void brightness_method_call_handler(FlMethodChannel* channel,
   }
 }
 
+static FlMethodChannel* g_brightnessChannel = nullptr;
+
+// Forward the change feed to Dart as brightnessChanged({displayId, value}),
+// so the UI follows socket and tray writes, including while hidden.
+static void NotifyDartBrightness(const std::string& displayId, double value) {
+  if (!g_brightnessChannel) return;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "displayId", fl_value_new_string(displayId.c_str()));
+  fl_value_set_string_take(args, "value", fl_value_new_float(value));
+  fl_method_channel_invoke_method(g_brightnessChannel, "brightnessChanged", args, nullptr,
+                                  nullptr, nullptr);
+}
+
+// Push i2cStatusChanged({access, setup, buses}) when a probe or the setup
+// changes what getI2cStatus would answer.
+static void NotifyDartI2cStatus() {
+  if (!g_brightnessChannel) return;
+  g_autoptr(FlValue) args = I2cStatusToFlValue();
+  fl_method_channel_invoke_method(g_brightnessChannel, "i2cStatusChanged", args, nullptr,
+                                  nullptr, nullptr);
+}
+
+// ── Headless command line ──────────────────────────────────────────
+//
+// For hotkey scripts:
+//
+//   bs_display_control --get [ID]
+//   bs_display_control --set ID=VALUE [--set ID=VALUE ...]
+//   bs_display_control --serve     (resident; see Control socket)
+//
+// my_application_local_command_line runs these against the native backends
+// and exits without registering the application, so neither GTK nor the
+// Flutter engine is started.  Results are printed to stdout as JSON (the
+// getDisplays list, or one {displayId, ok} per --set); diagnostics stay on
+// stderr.  VALUE is the unified slider value, -0.5 to 1.0: 0.0-1.0 is
+// hardware brightness and negative values add gamma dimming.  A fresh
+// process does not know whether an earlier one left gamma dimmed, so a
+// non-negative VALUE always writes gamma 1.0 as well.  Under wlroots the
+// compositor drops gamma set by a client when it exits, so a negative
+// VALUE fails there; use --serve.
+//
+// Exit status: 0 on success, 1 if a display was not found or a write
+// failed, 2 for a malformed command line (including unknown arguments).
+
+struct HeadlessCommand {
+  bool serve = false;
+  bool get = false;
+  std::string getId;  // Empty: every display.
+  std::vector<std::pair<std::string, double>> sets;
+};
+
+static void AppendFlValueJson(std::string& out, FlValue* value) {
+  char buf[32];
+  switch (fl_value_get_type(value)) {
+    case FL_VALUE_TYPE_BOOL:
+      out += fl_value_get_bool(value) ? "true" : "false";
+      break;
+    case FL_VALUE_TYPE_INT:
+      snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(fl_value_get_int(value)));
+      out += buf;
+      break;
+    case FL_VALUE_TYPE_FLOAT:
+      if (std::isfinite(fl_value_get_float(value))) {
+        snprintf(buf, sizeof(buf), "%.6g", fl_value_get_float(value));
+        out += buf;
+      } else {
+        out += "null";
+      }
+      break;
+    case FL_VALUE_TYPE_STRING:
+      AppendJsonString(out, fl_value_get_string(value));
+      break;
+    case FL_VALUE_TYPE_LIST:
+      out += '[';
+      for (size_t i = 0; i < fl_value_get_length(value); i++) {
+        if (i > 0) out += ',';
+        AppendFlValueJson(out, fl_value_get_list_value(value, i));
+      }
+      out += ']';
+      break;
+    case FL_VALUE_TYPE_MAP:
+      out += '{';
+      for (size_t i = 0; i < fl_value_get_length(value); i++) {
+        if (i > 0) out += ',';
+        AppendFlValueJson(out, fl_value_get_map_key(value, i));
+        out += ':';
+        AppendFlValueJson(out, fl_value_get_map_value(value, i));
+      }
+      out += '}';
+      break;
+    default:
+      out += "null";  // Typed lists are never produced here.
+      break;
+  }
+}
+
+// Parse the control options out of |args| (NULL-terminated, program name
+// excluded).  Returns false when there are none, so the GUI starts.  On a
+// malformed command line, including any argument that is not a control
+// option, returns true with |error| set.
+static bool ParseHeadlessCommand(gchar** args, HeadlessCommand& cmd, std::string& error) {
+  bool found = false;
+  const char* unknown = nullptr;
+  for (gchar** arg = args; *arg; arg++) {
+    if (strcmp(*arg, "--serve") == 0) {
+      found = true;
+      cmd.serve = true;
+    } else if (strcmp(*arg, "--get") == 0) {
+      found = true;
+      cmd.get = true;
+      if (arg[1] && arg[1][0] != '-') cmd.getId = *++arg;
+    } else if (strcmp(*arg, "--set") == 0 || g_str_has_prefix(*arg, "--set=")) {
+      found = true;
+      const char* spec = *arg + strlen("--set=");
+      if (strcmp(*arg, "--set") == 0) spec = arg[1] ? *++arg : "";
+      const char* eq = strrchr(spec, '=');
+      char* end = nullptr;
+      double value = eq ? g_ascii_strtod(eq + 1, &end) : 0.0;
+      if (!eq || eq == spec || end == eq + 1 || *end != '\0' || !std::isfinite(value)) {
+        error = "--set expects ID=VALUE";
+        return true;
+      }
+      cmd.sets.emplace_back(std::string(spec, static_cast<size_t>(eq - spec)), value);
+    } else if (!unknown) {
+      unknown = *arg;
+    }
+  }
+  if (!found) return false;
+  if (unknown) {
+    error = std::string("unknown argument ") + unknown;
+  } else if (cmd.serve + cmd.get + !cmd.sets.empty() > 1) {
+    error = "--serve, --get and --set cannot be combined";
+  }
+  return true;
+}
+
+// SIGINT/SIGTERM in --serve mode: leave the main loop so the socket is removed.
+static gboolean OnServeSignal(gpointer user_data) {
+  g_main_loop_quit(static_cast<GMainLoop*>(user_data));
+  return G_SOURCE_REMOVE;
+}
+
+// Run a parsed command and print its JSON result.  Returns the exit status.
+static int RunHeadlessCommand(const HeadlessCommand& cmd) {
+  if (cmd.serve) {
+    StartStartupProbe();  // Requests wait for it through WhenDisplaysReady().
+    if (!StartControlSocket()) return 1;
+    GMainLoop* loop = g_main_loop_new(nullptr, FALSE);
+    g_unix_signal_add(SIGINT, OnServeSignal, loop);
+    g_unix_signal_add(SIGTERM, OnServeSignal, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+    StopControlSocket();
+    return 0;
+  }
+
+  std::string json;
+  int status = 0;
+
+  if (cmd.get) {
+    g_autoptr(FlValue) list = ListDisplays(cmd.getId.empty() ? nullptr : cmd.getId.c_str());
+    if (!cmd.getId.empty() && fl_value_get_length(list) == 0) status = 1;
+    AppendFlValueJson(json, list);
+  } else {
+    PublishDrmDisplays(EnumerateDrmDisplays());
+    g_wlrOneShot = true;
+
+    // Nothing is known about gamma yet, so SetEffectiveBrightness() also
+    // writes gamma 1.0 for a non-negative value, clearing a trim an
+    // earlier negative --set left.
+    //
+    // The set cascade finishes ddcutil/xrandr fallbacks on the main loop,
+    // which is not running yet; drive the default context until every
+    // write has answered.
+    std::vector<bool> results(cmd.sets.size(), false);
+    size_t pending = cmd.sets.size();
+    for (size_t i = 0; i < cmd.sets.size(); i++) {
+      SetEffectiveBrightness(cmd.sets[i].first.c_str(), cmd.sets[i].second,
+                             [&results, &pending, i](bool ok) {
+        results[i] = ok;
+        pending--;
+      });
+    }
+    while (pending > 0) g_main_context_iteration(nullptr, TRUE);
+
+    g_autoptr(FlValue) list = fl_value_new_list();
+    for (size_t i = 0; i < cmd.sets.size(); i++) {
+      g_autoptr(FlValue) entry = fl_value_new_map();
+      fl_value_set_string_take(entry, "displayId",
+                               fl_value_new_string(cmd.sets[i].first.c_str()));
+      fl_value_set_string_take(entry, "ok", fl_value_new_bool(results[i]));
+      fl_value_append_take(list, fl_value_ref(entry));
+      if (!results[i]) status = 1;
+    }
+    AppendFlValueJson(json, list);
+  }
+
+  json += '\n';
+  fwrite(json.data(), 1, json.size(), stdout);
+  fflush(stdout);
+  return status;
+}
+
 // ── Application implementation ─────────────────────────────────────
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  GtkWindow* window;  // Created by the first activation.
+  FlView* view;
+  FlBasicMessageChannel* system_channel;
+  gboolean resident;      // --tray: closing only hides the window.
+  gboolean start_hidden;  // Stay hidden after the first frame.
+  gboolean first_frame;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
 
 static void first_frame_cb(MyApplication* self, FlView* view) {
+  self->first_frame = TRUE;
+  if (self->start_hidden) {
+    ResidentWindowHidden();
+    return;
+  }
   gtk_widget_show(gtk_widget_get_toplevel(GTK_WIDGET(view)));
 }
 
+static void my_application_show(MyApplication* self) {
+  ResidentShowRequested();
+  self->start_hidden = FALSE;
+  // Before the first frame, first_frame_cb shows it.
+  if (self->first_frame) gtk_window_present(self->window);
+}
+
+static void my_application_hide(MyApplication* self) {
+  if (!gtk_widget_get_visible(GTK_WIDGET(self->window))) return;
+  gtk_widget_hide(GTK_WIDGET(self->window));
+
+  // Let the framework drop its image and shader caches, as mobile
+  // embedders do on low memory.
+  g_autoptr(FlValue) message = fl_value_new_map();
+  fl_value_set_string_take(message, "type", fl_value_new_string("memoryPressure"));
+  fl_basic_message_channel_send(self->system_channel, message, nullptr, nullptr, nullptr);
+  ResidentWindowHidden();
+}
+
+static void my_application_toggle(MyApplication* self) {
+  if (gtk_widget_get_visible(GTK_WIDGET(self->window))) {
+    my_application_hide(self);
+  } else {
+    my_application_show(self);
+  }
+}
+
+static gboolean window_delete_cb(GtkWidget* widget, GdkEvent* event, gpointer user_data) {
+  MyApplication* self = MY_APPLICATION(user_data);
+  if (!self->resident) return FALSE;
+  my_application_hide(self);
+  return TRUE;
+}
+
+static gboolean window_map_cb(GtkWidget* widget, GdkEvent* event, gpointer user_data) {
+  ResidentWindowShown();
+  return FALSE;
+}
+
+static void window_destroy_cb(GtkWidget* widget, gpointer user_data) {
+  MyApplication* self = MY_APPLICATION(user_data);
+  self->window = nullptr;
+  self->view = nullptr;
+  g_brightnessChannel = nullptr;
+}
+
+static gboolean quit_signal_cb(gpointer user_data) {
+  g_application_quit(G_APPLICATION(user_data));
+  return G_SOURCE_CONTINUE;
+}
+
 static void my_application_activate(GApplication* application) {
   MyApplication* self = MY_APPLICATION(application);
+  // Single instance: later launches and the tray icon reuse the window
+  // and its running engine.
+  if (self->window) {
+    my_application_show(self);
+    return;
+  }
+
   GtkWindow* window =
       GTK_WINDOW(gtk_application_window_new(GTK_APPLICATION(application)));
+  self->window = window;
+  g_signal_connect(window, "delete-event", G_CALLBACK(window_delete_cb), self);
+  g_signal_connect(window, "map-event", G_CALLBACK(window_map_cb), self);
+  g_signal_connect(window, "destroy", G_CALLBACK(window_destroy_cb), self);
 
   gboolean use_header_bar = TRUE;
 #ifdef GDK_WINDOWING_X11
@@ -1176,6 +7793,7 @@ static void my_application_activate(GApplication* application) {
   fl_view_set_background_color(view, &background_color);
   gtk_widget_show(GTK_WIDGET(view));
   gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(view));
+  self->view = view;
 
   // Register the brightness method channel.
   g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
@@ -1186,6 +7804,25 @@ static void my_application_activate(GApplication* application) {
   fl_method_channel_set_method_call_handler(brightness_channel,
                                             brightness_method_call_handler,
                                             nullptr, nullptr);
+  g_brightnessChannel = brightness_channel;
+  g_brightnessListeners.push_back(NotifyDartBrightness);
+  g_i2cStatusListener = NotifyDartI2cStatus;
+  StartControlSocket();
+
+  g_autoptr(FlJsonMessageCodec) json_codec = fl_json_message_codec_new();
+  self->system_channel = fl_basic_message_channel_new(
+      fl_engine_get_binary_messenger(fl_view_get_engine(view)), "flutter/system",
+      FL_MESSAGE_CODEC(json_codec));
+
+  if (self->resident) {
+    g_resident.enabled = true;
+    g_tray.toggle = [self] { my_application_toggle(self); };
+    g_tray.show = [self] { my_application_show(self); };
+    g_tray.quit = [application] { g_application_quit(application); };
+    StartTrayIcon(g_application_get_dbus_connection(application));
+    g_unix_signal_add(SIGINT, quit_signal_cb, application);
+    g_unix_signal_add(SIGTERM, quit_signal_cb, application);
+  }
 
   g_signal_connect_swapped(view, "first-frame", G_CALLBACK(first_frame_cb),
                            self);
@@ -1200,7 +7837,52 @@ static gboolean my_application_local_command_line(GApplication* application,
                                                   gchar*** arguments,
                                                   int* exit_status) {
   MyApplication* self = MY_APPLICATION(application);
-  self->dart_entrypoint_arguments = g_strdupv(*arguments + 1);
+
+  // --trace[=FILE] and --tray are ours; everything else goes to Dart.
+  const char* tracePath = getenv("BS_DISPLAY_CONTROL_TRACE");
+  bool trace = tracePath && *tracePath;
+  if (trace && !strchr(tracePath, '/')) tracePath = nullptr;  // E.g. "1".
+  GPtrArray* dartArgs = g_ptr_array_new();
+  for (gchar** arg = *arguments + 1; *arg; arg++) {
+    if (strcmp(*arg, "--tray") == 0) {
+      self->resident = TRUE;
+      self->start_hidden = TRUE;
+    } else if (strcmp(*arg, "--trace") == 0) {
+      trace = true;
+      tracePath = nullptr;
+    } else if (g_str_has_prefix(*arg, "--trace=")) {
+      trace = true;
+      tracePath = *arg + strlen("--trace=");
+    } else {
+      g_ptr_array_add(dartArgs, g_strdup(*arg));
+    }
+  }
+  g_ptr_array_add(dartArgs, nullptr);
+  self->dart_entrypoint_arguments =
+      reinterpret_cast<char**>(g_ptr_array_free(dartArgs, FALSE));
+
+  if (trace) {
+    EnableTracing(tracePath);
+    g_unix_signal_add(SIGUSR1, OnTraceFlushSignal, nullptr);
+  }
+
+  // --get / --set: answer and exit before GTK or the engine start.
+  HeadlessCommand command;
+  std::string commandError;
+  if (ParseHeadlessCommand(self->dart_entrypoint_arguments, command, commandError)) {
+    if (!commandError.empty()) {
+      fprintf(stderr, "bs_display_control: %s\n"
+                      "Usage: bs_display_control --get [ID]\n"
+                      "       bs_display_control --set ID=VALUE [--set ID=VALUE ...]\n"
+                      "       bs_display_control --serve\n",
+              commandError.c_str());
+      *exit_status = 2;
+    } else {
+      *exit_status = RunHeadlessCommand(command);
+    }
+    FlushTrace();
+    return TRUE;
+  }
 
   g_autoptr(GError) error = nullptr;
   if (!g_application_register(application, nullptr, &error)) {
@@ -1209,6 +7891,13 @@ static gboolean my_application_local_command_line(GApplication* application,
     return TRUE;
   }
 
+  // Already running: a plain launch presents its window, a second --tray
+  // (e.g. autostart) does nothing.
+  if (self->resident && g_application_get_is_remote(application)) {
+    *exit_status = 0;
+    return TRUE;
+  }
+
   g_application_activate(application);
   *exit_status = 0;
 
@@ -1217,15 +7906,27 @@ static gboolean my_application_local_command_line(GApplication* application,
 
 static void my_application_startup(GApplication* application) {
   G_APPLICATION_CLASS(my_application_parent_class)->startup(application);
+  // Read the hardware while the engine boots.
+  StartStartupProbe();
+  LoadSchedule();
+  StartSchedule(true);
 }
 
 static void my_application_shutdown(GApplication* application) {
+  StopTrayIcon();
+  StopControlSocket();
+  StopAmbientLight();
+  StopSchedule();
+  StopBrightnessHotkeys();
+  StopWlrGamma();
+  FlushTrace();
   G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }
 
 static void my_application_dispose(GObject* object) {
   MyApplication* self = MY_APPLICATION(object);
   g_clear_pointer(&self->dart_entrypoint_arguments, g_strfreev);
+  g_clear_object(&self->system_channel);
   G_OBJECT_CLASS(my_application_parent_class)->dispose(object);
 }
 
@@ -1240,10 +7941,16 @@ static void my_application_class_init(MyApplicationClass* klass) {
 
 static void my_application_init(MyApplication* self) {}
 
+#if !GLIB_CHECK_VERSION(2, 74, 0)
+#define G_APPLICATION_DEFAULT_FLAGS G_APPLICATION_FLAGS_NONE
+#endif
+
 MyApplication* my_application_new() {
   g_set_prgname(APPLICATION_ID);
 
+  // Single instance: a second launch activates the first (see
+  // my_application_activate).
   return MY_APPLICATION(g_object_new(my_application_get_type(),
                                      "application-id", APPLICATION_ID, "flags",
-                                     G_APPLICATION_NON_UNIQUE, nullptr));
+                                     G_APPLICATION_DEFAULT_FLAGS, nullptr));
 }
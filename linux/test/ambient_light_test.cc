@@ -0,0 +1,134 @@
+#include "ambient_light.h"
+
+#include "test_support.h"
+
+using Elements = std::vector<std::pair<std::string, IioScanElement>>;
+
+static IioScanElement Parsed(const char* type) {
+  IioScanElement el;
+  EXPECT_TRUE(ParseIioScanType(type, el));
+  return el;
+}
+
+static void TestParseIioScanType() {
+  IioScanElement el = Parsed("le:u32/32>>0");
+  EXPECT_TRUE(!el.bigEndian && !el.isSigned);
+  EXPECT_EQ(el.bits, 32);
+  EXPECT_EQ(el.storageBits, 32);
+  EXPECT_EQ(el.repeat, 1);
+  EXPECT_EQ(el.shift, 0);
+
+  el = Parsed("be:s12/16>>4");
+  EXPECT_TRUE(el.bigEndian && el.isSigned);
+  EXPECT_EQ(el.bits, 12);
+  EXPECT_EQ(el.storageBits, 16);
+  EXPECT_EQ(el.shift, 4);
+
+  // No shift suffix, and a repeated channel.
+  el = Parsed("le:u16/16");
+  EXPECT_EQ(el.shift, 0);
+  el = Parsed("le:s16/16X3>>0");
+  EXPECT_EQ(el.repeat, 3);
+
+  IioScanElement bad;
+  EXPECT_TRUE(!ParseIioScanType("", bad));
+  EXPECT_TRUE(!ParseIioScanType("xx:u32/32", bad));
+  EXPECT_TRUE(!ParseIioScanType("le:u24/24", bad));    // Storage not a power of two.
+  EXPECT_TRUE(!ParseIioScanType("le:u33/32", bad));    // More bits than storage.
+  EXPECT_TRUE(!ParseIioScanType("le:u0/32", bad));
+  EXPECT_TRUE(!ParseIioScanType("le:u16/16>>16", bad));
+  EXPECT_TRUE(!ParseIioScanType("le:u16/16X0", bad));
+}
+
+static void TestComputeIioRecordLayout() {
+  // Sorted by index; the 64-bit timestamp is aligned to 8 bytes.
+  Elements elements = {{"in_timestamp", Parsed("le:s64/64>>0")},
+                       {"in_illuminance", Parsed("le:u16/16>>0")}};
+  elements[0].second.index = 1;
+  elements[1].second.index = 0;
+  EXPECT_EQ(ComputeIioRecordLayout(elements), 16);
+  EXPECT_TRUE(elements[0].first == "in_illuminance");
+  EXPECT_EQ(elements[0].second.offset, 0);
+  EXPECT_EQ(elements[1].second.offset, 8);
+
+  // Each element is aligned to its own storage size.
+  elements = {{"a", Parsed("le:u8/8")}, {"b", Parsed("le:u32/32")}, {"c", Parsed("le:u16/16")}};
+  for (int i = 0; i < 3; i++) elements[i].second.index = i;
+  EXPECT_EQ(ComputeIioRecordLayout(elements), 12);
+  EXPECT_EQ(elements[1].second.offset, 4);
+  EXPECT_EQ(elements[2].second.offset, 8);
+
+  // Repeats take consecutive slots; the record is padded to the largest
+  // alignment.
+  elements = {{"a", Parsed("le:u16/16X3")}, {"b", Parsed("le:u32/32")}};
+  elements[1].second.index = 1;
+  EXPECT_EQ(ComputeIioRecordLayout(elements), 12);
+  EXPECT_EQ(elements[1].second.offset, 8);
+
+  elements = {{"a", Parsed("le:u32/32")}, {"b", Parsed("le:u8/8")}};
+  elements[1].second.index = 1;
+  EXPECT_EQ(ComputeIioRecordLayout(elements), 8);
+
+  elements.clear();
+  EXPECT_EQ(ComputeIioRecordLayout(elements), 0);
+}
+
+static void TestIioSampleValue() {
+  const uint8_t le32[] = {0xe8, 0x03, 0x00, 0x00};
+  EXPECT_EQ(IioSampleValue(Parsed("le:u32/32"), le32), 1000);
+
+  const uint8_t be16[] = {0x03, 0xe8};
+  EXPECT_EQ(IioSampleValue(Parsed("be:u16/16"), be16), 1000);
+  const uint8_t le16[] = {0x03, 0xe8};
+  EXPECT_EQ(IioSampleValue(Parsed("le:u16/16"), le16), 0xe803);
+
+  // Sign extension from |bits|, not from the storage size.
+  const uint8_t minusOne[] = {0xff, 0x0f};
+  EXPECT_EQ(IioSampleValue(Parsed("le:s12/16"), minusOne), -1);
+  EXPECT_EQ(IioSampleValue(Parsed("le:u12/16"), minusOne), 4095);
+  const uint8_t minus2048[] = {0x00, 0x08};
+  EXPECT_EQ(IioSampleValue(Parsed("le:s12/16"), minus2048), -2048);
+
+  // The shift is applied before masking; bits above |bits| are ignored.
+  const uint8_t shifted[] = {0x12, 0x34};  // 0x1234 big-endian.
+  EXPECT_EQ(IioSampleValue(Parsed("be:u8/16>>4"), shifted), 0x23);
+  EXPECT_EQ(IioSampleValue(Parsed("be:s12/16>>4"), shifted), 0x123);
+  const uint8_t negShifted[] = {0xff, 0xf0};  // -1 in bits 4..15.
+  EXPECT_EQ(IioSampleValue(Parsed("be:s12/16>>4"), negShifted), -1);
+
+  const uint8_t s64[] = {0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  EXPECT_EQ(IioSampleValue(Parsed("le:s64/64"), s64), -2);
+
+  // The element's offset selects its bytes within the record.
+  IioScanElement el = Parsed("le:u16/16");
+  el.offset = 2;
+  const uint8_t record[] = {0xaa, 0xbb, 0x2a, 0x00};
+  EXPECT_EQ(IioSampleValue(el, record), 42);
+}
+
+static void TestEvaluateAmbientCurve() {
+  // The default curve at and beyond its points.
+  EXPECT_NEAR(EvaluateAmbientCurve({}, 0.0), 0.05, 1e-9);
+  EXPECT_NEAR(EvaluateAmbientCurve({}, -5.0), 0.05, 1e-9);
+  EXPECT_NEAR(EvaluateAmbientCurve({}, 100.0), 0.45, 1e-9);
+  EXPECT_NEAR(EvaluateAmbientCurve({}, 1e6), 1.0, 1e-9);
+
+  // Linear in log10(lux + 1) between points.
+  std::vector<AmbientCurvePoint> curve = {{9.0, 0.2}, {999.0, 0.6}};
+  EXPECT_NEAR(EvaluateAmbientCurve(curve, 0.0), 0.2, 1e-9);
+  EXPECT_NEAR(EvaluateAmbientCurve(curve, 99.0), 0.4, 1e-9);
+  EXPECT_NEAR(EvaluateAmbientCurve(curve, 5000.0), 0.6, 1e-9);
+
+  // A step (two points at the same lux) does not divide by zero.
+  curve = {{0.0, 0.1}, {10.0, 0.3}, {10.0, 0.7}};
+  EXPECT_NEAR(EvaluateAmbientCurve(curve, 10.0), 0.3, 1e-9);
+  EXPECT_NEAR(EvaluateAmbientCurve(curve, 11.0), 0.7, 1e-9);
+}
+
+int main() {
+  TestParseIioScanType();
+  TestComputeIioRecordLayout();
+  TestIioSampleValue();
+  TestEvaluateAmbientCurve();
+  return TestFailures();
+}
@@ -0,0 +1,180 @@
+#include "edid.h"
+
+#include <string>
+#include <vector>
+
+#include "test_support.h"
+
+// A base block for a "DEL" panel, product 0xA0B1, serial 0x12345678, with
+// the checksum fixed up.  Descriptors are added by the individual tests.
+static std::vector<uint8_t> BaseBlock() {
+  std::vector<uint8_t> edid(kEdidBlockSize, 0);
+  const uint8_t header[8] = {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00};
+  memcpy(edid.data(), header, sizeof(header));
+  edid[8] = 0x10;  // 'D' 'E' 'L' = 4, 5, 12 in 5-bit fields.
+  edid[9] = 0xAC;
+  edid[10] = 0xB1;
+  edid[11] = 0xA0;
+  edid[12] = 0x78;
+  edid[13] = 0x56;
+  edid[14] = 0x34;
+  edid[15] = 0x12;
+  edid[16] = 12;
+  edid[17] = 30;
+  edid[18] = 1;
+  edid[19] = 4;
+  return edid;
+}
+
+static void FixChecksum(std::vector<uint8_t>& edid, size_t block) {
+  uint8_t* b = edid.data() + block * kEdidBlockSize;
+  uint8_t sum = 0;
+  for (size_t i = 0; i < kEdidBlockSize - 1; ++i) sum += b[i];
+  b[kEdidBlockSize - 1] = static_cast<uint8_t>(-sum);
+}
+
+static void SetDescriptor(std::vector<uint8_t>& edid, size_t offset, uint8_t tag,
+                          const char* text) {
+  uint8_t* desc = edid.data() + offset;
+  memset(desc, 0, 18);
+  desc[3] = tag;
+  size_t n = strlen(text);
+  for (size_t i = 0; i < 13; ++i) desc[5 + i] = i < n ? text[i] : i == n ? '\n' : ' ';
+}
+
+static void TestChecksum() {
+  std::vector<uint8_t> edid = BaseBlock();
+  FixChecksum(edid, 0);
+  EdidInfo info;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(info.valid);
+  EXPECT_TRUE(info.checksumOk);
+
+  // A bad checksum is reported but does not make the block unusable.
+  edid[127]++;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(info.valid);
+  EXPECT_TRUE(!info.checksumOk);
+
+  // A wrong header or a short blob does.
+  edid[1] = 0x00;
+  EXPECT_TRUE(!DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(!info.valid);
+  edid = BaseBlock();
+  EXPECT_TRUE(!DecodeEdid(edid.data(), kEdidBlockSize - 1, info));
+}
+
+static void TestManufacturerAndSerial() {
+  std::vector<uint8_t> edid = BaseBlock();
+  FixChecksum(edid, 0);
+  EdidInfo info;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(strcmp(info.manufacturer, "DEL") == 0);
+  EXPECT_EQ(info.productCode, 0xA0B1);
+  EXPECT_EQ(info.serialNumber, 0x12345678u);
+  EXPECT_EQ(info.week, 12);
+  EXPECT_EQ(info.year, 2020);
+  EXPECT_EQ(info.versionMajor, 1);
+  EXPECT_EQ(info.versionMinor, 4);
+  EXPECT_TRUE(EdidDisplayName(info) == "DEL");
+
+  // "GSM": 7, 19, 13.
+  edid[8] = 0x1E;
+  edid[9] = 0x6D;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(strcmp(info.manufacturer, "GSM") == 0);
+}
+
+static void TestDescriptors() {
+  std::vector<uint8_t> edid = BaseBlock();
+  SetDescriptor(edid, 54, 0xFF, "ABC123  ");
+  SetDescriptor(edid, 72, 0xFC, "DELL U2720Q");
+  SetDescriptor(edid, 90, 0xFE, "LM270WR9");
+  SetDescriptor(edid, 108, 0xFC, "");
+  edid[108] = 0x01;  // Nonzero pixel clock: a timing, not a descriptor.
+  FixChecksum(edid, 0);
+  EdidInfo info;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(info.checksumOk);
+  EXPECT_TRUE(strcmp(info.serialString, "ABC123") == 0);
+  EXPECT_TRUE(strcmp(info.monitorName, "DELL U2720Q") == 0);
+  EXPECT_TRUE(strcmp(info.asciiText, "LM270WR9") == 0);
+  EXPECT_TRUE(EdidDisplayName(info) == "DELL U2720Q");
+
+  // Thirteen characters fill the field without a terminator.
+  SetDescriptor(edid, 72, 0xFC, "ABCDEFGHIJKLM");
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_TRUE(strcmp(info.monitorName, "ABCDEFGHIJKLM") == 0);
+}
+
+static void TestCtaExtension() {
+  std::vector<uint8_t> edid = BaseBlock();
+  edid[126] = 1;
+  FixChecksum(edid, 0);
+  edid.resize(2 * kEdidBlockSize, 0);
+  uint8_t* cta = edid.data() + kEdidBlockSize;
+  cta[0] = 0x02;
+  cta[1] = 3;
+  cta[3] = 0x40 | 0x20 | 0x01;  // Basic audio, YCbCr 4:4:4, one native DTD.
+  const uint8_t blocks[] = {
+      0x43, 0x90, 0x04, 0x03,              // Video: 3 SVDs.
+      0x23, 0x09, 0x07, 0x07,              // Audio: 1 SAD.
+      0x65, 0x03, 0x0C, 0x00, 0x10, 0x00,  // HDMI VSDB, address 1.0.0.0.
+      0xE3, 0x06, 0x05, 0x01,              // HDR static metadata.
+  };
+  memcpy(cta + 4, blocks, sizeof(blocks));
+  cta[2] = static_cast<uint8_t>(4 + sizeof(blocks));
+  FixChecksum(edid, 1);
+
+  EdidInfo info;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  EXPECT_EQ(info.extensionCount, 1);
+  EXPECT_EQ(info.ctaBlockCount, 1);
+  EXPECT_TRUE(info.cta.basicAudio);
+  EXPECT_TRUE(info.cta.ycbcr444);
+  EXPECT_TRUE(!info.cta.ycbcr422);
+  EXPECT_EQ(info.cta.nativeDtdCount, 1);
+  EXPECT_EQ(info.cta.videoDataBlockCount, 3);
+  EXPECT_EQ(info.cta.audioDataBlockCount, 1);
+  EXPECT_TRUE(info.cta.hasHdmiVsdb);
+  EXPECT_TRUE(!info.cta.hasHdmiForumVsdb);
+  EXPECT_TRUE(info.cta.hasHdrStaticMetadata);
+  EXPECT_EQ(info.cta.hdmiPhysicalAddress, 0x1000);
+
+  // A declared extension that was not read is not decoded.
+  EXPECT_TRUE(DecodeEdid(edid.data(), kEdidBlockSize, info));
+  EXPECT_EQ(info.extensionCount, 1);
+  EXPECT_EQ(info.ctaBlockCount, 0);
+}
+
+static void TestStableId() {
+  std::vector<uint8_t> edid = BaseBlock();
+  FixChecksum(edid, 0);
+  EdidInfo info;
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  std::string id = EdidStableId(info, "DP-1");
+  EXPECT_EQ(id.size(), 21u);
+  EXPECT_TRUE(id.compare(0, 5, "edid:") == 0);
+  // With a serial the connector does not matter.
+  EXPECT_TRUE(EdidStableId(info, "HDMI-A-1") == id);
+
+  // Without one it does, so two identical panels stay apart.
+  memset(edid.data() + 12, 0, 4);
+  EXPECT_TRUE(DecodeEdid(edid.data(), edid.size(), info));
+  std::string dp = EdidStableId(info, "DP-1");
+  EXPECT_TRUE(dp != id);
+  EXPECT_TRUE(EdidStableId(info, "DP-2") != dp);
+
+  EdidInfo empty = {};
+  EXPECT_TRUE(EdidStableId(empty, "DP-1").empty());
+  EXPECT_TRUE(EdidDisplayName(empty).empty());
+}
+
+int main() {
+  TestChecksum();
+  TestManufacturerAndSerial();
+  TestDescriptors();
+  TestCtaExtension();
+  TestStableId();
+  return TestFailures();
+}
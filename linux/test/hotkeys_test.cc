@@ -0,0 +1,93 @@
+#include "hotkeys.h"
+
+#include <vector>
+
+#include "test_support.h"
+
+static const int64_t kRepeatUs = 100000;
+
+static struct input_event Key(unsigned short code, int value) {
+  struct input_event ev = {};
+  ev.type = EV_KEY;
+  ev.code = code;
+  ev.value = value;
+  return ev;
+}
+
+static struct input_event Syn() {
+  struct input_event ev = {};
+  ev.type = EV_SYN;
+  ev.code = SYN_REPORT;
+  return ev;
+}
+
+static void TestIsHotkeyCandidate() {
+  EXPECT_TRUE(IsHotkeyCandidate("event0"));
+  EXPECT_TRUE(IsHotkeyCandidate("event17"));
+  EXPECT_TRUE(!IsHotkeyCandidate("event"));
+  EXPECT_TRUE(!IsHotkeyCandidate("mouse0"));
+  EXPECT_TRUE(!IsHotkeyCandidate("mice"));
+  EXPECT_TRUE(!IsHotkeyCandidate("by-id"));
+  EXPECT_TRUE(!IsHotkeyCandidate("js0"));
+  EXPECT_TRUE(!IsHotkeyCandidate("event3.tmp"));
+  EXPECT_TRUE(!IsHotkeyCandidate("xevent3"));
+}
+
+static void TestPressesAndReleases() {
+  int64_t lastKeyUs = 0;
+  uint64_t presses = 0;
+  std::vector<struct input_event> events = {
+      Key(KEY_BRIGHTNESSUP, 1), Syn(), Key(KEY_BRIGHTNESSUP, 0), Syn(),
+      Key(KEY_BRIGHTNESSUP, 1), Key(KEY_BRIGHTNESSUP, 0),
+      Key(KEY_BRIGHTNESSDOWN, 1), Key(KEY_BRIGHTNESSDOWN, 0)};
+  EXPECT_EQ(HotkeySteps(events.data(), events.size(), 1000000, kRepeatUs, lastKeyUs, presses), 1);
+  EXPECT_EQ(presses, 3);
+  EXPECT_EQ(lastKeyUs, 1000000);
+
+  // Other keys and other event types do not step.
+  struct input_event rel = {};
+  rel.type = EV_REL;
+  rel.code = KEY_BRIGHTNESSUP;
+  rel.value = 1;
+  events = {Key(KEY_A, 1), Key(KEY_VOLUMEUP, 1), rel};
+  EXPECT_EQ(HotkeySteps(events.data(), events.size(), 2000000, kRepeatUs, lastKeyUs, presses), 0);
+  EXPECT_EQ(presses, 3);
+}
+
+static void TestRepeatThinning() {
+  int64_t lastKeyUs = 0;
+  uint64_t presses = 0;
+  struct input_event press = Key(KEY_BRIGHTNESSDOWN, 1);
+  struct input_event repeat = Key(KEY_BRIGHTNESSDOWN, 2);
+
+  int64_t now = 5000000;
+  EXPECT_EQ(HotkeySteps(&press, 1, now, kRepeatUs, lastKeyUs, presses), -1);
+  // A repeat 33 ms after the press is dropped; one 100 ms after counts.
+  EXPECT_EQ(HotkeySteps(&repeat, 1, now + 33000, kRepeatUs, lastKeyUs, presses), 0);
+  EXPECT_EQ(HotkeySteps(&repeat, 1, now + 100000, kRepeatUs, lastKeyUs, presses), -1);
+  EXPECT_EQ(lastKeyUs, now + 100000);
+
+  // A second of repeat every 34 ms (the uinput recipe in the docs) is the
+  // press plus every third repeat.
+  lastKeyUs = 0;
+  presses = 0;
+  int steps = HotkeySteps(&press, 1, now, kRepeatUs, lastKeyUs, presses);
+  for (int i = 1; i <= 30; i++) {
+    steps += HotkeySteps(&repeat, 1, now + i * 34000, kRepeatUs, lastKeyUs, presses);
+  }
+  EXPECT_EQ(steps, -11);
+  EXPECT_EQ(presses, static_cast<uint64_t>(-steps));
+
+  // Repeats in one batch share one timestamp, so only the first counts;
+  // a fresh press always counts.
+  lastKeyUs = 0;
+  std::vector<struct input_event> batch = {repeat, repeat, repeat, press};
+  EXPECT_EQ(HotkeySteps(batch.data(), batch.size(), now, kRepeatUs, lastKeyUs, presses), -2);
+}
+
+int main() {
+  TestIsHotkeyCandidate();
+  TestPressesAndReleases();
+  TestRepeatThinning();
+  return TestFailures();
+}
@@ -0,0 +1,58 @@
+#include "kms_uapi.h"
+
+#include "test_support.h"
+
+// The layouts themselves are static_asserts in kms_uapi.h.  This checks
+// the ioctl numbers against the values the kernel headers produce, and
+// against the headers themselves where they are installed.
+#if __has_include(<drm/drm_mode.h>)
+#include <drm/drm.h>
+#include <drm/drm_mode.h>
+#define HAVE_DRM_UAPI 1
+#endif
+
+static void TestIoctlNumbers() {
+  EXPECT_EQ(kDrmIoctlSetClientCap, 0x4010640dUL);
+  EXPECT_EQ(kDrmIoctlGetResources, 0xc04064a0UL);
+  EXPECT_EQ(kDrmIoctlGetEncoder, 0xc01464a6UL);
+  EXPECT_EQ(kDrmIoctlGetConnector, 0xc05064a7UL);
+  EXPECT_EQ(kDrmIoctlGetProperty, 0xc04064aaUL);
+  EXPECT_EQ(kDrmIoctlObjGetProperties, 0xc02064b9UL);
+  EXPECT_EQ(kDrmIoctlAtomic, 0xc03864bcUL);
+  EXPECT_EQ(kDrmIoctlCreateBlob, 0xc01064bdUL);
+  EXPECT_EQ(kDrmIoctlDestroyBlob, 0xc00464beUL);
+}
+
+static void TestAgainstKernelHeaders() {
+#ifdef HAVE_DRM_UAPI
+  EXPECT_EQ(kDrmIoctlSetClientCap, DRM_IOCTL_SET_CLIENT_CAP);
+  EXPECT_EQ(kDrmIoctlGetResources, DRM_IOCTL_MODE_GETRESOURCES);
+  EXPECT_EQ(kDrmIoctlGetEncoder, DRM_IOCTL_MODE_GETENCODER);
+  EXPECT_EQ(kDrmIoctlGetConnector, DRM_IOCTL_MODE_GETCONNECTOR);
+  EXPECT_EQ(kDrmIoctlGetProperty, DRM_IOCTL_MODE_GETPROPERTY);
+  EXPECT_EQ(kDrmIoctlObjGetProperties, DRM_IOCTL_MODE_OBJ_GETPROPERTIES);
+  EXPECT_EQ(kDrmIoctlAtomic, DRM_IOCTL_MODE_ATOMIC);
+  EXPECT_EQ(kDrmIoctlCreateBlob, DRM_IOCTL_MODE_CREATEPROPBLOB);
+  EXPECT_EQ(kDrmIoctlDestroyBlob, DRM_IOCTL_MODE_DESTROYPROPBLOB);
+
+  EXPECT_EQ(kDrmClientCapUniversalPlanes, DRM_CLIENT_CAP_UNIVERSAL_PLANES);
+  EXPECT_EQ(kDrmClientCapAtomic, DRM_CLIENT_CAP_ATOMIC);
+  EXPECT_EQ(kDrmObjectCrtc, DRM_MODE_OBJECT_CRTC);
+  EXPECT_EQ(kDrmAtomicNonblock, DRM_MODE_ATOMIC_NONBLOCK);
+  EXPECT_EQ(kDrmModeInfoSize, sizeof(struct drm_mode_modeinfo));
+
+  EXPECT_EQ(offsetof(KmsGetConnector, connectorTypeId),
+            offsetof(struct drm_mode_get_connector, connector_type_id));
+  EXPECT_EQ(offsetof(KmsGetProperty, countValues),
+            offsetof(struct drm_mode_get_property, count_values));
+  EXPECT_EQ(offsetof(KmsAtomic, userData), offsetof(struct drm_mode_atomic, user_data));
+#else
+  fprintf(stderr, "kernel DRM headers not installed; checked the known numbers only\n");
+#endif
+}
+
+int main() {
+  TestIoctlNumbers();
+  TestAgainstKernelHeaders();
+  return TestFailures();
+}
@@ -0,0 +1,84 @@
+#!/bin/sh
+# Harness for the wlr-gamma-control backend on a headless sway.
+#
+#   sway_gamma_test.sh BINARY
+#
+# Starts sway with the headless backend in a private XDG_RUNTIME_DIR and
+# checks that:
+#   - a one-shot --set with gamma dimming never reports success, since the
+#     compositor drops the ramp when the process exits;
+#   - --serve binds zwlr_gamma_control_manager_v1 and answers a gamma
+#     write over the control socket.
+# Needs sway and socat.  Exits 77, which ctest reports as skipped, when
+# either or BINARY is missing or sway does not come up.
+
+set -u
+bin=${1:-}
+
+skip() { echo "SKIP: $*"; exit 77; }
+fail() { echo "FAIL: $*"; [ -s "$dir/log" ] && cat "$dir/log"; exit 1; }
+
+[ -n "$bin" ] && [ -x "$bin" ] || skip "runner binary not built ($bin)"
+command -v sway >/dev/null 2>&1 || skip "sway not installed"
+command -v socat >/dev/null 2>&1 || skip "socat not installed"
+
+dir=$(mktemp -d)
+chmod 700 "$dir"
+sway_pid=
+serve_pid=
+cleanup() {
+  [ -n "$serve_pid" ] && kill "$serve_pid" 2>/dev/null
+  [ -n "$sway_pid" ] && kill "$sway_pid" 2>/dev/null
+  wait 2>/dev/null
+  rm -rf "$dir"
+}
+trap cleanup EXIT
+
+export XDG_RUNTIME_DIR="$dir"
+unset DISPLAY WAYLAND_DISPLAY BS_DISPLAY_CONTROL_GAMMA
+: >"$dir/sway.conf"
+WLR_BACKENDS=headless WLR_LIBINPUT_NO_DEVICES=1 WLR_RENDERER=pixman \
+  sway -c "$dir/sway.conf" >"$dir/sway.log" 2>&1 &
+sway_pid=$!
+
+for _ in $(seq 50); do
+  WAYLAND_DISPLAY=$(cd "$dir" && ls wayland-? 2>/dev/null | head -n1)
+  [ -n "$WAYLAND_DISPLAY" ] && break
+  sleep 0.1
+done
+[ -n "$WAYLAND_DISPLAY" ] || skip "headless sway did not start"
+export WAYLAND_DISPLAY
+id=wayland:HEADLESS-1
+
+# One-shot dimming must fail: either the control is refused (no gamma on
+# the headless output) or the runner declines because it would revert.
+if "$bin" --set "$id=-0.25" >"$dir/out" 2>"$dir/log"; then
+  fail "one-shot --set $id=-0.25 reported success under wlroots"
+fi
+grep -q '"ok":false' "$dir/out" || fail "one-shot --set printed no failed result"
+if grep -q 'wlr-gamma: 0 outputs\|no output named' "$dir/log"; then
+  fail "the runner did not see $id"
+fi
+
+# Resident: the same write goes through the control socket.  The reply is
+# ok:false because a headless output has no hardware brightness, but the
+# gamma half must have reached the compositor.
+"$bin" --serve 2>"$dir/log" &
+serve_pid=$!
+sock="$dir/bs_display_control.sock"
+for _ in $(seq 50); do
+  [ -S "$sock" ] && break
+  sleep 0.1
+done
+[ -S "$sock" ] || fail "--serve did not create $sock"
+reply=$(echo "set $id -0.25" | socat -t 5 - "UNIX-CONNECT:$sock")
+case "$reply" in
+  *'"displays":'*) ;;
+  *) fail "unexpected reply to set: $reply" ;;
+esac
+grep -q 'wlr-gamma: [1-9]' "$dir/log" || fail "--serve did not bind wlr-gamma-control"
+if grep -q 'would revert' "$dir/log"; then
+  fail "--serve treated its writes as one-shot"
+fi
+
+echo "PASS: wlr-gamma one-shot and --serve behave under headless sway"
@@ -0,0 +1,37 @@
+#ifndef FLUTTER_TEST_SUPPORT_H_
+#define FLUTTER_TEST_SUPPORT_H_
+
+// Minimal checks for the runner tests: each failure is printed and
+// counted, and main() returns TestFailures() as the exit status.
+
+#include <cmath>
+#include <cstdio>
+
+inline int g_testFailures = 0;
+
+#define EXPECT_TRUE(cond)                                                   \
+  do {                                                                      \
+    if (!(cond)) {                                                          \
+      fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond);   \
+      g_testFailures++;                                                     \
+    }                                                                       \
+  } while (0)
+
+#define EXPECT_NEAR(actual, expected, tolerance)                            \
+  do {                                                                      \
+    double a_ = (actual), e_ = (expected);                                  \
+    if (!(std::fabs(a_ - e_) <= (tolerance))) {                             \
+      fprintf(stderr, "%s:%d: %s is %g, expected %g\n", __FILE__, __LINE__, \
+              #actual, a_, e_);                                             \
+      g_testFailures++;                                                     \
+    }                                                                       \
+  } while (0)
+
+#define EXPECT_EQ(actual, expected) EXPECT_NEAR(actual, expected, 0.0)
+
+inline int TestFailures() {
+  if (g_testFailures) fprintf(stderr, "%d check(s) failed\n", g_testFailures);
+  return g_testFailures ? 1 : 0;
+}
+
+#endif  // FLUTTER_TEST_SUPPORT_H_